@@ -29,9 +29,10 @@ class PageId;
 class ProjectReader;
 class ProjectWriter;
 class AbstractRelinker;
+class ProjectIndexSection;
 class QString;
-class QDomDocument;
-class QDomElement;
+class QXmlStreamReader;
+class QXmlStreamWriter;
 
 /**
  * Filters represent processing stages, like "Deskew", "Margins" and "Output".
@@ -59,11 +60,42 @@ public:
 
 	virtual void preUpdateUI(FilterUiInterface* ui, PageId const& page_id) = 0;
 	
-	virtual QDomElement saveSettings(
-		ProjectWriter const& writer, QDomDocument& doc) const = 0;
+	/**
+	 * \brief The name of the element under <filters> in a project file
+	 *        that holds the settings of this filter.
+	 */
+	virtual QString settingsElementName() const = 0;
+
+	/**
+	 * \brief Writes the settings element of this filter.
+	 *
+	 * Per-page or per-image settings are to be written one at a time,
+	 * so that a project never has to be fully present in memory.
+	 */
+	virtual void saveSettings(
+		ProjectWriter const& writer, QXmlStreamWriter& xml) const = 0;
 	
+	/**
+	 * \brief Reads the element written by saveSettings().
+	 *
+	 * \param reader Provides mapping from numeric ids to pages and images.
+	 * \param xml The stream positioned at the start of the settings element.
+	 *        On return, it has to be positioned at the end of that element.
+	 */
 	virtual void loadSettings(
-		ProjectReader const& reader, QDomElement const& filters_el) = 0;
+		ProjectReader const& reader, QXmlStreamReader& xml) = 0;
+
+	/**
+	 * \brief Loads settings from a project index, deferring the parsing
+	 *        of per-page settings until they are accessed.
+	 *
+	 * \return false if this filter doesn't support deferred loading.
+	 *         ProjectReader then calls loadSettings() instead.
+	 */
+	virtual bool loadDeferredSettings(
+		ProjectReader const& reader, ProjectIndexSection const& section) {
+		return false;
+	}
 };
 
 #endif
@@ -21,44 +21,60 @@
 #include <QCoreApplication>
 #include <QObject>
 #include <QThread>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
 #include <QEvent>
+#include <boost/foreach.hpp>
+#include <deque>
+#include <vector>
 #include <new>
 #include <assert.h>
 
-class BackgroundExecutor::Dispatcher : public QObject
+class BackgroundExecutor::Thread : public QThread
 {
 public:
-	Dispatcher(Impl& owner);
+	Thread(Impl& owner);
 protected:
-	virtual void customEvent(QEvent* event);
+	virtual void run();
 private:
 	Impl& m_rOwner;
 };
 
 
-class BackgroundExecutor::Impl : public QThread
+class BackgroundExecutor::Impl : public QObject
 {
+	friend class BackgroundExecutor::Thread;
 public:
-	Impl(BackgroundExecutor& owner);
+	Impl(BackgroundExecutor& owner, int num_threads);
 	
 	~Impl();
 	
 	void enqueueTask(TaskPtr const& task);
 protected:
-	virtual void run();
-	
 	virtual void customEvent(QEvent* event);
 private:
+	/**
+	 * Blocks until a task is available or we are shutting down.
+	 * In the latter case, a null task is returned.
+	 */
+	TaskPtr takeTask();
+
 	BackgroundExecutor& m_rOwner;
-	Dispatcher m_dispatcher;
-	bool m_threadStarted;
+	QMutex m_mutex;
+	QWaitCondition m_cond;
+	std::deque<TaskPtr> m_queue;
+	std::vector<Thread*> m_threads;
+	int const m_maxThreads;
+	int m_idleThreads;
+	bool m_exiting;
 };
 
 
 /*============================ BackgroundExecutor ==========================*/
 
-BackgroundExecutor::BackgroundExecutor()
-:	m_ptrImpl(new Impl(*this))
+BackgroundExecutor::BackgroundExecutor(int const num_threads)
+:	m_ptrImpl(new Impl(*this, num_threads))
 {
 }
 
@@ -81,65 +97,96 @@ BackgroundExecutor::enqueueTask(TaskPtr const& task)
 }
 
 
-/*===================== BackgroundExecutor::Dispatcher =====================*/
+/*======================= BackgroundExecutor::Thread =======================*/
 
-BackgroundExecutor::Dispatcher::Dispatcher(Impl& owner)
+BackgroundExecutor::Thread::Thread(Impl& owner)
 :	m_rOwner(owner)
 {
 }
 
 void
-BackgroundExecutor::Dispatcher::customEvent(QEvent* event)
+BackgroundExecutor::Thread::run()
 {
-	try {
-		TaskEvent* evt = dynamic_cast<TaskEvent*>(event);
-		assert(evt);
-
-		TaskPtr const& task = evt->payload();
-		assert(task);
-
-		TaskResultPtr const result((*task)());
-		if (result) {
-			QCoreApplication::postEvent(
-				&m_rOwner, new ResultEvent(result)
-			);
+	for (;;) {
+		TaskPtr const task(m_rOwner.takeTask());
+		if (!task) {
+			break;
+		}
+
+		try {
+			TaskResultPtr const result((*task)());
+			if (result) {
+				QCoreApplication::postEvent(
+					&m_rOwner, new ResultEvent(result)
+				);
+			}
+		} catch (std::bad_alloc const&) {
+			OutOfMemoryHandler::instance().handleOutOfMemorySituation();
 		}
-	} catch (std::bad_alloc const&) {
-		OutOfMemoryHandler::instance().handleOutOfMemorySituation();
 	}
 }
 
 
 /*======================= BackgroundExecutor::Impl =========================*/
 
-BackgroundExecutor::Impl::Impl(BackgroundExecutor& owner)
+BackgroundExecutor::Impl::Impl(BackgroundExecutor& owner, int const num_threads)
 :	m_rOwner(owner),
-	m_dispatcher(*this),
-	m_threadStarted(false)
+	m_maxThreads(num_threads < 1 ? 1 : num_threads),
+	m_idleThreads(0),
+	m_exiting(false)
 {
-	m_dispatcher.moveToThread(this);
 }
 
 BackgroundExecutor::Impl::~Impl()
 {
-	exit();
-	wait();
+	{
+		QMutexLocker const locker(&m_mutex);
+		m_exiting = true;
+		m_queue.clear();
+		m_cond.wakeAll();
+	}
+
+	BOOST_FOREACH(Thread* thread, m_threads) {
+		thread->wait();
+		delete thread;
+	}
 }
 
 void
 BackgroundExecutor::Impl::enqueueTask(TaskPtr const& task)
 {
-	QCoreApplication::postEvent(&m_dispatcher, new TaskEvent(task));
-	if (!m_threadStarted) {
-		start();
-		m_threadStarted = true;
+	QMutexLocker const locker(&m_mutex);
+
+	m_queue.push_back(task);
+	
+	// Threads are started lazily, when none of the existing ones
+	// is waiting for work.
+	if (m_idleThreads == 0 && (int)m_threads.size() < m_maxThreads) {
+		m_threads.push_back(new Thread(*this));
+		m_threads.back()->start();
 	}
+
+	m_cond.wakeOne();
 }
 
-void
-BackgroundExecutor::Impl::run()
+BackgroundExecutor::TaskPtr
+BackgroundExecutor::Impl::takeTask()
 {
-	exec();
+	QMutexLocker const locker(&m_mutex);
+
+	++m_idleThreads;
+	while (m_queue.empty() && !m_exiting) {
+		m_cond.wait(&m_mutex);
+	}
+	--m_idleThreads;
+
+	if (m_exiting) {
+		return TaskPtr();
+	}
+
+	TaskPtr const task(m_queue.front());
+	m_queue.pop_front();
+	return task;
 }
 
 void
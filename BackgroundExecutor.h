@@ -32,7 +32,15 @@ public:
 	typedef IntrusivePtr<AbstractCommand0<void> > TaskResultPtr;
 	typedef IntrusivePtr<AbstractCommand0<TaskResultPtr> > TaskPtr;
 	
-	BackgroundExecutor();
+	/**
+	 * \brief Creates an executor backed by \p num_threads background threads.
+	 *
+	 * With more than one thread, tasks may run concurrently and finish
+	 * in an order different from the one they were enqueued in.
+	 * Result functors are still executed in the thread where this
+	 * object was constructed.
+	 */
+	explicit BackgroundExecutor(int num_threads = 1);
 	
 	/**
 	 * \brief Waits for background tasks to finish, then destroys the object.
@@ -59,8 +67,7 @@ public:
 	void enqueueTask(TaskPtr const& task);
 private:
 	class Impl;
-	class Dispatcher;
-	typedef PayloadEvent<TaskPtr> TaskEvent;
+	class Thread;
 	typedef PayloadEvent<TaskResultPtr> ResultEvent;
 	
 	std::auto_ptr<Impl> m_ptrImpl;
@@ -166,6 +166,7 @@ CommandLine::setup()
 	m_deskewAngle = fetchDeskewAngle();
 	m_startFilterIdx = fetchStartFilterIdx();
 	m_endFilterIdx = fetchEndFilterIdx();
+	m_memoryBudget = fetchMemoryBudget();
 }
 
 
@@ -209,6 +210,8 @@ CommandLine::printHelp()
 	std::cout << "\t--content-box=<<left_offset>x<top_offset>:<width>x<height>>" << "\n";
 	std::cout << "\t\t\t\t\t\t-- if set the content detection is se to manual mode" << "\n";
 	std::cout << "\t\t\t\t\t\t   example: --content-box=100x100:1500x2500" << "\n";
+	std::cout << "\t--fast-content-detection\t\t-- detect content at 75 dpi rather than at 150 dpi," << "\n";
+	std::cout << "\t\t\t\t\t\t   then refine the box edges at 150 dpi" << "\n";
 	std::cout << "\t--margins=<number>\t\t\t-- sets left, top, right and bottom margins to same number." << "\n";
 	std::cout << "\t\t--margins-left=<number>" << "\n";
 	std::cout << "\t\t--margins-right=<number>" << "\n";
@@ -233,6 +236,11 @@ CommandLine::printHelp()
 	std::cout << "\t--start-filter=<1...6>\t\t\t-- default: 4" << "\n";
 	std::cout << "\t--end-filter=<1...6>\t\t\t-- default: 6" << "\n";
 	std::cout << "\t--output-project=, -o=<project_name>" << "\n";
+	std::cout << "\t--analyze-all\t\t\t\t-- analyze all pages in parallel, then generate output in parallel" << "\n";
+	std::cout << "\t\t--threads=<n>\t\t\t-- default: number of CPU cores" << "\n";
+	std::cout << "\t--profile[=<file.json>]\t\t\t-- write per-page, per-step timings; default: scantailor-profile.json" << "\n";
+	std::cout << "\t\t--profile-format=<trace|summary>\t-- default: trace (chrome://tracing)" << "\n";
+	std::cout << "\t--memory-budget=<megabytes>\t\t-- images exceeding it go to temporary files; default: 0 (unlimited)" << "\n";
 	std::cout << "\n";
 }
 
@@ -422,6 +430,15 @@ CommandLine::fetchOutputProjectFile()
 	return m_options.value("output-project");
 }
 
+int
+CommandLine::fetchMemoryBudget()
+{
+	if (!hasMemoryBudget())
+		return 0;
+
+	return m_options.value("memory-budget").toInt();
+}
+
 int
 CommandLine::fetchThreshold()
 {
@@ -516,3 +533,15 @@ CommandLine::hasOutputDpi() const
 		m_options.contains("output-dpi-y")
 	);
 }
+
+QString
+CommandLine::getProfileFile() const
+{
+	// A switch without a value is stored as "true".
+	QString const file(m_options.value("profile"));
+	if (file.isEmpty() || file == "true") {
+		return "scantailor-profile.json";
+	}
+
+	return file;
+}
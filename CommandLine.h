@@ -74,6 +74,7 @@ public:
 	bool hasDeskewAngle() const { return contains("rotate"); }
 	bool hasDeskew() const { return contains("deskew"); }
 	bool hasContentRect() const { return contains("content-box"); }
+	bool hasFastContentDetection() const { return contains("fast-content-detection"); }
 	bool hasColorMode() const { return contains("color-mode"); }
 	bool hasWhiteMargins() const { return contains("white-margins"); }
 	bool hasNormalizeIllumination() const { return contains("normalize-illumination"); }
@@ -81,6 +82,10 @@ public:
 	bool hasDespeckle() const { return contains("despeckle"); }
 	bool hasDewarping() const { return contains("dewarping"); }
 	bool hasDepthPerception() const { return contains("dewarping"); }
+	bool hasMemoryBudget() const { return contains("memory-budget"); }
+	bool hasProfile() const { return contains("profile"); }
+	bool isAnalyzeAll() const { return contains("analyze-all"); }
+	bool hasThreads() const { return contains("threads"); }
 
 	page_split::LayoutType getLayout() const { return m_layoutType; }
 	Qt::LayoutDirection getLayoutDirection() const { return m_layoutDirection; }
@@ -99,6 +104,10 @@ public:
 	output::DewarpingMode getDewarpingMode() const { return m_dewarpingMode; }
 	output::DespeckleLevel getDespeckleLevel() const { return m_despeckleLevel; }
 	output::DepthPerception getDepthPerception() const { return m_depthPerception; }
+	int getMemoryBudget() const { return m_memoryBudget; }
+	int getThreads() const { return m_options.value("threads").toInt(); }
+	QString getProfileFile() const;
+	bool isProfileSummary() const { return m_options.value("profile-format") == "summary"; }
 
 	bool help() { return m_options.contains("help"); }
 	void printHelp();
@@ -140,6 +149,7 @@ private:
 	output::DewarpingMode m_dewarpingMode;
 	output::DespeckleLevel m_despeckleLevel;
 	output::DepthPerception m_depthPerception;
+	int m_memoryBudget;
 
 	void parseCli(QStringList const& argv);
 	void addImage(QString const& path);
@@ -161,6 +171,7 @@ private:
 	output::DewarpingMode fetchDewarpingMode();
 	output::DespeckleLevel fetchDespeckleLevel();
 	output::DepthPerception fetchDepthPerception();
+	int fetchMemoryBudget();
 };
 
 #endif
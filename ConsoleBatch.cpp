@@ -19,7 +19,10 @@
 */
 
 #include <vector>
+#include <string>
 #include <iostream>
+#include <stdexcept>
+#include <algorithm>
 #include <assert.h>
 
 #include "Utils.h"
@@ -38,8 +41,12 @@
 #include "LoadFileTask.h"
 #include "ProjectWriter.h"
 #include "ProjectReader.h"
+#include "ProjectIndex.h"
 #include "OrthogonalRotation.h"
 #include "SelectedPage.h"
+#include "NonCopyable.h"
+#include "MemoryBudget.h"
+#include "Profiler.h"
 
 #include "filters/fix_orientation/Settings.h"
 #include "filters/fix_orientation/Filter.h"
@@ -68,11 +75,115 @@
 #include "filters/output/CacheDrivenTask.h"
 
 #include <QMap>
-#include <QDomDocument>
+#include <QThread>
+#include <QMutex>
+#include <QMutexLocker>
 
 #include "ConsoleBatch.h"
 #include "CommandLine.h"
 
+namespace
+{
+
+/**
+ * Runs a list of tasks on a number of threads and waits for all of them.
+ *
+ * Tasks running concurrently share the filters' Settings, ProjectPages,
+ * FileNameDisambiguator and ThumbnailPixmapCache, all of which protect
+ * their state with a mutex, as well as output::OutputWriter, which is
+ * thread-safe.  DerivedImageCache belongs to the FilterData of a single
+ * task and is never shared.
+ */
+class ParallelTaskRunner
+{
+	DECLARE_NON_COPYABLE(ParallelTaskRunner)
+public:
+	ParallelTaskRunner(std::vector<BackgroundTaskPtr> const& tasks)
+	: m_rTasks(tasks), m_nextTask(0) {}
+
+	/**
+	 * \brief Runs the tasks and returns when they are all done.
+	 *
+	 * If a task throws, no more tasks are started, and the error
+	 * is re-thrown from here as std::runtime_error.  The tasks that
+	 * are already running are allowed to finish.
+	 */
+	void run(int num_threads);
+private:
+	class Thread : public QThread
+	{
+	public:
+		Thread(ParallelTaskRunner& owner) : m_rOwner(owner) {}
+	protected:
+		virtual void run() { m_rOwner.processTasks(); }
+	private:
+		ParallelTaskRunner& m_rOwner;
+	};
+
+	void processTasks();
+
+	std::vector<BackgroundTaskPtr> const& m_rTasks;
+	QMutex m_mutex;
+	size_t m_nextTask;
+	std::string m_error;
+};
+
+void
+ParallelTaskRunner::run(int const num_threads)
+{
+	// Function-local statics aren't guaranteed to be initialized
+	// in a thread-safe way, so make sure the tasks find them constructed.
+	MemoryBudget::instance();
+	Profiler::instance();
+	
+	std::vector<Thread*> threads;
+	for (int i = 0; i < num_threads && i < (int)m_rTasks.size(); ++i) {
+		threads.push_back(new Thread(*this));
+		threads.back()->start();
+	}
+	for (size_t i = 0; i < threads.size(); ++i) {
+		threads[i]->wait();
+		delete threads[i];
+	}
+
+	if (!m_error.empty()) {
+		throw std::runtime_error(m_error);
+	}
+}
+
+void
+ParallelTaskRunner::processTasks()
+{
+	for (;;) {
+		BackgroundTaskPtr task;
+		{
+			QMutexLocker const locker(&m_mutex);
+			if (m_nextTask == m_rTasks.size() || !m_error.empty()) {
+				return;
+			}
+			task = m_rTasks[m_nextTask++];
+		}
+
+		try {
+			MemoryBudget::Admission const admission;
+			MemoryBudget::ScratchArena const arena;
+			(*task)();
+		} catch (std::exception const& e) {
+			QMutexLocker const locker(&m_mutex);
+			if (m_error.empty()) {
+				m_error = e.what();
+			}
+		} catch (...) {
+			QMutexLocker const locker(&m_mutex);
+			if (m_error.empty()) {
+				m_error = "Unknown error while processing a page.";
+			}
+		}
+	}
+}
+
+} // anonymous namespace
+
 ConsoleBatch::ConsoleBatch(std::vector<ImageFileInfo> const& images, QString const& output_directory, Qt::LayoutDirection const layout)
 :   batch(true), debug(true),
 	m_ptrDisambiguator(new FileNameDisambiguator),
@@ -93,15 +204,16 @@ ConsoleBatch::ConsoleBatch(QString const project_file)
 	if (!file.open(QIODevice::ReadOnly)) {
 		throw std::runtime_error("Unable to open the project file.");
 	}
+	file.close();
 
-	QDomDocument doc;
-	if (!doc.setContent(&file)) {
+	m_ptrReader.reset(
+		new ProjectReader(project_file, ProjectIndex::indexPathFor(project_file))
+	);
+
+	if (!m_ptrReader->success()) {
 		throw std::runtime_error("The project file is broken.");
 	}
 
-	file.close();
-
-	m_ptrReader.reset(new ProjectReader(doc));
 	m_ptrPages = m_ptrReader->pages();
 
 	PageSelectionAccessor const accessor((IntrusivePtr<PageSelectionProvider>())); // Won't be used anyway.
@@ -207,6 +319,15 @@ ConsoleBatch::process()
 		endFilterIdx = ef;
 	}
 
+	if (cli.isAnalyzeAll()) {
+		int num_threads = cli.hasThreads() ? cli.getThreads() : QThread::idealThreadCount();
+		if (num_threads < 1) {
+			num_threads = 1;
+		}
+		processAnalyzeAll(startFilterIdx, endFilterIdx, num_threads);
+		return;
+	}
+
 	for (int j=startFilterIdx; j<=endFilterIdx; j++) {
 		if (cli.isVerbose())
 			std::cout << "Filter: " << (j+1) << "\n";
@@ -223,9 +344,73 @@ ConsoleBatch::process()
 	}
 }
 
+void
+ConsoleBatch::analyzeAll(int const num_threads)
+{
+	processAnalyzeAll(
+		m_ptrStages->fixOrientationFilterIdx(),
+		m_ptrStages->outputFilterIdx(), num_threads
+	);
+}
+
+void
+ConsoleBatch::processAnalyzeAll(
+	int const start_filter_idx, int const end_filter_idx, int const num_threads)
+{
+	CommandLine const& cli = CommandLine::get();
+
+	int const last_filter_in_group[] = {
+		m_ptrStages->pageSplitFilterIdx(),
+		m_ptrStages->pageLayoutFilterIdx(),
+		m_ptrStages->outputFilterIdx()
+	};
+
+	int first_in_group = m_ptrStages->fixOrientationFilterIdx();
+	for (int group = 0; group < 3; ++group) {
+		int const first = std::max(first_in_group, start_filter_idx);
+		int const last = std::min(last_filter_in_group[group], end_filter_idx);
+		first_in_group = last_filter_in_group[group] + 1;
+		if (first > last) {
+			continue;
+		}
+
+		// Re-created for every group, as page splitting changes the pages.
+		PageSequence const page_sequence(m_ptrPages->toPageSequence(PAGE_VIEW));
+		for (int j = first; j <= last; ++j) {
+			if (cli.isVerbose())
+				std::cout << "Filter: " << (j+1) << "\n";
+			setupFilter(j, page_sequence.selectAll());
+		}
+
+		// Tasks are created here rather than in the worker threads,
+		// as createCompositeTask() isn't thread-safe.
+		std::vector<BackgroundTaskPtr> tasks;
+		tasks.reserve(page_sequence.numPages());
+		for (unsigned i=0; i<page_sequence.numPages(); i++) {
+			PageInfo const page(page_sequence.pageAt(i));
+			if (cli.isVerbose())
+				std::cout << "\tProcessing: " << page.imageId().filePath().toAscii().constData() << "\n";
+			tasks.push_back(createCompositeTask(page, last));
+		}
+
+		// By the time the output group runs, the page layout group has
+		// registered every page's content size, so the aggregate page
+		// size is computed once and doesn't change under the output tasks.
+		ParallelTaskRunner(tasks).run(num_threads);
+	}
+}
+
+void
+ConsoleBatch::waitForOutputFiles()
+{
+	m_ptrStages->outputFilter()->waitForOutputFiles();
+}
+
 void
 ConsoleBatch::saveProject(QString const project_file)
 {
+	waitForOutputFiles();
+	
 	PageInfo fpage = m_ptrPages->toPageSequence(PAGE_VIEW).pageAt(0);
 	SelectedPage sPage(fpage.id(), IMAGE_VIEW);
 	ProjectWriter writer(m_ptrPages, sPage, m_outFileNameGen);
@@ -51,6 +51,25 @@ public:
 	ConsoleBatch(QString const project_file);
 
 	void process();
+	
+	/**
+	 * \brief Runs all the stages the way process() does with --analyze-all,
+	 *        using the given number of threads.
+	 */
+	void analyzeAll(int num_threads);
+	
+	/**
+	 * \brief Waits for the output files still being written
+	 *        on background threads.
+	 *
+	 * Output params of a page are only committed once its files have
+	 * been written, so this has to be done before saving the project.
+	 */
+	void waitForOutputFiles();
+	
+	/**
+	 * Calls waitForOutputFiles() before saving.
+	 */
 	void saveProject(QString const project_file);
 
 private:
@@ -63,6 +82,17 @@ private:
 	IntrusivePtr<ThumbnailPixmapCache> m_ptrThumbnailCache;
 	std::auto_ptr<ProjectReader> m_ptrReader;
 
+	/**
+	 * \brief Processes all pages stage group by stage group, running
+	 *        pages in parallel within a group.
+	 *
+	 * The groups are: up to page splitting (which may change the set
+	 * of pages), up to page layout (everything that affects the
+	 * aggregate page size), and output.  This way output generation
+	 * starts only once all content boxes are known.
+	 */
+	void processAnalyzeAll(int start_filter_idx, int end_filter_idx, int num_threads);
+
 	void setupFilter(int idx, std::set<PageId> allPages);
 	void setupFixOrientation(std::set<PageId> allPages);
 	void setupPageSplit(std::set<PageId> allPages);
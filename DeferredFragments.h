@@ -0,0 +1,106 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DEFERREDFRAGMENTS_H_
+#define DEFERREDFRAGMENTS_H_
+
+#include "ProjectIndex.h"
+#include <QDomDocument>
+#include <QDomElement>
+#include <map>
+#include <vector>
+
+/**
+ * \brief Per-page (or per-image) settings elements that weren't parsed yet.
+ *
+ * Settings classes that support deferred loading keep these alongside
+ * the parsed settings.  Any access to the settings of a page is preceded
+ * by parsing its fragment, if it's still here.
+ *
+ * This class is not thread-safe.  It's meant to be protected by the same
+ * mutex that protects the settings.
+ */
+template<typename Key>
+class DeferredFragments
+{
+	// Member-wise copying is OK.
+public:
+	void add(Key const& key, ProjectIndexFragment const& fragment) {
+		m_fragments[key] = fragment;
+	}
+
+	/**
+	 * \brief Removes the fragment associated with \p key and parses it.
+	 *
+	 * \param key The key to look up.
+	 * \param doc The document to parse the fragment into.
+	 * \return The parsed element, or a null element if there was
+	 *         no fragment for \p key or it couldn't be parsed.
+	 */
+	QDomElement take(Key const& key, QDomDocument& doc);
+
+	/**
+	 * \brief Returns the keys of all fragments not yet taken.
+	 */
+	std::vector<Key> keys() const;
+
+	bool empty() const { return m_fragments.empty(); }
+
+	void clear() { m_fragments.clear(); }
+private:
+	typedef std::map<Key, ProjectIndexFragment> Fragments;
+
+	Fragments m_fragments;
+};
+
+
+template<typename Key>
+QDomElement
+DeferredFragments<Key>::take(Key const& key, QDomDocument& doc)
+{
+	typename Fragments::iterator const it(m_fragments.find(key));
+	if (it == m_fragments.end()) {
+		return QDomElement();
+	}
+
+	QByteArray const data(it->second.data());
+	m_fragments.erase(it);
+
+	if (!doc.setContent(data)) {
+		return QDomElement();
+	}
+	return doc.documentElement();
+}
+
+template<typename Key>
+std::vector<Key>
+DeferredFragments<Key>::keys() const
+{
+	std::vector<Key> keys;
+	keys.reserve(m_fragments.size());
+
+	typename Fragments::const_iterator it(m_fragments.begin());
+	typename Fragments::const_iterator const end(m_fragments.end());
+	for (; it != end; ++it) {
+		keys.push_back(it->first);
+	}
+
+	return keys;
+}
+
+#endif
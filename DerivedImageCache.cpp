@@ -0,0 +1,226 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "DerivedImageCache.h"
+#include "OrthogonalRotation.h"
+#include "imageproc/OrthogonalRotation.h"
+#include "imageproc/Scale.h"
+#include "imageproc/Constants.h"
+#include <QMutexLocker>
+#include <QSize>
+#include <algorithm>
+#include <math.h>
+
+using namespace imageproc;
+
+size_t const DerivedImageCache::DEFAULT_MAX_BINARY_BYTES = 24 * 1024 * 1024;
+
+bool
+DerivedImageCache::Key::operator<(Key const& rhs) const
+{
+	if (scaled != rhs.scaled) {
+		return scaled < rhs.scaled;
+	} else if (degrees != rhs.degrees) {
+		return degrees < rhs.degrees;
+	} else if (area.left() != rhs.area.left()) {
+		return area.left() < rhs.area.left();
+	} else if (area.top() != rhs.area.top()) {
+		return area.top() < rhs.area.top();
+	} else if (area.width() != rhs.area.width()) {
+		return area.width() < rhs.area.width();
+	} else {
+		return area.height() < rhs.area.height();
+	}
+}
+
+DerivedImageCache::DerivedImageCache(
+	GrayImage const& gray, BinaryThreshold const bw_threshold,
+	size_t const max_binary_bytes)
+:	m_gray(gray),
+	m_bwThreshold(bw_threshold),
+	m_gray300Ready(false),
+	m_maxBinaryBytes(max_binary_bytes),
+	m_binaryBytes(0),
+	m_useCounter(0)
+{
+}
+
+DerivedImageCache::~DerivedImageCache()
+{
+}
+
+GrayImage
+DerivedImageCache::gray300(QTransform* scaling)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	ensureGray300Locked();
+	if (scaling) {
+		*scaling = m_scaling300;
+	}
+	return m_gray300;
+}
+
+BinaryImage
+DerivedImageCache::binary(QRect const& area)
+{
+	QMutexLocker const locker(&m_mutex);
+	return binaryLocked(area, false);
+}
+
+BinaryImage
+DerivedImageCache::rotatedBinary(
+	QRect const& area, OrthogonalRotation const& rotation)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	return rotatedBinaryLocked(area, false, rotation.toDegrees());
+}
+
+BinaryImage
+DerivedImageCache::rotatedBinary300(
+	OrthogonalRotation const& rotation, QTransform* scaling)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	ensureGray300Locked();
+	if (scaling) {
+		*scaling = m_scaling300;
+	}
+
+	// When no scaling was necessary, share the images with binary()
+	// and rotatedBinary().
+	bool const scaled = !m_scaling300.isIdentity();
+	return rotatedBinaryLocked(m_gray300.rect(), scaled, rotation.toDegrees());
+}
+
+void
+DerivedImageCache::clear()
+{
+	QMutexLocker const locker(&m_mutex);
+
+	m_binaryImages.clear();
+	m_binaryBytes = 0;
+	m_gray300 = GrayImage();
+	m_scaling300.reset();
+	m_gray300Ready = false;
+}
+
+size_t
+DerivedImageCache::binaryBytes() const
+{
+	QMutexLocker const locker(&m_mutex);
+	return m_binaryBytes;
+}
+
+void
+DerivedImageCache::ensureGray300Locked()
+{
+	if (m_gray300Ready) {
+		return;
+	}
+
+	QImage const& img = m_gray.toQImage();
+	double const xfactor = (300.0 * constants::DPI2DPM) / img.dotsPerMeterX();
+	double const yfactor = (300.0 * constants::DPI2DPM) / img.dotsPerMeterY();
+	if (fabs(xfactor - 1.0) < 0.1 && fabs(yfactor - 1.0) < 0.1) {
+		m_gray300 = m_gray;
+		m_scaling300.reset();
+	} else {
+		QSize const new_size(
+			std::max(1, (int)ceil(xfactor * img.width())),
+			std::max(1, (int)ceil(yfactor * img.height()))
+		);
+		m_gray300 = scaleToGray(m_gray, new_size);
+		m_scaling300 = QTransform().scale(xfactor, yfactor);
+	}
+
+	m_gray300Ready = true;
+}
+
+BinaryImage
+DerivedImageCache::binaryLocked(QRect const& area, bool const scaled)
+{
+	Key const key(area, 0, scaled);
+	BinaryImage bin(findLocked(key));
+	if (bin.isNull()) {
+		GrayImage const& src = scaled ? m_gray300 : m_gray;
+		bin = area == src.rect() ? BinaryImage(src, m_bwThreshold)
+			: BinaryImage(src, area, m_bwThreshold);
+		insertLocked(key, bin);
+	}
+
+	return bin;
+}
+
+BinaryImage
+DerivedImageCache::rotatedBinaryLocked(
+	QRect const& area, bool const scaled, int const degrees)
+{
+	if (degrees == 0) {
+		return binaryLocked(area, scaled);
+	}
+
+	Key const key(area, degrees, scaled);
+	BinaryImage rotated(findLocked(key));
+	if (rotated.isNull()) {
+		rotated = orthogonalRotation(binaryLocked(area, scaled), degrees);
+		insertLocked(key, rotated);
+	}
+
+	return rotated;
+}
+
+BinaryImage
+DerivedImageCache::findLocked(Key const& key)
+{
+	BinaryImages::iterator const it(m_binaryImages.find(key));
+	if (it == m_binaryImages.end()) {
+		return BinaryImage();
+	}
+
+	it->second.lastUse = ++m_useCounter;
+	return it->second.image;
+}
+
+void
+DerivedImageCache::insertLocked(Key const& key, BinaryImage const& image)
+{
+	m_binaryImages.insert(BinaryImages::value_type(key, Entry(image, ++m_useCounter)));
+	m_binaryBytes += imageBytes(image);
+
+	// Drop the least recently used images, but never the one just inserted.
+	while (m_binaryBytes > m_maxBinaryBytes && m_binaryImages.size() > 1) {
+		BinaryImages::iterator lru(m_binaryImages.begin());
+		BinaryImages::iterator it(lru);
+		for (++it; it != m_binaryImages.end(); ++it) {
+			if (it->second.lastUse < lru->second.lastUse) {
+				lru = it;
+			}
+		}
+		m_binaryBytes -= imageBytes(lru->second.image);
+		m_binaryImages.erase(lru);
+	}
+}
+
+size_t
+DerivedImageCache::imageBytes(BinaryImage const& image)
+{
+	return size_t(image.wordsPerLine()) * image.height() * 4;
+}
@@ -0,0 +1,176 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef DERIVEDIMAGECACHE_H_
+#define DERIVEDIMAGECACHE_H_
+
+#include "NonCopyable.h"
+#include "RefCountable.h"
+#include "imageproc/BinaryImage.h"
+#include "imageproc/BinaryThreshold.h"
+#include "imageproc/GrayImage.h"
+#include <QMutex>
+#include <QTransform>
+#include <QRect>
+#include <map>
+
+class OrthogonalRotation;
+
+/**
+ * \brief Images derived from the grayscale version of the input image,
+ *        computed on demand and shared by the stages processing a page.
+ *
+ * Page split and deskew both start by binarizing the input image with
+ * the same global threshold and rotating it orthogonally.  When they run
+ * one after another on the same page, the FilterData passed between them
+ * carries the same instance of this class, so each derivation is computed
+ * at most once.  The two stages actually share an image only when the input
+ * is within 10% of 300 dpi, as page split works on a 300 dpi copy, and when
+ * deskew processes the whole image.
+ *
+ * Content box detection doesn't use this class.  It binarizes the deskewed
+ * image with a local threshold, which no other stage computes.
+ *
+ * Binary images are kept up to a size limit, beyond which the least
+ * recently used ones are dropped, to be recomputed if asked for again.
+ * The last stage to use the cache calls clear(), so that FilterData
+ * copies kept around by later stages don't hold on to the images.
+ *
+ * This class is thread-safe.
+ */
+class DerivedImageCache : public RefCountable
+{
+	DECLARE_NON_COPYABLE(DerivedImageCache)
+public:
+	/**
+	 * The default limit on the memory taken by binary images.
+	 * That's enough for a 600 dpi page, along with its rotated version
+	 * and a 300 dpi copy of both.
+	 */
+	static size_t const DEFAULT_MAX_BINARY_BYTES;
+
+	/**
+	 * \param gray The grayscale version of the input image.
+	 * \param bw_threshold The threshold to binarize \p gray with.
+	 * \param max_binary_bytes The limit on the memory taken by cached
+	 *        binary images.  The most recently used image is kept even
+	 *        if it alone exceeds the limit.
+	 */
+	DerivedImageCache(
+		imageproc::GrayImage const& gray, imageproc::BinaryThreshold bw_threshold,
+		size_t max_binary_bytes = DEFAULT_MAX_BINARY_BYTES);
+
+	virtual ~DerivedImageCache();
+
+	/**
+	 * \brief The grayscale image, scaled to approximately 300 dpi.
+	 *
+	 * Images whose resolution is within 10% of 300 dpi are not scaled.
+	 *
+	 * \param scaling If provided, receives the scaling transformation
+	 *        from the original image to the returned one.
+	 */
+	imageproc::GrayImage gray300(QTransform* scaling = 0);
+
+	/**
+	 * \brief A binarized area of the original image.
+	 */
+	imageproc::BinaryImage binary(QRect const& area);
+
+	/**
+	 * \brief A binarized area of the original image, rotated
+	 *        orthogonally by the given angle.
+	 */
+	imageproc::BinaryImage rotatedBinary(
+		QRect const& area, OrthogonalRotation const& rotation);
+
+	/**
+	 * \brief Binarized gray300(), rotated orthogonally by the given angle.
+	 *
+	 * \param rotation The orthogonal rotation to apply.
+	 * \param scaling If provided, receives the scaling transformation
+	 *        from the original image to the unrotated binary image.
+	 */
+	imageproc::BinaryImage rotatedBinary300(
+		OrthogonalRotation const& rotation, QTransform* scaling = 0);
+
+	/**
+	 * \brief Drops all the derived images.
+	 *
+	 * They will be recomputed if asked for again.
+	 */
+	void clear();
+
+	/**
+	 * \brief The memory taken by cached binary images, in bytes.
+	 */
+	size_t binaryBytes() const;
+private:
+	struct Key
+	{
+		QRect area;
+		int degrees;
+		bool scaled;
+
+		Key(QRect const& a, int deg, bool s) : area(a), degrees(deg), scaled(s) {}
+
+		bool operator<(Key const& rhs) const;
+	};
+
+	struct Entry
+	{
+		imageproc::BinaryImage image;
+		unsigned long lastUse;
+
+		Entry(imageproc::BinaryImage const& img, unsigned long last_use)
+		: image(img), lastUse(last_use) {}
+	};
+
+	typedef std::map<Key, Entry> BinaryImages;
+
+	void ensureGray300Locked();
+
+	imageproc::BinaryImage binaryLocked(QRect const& area, bool scaled);
+
+	imageproc::BinaryImage rotatedBinaryLocked(
+		QRect const& area, bool scaled, int degrees);
+
+	/**
+	 * Returns the cached image for \p key, marking it as the most
+	 * recently used one, or a null image if there is none.
+	 */
+	imageproc::BinaryImage findLocked(Key const& key);
+
+	void insertLocked(Key const& key, imageproc::BinaryImage const& image);
+
+	static size_t imageBytes(imageproc::BinaryImage const& image);
+
+	mutable QMutex m_mutex;
+	imageproc::GrayImage const m_gray;
+	imageproc::BinaryThreshold const m_bwThreshold;
+	imageproc::GrayImage m_gray300;
+	QTransform m_scaling300;
+	bool m_gray300Ready;
+	BinaryImages m_binaryImages;
+	size_t const m_maxBinaryBytes;
+	size_t m_binaryBytes;
+	unsigned long m_useCounter;
+};
+
+#endif
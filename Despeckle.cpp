@@ -352,7 +352,8 @@ bool canBeAttachedTo(
 	return false;
 }
 
-void voronoi(ConnectivityMap& cmap, std::vector<Distance>& dist)
+void voronoi(
+	ConnectivityMap& cmap, std::vector<Distance>& dist, TaskStatus const& status)
 {
 	int const width = cmap.size().width() + 2;
 	int const height = cmap.size().height() + 2;
@@ -377,6 +378,7 @@ void voronoi(ConnectivityMap& cmap, std::vector<Distance>& dist)
 	
 	// Top to bottom scan.
 	for (int y = 1; y < height; ++y) {
+		status.throwIfCancelled();
 		dist_line += width;
 		cmap_line += width;
 		dist_line[0].reset(0);
@@ -434,6 +436,7 @@ void voronoi(ConnectivityMap& cmap, std::vector<Distance>& dist)
 	
 	// Bottom to top scan.
 	for (int y = height - 2; y >= 1; --y) {
+		status.throwIfCancelled();
 		dist_line -= width;
 		cmap_line -= width;
 		dist_line[0].reset(0);
@@ -490,7 +493,9 @@ void voronoi(ConnectivityMap& cmap, std::vector<Distance>& dist)
 	}
 }
 
-void voronoiSpecial(ConnectivityMap& cmap, std::vector<Distance>& dist, Distance const special_distance)
+void voronoiSpecial(
+	ConnectivityMap& cmap, std::vector<Distance>& dist,
+	Distance const special_distance, TaskStatus const& status)
 {
 	int const width = cmap.size().width() + 2;
 	int const height = cmap.size().height() + 2;
@@ -512,6 +517,7 @@ void voronoiSpecial(ConnectivityMap& cmap, std::vector<Distance>& dist, Distance
 	
 	// Top to bottom scan.
 	for (int y = 1; y < height - 1; ++y) {
+		status.throwIfCancelled();
 		dist_line += width;
 		cmap_line += width;
 		dist_line[0].reset(0);
@@ -581,6 +587,7 @@ void voronoiSpecial(ConnectivityMap& cmap, std::vector<Distance>& dist, Distance
 	
 	// Bottom to top scan.
 	for (int y = height - 2; y >= 1; --y) {
+		status.throwIfCancelled();
 		dist_line -= width;
 		cmap_line -= width;
 		dist_line[0].reset(0);
@@ -656,7 +663,7 @@ void voronoiSpecial(ConnectivityMap& cmap, std::vector<Distance>& dist, Distance
 void voronoiDistances(
 	ConnectivityMap const& cmap,
 	std::vector<Distance> const& distance_matrix,
-	std::map<Connection, uint32_t>& conns)
+	std::map<Connection, uint32_t>& conns, TaskStatus const& status)
 {
 	int const width = cmap.size().width();
 	int const height = cmap.size().height();
@@ -666,6 +673,7 @@ void voronoiDistances(
 	uint32_t const* const cmap_data = cmap.data();
 	Distance const* const distance_data = &distance_matrix[0] + width + 3;
 	for (int y = 0, offset = 0; y < height; ++y, offset += 2) {
+		status.throwIfCancelled();
 		for (int x = 0; x < width; ++x, ++offset) {
 			uint32_t const label = cmap_data[offset];
 			assert(label != 0);
@@ -789,7 +797,7 @@ Despeckle::despeckleInPlace(
 	
 	// Build a Voronoi diagram.
 	std::vector<Distance> distance_matrix;
-	voronoi(cmap, distance_matrix);
+	voronoi(cmap, distance_matrix, status);
 	if (dbg) {
 		dbg->add(cmap.visualized(), "voronoi");
 	}
@@ -804,7 +812,7 @@ Despeckle::despeckleInPlace(
 	typedef std::map<Connection, uint32_t> Connections; // conn -> sqdist
 	Connections conns;
 	
-	voronoiDistances(cmap, distance_matrix, conns);
+	voronoiDistances(cmap, distance_matrix, conns, status);
 	
 	status.throwIfCancelled();
 
@@ -865,7 +873,7 @@ Despeckle::despeckleInPlace(
 		// treat pixels with a special distance in such a way
 		// to prevent them from spreading but also preventing
 		// them from being overwritten.
-		voronoiSpecial(cmap, distance_matrix, special_distance);
+		voronoiSpecial(cmap, distance_matrix, special_distance, status);
 		if (dbg) {
 			dbg->add(cmap.visualized(), "voronoi_special");
 		}
@@ -873,7 +881,7 @@ Despeckle::despeckleInPlace(
 		status.throwIfCancelled();
 
 		// We've got new connections.  Add them to the map.
-		voronoiDistances(cmap, distance_matrix, conns);
+		voronoiDistances(cmap, distance_matrix, conns, status);
 	}
 	
 	status.throwIfCancelled();
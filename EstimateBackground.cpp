@@ -29,6 +29,7 @@
 #include "imageproc/Morphology.h"
 #include "imageproc/Connectivity.h"
 #include "imageproc/PolynomialLine.h"
+#include "imageproc/PolynomialLineFitter.h"
 #include "imageproc/PolynomialSurface.h"
 #include "imageproc/PolygonRasterizer.h"
 #include "imageproc/GrayImage.h"
@@ -229,12 +230,14 @@ imageproc::PolynomialSurface estimateBackground(
 	
 	// Smooth every horizontal line with a polynomial,
 	// then mask pixels that became significantly lighter.
+	// All of them are fitted in a single row-by-row pass.
+	std::vector<PolynomialLine> const columns(
+		PolynomialLineFitter(2, height).fitColumns(bg_data, width, bg_stride)
+	);
 	for (int x = 0; x < width; ++x) {
 		uint32_t const mask = ~(msb >> (x & 31));
 		
-		int const degree = 2;
-		PolynomialLine pl(degree, bg_data + x, height, bg_stride);
-		pl.output(&line[0], height, 1);
+		columns[x].output(&line[0], height, 1);
 		
 		uint8_t const* p_bg = bg_data + x;
 		uint32_t* p_mask = mask_data + (x >> 5);
@@ -253,10 +256,9 @@ imageproc::PolynomialSurface estimateBackground(
 	// then mask pixels that became significantly lighter.
 	uint8_t const* bg_line = bg_data;
 	uint32_t* mask_line = mask_data;
+	PolynomialLineFitter const row_fitter(4, width);
 	for (int y = 0; y < height; ++y) {
-		int const degree = 4;
-		PolynomialLine pl(degree, bg_line, width, 1);
-		pl.output(&line[0], width, 1);
+		row_fitter.fit(bg_line, 1).output(&line[0], width, 1);
 		
 		for (int x = 0; x < width; ++x) {
 			if (bg_line[x] + 30 < line[x]) {
@@ -17,24 +17,199 @@
 */
 
 #include "FilterData.h"
+#include "NonCopyable.h"
+#include "RefCountable.h"
 #include "Dpm.h"
 #include "Dpi.h"
 #include "imageproc/Grayscale.h"
+#include "MemoryBudget.h"
+#include <QMutex>
+#include <QMutexLocker>
 
 using namespace imageproc;
 
+namespace
+{
+
+qint64 imageBytes(QImage const& image)
+{
+	return qint64(image.bytesPerLine()) * image.height();
+}
+
+} // anonymous namespace
+
+/**
+ * The images shared by all FilterData objects originating from
+ * the same image.  The original image is either provided up front
+ * or produced on first access.  The grayscale image and everything
+ * derived from it are only built when first asked for, so a stage that
+ * works with the original image alone (like the output stage does with
+ * bitonal images) never pays for them.
+ */
+class FilterData::Images : public RefCountable
+{
+	DECLARE_NON_COPYABLE(Images)
+public:
+	explicit Images(QImage const& image);
+
+	explicit Images(ImageProvider const& provider);
+
+	QImage const& origImage();
+
+	GrayImage const& grayImage();
+
+	BinaryThreshold bwThreshold();
+
+	DerivedImageCache& derivedImages();
+
+	void releaseDerivedImages();
+private:
+	void ensureOrigLoaded();
+
+	void ensureGrayBuilt();
+
+	QMutex m_mutex;
+	ImageProvider m_provider;
+	QImage m_origImage;
+	GrayImage m_grayImage;
+	MemoryBudget::Reservation m_origReservation;
+	MemoryBudget::Reservation m_grayReservation;
+	BinaryThreshold m_bwThreshold;
+	IntrusivePtr<DerivedImageCache> m_ptrDerivedImages;
+	bool m_origLoaded;
+};
+
+
 FilterData::FilterData(QImage const& image)
-:	m_origImage(image),
-	m_grayImage(toGrayscale(m_origImage)),
-	m_xform(image.rect(), Dpm(image)),
-	m_bwThreshold(BinaryThreshold::otsuThreshold(m_grayImage))
+:	m_ptrImages(new Images(image)),
+	m_xform(image.rect(), Dpm(image))
+{
+}
+
+FilterData::FilterData(ImageProvider const& provider, ImageTransformation const& xform)
+:	m_ptrImages(new Images(provider)),
+	m_xform(xform)
 {
 }
 
 FilterData::FilterData(FilterData const& other, ImageTransformation const& xform)
-:	m_origImage(other.m_origImage),
-	m_grayImage(other.m_grayImage),
-	m_xform(xform),
-	m_bwThreshold(other.m_bwThreshold)
+:	m_ptrImages(other.m_ptrImages),
+	m_xform(xform)
+{
+}
+
+BinaryThreshold
+FilterData::bwThreshold() const
+{
+	return m_ptrImages->bwThreshold();
+}
+
+QImage const&
+FilterData::origImage() const
+{
+	return m_ptrImages->origImage();
+}
+
+GrayImage const&
+FilterData::grayImage() const
+{
+	return m_ptrImages->grayImage();
+}
+
+DerivedImageCache&
+FilterData::derivedImages() const
+{
+	return m_ptrImages->derivedImages();
+}
+
+void
+FilterData::releaseDerivedImages() const
+{
+	m_ptrImages->releaseDerivedImages();
+}
+
+
+/*============================= FilterData::Images ==========================*/
+
+FilterData::Images::Images(QImage const& image)
+:	m_origImage(image),
+	m_origReservation(imageBytes(image)),
+	m_bwThreshold(128),
+	m_origLoaded(true)
+{
+}
+
+FilterData::Images::Images(ImageProvider const& provider)
+:	m_provider(provider),
+	m_bwThreshold(128),
+	m_origLoaded(false)
+{
+}
+
+QImage const&
+FilterData::Images::origImage()
+{
+	QMutexLocker const locker(&m_mutex);
+	ensureOrigLoaded();
+	return m_origImage;
+}
+
+GrayImage const&
+FilterData::Images::grayImage()
+{
+	QMutexLocker const locker(&m_mutex);
+	ensureGrayBuilt();
+	return m_grayImage;
+}
+
+BinaryThreshold
+FilterData::Images::bwThreshold()
+{
+	QMutexLocker const locker(&m_mutex);
+	ensureGrayBuilt();
+	return m_bwThreshold;
+}
+
+DerivedImageCache&
+FilterData::Images::derivedImages()
+{
+	QMutexLocker const locker(&m_mutex);
+	ensureGrayBuilt();
+	return *m_ptrDerivedImages;
+}
+
+void
+FilterData::Images::releaseDerivedImages()
+{
+	QMutexLocker const locker(&m_mutex);
+	if (m_ptrDerivedImages) {
+		m_ptrDerivedImages->clear();
+	}
+}
+
+void
+FilterData::Images::ensureOrigLoaded()
+{
+	if (!m_origLoaded) {
+		m_origImage = m_provider();
+		m_origReservation.reset(imageBytes(m_origImage));
+		m_provider.clear();
+		m_origLoaded = true;
+	}
+}
+
+void
+FilterData::Images::ensureGrayBuilt()
 {
+	if (!m_ptrDerivedImages) {
+		ensureOrigLoaded();
+		GrayscaleHistogram hist;
+		m_grayImage = GrayImage(toGrayscale(m_origImage, &hist));
+		if (m_grayImage.toQImage().cacheKey() != m_origImage.cacheKey()) {
+			// Otherwise it's already counted.
+			m_grayReservation.reset(imageBytes(m_grayImage.toQImage()));
+		}
+		m_bwThreshold = BinaryThreshold::otsuThreshold(hist);
+		m_ptrDerivedImages.reset(new DerivedImageCache(m_grayImage, m_bwThreshold));
+	}
 }
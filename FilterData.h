@@ -22,28 +22,63 @@
 #include "imageproc/BinaryThreshold.h"
 #include "imageproc/GrayImage.h"
 #include "ImageTransformation.h"
+#include "DerivedImageCache.h"
+#include "IntrusivePtr.h"
 #include <QImage>
+#include <boost/function.hpp>
 
 class FilterData
 {
 	// Member-wise copying is OK.
 public:
+	typedef boost::function<QImage ()> ImageProvider;
+
 	FilterData(QImage const& image);
+
+	/**
+	 * \brief Constructs FilterData that obtains its images from \p provider
+	 *        when they are first accessed.
+	 *
+	 * A stage whose stored results are still valid only needs xform()
+	 * to pass the page on to the next stage, so a page where nothing
+	 * needs to be recomputed is processed without the image ever being
+	 * loaded.  The provider is called at most once, on the thread
+	 * accessing the images.  It may throw, in which case the exception
+	 * propagates to the caller of the accessor.
+	 *
+	 * \param provider Produces the original image.
+	 * \param xform The transformation FilterData(provider()) would have.
+	 */
+	FilterData(ImageProvider const& provider, ImageTransformation const& xform);
 	
 	FilterData(FilterData const& other, ImageTransformation const& xform);
 		
-	imageproc::BinaryThreshold bwThreshold() const { return m_bwThreshold; }
+	imageproc::BinaryThreshold bwThreshold() const;
 	
 	ImageTransformation const& xform() const { return m_xform; }
 
-	QImage const& origImage() const {return m_origImage;}
+	QImage const& origImage() const;
+
+	imageproc::GrayImage const& grayImage() const;
 
-	imageproc::GrayImage const& grayImage() const {return m_grayImage;}
+	/**
+	 * \brief Images derived from grayImage(), shared with all the
+	 *        FilterData objects constructed from this one.
+	 */
+	DerivedImageCache& derivedImages() const;
+
+	/**
+	 * \brief To be called by the last stage using derivedImages().
+	 *
+	 * Drops the derived images, provided they were ever built.
+	 * Unlike derivedImages(), this doesn't load the image.
+	 */
+	void releaseDerivedImages() const;
 private:
-	QImage m_origImage;
-	imageproc::GrayImage m_grayImage;
+	class Images;
+
+	IntrusivePtr<Images> m_ptrImages;
 	ImageTransformation m_xform;
-	imageproc::BinaryThreshold m_bwThreshold;
 };
 
 #endif
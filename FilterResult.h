@@ -30,6 +30,16 @@ class FilterResult : public RefCountable
 public:
 	virtual void updateUI(FilterUiInterface* ui) = 0;
 	
+	/**
+	 * \brief Does the part of updateUI() that can't wait for the page
+	 *        to be displayed, namely invalidating thumbnails.
+	 *
+	 * Called for results that are kept without being displayed, such as
+	 * the ones for prefetched pages.  If such a result gets displayed
+	 * later, updateUI() is called for it as usual.
+	 */
+	virtual void updateThumbnails(FilterUiInterface* ui) {}
+	
 	/**
 	 * \brief Return the filter that generated this result.
 	 * \note Returning a null smart pointer indicates that the result
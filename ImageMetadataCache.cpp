@@ -0,0 +1,172 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ImageMetadataCache.h"
+#include "AtomicFileOverwriter.h"
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDataStream>
+#include <QFile>
+#include <QDir>
+#include <QMutexLocker>
+#include <QSize>
+
+namespace
+{
+
+quint32 const MAGIC = 0x53544d43; // "STMC"
+quint32 const VERSION = 1;
+
+} // anonymous namespace
+
+ImageMetadataCache::ImageMetadataCache(QString const& file_path)
+:	m_filePath(file_path),
+	m_modified(false)
+{
+	load();
+}
+
+ImageMetadataCache::~ImageMetadataCache()
+{
+}
+
+bool
+ImageMetadataCache::lookup(
+	QFileInfo const& file_info, std::vector<ImageMetadata>& per_page_metadata) const
+{
+	QString const path(file_info.absoluteFilePath());
+	
+	QMutexLocker const locker(&m_mutex);
+	
+	Map::const_iterator const it(m_entries.find(path));
+	if (it == m_entries.end()) {
+		return false;
+	}
+	
+	Entry const& entry = it->second;
+	if (entry.fileSize != file_info.size()
+			|| entry.mtime != file_info.lastModified().toTime_t()) {
+		return false;
+	}
+	
+	per_page_metadata = entry.perPageMetadata;
+	return true;
+}
+
+void
+ImageMetadataCache::store(
+	QFileInfo const& file_info, std::vector<ImageMetadata> const& per_page_metadata)
+{
+	Entry entry;
+	entry.fileSize = file_info.size();
+	entry.mtime = file_info.lastModified().toTime_t();
+	entry.perPageMetadata = per_page_metadata;
+	
+	QString const path(file_info.absoluteFilePath());
+	
+	QMutexLocker const locker(&m_mutex);
+	m_entries[path] = entry;
+	m_modified = true;
+}
+
+bool
+ImageMetadataCache::save()
+{
+	QMutexLocker const locker(&m_mutex);
+	
+	if (!m_modified) {
+		return true;
+	}
+	
+	QDir().mkpath(QFileInfo(m_filePath).absolutePath());
+	
+	AtomicFileOverwriter overwriter;
+	QIODevice* const io_device = overwriter.startWriting(m_filePath);
+	if (!io_device) {
+		return false;
+	}
+	
+	QDataStream strm(io_device);
+	strm.setVersion(QDataStream::Qt_4_4);
+	strm << MAGIC << VERSION << (quint32)m_entries.size();
+	
+	Map::const_iterator it(m_entries.begin());
+	Map::const_iterator const end(m_entries.end());
+	for (; it != end; ++it) {
+		Entry const& entry = it->second;
+		strm << it->first << entry.fileSize << (quint32)entry.mtime;
+		strm << (quint32)entry.perPageMetadata.size();
+		std::vector<ImageMetadata>::const_iterator page(entry.perPageMetadata.begin());
+		for (; page != entry.perPageMetadata.end(); ++page) {
+			strm << (qint32)page->size().width() << (qint32)page->size().height();
+			strm << (qint32)page->dpi().horizontal() << (qint32)page->dpi().vertical();
+		}
+	}
+	
+	if (strm.status() != QDataStream::Ok || !overwriter.commit()) {
+		return false;
+	}
+	
+	m_modified = false;
+	return true;
+}
+
+void
+ImageMetadataCache::load()
+{
+	QFile file(m_filePath);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return;
+	}
+	
+	QDataStream strm(&file);
+	strm.setVersion(QDataStream::Qt_4_4);
+	
+	quint32 magic = 0, version = 0, num_entries = 0;
+	strm >> magic >> version >> num_entries;
+	if (magic != MAGIC || version != VERSION) {
+		return;
+	}
+	
+	Map entries;
+	for (quint32 i = 0; i < num_entries; ++i) {
+		QString path;
+		Entry entry;
+		quint32 mtime = 0, num_pages = 0;
+		strm >> path >> entry.fileSize >> mtime >> num_pages;
+		if (strm.status() != QDataStream::Ok) {
+			return;
+		}
+		entry.mtime = mtime;
+		
+		for (quint32 j = 0; j < num_pages; ++j) {
+			qint32 width = 0, height = 0, xdpi = 0, ydpi = 0;
+			strm >> width >> height >> xdpi >> ydpi;
+			if (strm.status() != QDataStream::Ok) {
+				return;
+			}
+			entry.perPageMetadata.push_back(
+				ImageMetadata(QSize(width, height), Dpi(xdpi, ydpi))
+			);
+		}
+		
+		entries[path] = entry;
+	}
+	
+	m_entries.swap(entries);
+}
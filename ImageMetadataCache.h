@@ -0,0 +1,93 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGEMETADATACACHE_H_
+#define IMAGEMETADATACACHE_H_
+
+#include "NonCopyable.h"
+#include "ImageMetadata.h"
+#include <QString>
+#include <QMutex>
+#include <QtGlobal>
+#include <map>
+#include <vector>
+
+class QFileInfo;
+
+/**
+ * \brief A persistent cache of per-page image metadata.
+ *
+ * Entries are keyed by the absolute file path and are only considered
+ * valid if the size and the modification time of the file didn't change
+ * since the entry was stored.
+ *
+ * This class is thread-safe.
+ */
+class ImageMetadataCache
+{
+	DECLARE_NON_COPYABLE(ImageMetadataCache)
+public:
+	/**
+	 * \brief Loads the cache from a file, if it exists.
+	 *
+	 * A missing or unreadable file results in an empty cache.
+	 */
+	explicit ImageMetadataCache(QString const& file_path);
+	
+	~ImageMetadataCache();
+	
+	/**
+	 * \brief Looks up the metadata of a file.
+	 *
+	 * \return true if an up-to-date entry was found, in which case
+	 *         \p per_page_metadata is filled with it.
+	 */
+	bool lookup(QFileInfo const& file_info,
+		std::vector<ImageMetadata>& per_page_metadata) const;
+	
+	void store(QFileInfo const& file_info,
+		std::vector<ImageMetadata> const& per_page_metadata);
+	
+	/**
+	 * \brief Writes the cache back to the file it was loaded from,
+	 *        if it was modified.
+	 *
+	 * \return false if writing failed.
+	 */
+	bool save();
+private:
+	struct Entry
+	{
+		qint64 fileSize;
+		uint mtime;
+		std::vector<ImageMetadata> perPageMetadata;
+		
+		Entry() : fileSize(0), mtime(0) {}
+	};
+	
+	typedef std::map<QString, Entry> Map;
+	
+	void load();
+	
+	QString m_filePath;
+	Map m_entries;
+	mutable QMutex m_mutex;
+	bool m_modified;
+};
+
+#endif
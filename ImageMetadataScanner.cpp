@@ -0,0 +1,155 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ImageMetadataScanner.h"
+#include "ImageMetadataCache.h"
+#include "OutOfMemoryHandler.h"
+#include <QThread>
+#include <QMutexLocker>
+#include <QFileInfo>
+#include <boost/lambda/lambda.hpp>
+#include <boost/lambda/bind.hpp>
+#include <new>
+
+class ImageMetadataScanner::Worker : public QThread
+{
+public:
+	Worker(ImageMetadataScanner* owner) : m_pOwner(owner) {}
+protected:
+	virtual void run() { m_pOwner->processTasks(); }
+private:
+	ImageMetadataScanner* m_pOwner;
+};
+
+
+ImageMetadataScanner::ImageMetadataScanner(
+	ImageMetadataCache* cache, int const num_threads)
+:	m_pCache(cache),
+	m_exiting(false)
+{
+	for (int i = 0; i < num_threads; ++i) {
+		m_workers.push_back(boost::shared_ptr<Worker>(new Worker(this)));
+	}
+}
+
+ImageMetadataScanner::~ImageMetadataScanner()
+{
+	{
+		QMutexLocker const locker(&m_mutex);
+		m_exiting = true;
+		m_tasks.clear();
+	}
+	
+	m_cond.wakeAll();
+	
+	std::vector<boost::shared_ptr<Worker> >::iterator it(m_workers.begin());
+	for (; it != m_workers.end(); ++it) {
+		(*it)->wait();
+	}
+}
+
+void
+ImageMetadataScanner::enqueue(int const id, QString const& file_path)
+{
+	QMutexLocker const locker(&m_mutex);
+	
+	m_tasks.push_back(Task(id, file_path));
+	
+	// Threads are started lazily, so that we don't create more of them
+	// than there are files to read.
+	std::vector<boost::shared_ptr<Worker> >::iterator it(m_workers.begin());
+	for (; it != m_workers.end(); ++it) {
+		if (!(*it)->isRunning()) {
+			(*it)->start(QThread::LowPriority);
+			return;
+		}
+	}
+	
+	m_cond.wakeOne();
+}
+
+bool
+ImageMetadataScanner::takeResult(Result& result)
+{
+	QMutexLocker const locker(&m_mutex);
+	
+	if (m_results.empty()) {
+		return false;
+	}
+	
+	result = m_results.front();
+	m_results.pop_front();
+	return true;
+}
+
+void
+ImageMetadataScanner::processTasks()
+try {
+	QMutexLocker locker(&m_mutex);
+	
+	for (;;) {
+		if (m_exiting) {
+			break;
+		}
+		
+		if (m_tasks.empty()) {
+			m_cond.wait(&m_mutex);
+			continue;
+		}
+		
+		Task const task(m_tasks.front());
+		m_tasks.pop_front();
+		
+		locker.unlock();
+		Result const result(processTask(task));
+		locker.relock();
+		
+		m_results.push_back(result);
+	}
+} catch (std::bad_alloc const&) {
+	OutOfMemoryHandler::instance().handleOutOfMemorySituation();
+}
+
+ImageMetadataScanner::Result
+ImageMetadataScanner::processTask(Task const& task) const
+{
+	using namespace boost::lambda;
+	
+	Result result;
+	result.id = task.id;
+	
+	QFileInfo const file_info(task.filePath);
+	if (m_pCache && m_pCache->lookup(file_info, result.perPageMetadata)) {
+		result.status = ImageMetadataLoader::LOADED;
+		return result;
+	}
+	
+	void (std::vector<ImageMetadata>::*push_back) (const ImageMetadata&) =
+		&std::vector<ImageMetadata>::push_back;
+	result.status = ImageMetadataLoader::load(
+		task.filePath, boost::lambda::bind(
+			push_back, var(result.perPageMetadata), _1
+		)
+	);
+	
+	if (result.status == ImageMetadataLoader::LOADED && m_pCache) {
+		m_pCache->store(file_info, result.perPageMetadata);
+	}
+	
+	return result;
+}
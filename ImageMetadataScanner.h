@@ -0,0 +1,109 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGEMETADATASCANNER_H_
+#define IMAGEMETADATASCANNER_H_
+
+#include "NonCopyable.h"
+#include "ImageMetadata.h"
+#include "ImageMetadataLoader.h"
+#include <QString>
+#include <QMutex>
+#include <QWaitCondition>
+#include <boost/shared_ptr.hpp>
+#include <vector>
+#include <deque>
+
+class ImageMetadataCache;
+
+/**
+ * \brief Loads image metadata of many files on a bounded set of
+ *        background threads.
+ *
+ * Files are submitted with enqueue() and the results are collected
+ * with takeResult(), which never blocks, so it may be polled from
+ * the GUI thread.  Only file headers are read, pixels are never decoded.
+ * If a cache is provided, it's consulted before reading a file
+ * and updated after a file was read successfully.
+ */
+class ImageMetadataScanner
+{
+	DECLARE_NON_COPYABLE(ImageMetadataScanner)
+public:
+	struct Result
+	{
+		int id;
+		ImageMetadataLoader::Status status;
+		std::vector<ImageMetadata> perPageMetadata;
+		
+		Result() : id(-1), status(ImageMetadataLoader::GENERIC_ERROR) {}
+	};
+	
+	/**
+	 * \param cache The cache to use, or null.  If provided, it must
+	 *        outlive this object.
+	 * \param num_threads The maximum number of files to read in parallel.
+	 */
+	ImageMetadataScanner(ImageMetadataCache* cache, int num_threads);
+	
+	/**
+	 * \brief Discards any pending files and waits for the threads to finish.
+	 */
+	~ImageMetadataScanner();
+	
+	/**
+	 * \brief Schedules a file for reading.
+	 *
+	 * \param id An arbitrary identifier that will be passed back in Result.
+	 * \param file_path The path of the file to read.
+	 */
+	void enqueue(int id, QString const& file_path);
+	
+	/**
+	 * \brief Takes a finished result, if there is one.
+	 *
+	 * Results come in no particular order.
+	 *
+	 * \return true if \p result was filled, false if nothing is ready yet.
+	 */
+	bool takeResult(Result& result);
+private:
+	class Worker;
+	
+	struct Task
+	{
+		int id;
+		QString filePath;
+		
+		Task(int i, QString const& path) : id(i), filePath(path) {}
+	};
+	
+	void processTasks();
+	
+	Result processTask(Task const& task) const;
+	
+	ImageMetadataCache* m_pCache;
+	std::vector<boost::shared_ptr<Worker> > m_workers;
+	std::deque<Task> m_tasks;
+	std::deque<Result> m_results;
+	QMutex m_mutex;
+	QWaitCondition m_cond;
+	bool m_exiting;
+};
+
+#endif
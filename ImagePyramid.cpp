@@ -0,0 +1,156 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ImagePyramid.h"
+#include "imageproc/Transform.h"
+#include <QMutexLocker>
+#include <QRect>
+#include <QSize>
+#include <Qt>
+#include <algorithm>
+#include <assert.h>
+#include <math.h>
+
+using namespace imageproc;
+
+namespace
+{
+
+/**
+ * We don't go below this size, as there is no point in
+ * having levels smaller than a thumbnail.
+ */
+int const MIN_LEVEL_DIMENSION = 64;
+
+} // anonymous namespace
+
+ImagePyramid::ImagePyramid(QImage const& image)
+:	m_baseImage(image),
+	m_numLevels(1)
+{
+	m_levelSizes.push_back(image.size());
+	for (;;) {
+		QSize const prev_size(m_levelSizes.back());
+		if (prev_size.width() < MIN_LEVEL_DIMENSION * 2 ||
+				prev_size.height() < MIN_LEVEL_DIMENSION * 2) {
+			break;
+		}
+		m_levelSizes.push_back(levelSize(prev_size));
+	}
+
+	m_numLevels = m_levelSizes.size();
+	m_levels.resize(m_numLevels);
+	m_levels[0] = m_baseImage;
+}
+
+ImagePyramid::~ImagePyramid()
+{
+}
+
+int
+ImagePyramid::selectLevel(QTransform const& image_to_target) const
+{
+	// Lengths of unit vectors in image coordinates, mapped to target coordinates.
+	double const xscale = sqrt(
+		image_to_target.m11() * image_to_target.m11() +
+		image_to_target.m12() * image_to_target.m12()
+	);
+	double const yscale = sqrt(
+		image_to_target.m21() * image_to_target.m21() +
+		image_to_target.m22() * image_to_target.m22()
+	);
+	double const scale = std::max(xscale, yscale);
+	if (scale <= 0.0) {
+		return 0;
+	}
+
+	// Level n has 2^n source pixels per level pixel.  We want the largest
+	// n where a level pixel doesn't become larger than a target pixel.
+	int const level = (int)floor(log(1.0 / scale) / log(2.0));
+	return qBound(0, level, m_numLevels - 1);
+}
+
+QImage
+ImagePyramid::level(int const idx) const
+{
+	assert(idx >= 0 && idx < m_numLevels);
+
+	// The mutex is not held while downscaling, so that requests for levels
+	// that are already built don't wait for a slow one.  Two threads may
+	// then build the same level, in which case the first result is kept.
+	// Both results are identical anyway.
+	for (;;) {
+		int last_built = idx;
+		QImage prev;
+		{
+			QMutexLocker const locker(&m_mutex);
+			while (last_built > 0 && m_levels[last_built].isNull()) {
+				--last_built;
+			}
+			if (last_built == idx) {
+				return m_levels[idx];
+			}
+			prev = m_levels[last_built];
+		}
+
+		int const i = last_built + 1;
+		QSize const size(m_levelSizes[i]);
+
+		QTransform xform;
+		xform.scale(
+			(double)size.width() / prev.width(),
+			(double)size.height() / prev.height()
+		);
+		QImage const built(
+			transform(
+				prev, xform, QRect(QPoint(0, 0), size),
+				OutsidePixels::assumeWeakNearest()
+			)
+		);
+
+		QMutexLocker const locker(&m_mutex);
+		if (m_levels[i].isNull()) {
+			m_levels[i] = built;
+		}
+	}
+}
+
+QTransform
+ImagePyramid::imageToLevel(int const idx) const
+{
+	assert(idx >= 0 && idx < m_numLevels);
+
+	QSize const base_size(m_levelSizes[0]);
+	QSize const level_size(m_levelSizes[idx]);
+
+	QTransform xform;
+	xform.scale(
+		(double)level_size.width() / base_size.width(),
+		(double)level_size.height() / base_size.height()
+	);
+	return xform;
+}
+
+QSize
+ImagePyramid::levelSize(QSize const& prev_level_size)
+{
+	return QSize(
+		(prev_level_size.width() + 1) / 2,
+		(prev_level_size.height() + 1) / 2
+	);
+}
@@ -0,0 +1,87 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGEPYRAMID_H_
+#define IMAGEPYRAMID_H_
+
+#include "NonCopyable.h"
+#include "RefCountable.h"
+#include <QImage>
+#include <QTransform>
+#include <QMutex>
+#include <vector>
+
+/**
+ * \brief A set of progressively downscaled versions of an image.
+ *
+ * Level 0 is the original image.  Each subsequent level is half the size
+ * of the previous one in both dimensions.  Levels are built lazily, on first
+ * access, so an image that's never zoomed out doesn't pay for them.
+ *
+ * All methods are thread-safe.
+ */
+class ImagePyramid : public RefCountable
+{
+	DECLARE_NON_COPYABLE(ImagePyramid)
+public:
+	/**
+	 * \param image The full resolution image.  It's shallow-copied,
+	 *        so no pixel data is duplicated.
+	 */
+	explicit ImagePyramid(QImage const& image);
+
+	virtual ~ImagePyramid();
+
+	QImage const& baseImage() const { return m_baseImage; }
+
+	int numLevels() const { return m_numLevels; }
+
+	/**
+	 * \brief Chooses the coarsest level that still provides at least
+	 *        one source pixel per target pixel.
+	 *
+	 * \param image_to_target Transformation from base image coordinates
+	 *        to the coordinates of an image we are going to build.
+	 */
+	int selectLevel(QTransform const& image_to_target) const;
+
+	/**
+	 * \brief Returns the image corresponding to the given level.
+	 *
+	 * If that level wasn't built yet, it will be built now, along with
+	 * any intermediate levels.  Building doesn't block concurrent
+	 * requests for levels that are already built.
+	 */
+	QImage level(int idx) const;
+
+	/**
+	 * \brief Transformation from base image coordinates to coordinates
+	 *        of a given level.
+	 */
+	QTransform imageToLevel(int idx) const;
+private:
+	static QSize levelSize(QSize const& prev_level_size);
+
+	QImage const m_baseImage;
+	mutable QMutex m_mutex;
+	mutable std::vector<QImage> m_levels;
+	std::vector<QSize> m_levelSizes;
+	int m_numLevels;
+};
+
+#endif
@@ -20,6 +20,7 @@
 #include "ImageViewBase.h.moc"
 #include "NonCopyable.h"
 #include "ImagePresentation.h"
+#include "ImagePyramid.h"
 #include "OpenGLSupport.h"
 #include "PixmapRenderer.h"
 #include "BackgroundExecutor.h"
@@ -46,8 +47,10 @@
 #include <QApplication>
 #include <QSettings>
 #include <QVariant>
+#include <QThread>
 #include <Qt>
 #include <QDebug>
+#include <boost/foreach.hpp>
 #include <algorithm>
 #include <assert.h>
 #include <math.h>
@@ -59,16 +62,68 @@
 
 using namespace imageproc;
 
-class ImageViewBase::HqTransformTask :
-	public AbstractCommand0<IntrusivePtr<AbstractCommand0<void> > >,
-	public QObject
+namespace
 {
-	DECLARE_NON_COPYABLE(HqTransformTask)
+
+/**
+ * The width and height of a high quality tile, in widget pixels.
+ */
+int const HQ_TILE_SIZE = 256;
+
+/**
+ * Tiles that are not currently visible are kept for reuse when panning,
+ * but only as long as the total number of tiles stays below this limit.
+ * With 32-bit pixels, that's 64 MB worth of tiles.
+ */
+size_t const MAX_HQ_TILES = 256;
+
+int floorDiv(int const num, int const denom)
+{
+	return (int)floor((double)num / denom);
+}
+
+/**
+ * Tile spaces whose linear parts differ by less than this, relative to
+ * the scale, are the same tile space.  That only absorbs the rounding
+ * errors of combining the same transformations in a different order.
+ */
+double const HQ_LINEAR_TOLERANCE = 1e-9;
+
+/**
+ * Tile spaces whose fractional offsets differ by less than this many
+ * widget pixels are the same tile space.  Shifting a bilinearly
+ * interpolated 8-bit image by 1/256 of a pixel changes any of its
+ * pixels by less than one level, so tiles built for one of them are
+ * indistinguishable from the ones built for the other.
+ */
+double const HQ_TRANSLATION_TOLERANCE = 1.0 / 256.0;
+
+bool sameTileSpace(QTransform const& t1, QTransform const& t2)
+{
+	double const linear_tolerance = HQ_LINEAR_TOLERANCE * std::max(
+		fabs(t1.m11()) + fabs(t1.m12()), fabs(t1.m21()) + fabs(t1.m22())
+	);
+	double const translation_tolerance = HQ_TRANSLATION_TOLERANCE;
+
+	return fabs(t1.m11() - t2.m11()) <= linear_tolerance
+		&& fabs(t1.m12() - t2.m12()) <= linear_tolerance
+		&& fabs(t1.m21() - t2.m21()) <= linear_tolerance
+		&& fabs(t1.m22() - t2.m22()) <= linear_tolerance
+		&& fabs(t1.dx() - t2.dx()) <= translation_tolerance
+		&& fabs(t1.dy() - t2.dy()) <= translation_tolerance;
+}
+
+} // anonymous namespace
+
+class ImageViewBase::HqTileTask :
+	public AbstractCommand0<IntrusivePtr<AbstractCommand0<void> > >
+{
+	DECLARE_NON_COPYABLE(HqTileTask)
 public:
-	HqTransformTask(
-		ImageViewBase* image_view,
-		QImage const& image, QTransform const& xform,
-		QSize const& target_size);
+	HqTileTask(
+		ImageViewBase* image_view, HqTileIdx const& idx,
+		IntrusivePtr<ImagePyramid> const& pyramid, int level,
+		QTransform const& image_to_tile_space, QRect const& tile_rect);
 	
 	void cancel() { m_ptrResult->cancel(); }
 	
@@ -79,9 +134,10 @@ private:
 	class Result : public AbstractCommand0<void>
 	{
 	public:
-		Result(ImageViewBase* image_view);
+		Result(ImageViewBase* image_view,
+			HqTileIdx const& idx, HqTileTask const* task);
 		
-		void setData(QPoint const& origin, QImage const& hq_image);
+		void setData(QImage const& tile_image);
 		
 		void cancel() { m_cancelFlag.fetchAndStoreRelaxed(1); }
 		
@@ -90,15 +146,17 @@ private:
 		virtual void operator()();
 	private:
 		QPointer<ImageViewBase> m_ptrImageView;
-		QPoint m_origin;
-		QImage m_hqImage;
+		HqTileIdx m_idx;
+		HqTileTask const* m_pTask;
+		QImage m_tileImage;
 		mutable QAtomicInt m_cancelFlag;
 	};
 	
 	IntrusivePtr<Result> m_ptrResult;
-	QImage m_image;
-	QTransform m_xform;
-	QSize m_targetSize;
+	IntrusivePtr<ImagePyramid> m_ptrPyramid;
+	int m_level;
+	QTransform m_imageToTileSpace;
+	QRect m_tileRect;
 };
 
 
@@ -149,6 +207,11 @@ ImageViewBase::ImageViewBase(
 	QImage const& image, ImagePixmapUnion const& downscaled_version,
 	ImagePresentation const& presentation, Margins const& margins)
 :	m_image(image),
+	m_ptrPyramid(new ImagePyramid(image)),
+	m_hqSourceId(0),
+	m_hqLevel(0),
+	m_hqPaintCounter(0),
+	m_hqTileSpaceSet(false),
 	m_virtualImageCropArea(presentation.cropArea()),
 	m_virtualDisplayArea(presentation.displayArea()),
 	m_imageToVirtual(presentation.transform()),
@@ -220,6 +283,7 @@ ImageViewBase::ImageViewBase(
 
 ImageViewBase::~ImageViewBase()
 {
+	discardHqTiles();
 }
 
 void
@@ -228,12 +292,8 @@ ImageViewBase::hqTransformSetEnabled(bool const enabled)
 	if (!enabled && m_hqTransformEnabled) {
 		// Turning off.
 		m_hqTransformEnabled = false;
-		if (m_ptrHqTransformTask.get()) {
-			m_ptrHqTransformTask->cancel();
-			m_ptrHqTransformTask.reset();
-		}
-		if (!m_hqPixmap.isNull()) {
-			m_hqPixmap = QPixmap();
+		if (!m_hqTiles.empty()) {
+			discardHqTiles();
 			update();
 		}
 	} else if (enabled && !m_hqTransformEnabled) {
@@ -463,19 +523,38 @@ ImageViewBase::paintEvent(QPaintEvent* event)
 		painter.setRenderHint(QPainter::SmoothPixmapTransform, pixel_width < 0.5);
 	}
 
-	if (validateHqPixmap()) {
-		// HQ pixmap maps one to one to screen pixels, so antialiasing is not necessary.
-		painter.setRenderHint(QPainter::SmoothPixmapTransform, false);
-		painter.drawPixmap(m_hqPixmapPos, m_hqPixmap);
-	} else {
+	QTransform tile_space;
+	QPoint tile_space_origin;
+	splitHqTransform(m_imageToVirtual * m_virtualToWidget, tile_space, tile_space_origin);
+
+	std::vector<HqTileIdx> visible_tiles;
+	bool hq_complete = false;
+	if (validateHqTileSpace(tile_space)) {
+		visibleHqTiles(tile_space_origin, visible_tiles);
+		hq_complete = (requestMissingHqTiles(visible_tiles) == 0);
+	} else if (m_hqTransformEnabled) {
 		scheduleHqVersionRebuild();
+	}
 
+	if (!hq_complete) {
 		painter.setWorldTransform(
 			m_pixmapToImage * m_imageToVirtual * m_virtualToWidget
 		);
 		PixmapRenderer::drawPixmap(painter, m_pixmap);
 	}
 
+	if (!visible_tiles.empty()) {
+		// HQ tiles map one to one to screen pixels, so antialiasing is not necessary.
+		painter.setRenderHint(QPainter::SmoothPixmapTransform, false);
+		painter.setWorldTransform(QTransform());
+		BOOST_FOREACH(HqTileIdx const& idx, visible_tiles) {
+			HqTile const& tile = m_hqTiles[idx];
+			if (!tile.pixmap.isNull()) {
+				painter.drawPixmap(tile.rect.topLeft() + tile_space_origin, tile.pixmap);
+			}
+		}
+	}
+
 	painter.setRenderHints(QPainter::Antialiasing, true);
 	painter.setWorldMatrixEnabled(false);
 
@@ -995,16 +1074,35 @@ ImageViewBase::setWidgetFocalPointWithoutMoving(QPointF const new_widget_fp)
 }
 
 /**
- * Returns true if m_hqPixmap is valid and up to date.
+ * Splits the image-to-widget transformation into the one from image
+ * coordinates to the tile space and an integer offset from the tile space
+ * to widget coordinates.
+ */
+void
+ImageViewBase::splitHqTransform(
+	QTransform const& xform, QTransform& tile_space, QPoint& tile_space_origin)
+{
+	double const int_dx = floor(xform.dx());
+	double const int_dy = floor(xform.dy());
+
+	tile_space = QTransform(
+		xform.m11(), xform.m12(), xform.m21(), xform.m22(),
+		xform.dx() - int_dx, xform.dy() - int_dy
+	);
+	tile_space_origin = QPoint((int)int_dx, (int)int_dy);
+}
+
+/**
+ * Returns true if m_hqTiles were built for the given tile space.
  */
 bool
-ImageViewBase::validateHqPixmap() const
+ImageViewBase::validateHqTileSpace(QTransform const& tile_space) const
 {
 	if (!m_hqTransformEnabled) {
 		return false;
 	}
 
-	if (m_hqPixmap.isNull()) {
+	if (!m_hqTileSpaceSet) {
 		return false;
 	}
 
@@ -1012,68 +1110,193 @@ ImageViewBase::validateHqPixmap() const
 		return false;
 	}
 
-	if (m_hqXform != m_imageToVirtual * m_virtualToWidget) {
+	if (!sameTileSpace(m_hqTileSpace, tile_space)) {
 		return false;
 	}
 
 	return true;
 }
 
+/**
+ * Collects indexes of tiles that intersect the viewport.
+ */
 void
-ImageViewBase::scheduleHqVersionRebuild()
+ImageViewBase::visibleHqTiles(
+	QPoint const& tile_space_origin, std::vector<HqTileIdx>& tiles) const
 {
-	QTransform const xform(m_imageToVirtual * m_virtualToWidget);
+	QRect const viewport_rect(viewport()->rect().translated(-tile_space_origin));
+	QRect const area(viewport_rect.intersected(m_hqImageRect));
+	if (area.isEmpty()) {
+		return;
+	}
 
-	if (!m_timer.isActive() || m_potentialHqXform != xform) {
-		if (m_ptrHqTransformTask.get()) {
-			m_ptrHqTransformTask->cancel();
-			m_ptrHqTransformTask.reset();
+	int const first_col = floorDiv(area.left(), HQ_TILE_SIZE);
+	int const last_col = floorDiv(area.right(), HQ_TILE_SIZE);
+	int const first_row = floorDiv(area.top(), HQ_TILE_SIZE);
+	int const last_row = floorDiv(area.bottom(), HQ_TILE_SIZE);
+	
+	for (int row = first_row; row <= last_row; ++row) {
+		for (int col = first_col; col <= last_col; ++col) {
+			tiles.push_back(HqTileIdx(col, row));
 		}
-		m_potentialHqXform = xform;
 	}
-	m_timer.start();
 }
 
+/**
+ * Enqueues building of visible tiles that are neither built nor being built,
+ * and cancels building of tiles that are no longer visible.
+ *
+ * \return The number of visible tiles that are not built yet.
+ */
+int
+ImageViewBase::requestMissingHqTiles(std::vector<HqTileIdx> const& visible_tiles)
+{
+	++m_hqPaintCounter;
+
+	int num_missing = 0;
+
+	BOOST_FOREACH(HqTileIdx const& idx, visible_tiles) {
+		HqTile& tile = m_hqTiles[idx];
+		tile.lastUsed = m_hqPaintCounter;
+		if (!tile.pixmap.isNull()) {
+			continue;
+		}
+
+		++num_missing;
+		if (tile.task) {
+			continue;
+		}
+
+		tile.rect = QRect(
+			idx.first * HQ_TILE_SIZE, idx.second * HQ_TILE_SIZE,
+			HQ_TILE_SIZE, HQ_TILE_SIZE
+		).intersected(m_hqImageRect);
+
+		tile.task.reset(
+			new HqTileTask(
+				this, idx, m_ptrPyramid, m_hqLevel, m_hqTileSpace, tile.rect
+			)
+		);
+		hqTileExecutor().enqueueTask(tile.task);
+	}
+
+	HqTileMap::iterator it(m_hqTiles.begin());
+	while (it != m_hqTiles.end()) {
+		HqTile& tile = it->second;
+		if (tile.lastUsed != m_hqPaintCounter && tile.task) {
+			// Scrolled out of view before being built.
+			tile.task->cancel();
+			m_hqTiles.erase(it++);
+		} else {
+			++it;
+		}
+	}
+
+	evictHqTiles();
+
+	return num_missing;
+}
+
+/**
+ * Removes the least recently visible tiles until we fit into MAX_HQ_TILES.
+ */
 void
-ImageViewBase::initiateBuildingHqVersion()
+ImageViewBase::evictHqTiles()
 {
-	if (validateHqPixmap()) {
+	if (m_hqTiles.size() <= MAX_HQ_TILES) {
 		return;
 	}
 
-	m_hqPixmap = QPixmap();
-
-	if (m_ptrHqTransformTask.get()) {
-		m_ptrHqTransformTask->cancel();
-		m_ptrHqTransformTask.reset();
+	std::vector<std::pair<unsigned, HqTileIdx> > candidates;
+	for (HqTileMap::iterator it(m_hqTiles.begin()); it != m_hqTiles.end(); ++it) {
+		if (it->second.lastUsed != m_hqPaintCounter) {
+			candidates.push_back(std::make_pair(it->second.lastUsed, it->first));
+		}
 	}
 
-	QTransform const xform(m_imageToVirtual * m_virtualToWidget);
-	IntrusivePtr<HqTransformTask> const task(
-		new HqTransformTask(this, m_image, xform, viewport()->size())
+	size_t const num_to_evict = std::min(
+		m_hqTiles.size() - MAX_HQ_TILES, candidates.size()
 	);
-	
-	backgroundExecutor().enqueueTask(task);
-	
-	m_ptrHqTransformTask = task;
-	m_hqXform = xform;
+	std::partial_sort(
+		candidates.begin(), candidates.begin() + num_to_evict, candidates.end()
+	);
+
+	for (size_t i = 0; i < num_to_evict; ++i) {
+		m_hqTiles.erase(candidates[i].second);
+	}
+}
+
+/**
+ * Cancels building of all tiles and discards the ones already built.
+ */
+void
+ImageViewBase::discardHqTiles()
+{
+	for (HqTileMap::iterator it(m_hqTiles.begin()); it != m_hqTiles.end(); ++it) {
+		if (it->second.task) {
+			it->second.task->cancel();
+		}
+	}
+	m_hqTiles.clear();
+}
+
+void
+ImageViewBase::scheduleHqVersionRebuild()
+{
+	QTransform tile_space;
+	QPoint tile_space_origin;
+	splitHqTransform(m_imageToVirtual * m_virtualToWidget, tile_space, tile_space_origin);
+
+	if (!m_timer.isActive() || !sameTileSpace(m_potentialHqTileSpace, tile_space)) {
+		discardHqTiles();
+		m_potentialHqTileSpace = tile_space;
+	}
+	m_timer.start();
+}
+
+void
+ImageViewBase::initiateBuildingHqVersion()
+{
+	QTransform tile_space;
+	QPoint tile_space_origin;
+	splitHqTransform(m_imageToVirtual * m_virtualToWidget, tile_space, tile_space_origin);
+
+	if (!m_hqTransformEnabled || validateHqTileSpace(tile_space)) {
+		return;
+	}
+
+	discardHqTiles();
+
+	m_hqTileSpace = tile_space;
+	m_hqImageRect = tile_space.mapRect(QRectF(m_image.rect())).toRect();
 	m_hqSourceId = m_image.cacheKey();
+	m_hqLevel = m_ptrPyramid->selectLevel(tile_space);
+	m_hqTileSpaceSet = true;
+
+	// Tiles are requested from paintEvent(), as only then
+	// we know which ones are visible.
+	update();
 }
 
 /**
- * Gets called from HqTransformationTask::Result.
+ * Gets called from HqTileTask::Result.
  */
 void
-ImageViewBase::hqVersionBuilt(
-	QPoint const& origin, QImage const& image)
+ImageViewBase::hqTileBuilt(
+	HqTileIdx const& idx, HqTileTask const* task, QImage const& image)
 {
 	if (!m_hqTransformEnabled) {
 		return;
 	}
+
+	HqTileMap::iterator const it(m_hqTiles.find(idx));
+	if (it == m_hqTiles.end() || it->second.task.get() != task) {
+		// The tile was discarded or requested again in the meantime.
+		return;
+	}
 	
-	m_hqPixmap = QPixmap::fromImage(image);
-	m_hqPixmapPos = origin;
-	m_ptrHqTransformTask.reset();
+	it->second.pixmap = QPixmap::fromImage(image);
+	it->second.task.reset();
 	update();
 }
 
@@ -1112,72 +1335,83 @@ ImageViewBase::backgroundExecutor()
 	return executor;
 }
 
+BackgroundExecutor&
+ImageViewBase::hqTileExecutor()
+{
+	static BackgroundExecutor executor(QThread::idealThreadCount());
+	return executor;
+}
+
 
-/*==================== ImageViewBase::HqTransformTask ======================*/
+/*======================= ImageViewBase::HqTileTask ========================*/
 
-ImageViewBase::HqTransformTask::HqTransformTask(
-	ImageViewBase* image_view,
-	QImage const& image, QTransform const& xform,
-	QSize const& target_size)
-:	m_ptrResult(new Result(image_view)),
-	m_image(image),
-	m_xform(xform),
-	m_targetSize(target_size)
+ImageViewBase::HqTileTask::HqTileTask(
+	ImageViewBase* image_view, HqTileIdx const& idx,
+	IntrusivePtr<ImagePyramid> const& pyramid, int const level,
+	QTransform const& image_to_tile_space, QRect const& tile_rect)
+:	m_ptrResult(new Result(image_view, idx, this)),
+	m_ptrPyramid(pyramid),
+	m_level(level),
+	m_imageToTileSpace(image_to_tile_space),
+	m_tileRect(tile_rect)
 {
 }
 
 IntrusivePtr<AbstractCommand0<void> >
-ImageViewBase::HqTransformTask::operator()()
+ImageViewBase::HqTileTask::operator()()
 {
 	if (isCancelled()) {
 		return IntrusivePtr<AbstractCommand0<void> >();
 	}
-	
-	QRect const target_rect(
-		m_xform.map(
-			QRectF(m_image.rect())
-		).boundingRect().toRect().intersected(
-			QRect(QPoint(0, 0), m_targetSize)
-		)
+
+	// This may build the level, if no one did it before.
+	QImage const level_image(m_ptrPyramid->level(m_level));
+
+	if (isCancelled()) {
+		return IntrusivePtr<AbstractCommand0<void> >();
+	}
+
+	QTransform const level_to_tile_space(
+		m_ptrPyramid->imageToLevel(m_level).inverted() * m_imageToTileSpace
 	);
 	
-	QImage hq_image(
+	QImage tile_image(
 		transform(
-			m_image, m_xform, target_rect,
+			level_image, level_to_tile_space, m_tileRect,
 			OutsidePixels::assumeWeakColor(Qt::white), QSizeF(0.0, 0.0)
 		)
 	);
 #if defined(Q_WS_X11)
 	// ARGB32_Premultiplied is an optimal format for X11 + XRender.
-	hq_image = hq_image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+	tile_image = tile_image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
 #endif
-	m_ptrResult->setData(target_rect.topLeft(), hq_image);
+	m_ptrResult->setData(tile_image);
 	
 	return m_ptrResult;
 }
 
 
-/*================ ImageViewBase::HqTransformTask::Result ================*/
+/*=================== ImageViewBase::HqTileTask::Result ====================*/
 
-ImageViewBase::HqTransformTask::Result::Result(
-	ImageViewBase* image_view)
-:	m_ptrImageView(image_view)
+ImageViewBase::HqTileTask::Result::Result(
+	ImageViewBase* image_view, HqTileIdx const& idx, HqTileTask const* task)
+:	m_ptrImageView(image_view),
+	m_idx(idx),
+	m_pTask(task)
 {
 }
 
 void
-ImageViewBase::HqTransformTask::Result::setData(
-	QPoint const& origin, QImage const& hq_image)
+ImageViewBase::HqTileTask::Result::setData(QImage const& tile_image)
 {
-	m_hqImage = hq_image;
-	m_origin = origin;
+	m_tileImage = tile_image;
 }
 
 void
-ImageViewBase::HqTransformTask::Result::operator()()
+ImageViewBase::HqTileTask::Result::operator()()
 {
 	if (m_ptrImageView && !isCancelled()) {
-		m_ptrImageView->hqVersionBuilt(m_origin, m_hqImage);
+		m_ptrImageView->hqTileBuilt(m_idx, m_pTask, m_tileImage);
 	}
 }
 
@@ -35,11 +35,16 @@
 #include <QPointF>
 #include <QSizeF>
 #include <QRectF>
+#include <QRect>
 #include <Qt>
+#include <map>
+#include <vector>
+#include <utility>
 
 class QPainter;
 class BackgroundExecutor;
 class ImagePresentation;
+class ImagePyramid;
 
 /**
  * \brief The base class for widgets that display and manipulate images.
@@ -263,10 +268,42 @@ private slots:
 
 	void reactToScrollBars();
 private:
-	class HqTransformTask;
+	class HqTileTask;
 	class TempFocalPointAdjuster;
 	class TransformChangeWatcher;
 
+	/**
+	 * Column and row of a high quality tile in the tile space.
+	 */
+	typedef std::pair<int, int> HqTileIdx;
+
+	struct HqTile
+	{
+		/**
+		 * The area this tile covers, in tile space coordinates.
+		 */
+		QRect rect;
+
+		/**
+		 * Null until the tile is built.
+		 */
+		QPixmap pixmap;
+
+		/**
+		 * The pending task building this tile, if any.
+		 */
+		IntrusivePtr<HqTileTask> task;
+
+		/**
+		 * The value of m_hqPaintCounter when this tile was last visible.
+		 */
+		unsigned lastUsed;
+
+		HqTile() : lastUsed(0) {}
+	};
+
+	typedef std::map<HqTileIdx, HqTile> HqTileMap;
+
 	QRectF dynamicViewportRect() const;
 
 	void transformChanged();
@@ -283,11 +320,26 @@ private:
 	
 	QPointF centeredWidgetFocalPoint() const;
 	
-	bool validateHqPixmap() const;
+	static void splitHqTransform(
+		QTransform const& xform, QTransform& tile_space, QPoint& tile_space_origin);
+
+	bool validateHqTileSpace(QTransform const& tile_space) const;
+
+	void visibleHqTiles(
+		QPoint const& tile_space_origin, std::vector<HqTileIdx>& tiles) const;
+
+	int requestMissingHqTiles(std::vector<HqTileIdx> const& visible_tiles);
+
+	void evictHqTiles();
+
+	void discardHqTiles();
 
 	void scheduleHqVersionRebuild();
 
-	void hqVersionBuilt(QPoint const& origin, QImage const& image);
+	void hqTileBuilt(
+		HqTileIdx const& idx, HqTileTask const* task, QImage const& image);
+
+	static BackgroundExecutor& hqTileExecutor();
 
 	void updateStatusTipAndCursor();
 
@@ -320,37 +372,61 @@ private:
 	QPixmap m_pixmap;
 	
 	/**
-	 * The high quality, pre-transformed version of m_pixmap.
+	 * Progressively downscaled versions of m_image.  High quality tiles
+	 * are built from the coarsest level that still has enough resolution.
 	 */
-	QPixmap m_hqPixmap;
-	
+	IntrusivePtr<ImagePyramid> m_ptrPyramid;
+
 	/**
-	 * The position, in widget coordinates, where m_hqPixmap is to be drawn.
+	 * High quality, pre-transformed pieces of m_image.
+	 *
+	 * The tile space is m_image transformed by the linear part of
+	 * image-to-widget transformation, plus the fractional part of its
+	 * translation.  Tile space coordinates plus an integer offset give
+	 * widget coordinates, which makes tiles reusable while panning.
+	 * Tiles are only built for the visible area and are discarded
+	 * when the tile space changes, that is when zooming.
 	 */
-	QPoint m_hqPixmapPos;
-	
+	HqTileMap m_hqTiles;
+
 	/**
-	 * The transformation used to build m_hqPixmap.
-	 * It's used to detect if m_hqPixmap needs to be rebuild.
+	 * The transformation from image coordinates to the tile space.
 	 */
-	QTransform m_hqXform;
+	QTransform m_hqTileSpace;
 
 	/**
-	 * Used to check if we need to extend the delay before building m_hqPixmap.
+	 * Used to check if we need to extend the delay before building
+	 * high quality tiles for a new tile space.
 	 */
-	QTransform m_potentialHqXform;
+	QTransform m_potentialHqTileSpace;
+
+	/**
+	 * m_image.rect() mapped to the tile space.
+	 */
+	QRect m_hqImageRect;
 	
 	/**
 	 * The ID (QImage::cacheKey()) of the image that was used
-	 * to build m_hqPixmap.  It's used to detect if m_hqPixmap
-	 * needs to be rebuilt.
+	 * to build m_hqTiles.  It's used to detect if m_hqTiles
+	 * need to be rebuilt.
 	 */
 	qint64 m_hqSourceId;
-	
+
+	/**
+	 * The level of m_ptrPyramid high quality tiles are built from.
+	 */
+	int m_hqLevel;
+
+	/**
+	 * Incremented on every paint.  Used to evict the least recently
+	 * visible tiles.
+	 */
+	unsigned m_hqPaintCounter;
+
 	/**
-	 * The pending (if any) high quality transformation task.
+	 * Set once m_hqTileSpace is initialized.
 	 */
-	IntrusivePtr<HqTransformTask> m_ptrHqTransformTask;
+	bool m_hqTileSpaceSet;
 
 	/**
 	 * Transformation from m_pixmap coordinates to m_image coordinates.
@@ -255,7 +255,10 @@ JpegMetadataLoader::loadMetadata(
 	// The other possible value is JPEG_SUSPENDED, but we never suspend it.
 	assert(header_status == JPEG_HEADER_OK);
 	
-	if (!jpeg_start_decompress(cinfo.ptr())) {
+	// For progressive JPEGs, jpeg_start_decompress() would read and
+	// entropy-decode the whole file, so we only call it for baseline ones.
+	// Everything we need is already known after jpeg_read_header().
+	if (!cinfo->progressive_mode && !jpeg_start_decompress(cinfo.ptr())) {
 		// libjpeg doesn't support all compression types.
 		return GENERIC_ERROR;
 	}
@@ -31,12 +31,21 @@
 #include "Dpm.h"
 #include "FilterData.h"
 #include "ImageLoader.h"
+#include "ImageMetadataLoader.h"
+#include "Profiler.h"
 #include <QCoreApplication>
 #include <QFile>
 #include <QDir>
+#include <QFileInfo>
 #include <QImage>
+#include <QSize>
 #include <QString>
 #include <QTextDocument> // for Qt::escape()
+#include <boost/bind.hpp>
+#include <boost/lambda/lambda.hpp>
+#include <boost/lambda/bind.hpp>
+#include <vector>
+#include <exception>
 #include <assert.h>
 
 using namespace imageproc;
@@ -57,6 +66,18 @@ private:
 	bool m_fileExists;
 };
 
+/**
+ * Thrown by loadImageOnDemand() when the image can't be loaded or doesn't
+ * match the metadata the deferred processing was started with.
+ */
+class LoadFileTask::ImageMismatch : public std::exception
+{
+public:
+	virtual char const* what() const throw() {
+		return "LoadFileTask: image doesn't match its metadata";
+	}
+};
+
 
 LoadFileTask::LoadFileTask(
 	Type type, PageInfo const& page,
@@ -80,24 +101,130 @@ LoadFileTask::~LoadFileTask()
 FilterResultPtr
 LoadFileTask::operator()()
 {
-	QImage image(ImageLoader::load(m_imageId));
-	
+	ProfileSpan const task_span(
+		"LoadFileTask", Profiler::isEnabled() ? profileLabel() : QString()
+	);
+
 	try {
-		throwIfCancelled();
-		
-		if (image.isNull()) {
-			return FilterResultPtr(new ErrorResult(m_imageId.filePath()));
-		} else {
-			updateImageSizeIfChanged(image);
-			overrideDpi(image);
-			m_ptrThumbnailCache->ensureThumbnailExists(m_imageId, image);
-			return m_ptrNextTask->process(*this, FilterData(image));
+		// If we know what the image looks like, we start the processing
+		// without loading it.  The stages whose stored results are still
+		// valid only need the transformation, so the image is only loaded
+		// once some stage actually has to recompute something.
+		if (canDeferLoading()) {
+			ImageTransformation const xform(
+				QRect(QPoint(0, 0), m_imageMetadata.size()),
+				// Round-trip through Dpm, just like overrideDpi() does.
+				Dpm(m_imageMetadata.dpi())
+			);
+			FilterData const data(
+				boost::bind(&LoadFileTask::loadImageOnDemand, this), xform
+			);
+			try {
+				return m_ptrNextTask->process(*this, data);
+			} catch (ImageMismatch const&) {
+				// The header said otherwise, so either the file is damaged,
+				// or it was replaced after we've checked it.  We don't start
+				// over, as the stages that ran before may have already updated
+				// their settings.  The next run will see the new header.
+				return FilterResultPtr(new ErrorResult(m_imageId.filePath()));
+			}
 		}
+
+		QImage image(loadImage());
+
+		throwIfCancelled();
+
+		return processLoaded(image);
 	} catch (CancelledException const&) {
 		return FilterResultPtr();
 	}
 }
 
+FilterResultPtr
+LoadFileTask::processLoaded(QImage& image)
+{
+	if (image.isNull()) {
+		return FilterResultPtr(new ErrorResult(m_imageId.filePath()));
+	}
+
+	updateImageSizeIfChanged(image);
+	overrideDpi(image);
+	m_ptrThumbnailCache->ensureThumbnailExists(m_imageId, image);
+	return m_ptrNextTask->process(*this, FilterData(image));
+}
+
+/**
+ * Loading the image can be deferred if its size is known and matches
+ * the one in the file header, and there is no thumbnail to be made
+ * from it.  Everything that could make the processing start over is
+ * checked here, before any stage runs.
+ */
+bool
+LoadFileTask::canDeferLoading() const
+{
+	if (m_imageMetadata.size().isEmpty() || !m_imageMetadata.isDpiOK()) {
+		return false;
+	}
+
+	if (m_ptrThumbnailCache->needsThumbnail(m_imageId)) {
+		return false;
+	}
+
+	return imageSizeFromHeader() == m_imageMetadata.size();
+}
+
+/**
+ * Reads the image size from the file header, without decoding the image.
+ * Returns an invalid size if that's not possible.
+ */
+QSize
+LoadFileTask::imageSizeFromHeader() const
+{
+	std::vector<ImageMetadata> metadata;
+	void (std::vector<ImageMetadata>::*push_back) (const ImageMetadata&) =
+		&std::vector<ImageMetadata>::push_back;
+	ImageMetadataLoader::Status const status = ImageMetadataLoader::load(
+		m_imageId.filePath(), boost::lambda::bind(
+			push_back, boost::lambda::var(metadata), boost::lambda::_1
+		)
+	);
+
+	int const page = m_imageId.zeroBasedPage();
+	if (status != ImageMetadataLoader::LOADED || page >= (int)metadata.size()) {
+		return QSize();
+	}
+	return metadata[page].size();
+}
+
+/**
+ * Provides the image to a FilterData constructed without one.
+ * Throws ImageMismatch if the image can't be loaded or its size
+ * is not what the FilterData was constructed for.
+ */
+QImage
+LoadFileTask::loadImageOnDemand()
+{
+	QImage image(loadImage());
+
+	throwIfCancelled();
+
+	if (image.size() != m_imageMetadata.size()) {
+		throw ImageMismatch();
+	}
+
+	overrideDpi(image);
+	return image;
+}
+
+QImage
+LoadFileTask::loadImage() const
+{
+	ProfileSpan load_span("ImageLoader::load");
+	QImage const image(ImageLoader::load(m_imageId));
+	load_span.setImageSize(image.size());
+	return image;
+}
+
 void
 LoadFileTask::updateImageSizeIfChanged(QImage const& image)
 {
@@ -115,6 +242,16 @@ LoadFileTask::updateImageSizeIfChanged(QImage const& image)
 	}
 }
 
+QString
+LoadFileTask::profileLabel() const
+{
+	QString label(QFileInfo(m_imageId.filePath()).fileName());
+	if (m_imageId.page() > 0) {
+		label += QString::fromAscii(":%1").arg(m_imageId.page());
+	}
+	return label;
+}
+
 void
 LoadFileTask::overrideDpi(QImage& image) const
 {
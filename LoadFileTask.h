@@ -25,11 +25,12 @@
 #include "IntrusivePtr.h"
 #include "ImageId.h"
 #include "ImageMetadata.h"
+#include <QImage>
+#include <QSize>
 
 class ThumbnailPixmapCache;
 class PageInfo;
 class ProjectPages;
-class QImage;
 
 namespace fix_orientation
 {
@@ -50,10 +51,23 @@ public:
 	virtual FilterResultPtr operator()();
 private:
 	class ErrorResult;
+	class ImageMismatch;
 	
+	FilterResultPtr processLoaded(QImage& image);
+
+	bool canDeferLoading() const;
+
+	QSize imageSizeFromHeader() const;
+
+	QImage loadImageOnDemand();
+
+	QImage loadImage() const;
+
 	void updateImageSizeIfChanged(QImage const& image);
 	
 	void overrideDpi(QImage& image) const;
+
+	QString profileLabel() const;
 	
 	IntrusivePtr<ThumbnailPixmapCache> m_ptrThumbnailCache;
 	ImageId m_imageId;
@@ -44,7 +44,9 @@
 #include "TabbedDebugImages.h"
 #include "BasicImageView.h"
 #include "ProjectWriter.h"
+#include "ProjectIndex.h"
 #include "ProjectReader.h"
+#include "XmlStreamUtils.h"
 #include "ThumbnailPixmapCache.h"
 #include "ThumbnailFactory.h"
 #include "ContentBoxPropagator.h"
@@ -63,6 +65,7 @@
 #include "AbstractRelinker.h"
 #include "RelinkingDialog.h"
 #include "OutOfMemoryHandler.h"
+#include "MemoryBudget.h"
 #include "OutOfMemoryDialog.h"
 #include "QtSignalForwarder.h"
 #include "filters/fix_orientation/Filter.h"
@@ -121,7 +124,6 @@
 #include <QPalette>
 #include <QStyle>
 #include <QSettings>
-#include <QDomDocument>
 #include <QSortFilterProxyModel>
 #include <QFileSystemModel>
 #include <QFileInfo>
@@ -160,6 +162,8 @@ MainWindow::MainWindow()
 	m_ptrStages(new StageSequence(m_ptrPages, newPageSelectionAccessor())),
 	m_ptrWorkerThread(new WorkerThread),
 	m_ptrInteractiveQueue(new ProcessingTaskQueue(ProcessingTaskQueue::RANDOM_ORDER)),
+	m_ptrPrefetchQueue(new ProcessingTaskQueue(ProcessingTaskQueue::RANDOM_ORDER)),
+	m_allThumbnailsInvalidated(false),
 	m_ptrOutOfMemoryDialog(new OutOfMemoryDialog),
 	m_curFilter(0),
 	m_ignoreSelectionChanges(0),
@@ -311,12 +315,29 @@ MainWindow::MainWindow()
 			resize(1014, 689); // A sensible value.
 		}
 	}
+
+	// Filters only re-serialize pages whose settings have changed,
+	// so periodic saving stays cheap even for large projects.
+	int const autosave_minutes = settings.value(
+		"settings/autosave_interval_minutes", 5
+	).toInt();
+	connect(&m_autosaveTimer, SIGNAL(timeout()), SLOT(autosaveProject()));
+	if (autosave_minutes > 0) {
+		m_autosaveTimer.start(autosave_minutes * 60 * 1000);
+	}
+
+	// Zero means no limit.  Images that don't fit go to temporary files.
+	qint64 const memory_budget_mb = settings.value(
+		"settings/memory_budget_mb", 0
+	).toLongLong();
+	MemoryBudget::instance().setLimit(memory_budget_mb * 1024 * 1024);
 }
 
 
 MainWindow::~MainWindow()
 {
 	m_ptrInteractiveQueue->cancelAndClear();
+	cancelPrefetch();
 	if (m_ptrBatchQueue.get()) {
 		m_ptrBatchQueue->cancelAndClear();
 	}
@@ -353,6 +374,7 @@ MainWindow::switchToNewProject(
 {
 	stopBatchProcessing(CLEAR_MAIN_AREA);
 	m_ptrInteractiveQueue->cancelAndClear();
+	cancelPrefetch();
 
 	Utils::maybeCreateCacheDir(out_dir);
 	
@@ -578,6 +600,11 @@ MainWindow::promptProjectSave()
 	}
 }
 
+/**
+ * Compares two project files by their XML content rather than byte by byte,
+ * so that a project written by an older version, which ordered attributes
+ * differently, isn't considered changed just by being written again.
+ */
 bool
 MainWindow::compareFiles(QString const& fpath1, QString const& fpath2)
 {
@@ -591,22 +618,7 @@ MainWindow::compareFiles(QString const& fpath1, QString const& fpath2)
 		return false;
 	}
 	
-	if (!file1.isSequential() && !file2.isSequential()) {
-		if (file1.size() != file2.size()) {
-			return false;
-		}
-	}
-	
-	int const chunk_size = 4096;
-	for (;;) {
-		QByteArray const chunk1(file1.read(chunk_size));
-		QByteArray const chunk2(file2.read(chunk_size));
-		if (chunk1.size() != chunk2.size()) {
-			return false;
-		} else if (chunk1.size() == 0) {
-			return true;
-		}
-	}
+	return XmlStreamUtils::sameContent(file1, file2);
 }
 
 IntrusivePtr<PageOrderProvider const>
@@ -813,18 +825,31 @@ void
 MainWindow::invalidateThumbnail(PageId const& page_id)
 {
 	m_ptrThumbSequence->invalidateThumbnail(page_id);
+	
+	// A prefetched result for that page may no longer be up to date.
+	std::set<PageId> pages;
+	pages.insert(page_id);
+	m_ptrPrefetchQueue->cancelAndRemove(pages);
+	m_prefetchedResults.erase(page_id);
 }
 
 void
 MainWindow::invalidateThumbnail(PageInfo const& page_info)
 {
 	m_ptrThumbSequence->invalidateThumbnail(page_info);
+	
+	std::set<PageId> pages;
+	pages.insert(page_info.id());
+	m_ptrPrefetchQueue->cancelAndRemove(pages);
+	m_prefetchedResults.erase(page_info.id());
 }
 
 void
 MainWindow::invalidateAllThumbnails()
 {
 	m_ptrThumbSequence->invalidateAllThumbnails();
+	cancelPrefetch();
+	m_allThumbnailsInvalidated = true;
 }
 
 IntrusivePtr<AbstractCommand0<void> >
@@ -1096,6 +1121,9 @@ MainWindow::filterSelectionChanged(QItemSelection const& selected)
 		m_ptrBatchQueue->cancelAndClear();
 	}
 	
+	// Prefetched results belong to the previously selected filter.
+	cancelPrefetch();
+	
 	bool const was_below_fix_orientation = isBelowFixOrientation(m_curFilter);
 	bool const was_below_select_content = isBelowSelectContent(m_curFilter);
 	m_curFilter = selected.front().top();
@@ -1163,6 +1191,7 @@ MainWindow::startBatchProcessing()
 	}
 
 	m_ptrInteractiveQueue->cancelAndClear();
+	cancelPrefetch();
 	
 	m_ptrBatchQueue.reset(
 		new ProcessingTaskQueue(
@@ -1236,23 +1265,35 @@ MainWindow::filterResult(BackgroundTaskPtr const& task, FilterResultPtr const& r
 	if (m_ptrBatchQueue.get()) {
 		m_ptrBatchQueue->processingFinished(task);
 	}
+	PageInfo const prefetched_page(m_ptrPrefetchQueue->processingFinished(task));
 
 	if (task->isCancelled()) {
 		return;
 	}
 	
-	if (!isBatchProcessingInProgress()) {
-		if (!result->filter()) {
-			// Error loading file.  No special action is necessary.
-		} else if (result->filter() != m_ptrStages->filterAt(m_curFilter)) {
-			// Error from one of the previous filters.
-			int const idx = m_ptrStages->findFilter(result->filter());
-			assert(idx >= 0);
-			m_curFilter = idx;
+	if (!prefetched_page.isNull()) {
+		if (prefetched_page.id() != m_promotedPrefetchPage) {
+			// The result may be dropped without ever being displayed,
+			// so its thumbnail updates can't wait for that.
+			m_allThumbnailsInvalidated = false;
+			result->updateThumbnails(this);
+			if (m_allThumbnailsInvalidated) {
+				// Such as when the aggregate page size has changed.
+				// The displayed page is out of date as well.
+				updateMainArea();
+				return;
+			}
 			
-			ScopedIncDec<int> selection_guard(m_ignoreSelectionChanges);
-			filterList->selectRow(idx);
+			// Keep it until the user navigates to that page.
+			m_prefetchedResults[prefetched_page.id()] = result;
+			startNextPrefetch();
+			return;
 		}
+		m_promotedPrefetchPage = PageId();
+	}
+	
+	if (!isBatchProcessingInProgress()) {
+		selectResultFilter(result);
 	}
 
 	// This needs to be done even if batch processing is taking place,
@@ -1285,13 +1326,110 @@ MainWindow::filterResult(BackgroundTaskPtr const& task, FilterResultPtr const& r
 		if (!page.isNull()) {
 			m_ptrThumbSequence->setSelection(page.id());
 		}
+	} else {
+		schedulePrefetch(m_ptrThumbSequence->selectionLeader());
+	}
+}
+
+/**
+ * If \p result came from one of the filters preceding the current one,
+ * which happens when that filter fails, makes that filter current.
+ */
+void
+MainWindow::selectResultFilter(FilterResultPtr const& result)
+{
+	if (!result->filter()) {
+		// Error loading file.  No special action is necessary.
+	} else if (result->filter() != m_ptrStages->filterAt(m_curFilter)) {
+		// Error from one of the previous filters.
+		int const idx = m_ptrStages->findFilter(result->filter());
+		assert(idx >= 0);
+		m_curFilter = idx;
+		
+		ScopedIncDec<int> selection_guard(m_ignoreSelectionChanges);
+		filterList->selectRow(idx);
+	}
+}
+
+/**
+ * Queues interactive tasks for the pages before and after \p page,
+ * so that moving to one of them shows a ready result.  Only results
+ * for those two pages are retained.
+ */
+void
+MainWindow::schedulePrefetch(PageInfo const& page)
+{
+	m_ptrPrefetchQueue->cancelAndClear();
+	m_promotedPrefetchPage = PageId();
+	
+	if (page.isNull() || m_debug || isBatchProcessingInProgress()) {
+		m_prefetchedResults.clear();
+		return;
+	}
+	
+	PageInfo const neighbours[] = {
+		m_ptrThumbSequence->nextPage(page.id()),
+		m_ptrThumbSequence->prevPage(page.id())
+	};
+	
+	std::map<PageId, FilterResultPtr> retained;
+	BOOST_FOREACH (PageInfo const& neighbour, neighbours) {
+		if (neighbour.isNull()) {
+			continue;
+		}
+		
+		std::map<PageId, FilterResultPtr>::iterator const it(
+			m_prefetchedResults.find(neighbour.id())
+		);
+		if (it != m_prefetchedResults.end()) {
+			retained.insert(*it);
+			continue;
+		}
+		
+		if (isOutputFilter() && !checkReadyForOutput(&neighbour.id())) {
+			continue;
+		}
+		
+		m_ptrPrefetchQueue->addProcessingTask(
+			neighbour, createCompositeTask(
+				neighbour, m_curFilter, /*batch=*/false, /*debug=*/false
+			)
+		);
 	}
+	m_prefetchedResults.swap(retained);
+	
+	startNextPrefetch();
+}
+
+void
+MainWindow::startNextPrefetch()
+{
+	// Prefetching never competes with the task for the selected page.
+	if (!m_ptrInteractiveQueue->allProcessed()) {
+		return;
+	}
+	
+	BackgroundTaskPtr const task(m_ptrPrefetchQueue->takeForProcessing());
+	if (task) {
+		m_ptrWorkerThread->performTask(task);
+	}
+}
+
+void
+MainWindow::cancelPrefetch()
+{
+	m_ptrPrefetchQueue->cancelAndClear();
+	m_prefetchedResults.clear();
+	m_promotedPrefetchPage = PageId();
 }
 
 void
 MainWindow::debugToggled(bool const enabled)
 {
 	m_debug = enabled;
+	
+	// Prefetched results don't come with debug images.
+	cancelPrefetch();
 }
 
 void
@@ -1458,19 +1596,11 @@ MainWindow::openProject(QString const& project_file)
 		);
 		return;
 	}
-	
-	QDomDocument doc;
-	if (!doc.setContent(&file)) {
-		QMessageBox::warning(
-			this, tr("Error"),
-			tr("The project file is broken.")
-		);
-		return;
-	}
-	
 	file.close();
 	
-	ProjectOpeningContext* context = new ProjectOpeningContext(this, project_file, doc);
+	// The file is parsed by ProjectReader, which reports a broken
+	// file through ProjectOpeningContext.
+	ProjectOpeningContext* context = new ProjectOpeningContext(this, project_file);
 	connect(context, SIGNAL(done(ProjectOpeningContext*)), SLOT(projectOpened(ProjectOpeningContext*)));
 	context->proceed();
 }
@@ -1545,6 +1675,25 @@ MainWindow::handleOutOfMemorySituation()
 	m_ptrOutOfMemoryDialog.release()->show();
 }
 
+/**
+ * Writes the project into its backup file, the same one closeProjectInteractive()
+ * uses.  A backup left behind by a crash can then be opened in place of
+ * the project file.
+ */
+void
+MainWindow::autosaveProject()
+{
+	if (m_projectFile.isEmpty() || !isProjectLoaded()) {
+		return;
+	}
+
+	ProjectWriter writer(m_ptrPages, m_selectedPage, m_outFileNameGen);
+	QString const backup_file_path(backupFilePath(m_projectFile));
+	if (!writer.write(backup_file_path, m_ptrStages->filters())) {
+		QFile::remove(backup_file_path);
+	}
+}
+
 /**
  * Note: the removed widgets are not deleted.
  */
@@ -1693,6 +1842,28 @@ MainWindow::loadPageInteractive(PageInfo const& page)
 	
 	assert(m_ptrThumbnailCache.get());
 
+	std::map<PageId, FilterResultPtr>::iterator const it(
+		m_prefetchedResults.find(page.id())
+	);
+	if (it != m_prefetchedResults.end()) {
+		FilterResultPtr const result(it->second);
+		m_prefetchedResults.erase(it);
+		selectResultFilter(result);
+		result->updateUI(this);
+		schedulePrefetch(page);
+		return;
+	}
+	
+	if (m_ptrPrefetchQueue->isBeingProcessed(page.id())) {
+		// The result is on its way.  Display it once it's ready.
+		m_promotedPrefetchPage = page.id();
+		return;
+	}
+	
+	// Prefetch tasks would delay the one we are about to start.
+	m_ptrPrefetchQueue->cancelAndClear();
+	m_promotedPrefetchPage = PageId();
+
 	m_ptrInteractiveQueue->cancelAndClear();
 	m_ptrInteractiveQueue->addProcessingTask(
 		page, createCompositeTask(page, m_curFilter, /*batch=*/false, m_debug)
@@ -1739,16 +1910,12 @@ MainWindow::closeProjectInteractive()
 		return true;
 	}
 	
-	QFileInfo const project_file(m_projectFile);
-	QFileInfo const backup_file(
-		project_file.absoluteDir(),
-		QString::fromAscii("Backup.")+project_file.fileName()
-	);
-	QString const backup_file_path(backup_file.absoluteFilePath());
+	QString const backup_file_path(backupFilePath(m_projectFile));
+	QString const backup_index_path(ProjectIndex::indexPathFor(backup_file_path));
 	
 	ProjectWriter writer(m_ptrPages, m_selectedPage, m_outFileNameGen);
 	
-	if (!writer.write(backup_file_path, m_ptrStages->filters())) {
+	if (!writer.write(backup_file_path, m_ptrStages->filters(), projectIndexEnabled())) {
 		// Backup file could not be written???
 		QFile::remove(backup_file_path);
 		switch (promptProjectSave()) {
@@ -1767,6 +1934,7 @@ MainWindow::closeProjectInteractive()
 	if (compareFiles(m_projectFile, backup_file_path)) {
 		// The project hasn't really changed.
 		QFile::remove(backup_file_path);
+		QFile::remove(backup_index_path);
 		closeProjectWithoutSaving();
 		return true;
 	}
@@ -1781,9 +1949,16 @@ MainWindow::closeProjectInteractive()
 				);
 				return false;
 			}
+			// The index records a hash of the project file's contents,
+			// so it still matches after both have been renamed.
+			if (!Utils::overwritingRename(
+					backup_index_path, ProjectIndex::indexPathFor(m_projectFile))) {
+				QFile::remove(ProjectIndex::indexPathFor(m_projectFile));
+			}
 			// fall through
 		case DONT_SAVE:
 			QFile::remove(backup_file_path);
+			QFile::remove(backup_index_path);
 			break;
 		case CANCEL:
 			return false;
@@ -1805,7 +1980,7 @@ MainWindow::saveProjectWithFeedback(QString const& project_file)
 {
 	ProjectWriter writer(m_ptrPages, m_selectedPage, m_outFileNameGen);
 	
-	if (!writer.write(project_file, m_ptrStages->filters())) {
+	if (!writer.write(project_file, m_ptrStages->filters(), projectIndexEnabled())) {
 		QMessageBox::warning(
 			this, tr("Error"),
 			tr("Error saving the project file!")
@@ -1816,6 +1991,30 @@ MainWindow::saveProjectWithFeedback(QString const& project_file)
 	return true;
 }
 
+QString
+MainWindow::backupFilePath(QString const& project_file)
+{
+	QFileInfo const project_file_info(project_file);
+	QFileInfo const backup_file(
+		project_file_info.absoluteDir(),
+		QString::fromAscii("Backup.")+project_file_info.fileName()
+	);
+	return backup_file.absoluteFilePath();
+}
+
+/**
+ * Whether a ProjectIndex is to be written along with the project file.
+ * The index is only an accelerator for opening the project, so failing
+ * to write it is not an error.  A stale index is detected and ignored
+ * by ProjectReader.
+ */
+bool
+MainWindow::projectIndexEnabled()
+{
+	QSettings const settings;
+	return settings.value("settings/write_project_index", true).toBool();
+}
+
 /**
  * Note: showInsertFileDialog(BEFORE, ImageId()) is legal and means inserting at the end.
  */
@@ -2002,6 +2201,7 @@ void
 MainWindow::removeFromProject(std::set<PageId> const& pages)
 {
 	m_ptrInteractiveQueue->cancelAndRemove(pages);
+	cancelPrefetch();
 	if (m_ptrBatchQueue.get()) {
 		m_ptrBatchQueue->cancelAndRemove(pages);
 	}
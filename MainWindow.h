@@ -40,10 +40,12 @@
 #include <QString>
 #include <QPointer>
 #include <QObjectCleanupHandler>
+#include <QTimer>
 #include <QSizeF>
 #include <memory>
 #include <vector>
 #include <set>
+#include <map>
 
 class AbstractFilter;
 class AbstractRelinker;
@@ -170,6 +172,8 @@ private slots:
 	void showAboutDialog();
 
 	void handleOutOfMemorySituation();
+
+	void autosaveProject();
 private:
 	class PageSelectionProviderImpl;
 	enum SavePromptResult { SAVE, DONT_SAVE, CANCEL };
@@ -238,6 +242,14 @@ private:
 	
 	void loadPageInteractive(PageInfo const& page);
 	
+	void selectResultFilter(FilterResultPtr const& result);
+	
+	void schedulePrefetch(PageInfo const& page);
+	
+	void startNextPrefetch();
+	
+	void cancelPrefetch();
+	
 	void updateWindowTitle();
 	
 	bool closeProjectInteractive();
@@ -245,6 +257,10 @@ private:
 	void closeProjectWithoutSaving();
 	
 	bool saveProjectWithFeedback(QString const& project_file);
+
+	static QString backupFilePath(QString const& project_file);
+
+	static bool projectIndexEnabled();
 	
 	void showInsertFileDialog(
 		BeforeOrAfter before_or_after, ImageId const& existig);
@@ -282,6 +298,28 @@ private:
 	std::auto_ptr<WorkerThread> m_ptrWorkerThread;
 	std::auto_ptr<ProcessingTaskQueue> m_ptrBatchQueue;
 	std::auto_ptr<ProcessingTaskQueue> m_ptrInteractiveQueue;
+	
+	/**
+	 * Interactive tasks for the pages next to the selected one.
+	 * They only run when the worker thread would otherwise be idle,
+	 * and their results are kept in m_prefetchedResults until the user
+	 * navigates to one of those pages.
+	 */
+	std::auto_ptr<ProcessingTaskQueue> m_ptrPrefetchQueue;
+	std::map<PageId, FilterResultPtr> m_prefetchedResults;
+	
+	/**
+	 * The selected page, whose prefetch task was already running
+	 * when the page got selected.  Its result is to be displayed
+	 * rather than kept.
+	 */
+	PageId m_promotedPrefetchPage;
+	
+	/**
+	 * Set by invalidateAllThumbnails(), which lets filterResult() find out
+	 * a prefetched result made the displayed page out of date.
+	 */
+	bool m_allThumbnailsInvalidated;
 	QStackedLayout* m_pImageFrameLayout;
 	QStackedLayout* m_pOptionsFrameLayout;
 	QPointer<FilterOptionsWidget> m_ptrOptionsWidget;
@@ -296,6 +334,7 @@ private:
 	QObjectCleanupHandler m_optionsWidgetCleanup;
 	QObjectCleanupHandler m_imageWidgetCleanup;
 	std::auto_ptr<OutOfMemoryDialog> m_ptrOutOfMemoryDialog;
+	QTimer m_autosaveTimer;
 	int m_curFilter;
 	int m_ignoreSelectionChanges;
 	int m_ignorePageOrderingChanges;
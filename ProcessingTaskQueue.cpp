@@ -60,7 +60,7 @@ ProcessingTaskQueue::takeForProcessing()
 	return BackgroundTaskPtr();
 }
 
-void
+PageInfo
 ProcessingTaskQueue::processingFinished(BackgroundTaskPtr const& task)
 {
 	std::list<Entry>::iterator it(m_queue.begin());
@@ -69,12 +69,12 @@ ProcessingTaskQueue::processingFinished(BackgroundTaskPtr const& task)
 	for (;; ++it) {
 		if (it == end) {
 			// Task not found.
-			return;
+			return PageInfo();
 		}
 
 		if (!it->takenForProcessing) {
 			// There is no point in looking further.
-			return;
+			return PageInfo();
 		}
 
 		if (it->task == task) {
@@ -92,7 +92,9 @@ ProcessingTaskQueue::processingFinished(BackgroundTaskPtr const& task)
 		m_selectedPage = it->pageInfo;
 	}
 
+	PageInfo const page_info(it->pageInfo);
 	m_queue.erase(it);
+	return page_info;
 }
 
 PageInfo
@@ -107,6 +109,21 @@ ProcessingTaskQueue::allProcessed() const
 	return m_queue.empty();
 }
 
+bool
+ProcessingTaskQueue::isBeingProcessed(PageId const& page_id) const
+{
+	BOOST_FOREACH(Entry const& ent, m_queue) {
+		if (!ent.takenForProcessing) {
+			break;
+		}
+		if (ent.pageInfo.id() == page_id) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
 void
 ProcessingTaskQueue::cancelAndRemove(std::set<PageId> const& pages)
 {
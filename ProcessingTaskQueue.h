@@ -48,7 +48,13 @@ public:
 	 */
 	BackgroundTaskPtr takeForProcessing();
 
-	void processingFinished(BackgroundTaskPtr const& task);
+	/**
+	 * \brief Removes a finished task from the queue.
+	 *
+	 * \return The page the task was processing, or a null PageInfo
+	 *         if the task didn't come from this queue.
+	 */
+	PageInfo processingFinished(BackgroundTaskPtr const& task);
 
 	/**
 	 * \brief Returns the page to be visually selected.
@@ -60,6 +66,12 @@ public:
 	PageInfo selectedPage() const;
 
 	bool allProcessed() const;
+	
+	/**
+	 * \brief Returns true if a task for the given page was taken
+	 *        for processing and hasn't finished yet.
+	 */
+	bool isBeingProcessed(PageId const& page_id) const;
 
 	void cancelAndRemove(std::set<PageId> const& pages);
 
@@ -21,6 +21,8 @@
 #include "NonCopyable.h"
 #include "ImageMetadata.h"
 #include "ImageMetadataLoader.h"
+#include "ImageMetadataCache.h"
+#include "ImageMetadataScanner.h"
 #include "SmartFilenameOrdering.h"
 #include <QAbstractListModel>
 #include <QSortFilterProxyModel>
@@ -37,12 +39,15 @@
 #include <QMessageBox>
 #include <QTimerEvent>
 #include <QSettings>
+#include <QDesktopServices>
+#include <QThread>
 #include <QBrush>
 #include <QColor>
 #include <QDebug>
 #include <boost/lambda/lambda.hpp>
 #include <boost/lambda/bind.hpp>
 #include <boost/lambda/construct.hpp>
+#include <boost/foreach.hpp>
 #include <vector>
 #include <deque>
 #include <algorithm>
@@ -85,7 +90,7 @@ class ProjectFilesDialog::FileList : private QAbstractListModel
 {
 	DECLARE_NON_COPYABLE(FileList)
 public:
-	enum LoadStatus { LOAD_OK, LOAD_FAILED, NO_MORE_FILES };
+	enum LoadStatus { LOAD_OK, LOAD_FAILED, NOT_READY_YET, NO_MORE_FILES };
 	
 	FileList();
 	
@@ -116,9 +121,9 @@ public:
 	
 	void remove(QItemSelection const& selection);
 	
-	void prepareForLoadingFiles();
+	void prepareForLoadingFiles(ImageMetadataScanner& scanner);
 	
-	LoadStatus loadNextFile();
+	LoadStatus loadNextFile(ImageMetadataScanner& scanner);
 private:
 	virtual int rowCount(QModelIndex const& parent) const;
 	
@@ -127,7 +132,7 @@ private:
 	virtual Qt::ItemFlags flags(QModelIndex const& index) const;
 	
 	std::vector<Item> m_items;
-	std::deque<int> m_itemsToLoad;
+	int m_numItemsToLoad;
 };
 
 
@@ -586,7 +591,24 @@ ProjectFilesDialog::onOK()
 void
 ProjectFilesDialog::startLoadingMetadata()
 {
-	m_ptrInProjectFiles->prepareForLoadingFiles();
+	if (!m_ptrMetadataCache.get()) {
+		QString const cache_dir(
+			QDesktopServices::storageLocation(QDesktopServices::CacheLocation)
+		);
+		if (!cache_dir.isEmpty()) {
+			m_ptrMetadataCache.reset(
+				new ImageMetadataCache(cache_dir + "/image_metadata.cache")
+			);
+		}
+	}
+	
+	// Reading metadata is mostly I/O bound, so we may use more threads
+	// than there are cores, but not so many as to thrash a spinning disk.
+	int const num_threads = std::min(std::max(QThread::idealThreadCount(), 2), 8);
+	m_ptrMetadataScanner.reset(
+		new ImageMetadataScanner(m_ptrMetadataCache.get(), num_threads)
+	);
+	m_ptrInProjectFiles->prepareForLoadingFiles(*m_ptrMetadataScanner);
 	
 	progressBar->setMaximum(m_ptrInProjectFiles->count());
 	inpDirLine->setEnabled(false);
@@ -602,7 +624,7 @@ ProjectFilesDialog::startLoadingMetadata()
 	buttonBox->button(QDialogButtonBox::Ok)->setEnabled(false);
 	offProjectList->clearSelection();
 	inProjectList->clearSelection();
-	m_loadTimerId = startTimer(0);
+	m_loadTimerId = startTimer(50);
 	m_metadataLoadFailed = false;
 }
 
@@ -614,16 +636,23 @@ ProjectFilesDialog::timerEvent(QTimerEvent* event)
 		return;
 	}
 	
-	switch (m_ptrInProjectFiles->loadNextFile()) {
-		case FileList::NO_MORE_FILES:
-			finishLoadingMetadata();
-			break;
-		case FileList::LOAD_FAILED:
-			m_metadataLoadFailed = true;
-			// Fall through.
-		case FileList::LOAD_OK:
-			progressBar->setValue(progressBar->value() + 1);
-			break;
+	int num_loaded = 0;
+	for (;;) {
+		switch (m_ptrInProjectFiles->loadNextFile(*m_ptrMetadataScanner)) {
+			case FileList::NO_MORE_FILES:
+				progressBar->setValue(progressBar->value() + num_loaded);
+				finishLoadingMetadata();
+				return;
+			case FileList::NOT_READY_YET:
+				progressBar->setValue(progressBar->value() + num_loaded);
+				return;
+			case FileList::LOAD_FAILED:
+				m_metadataLoadFailed = true;
+				// Fall through.
+			case FileList::LOAD_OK:
+				++num_loaded;
+				break;
+		}
 	}
 }
 
@@ -631,6 +660,10 @@ void
 ProjectFilesDialog::finishLoadingMetadata()
 {
 	killTimer(m_loadTimerId);
+	m_ptrMetadataScanner.reset();
+	if (m_ptrMetadataCache.get()) {
+		m_ptrMetadataCache->save();
+	}
 	
 	inpDirLine->setEnabled(true);
 	inpDirBrowseBtn->setEnabled(true);
@@ -662,6 +695,7 @@ ProjectFilesDialog::finishLoadingMetadata()
 /*====================== ProjectFilesDialog::FileList ====================*/
 
 ProjectFilesDialog::FileList::FileList()
+:	m_numItemsToLoad(0)
 {
 }
 
@@ -757,7 +791,7 @@ ProjectFilesDialog::FileList::flags(QModelIndex const& index) const
 }
 
 void
-ProjectFilesDialog::FileList::prepareForLoadingFiles()
+ProjectFilesDialog::FileList::prepareForLoadingFiles(ImageMetadataScanner& scanner)
 {
 	using namespace boost::lambda;
 	
@@ -775,35 +809,34 @@ ProjectFilesDialog::FileList::prepareForLoadingFiles()
 		)
 	);
 	
-	m_itemsToLoad.swap(item_indexes);
+	// The scanner reads files in parallel, but we still submit them
+	// in the visual order, so that the progress looks natural.
+	BOOST_FOREACH(int const item_idx, item_indexes) {
+		scanner.enqueue(item_idx, m_items[item_idx].fileInfo().absoluteFilePath());
+	}
+	m_numItemsToLoad = num_items;
 }
 
 ProjectFilesDialog::FileList::LoadStatus
-ProjectFilesDialog::FileList::loadNextFile()
+ProjectFilesDialog::FileList::loadNextFile(ImageMetadataScanner& scanner)
 {
-	using namespace boost::lambda;
-	
-	if (m_itemsToLoad.empty()) {
+	if (m_numItemsToLoad == 0) {
 		return NO_MORE_FILES;
 	}
 	
-	int const item_idx = m_itemsToLoad.front();
+	ImageMetadataScanner::Result result;
+	if (!scanner.takeResult(result)) {
+		return NOT_READY_YET;
+	}
+	
+	int const item_idx = result.id;
 	Item& item = m_items[item_idx];
-	std::vector<ImageMetadata> per_page_metadata;
-	QString const file_path(item.fileInfo().absoluteFilePath());
-	void (std::vector<ImageMetadata>::*push_back) (const ImageMetadata&) =
-		&std::vector<ImageMetadata>::push_back;
-	ImageMetadataLoader::Status const st = ImageMetadataLoader::load(
-		file_path, boost::lambda::bind(
-			push_back, var(per_page_metadata), _1
-		)
-	);
 	
 	LoadStatus status;
 	
-	if (st == ImageMetadataLoader::LOADED) {
+	if (result.status == ImageMetadataLoader::LOADED) {
 		status = LOAD_OK;
-		item.perPageMetadata().swap(per_page_metadata);
+		item.perPageMetadata().swap(result.perPageMetadata);
 		item.setStatus(Item::STATUS_LOAD_OK);
 	} else {
 		status = LOAD_FAILED;
@@ -812,7 +845,7 @@ ProjectFilesDialog::FileList::loadNextFile()
 	QModelIndex const idx(index(item_idx, 0));
 	emit dataChanged(idx, idx);
 	
-	m_itemsToLoad.pop_front();
+	--m_numItemsToLoad;
 	
 	return status;
 }
@@ -27,6 +27,9 @@
 #include <vector>
 #include <memory>
 
+class ImageMetadataCache;
+class ImageMetadataScanner;
+
 class ProjectFilesDialog : public QDialog, private Ui::ProjectFilesDialog
 {
 	Q_OBJECT
@@ -81,6 +84,8 @@ private:
 	std::auto_ptr<SortedFileList> m_ptrOffProjectFilesSorted;
 	std::auto_ptr<FileList> m_ptrInProjectFiles;
 	std::auto_ptr<SortedFileList> m_ptrInProjectFilesSorted;
+	std::auto_ptr<ImageMetadataCache> m_ptrMetadataCache;
+	std::auto_ptr<ImageMetadataScanner> m_ptrMetadataScanner;
 	int m_loadTimerId;
 	bool m_metadataLoadFailed;
 	bool m_autoOutDir;
@@ -0,0 +1,354 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ProjectIndex.h"
+#include "XmlStreamUtils.h"
+#include "AtomicFileOverwriter.h"
+#include <QXmlStreamWriter>
+#include <QXmlStreamAttribute>
+#include <QDataStream>
+#include <QBuffer>
+#include <QLatin1String>
+#include <limits>
+#include <assert.h>
+
+namespace
+{
+
+quint32 const INDEX_MAGIC = 0x53544958; // "STIX"
+quint32 const INDEX_VERSION = 3;
+
+QCryptographicHash::Algorithm const HASH_ALGORITHM = QCryptographicHash::Sha1;
+
+} // anonymous namespace
+
+
+/*============================ ProjectIndexFragment ==========================*/
+
+QByteArray
+ProjectIndexFragment::data() const
+{
+	if (!m_ptrIndex) {
+		return QByteArray();
+	}
+
+	return QByteArray(
+		reinterpret_cast<char const*>(m_ptrIndex->m_pMapped + m_offset), m_size
+	);
+}
+
+
+/*============================ ProjectIndexSection ===========================*/
+
+ProjectIndexFragment
+ProjectIndexSection::entryFragment(size_t const idx) const
+{
+	Entry const& entry = m_entries[idx];
+	return ProjectIndexFragment(
+		IntrusivePtr<ProjectIndex const>(m_pIndex), entry.offset, entry.size
+	);
+}
+
+QByteArray
+ProjectIndexSection::toXml() const
+{
+	QByteArray xml;
+	QBuffer buffer(&xml);
+	buffer.open(QIODevice::WriteOnly);
+
+	QXmlStreamWriter writer(&buffer);
+	writer.writeStartElement(m_name);
+	writer.writeAttributes(m_attributes);
+	size_t const num_entries = m_entries.size();
+	for (size_t i = 0; i < num_entries; ++i) {
+		XmlStreamUtils::writeFragment(writer, entryFragment(i).data());
+	}
+	writer.writeEndElement();
+
+	return xml;
+}
+
+
+/*=============================== ProjectIndex ===============================*/
+
+QString
+ProjectIndex::indexPathFor(QString const& project_file)
+{
+	return project_file + QLatin1String(".index");
+}
+
+QByteArray
+ProjectIndex::hashProjectFile(QString const& project_file)
+{
+	QFile file(project_file);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return QByteArray();
+	}
+
+	QCryptographicHash hash(HASH_ALGORITHM);
+	char buf[64 * 1024];
+	for (;;) {
+		qint64 const len = file.read(buf, sizeof(buf));
+		if (len < 0) {
+			return QByteArray();
+		} else if (len == 0) {
+			break;
+		}
+		hash.addData(buf, (int)len);
+	}
+
+	return hash.result();
+}
+
+IntrusivePtr<ProjectIndex>
+ProjectIndex::open(QString const& index_file, QString const& project_file)
+{
+	if (!QFile::exists(index_file)) {
+		// Don't bother hashing the project file.
+		return IntrusivePtr<ProjectIndex>();
+	}
+
+	QByteArray const hash(hashProjectFile(project_file));
+	if (hash.isEmpty()) {
+		return IntrusivePtr<ProjectIndex>();
+	}
+
+	IntrusivePtr<ProjectIndex> index(new ProjectIndex(index_file));
+	if (!index->load(hash)) {
+		index.reset();
+	}
+	return index;
+}
+
+ProjectIndex::ProjectIndex(QString const& index_file)
+:	m_pMapped(0),
+	m_mappedSize(0),
+	m_file(index_file)
+{
+}
+
+ProjectIndex::~ProjectIndex()
+{
+	if (m_pMapped) {
+		m_file.unmap(const_cast<uchar*>(m_pMapped));
+	}
+}
+
+bool
+ProjectIndex::load(QByteArray const& project_hash)
+{
+	if (!m_file.open(QIODevice::ReadOnly)) {
+		return false;
+	}
+
+	QDataStream strm(&m_file);
+	strm.setVersion(QDataStream::Qt_4_4);
+
+	quint32 magic = 0;
+	quint32 version = 0;
+	QByteArray hash;
+	strm >> magic >> version;
+	if (magic != INDEX_MAGIC || version != INDEX_VERSION) {
+		return false;
+	}
+	strm >> hash;
+	if (hash != project_hash) {
+		return false;
+	}
+
+	quint32 num_sections = 0;
+	strm >> num_sections;
+	for (quint32 i = 0; i < num_sections && strm.status() == QDataStream::Ok; ++i) {
+		ProjectIndexSection section;
+		section.m_pIndex = this;
+		strm >> section.m_name;
+
+		quint32 num_attrs = 0;
+		strm >> num_attrs;
+		for (quint32 j = 0; j < num_attrs && strm.status() == QDataStream::Ok; ++j) {
+			QString name;
+			QString value;
+			strm >> name >> value;
+			section.m_attributes.append(name, value);
+		}
+
+		quint32 num_entries = 0;
+		strm >> num_entries;
+		for (quint32 j = 0; j < num_entries && strm.status() == QDataStream::Ok; ++j) {
+			qint32 id = 0;
+			quint32 offset = 0;
+			quint32 size = 0;
+			strm >> id >> offset >> size;
+
+			ProjectIndexSection::Entry entry;
+			entry.offset = offset;
+			entry.size = size;
+			entry.id = id;
+			section.m_entries.push_back(entry);
+		}
+
+		m_sections[section.m_name] = section;
+	}
+
+	quint32 blob_size = 0;
+	strm >> blob_size;
+	if (strm.status() != QDataStream::Ok) {
+		return false;
+	}
+
+	qint64 const blob_offset = m_file.pos();
+	if (blob_offset + blob_size != m_file.size()) {
+		return false;
+	}
+
+	// Make entry offsets relative to the beginning of the file.
+	Sections::iterator it(m_sections.begin());
+	Sections::iterator const end(m_sections.end());
+	for (; it != end; ++it) {
+		std::vector<ProjectIndexSection::Entry>& entries = it->second.m_entries;
+		for (size_t i = 0; i < entries.size(); ++i) {
+			if (entries[i].offset + entries[i].size > blob_size) {
+				return false;
+			}
+			entries[i].offset += blob_offset;
+		}
+	}
+
+	m_mappedSize = m_file.size();
+	m_pMapped = m_file.map(0, m_mappedSize);
+	return m_pMapped != 0;
+}
+
+ProjectIndexSection const*
+ProjectIndex::section(QString const& name) const
+{
+	Sections::const_iterator const it(m_sections.find(name));
+	if (it == m_sections.end()) {
+		return 0;
+	}
+	return &it->second;
+}
+
+
+/*============================ ProjectIndexBuilder ===========================*/
+
+ProjectIndexBuilder::ProjectIndexBuilder()
+:	m_overflow(false)
+{
+}
+
+void
+ProjectIndexBuilder::beginSection(
+	QString const& name, QXmlStreamAttributes const& attributes)
+{
+	m_sections.push_back(Section());
+	m_sections.back().name = name;
+	m_sections.back().attributes = attributes;
+}
+
+void
+ProjectIndexBuilder::addEntry(int const id, QByteArray const& fragment)
+{
+	assert(!m_sections.empty());
+
+	if (qint64(m_blob.size()) + fragment.size() > std::numeric_limits<qint32>::max()) {
+		m_overflow = true;
+		return;
+	}
+
+	Entry entry;
+	entry.offset = m_blob.size();
+	entry.size = fragment.size();
+	entry.id = id;
+	m_sections.back().entries.push_back(entry);
+	m_blob.append(fragment);
+}
+
+bool
+ProjectIndexBuilder::write(
+	QString const& index_file, QByteArray const& project_hash) const
+{
+	if (m_overflow || project_hash.isEmpty()) {
+		return false;
+	}
+
+	AtomicFileOverwriter overwriter;
+	QIODevice* const out = overwriter.startWriting(index_file);
+	if (!out) {
+		return false;
+	}
+
+	QDataStream strm(out);
+	strm.setVersion(QDataStream::Qt_4_4);
+	strm << INDEX_MAGIC << INDEX_VERSION << project_hash;
+	strm << quint32(m_sections.size());
+	for (size_t i = 0; i < m_sections.size(); ++i) {
+		Section const& section = m_sections[i];
+		strm << section.name;
+		strm << quint32(section.attributes.size());
+		for (int j = 0; j < section.attributes.size(); ++j) {
+			QXmlStreamAttribute const& attr = section.attributes[j];
+			strm << attr.qualifiedName().toString() << attr.value().toString();
+		}
+		strm << quint32(section.entries.size());
+		for (size_t j = 0; j < section.entries.size(); ++j) {
+			Entry const& entry = section.entries[j];
+			strm << entry.id << entry.offset << entry.size;
+		}
+	}
+	strm << quint32(m_blob.size());
+	if (strm.status() != QDataStream::Ok || out->write(m_blob) != m_blob.size()) {
+		return false; // The destructor of AtomicFileOverwriter will abort().
+	}
+
+	// On POSIX systems, an index that's currently mapped remains valid
+	// after being replaced.  Elsewhere, replacing it may fail, leaving
+	// the old index, which no longer matches the project file.
+	return overwriter.commit();
+}
+
+
+/*=========================== ProjectHashingWriter ===========================*/
+
+ProjectHashingWriter::ProjectHashingWriter(QIODevice* target)
+:	m_pTarget(target),
+	m_hash(HASH_ALGORITHM)
+{
+}
+
+QByteArray
+ProjectHashingWriter::hash() const
+{
+	return m_hash.result();
+}
+
+qint64
+ProjectHashingWriter::readData(char*, qint64)
+{
+	return -1;
+}
+
+qint64
+ProjectHashingWriter::writeData(char const* data, qint64 const size)
+{
+	qint64 const written = m_pTarget->write(data, size);
+	if (written > 0) {
+		m_hash.addData(data, (int)written);
+	}
+	return written;
+}
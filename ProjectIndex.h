@@ -0,0 +1,269 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROJECTINDEX_H_
+#define PROJECTINDEX_H_
+
+#include "NonCopyable.h"
+#include "RefCountable.h"
+#include "IntrusivePtr.h"
+#include <QFile>
+#include <QIODevice>
+#include <QCryptographicHash>
+#include <QString>
+#include <QByteArray>
+#include <QXmlStreamAttributes>
+#include <vector>
+#include <map>
+#include <stddef.h>
+
+class ProjectIndex;
+
+/**
+ * \brief A reference to a serialized per-page (or per-image) settings
+ *        element stored in a ProjectIndex.
+ *
+ * Holding a fragment keeps the index file mapped into memory.
+ */
+class ProjectIndexFragment
+{
+	// Member-wise copying is OK.
+public:
+	ProjectIndexFragment() : m_offset(0), m_size(0) {}
+
+	ProjectIndexFragment(
+		IntrusivePtr<ProjectIndex const> const& index, qint64 offset, int size)
+	: m_ptrIndex(index), m_offset(offset), m_size(size) {}
+
+	bool isNull() const { return !m_ptrIndex; }
+
+	/**
+	 * \brief Returns a deep copy of the serialized element.
+	 */
+	QByteArray data() const;
+private:
+	IntrusivePtr<ProjectIndex const> m_ptrIndex;
+	qint64 m_offset;
+	int m_size;
+};
+
+
+/**
+ * \brief The settings element of a single filter, as stored in a ProjectIndex.
+ */
+class ProjectIndexSection
+{
+	// Member-wise copying is OK.
+public:
+	ProjectIndexSection() : m_pIndex(0) {}
+
+	QString const& name() const { return m_name; }
+
+	QXmlStreamAttributes const& attributes() const { return m_attributes; }
+
+	/**
+	 * \brief The number of per-page (or per-image) elements.
+	 */
+	size_t numEntries() const { return m_entries.size(); }
+
+	/**
+	 * \brief The numeric id (as assigned by ProjectWriter) of a page or image.
+	 */
+	int entryId(size_t idx) const { return m_entries[idx].id; }
+
+	/**
+	 * \brief The serialized settings element of a page or image.
+	 */
+	ProjectIndexFragment entryFragment(size_t idx) const;
+
+	/**
+	 * \brief Reassembles the filter's settings element, the way it
+	 *        appears in the project file.
+	 */
+	QByteArray toXml() const;
+private:
+	friend class ProjectIndex;
+
+	struct Entry
+	{
+		qint64 offset;
+		int size;
+		int id;
+	};
+
+	/**
+	 * Not an IntrusivePtr, as the index owns its sections.
+	 */
+	ProjectIndex const* m_pIndex;
+	QString m_name;
+	QXmlStreamAttributes m_attributes;
+	std::vector<Entry> m_entries;
+};
+
+
+/**
+ * \brief A binary sidecar of a project file, that allows loading filter
+ *        settings without parsing the whole project file.
+ *
+ * The index is stored next to the project file and records a hash of
+ * the contents of the project file it was written along with.  An index
+ * that doesn't match its project file is ignored, so the project file
+ * always stays authoritative.  Hashing the project file is still much
+ * cheaper than parsing it.
+ * Serialized per-page settings are kept in a memory-mapped blob, so that
+ * filters may parse them on first access rather than on project opening.
+ */
+class ProjectIndex : public RefCountable
+{
+	DECLARE_NON_COPYABLE(ProjectIndex)
+public:
+	/**
+	 * \brief Returns the path of the index corresponding to a project file.
+	 */
+	static QString indexPathFor(QString const& project_file);
+
+	/**
+	 * \brief Hashes the contents of a project file, the way an index
+	 *        records it.
+	 *
+	 * \return The hash, or an empty array if the file couldn't be read.
+	 */
+	static QByteArray hashProjectFile(QString const& project_file);
+
+	/**
+	 * \brief Opens an index, provided it matches the project file.
+	 *
+	 * \param index_file The path to the index.
+	 * \param project_file The path to the project file.
+	 * \return The opened index, or null if the index is missing, corrupted,
+	 *         of an unsupported version or made for a different project file.
+	 */
+	static IntrusivePtr<ProjectIndex> open(
+		QString const& index_file, QString const& project_file);
+
+	virtual ~ProjectIndex();
+
+	/**
+	 * \brief Returns the section for a filter with the given settings
+	 *        element name, or null if there is none.
+	 */
+	ProjectIndexSection const* section(QString const& name) const;
+private:
+	friend class ProjectIndexFragment;
+
+	typedef std::map<QString, ProjectIndexSection> Sections;
+
+	ProjectIndex(QString const& index_file);
+
+	bool load(QByteArray const& project_stamp);
+
+	uchar const* m_pMapped;
+	qint64 m_mappedSize;
+	QFile m_file;
+	Sections m_sections;
+};
+
+
+/**
+ * \brief Collects filter settings while ProjectWriter writes them,
+ *        then stores them as a ProjectIndex.
+ *
+ * Building the index this way requires no parsing of the project file.
+ */
+class ProjectIndexBuilder
+{
+	DECLARE_NON_COPYABLE(ProjectIndexBuilder)
+public:
+	ProjectIndexBuilder();
+
+	/**
+	 * \brief Starts the settings element of another filter.
+	 */
+	void beginSection(QString const& name, QXmlStreamAttributes const& attributes);
+
+	/**
+	 * \brief Adds a per-page (or per-image) element to the current section.
+	 *
+	 * \param id The numeric id of a page or image, as assigned by ProjectWriter.
+	 * \param fragment The element, as produced by XmlFragment::toByteArray().
+	 */
+	void addEntry(int id, QByteArray const& fragment);
+
+	/**
+	 * \brief Writes the index for a project file that was fully written.
+	 *
+	 * \param project_hash The hash of the project file, as computed
+	 *        by ProjectHashingWriter.
+	 * \return true on success.  On failure, a previous index may be left
+	 *         behind, but it won't match the project file anymore.
+	 */
+	bool write(QString const& index_file, QByteArray const& project_hash) const;
+private:
+	struct Entry
+	{
+		quint32 offset;
+		quint32 size;
+		qint32 id;
+	};
+
+	struct Section
+	{
+		QString name;
+		QXmlStreamAttributes attributes;
+		std::vector<Entry> entries;
+	};
+
+	std::vector<Section> m_sections;
+	QByteArray m_blob;
+	bool m_overflow;
+};
+
+
+/**
+ * \brief Passes everything written to it on to another device,
+ *        hashing it along the way.
+ *
+ * That's how ProjectWriter gets the hash for a ProjectIndex
+ * without reading the project file back.
+ */
+class ProjectHashingWriter : public QIODevice
+{
+	DECLARE_NON_COPYABLE(ProjectHashingWriter)
+public:
+	/**
+	 * \param target An open device to write to.  It's not owned.
+	 */
+	explicit ProjectHashingWriter(QIODevice* target);
+
+	virtual bool isSequential() const { return true; }
+
+	/**
+	 * \brief The hash of everything written so far, the same as
+	 *        ProjectIndex::hashProjectFile() would produce.
+	 */
+	QByteArray hash() const;
+protected:
+	virtual qint64 readData(char* data, qint64 max_size);
+
+	virtual qint64 writeData(char const* data, qint64 size);
+private:
+	QIODevice* m_pTarget;
+	QCryptographicHash m_hash;
+};
+
+#endif
@@ -20,6 +20,7 @@
 #include "ProjectOpeningContext.h.moc"
 #include "FixDpiDialog.h"
 #include "ProjectPages.h"
+#include "ProjectIndex.h"
 #include <QString>
 #include <QMessageBox>
 #include <Qt>
@@ -29,9 +30,9 @@
 #include <assert.h>
 
 ProjectOpeningContext::ProjectOpeningContext(
-	QWidget* parent, QString const& project_file, QDomDocument const& doc)
+	QWidget* parent, QString const& project_file)
 :	m_projectFile(project_file),
-	m_reader(doc),
+	m_reader(project_file, ProjectIndex::indexPathFor(project_file)),
 	m_pParent(parent)
 {
 }
@@ -30,15 +30,13 @@
 
 class FixDpiDialog;
 class QWidget;
-class QDomDocument;
 
 class ProjectOpeningContext : public QObject
 {
 	Q_OBJECT
 	DECLARE_NON_COPYABLE(ProjectOpeningContext)
 public:
-	ProjectOpeningContext(
-		QWidget* parent, QString const& project_file, QDomDocument const& doc);
+	ProjectOpeningContext(QWidget* parent, QString const& project_file);
 	
 	virtual ~ProjectOpeningContext();
 	
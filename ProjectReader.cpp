@@ -20,62 +20,54 @@
 #include "ProjectPages.h"
 #include "FileNameDisambiguator.h"
 #include "AbstractFilter.h"
-#include "XmlUnmarshaller.h"
+#include "XmlStreamUtils.h"
 #include "Dpi.h"
 #include <QSize>
 #include <QDir>
+#include <QFile>
+#include <QDomDocument>
 #include <QDomElement>
-#include <QDomNode>
+#include <QXmlStreamReader>
+#include <QXmlStreamAttributes>
+#include <QLatin1String>
 #ifndef Q_MOC_RUN
 #include <boost/bind.hpp>
+#include <boost/foreach.hpp>
 #endif
 #include <set>
 
-ProjectReader::ProjectReader(QDomDocument const& doc)
-:	m_doc(doc),
+namespace
+{
+
+int attrToInt(QXmlStreamAttributes const& attrs, char const* name, bool* ok)
+{
+	return attrs.value(QLatin1String(name)).toString().toInt(ok);
+}
+
+} // anonymous namespace
+
+ProjectReader::ProjectReader(QString const& project_file, QString const& index_file)
+:	m_projectFile(project_file),
 	m_ptrDisambiguator(new FileNameDisambiguator)
 {
-	QDomElement project_el(m_doc.documentElement());
-	m_outDir = project_el.attribute("outputDirectory");
-	
-	Qt::LayoutDirection layout_direction = Qt::LeftToRight;
-	if (project_el.attribute("layoutDirection") == "RTL") {
-		layout_direction = Qt::RightToLeft;
-	}
-	
-	QDomElement const dirs_el(project_el.namedItem("directories").toElement());
-	if (dirs_el.isNull()) {
+	QFile file(project_file);
+	if (!file.open(QIODevice::ReadOnly)) {
 		return;
 	}
-	processDirectories(dirs_el);
-	
-	QDomElement const files_el(project_el.namedItem("files").toElement());
-	if (files_el.isNull()) {
-		return;
+
+	if (!index_file.isEmpty()) {
+		m_ptrIndex = ProjectIndex::open(index_file, project_file);
 	}
-	processFiles(files_el);
-	
-	QDomElement const images_el(project_el.namedItem("images").toElement());
-	if (images_el.isNull()) {
-		return;
+
+	QXmlStreamReader xml(&file);
+	if (xml.readNextStartElement()) {
+		readProject(xml);
 	}
-	processImages(images_el, layout_direction);
-	
-	QDomElement const pages_el(project_el.namedItem("pages").toElement());
-	if (pages_el.isNull()) {
-		return;
+
+	if (xml.hasError()) {
+		// A truncated or otherwise broken file.
+		m_ptrPages.reset();
 	}
-	processPages(pages_el);
-
-	// Load naming disambiguator.  This needs to be done after processing pages.
-	QDomElement const disambig_el(
-		project_el.namedItem("file-name-disambiguation").toElement()
-	);
-	m_ptrDisambiguator.reset(
-		new FileNameDisambiguator(
-			disambig_el, boost::bind(&ProjectReader::expandFilePath, this, _1)
-		)
-	);
 }
 
 ProjectReader::~ProjectReader()
@@ -83,40 +75,141 @@ ProjectReader::~ProjectReader()
 }
 
 void
-ProjectReader::readFilterSettings(std::vector<FilterPtr> const& filters) const
+ProjectReader::readProject(QXmlStreamReader& xml)
 {
-	QDomElement project_el(m_doc.documentElement());
-	QDomElement filters_el(project_el.namedItem("filters").toElement());
+	QXmlStreamAttributes const attrs(xml.attributes());
+	m_outDir = attrs.value(QLatin1String("outputDirectory")).toString();
 	
-	std::vector<FilterPtr>::const_iterator it(filters.begin());
-	std::vector<FilterPtr>::const_iterator const end(filters.end());
-	for (; it != end; ++it) {
-		(*it)->loadSettings(*this, filters_el);
+	Qt::LayoutDirection layout_direction = Qt::LeftToRight;
+	if (attrs.value(QLatin1String("layoutDirection")) == QLatin1String("RTL")) {
+		layout_direction = Qt::RightToLeft;
+	}
+
+	// Sections are expected in the order ProjectWriter writes them,
+	// as each one depends on the ones before it.
+	bool dirs_done = false;
+	bool files_done = false;
+	bool images_done = false;
+	bool pages_done = false;
+
+	while (xml.readNextStartElement()) {
+		if (xml.name() == QLatin1String("directories")) {
+			processDirectories(xml);
+			dirs_done = true;
+		} else if (xml.name() == QLatin1String("files") && dirs_done) {
+			processFiles(xml);
+			files_done = true;
+		} else if (xml.name() == QLatin1String("images") && files_done) {
+			processImages(xml, layout_direction);
+			images_done = true;
+		} else if (xml.name() == QLatin1String("pages") && images_done) {
+			processPages(xml);
+			pages_done = true;
+		} else if (xml.name() == QLatin1String("file-name-disambiguation") && pages_done) {
+			// Small enough to go through DOM.
+			QDomDocument doc;
+			QDomElement const disambig_el(XmlStreamUtils::readElement(xml, doc));
+			m_ptrDisambiguator.reset(
+				new FileNameDisambiguator(
+					disambig_el, boost::bind(&ProjectReader::expandFilePath, this, _1)
+				)
+			);
+		} else if (xml.name() == QLatin1String("filters") && m_ptrIndex) {
+			// The index was built from this very file, so it's known
+			// to be well-formed, and the rest of it doesn't concern us.
+			break;
+		} else {
+			// Filter settings are read later by readFilterSettings().
+			// Skipping them still makes the parser check they are well-formed.
+			xml.skipCurrentElement();
+		}
 	}
 }
 
 void
-ProjectReader::processDirectories(QDomElement const& dirs_el)
+ProjectReader::readFilterSettings(std::vector<FilterPtr> const& filters) const
 {
-	QString const dir_tag_name("directory");
-	
-	QDomNode node(dirs_el.firstChild());
-	for (; !node.isNull(); node = node.nextSibling()) {
-		if (!node.isElement()) {
+	if (!m_ptrIndex) {
+		readFilterSettingsFromXml(filters);
+		return;
+	}
+
+	std::vector<FilterPtr> remaining;
+
+	BOOST_FOREACH(FilterPtr const& filter, filters) {
+		ProjectIndexSection const* section = m_ptrIndex->section(
+			filter->settingsElementName()
+		);
+		if (!section) {
+			remaining.push_back(filter);
+		} else if (!filter->loadDeferredSettings(*this, *section)) {
+			QXmlStreamReader xml(section->toXml());
+			if (xml.readNextStartElement()) {
+				filter->loadSettings(*this, xml);
+			}
+		}
+	}
+
+	if (!remaining.empty()) {
+		readFilterSettingsFromXml(remaining);
+	}
+}
+
+void
+ProjectReader::readFilterSettingsFromXml(std::vector<FilterPtr> const& filters) const
+{
+	QFile file(m_projectFile);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return;
+	}
+
+	QXmlStreamReader xml(&file);
+	if (!xml.readNextStartElement()) {
+		return;
+	}
+
+	while (xml.readNextStartElement()) {
+		if (xml.name() != QLatin1String("filters")) {
+			xml.skipCurrentElement();
 			continue;
 		}
-		if (node.nodeName() != dir_tag_name) {
+
+		while (xml.readNextStartElement()) {
+			std::vector<FilterPtr>::const_iterator it(filters.begin());
+			std::vector<FilterPtr>::const_iterator const end(filters.end());
+			for (; it != end; ++it) {
+				if (xml.name() == (*it)->settingsElementName()) {
+					break;
+				}
+			}
+			if (it != end) {
+				(*it)->loadSettings(*this, xml);
+			} else {
+				xml.skipCurrentElement();
+			}
+		}
+		break;
+	}
+}
+
+void
+ProjectReader::processDirectories(QXmlStreamReader& xml)
+{
+	while (xml.readNextStartElement()) {
+		if (xml.name() != QLatin1String("directory")) {
+			xml.skipCurrentElement();
 			continue;
 		}
-		QDomElement el(node.toElement());
+		QXmlStreamAttributes const attrs(xml.attributes());
+		xml.skipCurrentElement();
 		
 		bool ok = true;
-		int const id = el.attribute("id").toInt(&ok);
+		int const id = attrToInt(attrs, "id", &ok);
 		if (!ok) {
 			continue;
 		}
 		
-		QString const path(el.attribute("path"));
+		QString const path(attrs.value(QLatin1String("path")).toString());
 		if (path.isEmpty()) {
 			continue;
 		}
@@ -126,31 +219,27 @@ ProjectReader::processDirectories(QDomElement const& dirs_el)
 }
 
 void
-ProjectReader::processFiles(QDomElement const& files_el)
+ProjectReader::processFiles(QXmlStreamReader& xml)
 {
-	QString const file_tag_name("file");
-	
-	QDomNode node(files_el.firstChild());
-	for (; !node.isNull(); node = node.nextSibling()) {
-		if (!node.isElement()) {
-			continue;
-		}
-		if (node.nodeName() != file_tag_name) {
+	while (xml.readNextStartElement()) {
+		if (xml.name() != QLatin1String("file")) {
+			xml.skipCurrentElement();
 			continue;
 		}
-		QDomElement el(node.toElement());
+		QXmlStreamAttributes const attrs(xml.attributes());
+		xml.skipCurrentElement();
 		
 		bool ok = true;
-		int const id = el.attribute("id").toInt(&ok);
+		int const id = attrToInt(attrs, "id", &ok);
 		if (!ok) {
 			continue;
 		}
-		int const dir_id = el.attribute("dirId").toInt(&ok);
+		int const dir_id = attrToInt(attrs, "dirId", &ok);
 		if (!ok) {
 			continue;
 		}
 		
-		QString const name(el.attribute("name"));
+		QString const name(attrs.value(QLatin1String("name")).toString());
 		if (name.isEmpty()) {
 			continue;
 		}
@@ -161,7 +250,9 @@ ProjectReader::processFiles(QDomElement const& files_el)
 		}
 		
 		// Backwards compatibility.
-		bool const compat_multi_page = (el.attribute("multiPage") == "1");
+		bool const compat_multi_page = (
+			attrs.value(QLatin1String("multiPage")) == QLatin1String("1")
+		);
 
 		QString const file_path(QDir(dir_path).filePath(name));
 		FileRecord const rec(file_path, compat_multi_page);
@@ -171,44 +262,39 @@ ProjectReader::processFiles(QDomElement const& files_el)
 
 void
 ProjectReader::processImages(
-	QDomElement const& images_el,
-	Qt::LayoutDirection const layout_direction)
+	QXmlStreamReader& xml, Qt::LayoutDirection const layout_direction)
 {
-	QString const image_tag_name("image");
-	
 	std::vector<ImageInfo> images;
 	
-	QDomNode node(images_el.firstChild());
-	for (; !node.isNull(); node = node.nextSibling()) {
-		if (!node.isElement()) {
-			continue;
-		}
-		if (node.nodeName() != image_tag_name) {
+	while (xml.readNextStartElement()) {
+		if (xml.name() != QLatin1String("image")) {
+			xml.skipCurrentElement();
 			continue;
 		}
-		QDomElement el(node.toElement());
+		QXmlStreamAttributes const attrs(xml.attributes());
+		ImageMetadata const metadata(processImageMetadata(xml));
 		
 		bool ok = true;
-		int const id = el.attribute("id").toInt(&ok);
+		int const id = attrToInt(attrs, "id", &ok);
 		if (!ok) {
 			continue;
 		}
-		int const sub_pages = el.attribute("subPages").toInt(&ok);
+		int const sub_pages = attrToInt(attrs, "subPages", &ok);
 		if (!ok) {
 			continue;
 		}
-		int const file_id = el.attribute("fileId").toInt(&ok);
+		int const file_id = attrToInt(attrs, "fileId", &ok);
 		if (!ok) {
 			continue;
 		}
-		int const file_image = el.attribute("fileImage").toInt(&ok);
+		int const file_image = attrToInt(attrs, "fileImage", &ok);
 		if (!ok) {
 			continue;
 		}
 
-		QString const removed(el.attribute("removed"));
-		bool const left_half_removed = (removed == "L");
-		bool const right_half_removed = (removed == "R");
+		QStringRef const removed(attrs.value(QLatin1String("removed")));
+		bool const left_half_removed = (removed == QLatin1String("L"));
+		bool const right_half_removed = (removed == QLatin1String("R"));
 		
 		FileRecord const file_record(getFileRecord(file_id));
 		if (file_record.filePath.isEmpty()) {
@@ -218,7 +304,6 @@ ProjectReader::processImages(
 			file_record.filePath,
 			file_image + int(file_record.compatMultiPage)
 		);
-		ImageMetadata const metadata(processImageMetadata(el));
 		ImageInfo const image_info(
 			image_id, metadata, sub_pages,
 			left_half_removed, right_half_removed
@@ -234,52 +319,55 @@ ProjectReader::processImages(
 }
 
 ImageMetadata
-ProjectReader::processImageMetadata(QDomElement const& image_el)
+ProjectReader::processImageMetadata(QXmlStreamReader& xml)
 {
 	QSize size;
 	Dpi dpi;
 	
-	QDomElement const size_el(image_el.namedItem("size").toElement());
-	if (!size_el.isNull()) {
-		size = XmlUnmarshaller::size(size_el);
-	}
-	QDomElement const dpi_el(image_el.namedItem("dpi").toElement());
-	if (!dpi_el.isNull()) {
-		dpi = XmlUnmarshaller::dpi(dpi_el);
+	while (xml.readNextStartElement()) {
+		QXmlStreamAttributes const attrs(xml.attributes());
+		if (xml.name() == QLatin1String("size")) {
+			size = QSize(
+				attrs.value(QLatin1String("width")).toString().toInt(),
+				attrs.value(QLatin1String("height")).toString().toInt()
+			);
+		} else if (xml.name() == QLatin1String("dpi")) {
+			dpi = Dpi(
+				attrs.value(QLatin1String("horizontal")).toString().toInt(),
+				attrs.value(QLatin1String("vertical")).toString().toInt()
+			);
+		}
+		xml.skipCurrentElement();
 	}
 	
 	return ImageMetadata(size, dpi);
 }
 
 void
-ProjectReader::processPages(QDomElement const& pages_el)
+ProjectReader::processPages(QXmlStreamReader& xml)
 {
-	QString const page_tag_name("page");
-	
-	QDomNode node(pages_el.firstChild());
-	for (; !node.isNull(); node = node.nextSibling()) {
-		if (!node.isElement()) {
-			continue;
-		}
-		if (node.nodeName() != page_tag_name) {
+	while (xml.readNextStartElement()) {
+		if (xml.name() != QLatin1String("page")) {
+			xml.skipCurrentElement();
 			continue;
 		}
-		QDomElement el(node.toElement());
+		QXmlStreamAttributes const attrs(xml.attributes());
+		xml.skipCurrentElement();
 		
 		bool ok = true;
 		
-		int const id = el.attribute("id").toInt(&ok);
+		int const id = attrToInt(attrs, "id", &ok);
 		if (!ok) {
 			continue;
 		}
 		
-		int const image_id = el.attribute("imageId").toInt(&ok);
+		int const image_id = attrToInt(attrs, "imageId", &ok);
 		if (!ok) {
 			continue;
 		}
 		
 		PageId::SubPage const sub_page = PageId::subPageFromString(
-			el.attribute("subPage"), &ok
+			attrs.value(QLatin1String("subPage")).toString(), &ok
 		);
 		if (!ok) {
 			continue;
@@ -293,7 +381,7 @@ ProjectReader::processPages(QDomElement const& pages_el)
 		PageId const page_id(image.id(), sub_page);
 		m_pageMap.insert(PageMap::value_type(id, page_id));
 
-		if (el.attribute("selected") == "selected") {
+		if (attrs.value(QLatin1String("selected")) == QLatin1String("selected")) {
 			m_selectedPage.set(page_id, PAGE_VIEW);
 		}
 	}
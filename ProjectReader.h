@@ -25,13 +25,13 @@
 #include "ImageMetadata.h"
 #include "SelectedPage.h"
 #include "IntrusivePtr.h"
+#include "ProjectIndex.h"
 #include <QString>
-#include <QDomDocument>
 #include <Qt>
 #include <vector>
 #include <map>
 
-class QDomElement;
+class QXmlStreamReader;
 class ProjectData;
 class ProjectPages;
 class FileNameDisambiguator;
@@ -42,7 +42,17 @@ class ProjectReader
 public:
 	typedef IntrusivePtr<AbstractFilter> FilterPtr;
 	
-	ProjectReader(QDomDocument const& doc);
+	/**
+	 * \brief Parses everything except filter settings.
+	 *
+	 * \param project_file The path to a project file.  It's streamed
+	 *        rather than read into memory.  The filter settings are
+	 *        streamed from it later, by readFilterSettings().
+	 * \param index_file Optional path to a ProjectIndex.  If it matches
+	 *        \p project_file, filter settings are taken from there instead.
+	 */
+	explicit ProjectReader(
+		QString const& project_file, QString const& index_file = QString());
 	
 	~ProjectReader();
 	
@@ -80,16 +90,20 @@ private:
 	typedef std::map<int, ImageInfo> ImageMap;
 	typedef std::map<int, PageId> PageMap;
 	
-	void processDirectories(QDomElement const& dirs_el);
+	void readProject(QXmlStreamReader& xml);
+
+	void readFilterSettingsFromXml(std::vector<FilterPtr> const& filters) const;
+
+	void processDirectories(QXmlStreamReader& xml);
 	
-	void processFiles(QDomElement const& files_el);
+	void processFiles(QXmlStreamReader& xml);
 	
-	void processImages(QDomElement const& images_el,
+	void processImages(QXmlStreamReader& xml,
 		Qt::LayoutDirection layout_direction);
 	
-	ImageMetadata processImageMetadata(QDomElement const& image_el);
+	ImageMetadata processImageMetadata(QXmlStreamReader& xml);
 	
-	void processPages(QDomElement const& pages_el);
+	void processPages(QXmlStreamReader& xml);
 	
 	QString getDirPath(int id) const;
 	
@@ -99,7 +113,8 @@ private:
 	
 	ImageInfo getImageInfo(int id) const;
 	
-	QDomDocument m_doc;
+	QString m_projectFile;
+	IntrusivePtr<ProjectIndex> m_ptrIndex;
 	QString m_outDir;
 	DirMap m_dirMap;
 	FileMap m_fileMap;
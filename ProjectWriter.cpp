@@ -24,11 +24,14 @@
 #include "ImageId.h"
 #include "ImageMetadata.h"
 #include "AbstractFilter.h"
+#include "ProjectIndex.h"
 #include "FileNameDisambiguator.h"
+#include "XmlStreamUtils.h"
 #include "compat/boost_multi_index_foreach_fix.h"
-#include <QtXml>
+#include <QDomDocument>
+#include <QDomElement>
+#include <QXmlStreamWriter>
 #include <QFile>
-#include <QTextStream>
 #include <QFileInfo>
 #ifndef Q_MOC_RUN
 #include <boost/bind.hpp>
@@ -44,7 +47,8 @@ ProjectWriter::ProjectWriter(
 :	m_pageSequence(page_sequence->toPageSequence(PAGE_VIEW)),
 	m_outFileNameGen(out_file_name_gen),
 	m_selectedPage(selected_page),
-	m_layoutDirection(page_sequence->layoutDirection())
+	m_layoutDirection(page_sequence->layoutDirection()),
+	m_pIndexBuilder(0)
 {
 	int next_id = 1;
 	size_t const num_pages = m_pageSequence.numPages();
@@ -81,124 +85,193 @@ ProjectWriter::~ProjectWriter()
 }
 
 bool
-ProjectWriter::write(QString const& file_path, std::vector<FilterPtr> const& filters) const
+ProjectWriter::write(
+	QString const& file_path, std::vector<FilterPtr> const& filters,
+	bool const with_index) const
 {
-	QDomDocument doc;
-	QDomElement root_el(doc.createElement("project"));
-	doc.appendChild(root_el);
-	root_el.setAttribute("outputDirectory", m_outFileNameGen.outDir());
-	root_el.setAttribute(
+	QString const index_file(ProjectIndex::indexPathFor(file_path));
+	if (!with_index) {
+		QFile::remove(index_file);
+		return writeProjectFile(file_path, filters);
+	}
+
+	ProjectIndexBuilder index_builder;
+	m_pIndexBuilder = &index_builder;
+	bool written = false;
+	QByteArray project_hash;
+	try {
+		written = writeProjectFile(file_path, filters, &project_hash);
+	} catch (...) {
+		m_pIndexBuilder = 0;
+		throw;
+	}
+	m_pIndexBuilder = 0;
+
+	if (!written || !index_builder.write(index_file, project_hash)) {
+		QFile::remove(index_file);
+	}
+
+	return written;
+}
+
+void
+ProjectWriter::writeSettingsStart(
+	QXmlStreamWriter& xml, QString const& element_name,
+	QXmlStreamAttributes const& attributes) const
+{
+	xml.writeStartElement(element_name);
+	xml.writeAttributes(attributes);
+	if (m_pIndexBuilder) {
+		m_pIndexBuilder->beginSection(element_name, attributes);
+	}
+}
+
+void
+ProjectWriter::writeSettingsEntry(
+	QXmlStreamWriter& xml, int const numeric_id, XmlFragment const& fragment) const
+{
+	if (fragment.isNull()) {
+		return;
+	}
+
+	fragment.write(xml);
+	if (m_pIndexBuilder) {
+		m_pIndexBuilder->addEntry(numeric_id, fragment.toByteArray());
+	}
+}
+
+bool
+ProjectWriter::writeProjectFile(
+	QString const& file_path, std::vector<FilterPtr> const& filters,
+	QByteArray* project_hash) const
+{
+	QFile file(file_path);
+	if (!file.open(QIODevice::WriteOnly)) {
+		return false;
+	}
+
+	// The file is hashed as it's written, which saves reading it back.
+	ProjectHashingWriter hashing_writer(&file);
+	hashing_writer.open(QIODevice::WriteOnly | QIODevice::Unbuffered);
+
+	QXmlStreamWriter xml(&hashing_writer);
+	xml.setAutoFormatting(true);
+	xml.setAutoFormattingIndent(2);
+
+	// No XML declaration, as project files never had one.
+	xml.writeStartElement("project");
+	xml.writeAttribute("outputDirectory", m_outFileNameGen.outDir());
+	xml.writeAttribute(
 		"layoutDirection",
 		m_layoutDirection == Qt::LeftToRight ? "LTR" : "RTL"
 	);
 	
-	root_el.appendChild(processDirectories(doc));
-	root_el.appendChild(processFiles(doc));
-	root_el.appendChild(processImages(doc));
-	root_el.appendChild(processPages(doc));
-	root_el.appendChild(
-		m_outFileNameGen.disambiguator()->toXml(
-			doc, "file-name-disambiguation",
-			boost::bind(&ProjectWriter::packFilePath, this, _1)
-		)
-	);
+	processDirectories(xml);
+	processFiles(xml);
+	processImages(xml);
+	processPages(xml);
+	processDisambiguator(xml);
 	
-	QDomElement filters_el(doc.createElement("filters"));
-	root_el.appendChild(filters_el);
+	xml.writeStartElement("filters");
 	std::vector<FilterPtr>::const_iterator it(filters.begin());
 	std::vector<FilterPtr>::const_iterator const end(filters.end());
 	for (; it != end; ++it) {
-		filters_el.appendChild((*it)->saveSettings(*this, doc));
+		(*it)->saveSettings(*this, xml);
 	}
-	
-	QFile file(file_path);
-	if (file.open(QIODevice::WriteOnly)) {
-		QTextStream strm(&file);
-		doc.save(strm, 2);
-		return true;
+	xml.writeEndElement(); // filters
+
+	xml.writeEndElement(); // project
+	xml.writeEndDocument();
+
+	if (xml.hasError()) {
+		return false;
 	}
-	
-	return false;
+
+	if (project_hash) {
+		*project_hash = hashing_writer.hash();
+	}
+
+	return true;
 }
 
-QDomElement
-ProjectWriter::processDirectories(QDomDocument& doc) const
+void
+ProjectWriter::processDirectories(QXmlStreamWriter& xml) const
 {
-	QDomElement dirs_el(doc.createElement("directories"));
+	xml.writeStartElement("directories");
 	
 	BOOST_FOREACH(Directory const& dir, m_dirs.get<Sequenced>()) {
-		QDomElement dir_el(doc.createElement("directory"));
-		dir_el.setAttribute("id", dir.numericId);
-		dir_el.setAttribute("path", dir.path);
-		dirs_el.appendChild(dir_el);
+		xml.writeStartElement("directory");
+		xml.writeAttribute("id", QString::number(dir.numericId));
+		xml.writeAttribute("path", dir.path);
+		xml.writeEndElement();
 	}
 	
-	return dirs_el;
+	xml.writeEndElement();
 }
 
-QDomElement
-ProjectWriter::processFiles(QDomDocument& doc) const
+void
+ProjectWriter::processFiles(QXmlStreamWriter& xml) const
 {
-	QDomElement files_el(doc.createElement("files"));
+	xml.writeStartElement("files");
 	
 	BOOST_FOREACH(File const& file, m_files.get<Sequenced>()) {
 		QFileInfo const file_info(file.path);
 		QString const& dir_path = file_info.absolutePath();
-		QDomElement file_el(doc.createElement("file"));
-		file_el.setAttribute("id", file.numericId);
-		file_el.setAttribute("dirId", dirId(dir_path));
-		file_el.setAttribute("name", file_info.fileName());
-		files_el.appendChild(file_el);
+		xml.writeStartElement("file");
+		xml.writeAttribute("id", QString::number(file.numericId));
+		xml.writeAttribute("dirId", QString::number(dirId(dir_path)));
+		xml.writeAttribute("name", file_info.fileName());
+		xml.writeEndElement();
 	}
 	
-	return files_el;
+	xml.writeEndElement();
 }
 
-QDomElement
-ProjectWriter::processImages(QDomDocument& doc) const
+void
+ProjectWriter::processImages(QXmlStreamWriter& xml) const
 {
-	QDomElement images_el(doc.createElement("images"));
+	xml.writeStartElement("images");
 	
 	BOOST_FOREACH(Image const& image, m_images.get<Sequenced>()) {
-		QDomElement image_el(doc.createElement("image"));
-		image_el.setAttribute("id", image.numericId);
-		image_el.setAttribute("subPages", image.numSubPages);
-		image_el.setAttribute("fileId", fileId(image.id.filePath()));
-		image_el.setAttribute("fileImage", image.id.page());
+		xml.writeStartElement("image");
+		xml.writeAttribute("id", QString::number(image.numericId));
+		xml.writeAttribute("subPages", QString::number(image.numSubPages));
+		xml.writeAttribute("fileId", QString::number(fileId(image.id.filePath())));
+		xml.writeAttribute("fileImage", QString::number(image.id.page()));
 		if (image.leftHalfRemoved != image.rightHalfRemoved) {
 			// Both are not supposed to be removed.
-			image_el.setAttribute("removed", image.leftHalfRemoved ? "L" : "R");
+			xml.writeAttribute("removed", image.leftHalfRemoved ? "L" : "R");
 		}
-		writeImageMetadata(doc, image_el, image.id);
-		images_el.appendChild(image_el);
+		writeImageMetadata(xml, image.id);
+		xml.writeEndElement();
 	}
 	
-	return images_el;
+	xml.writeEndElement();
 }
 
 void
 ProjectWriter::writeImageMetadata(
-	QDomDocument& doc, QDomElement& image_el, ImageId const& image_id) const
+	QXmlStreamWriter& xml, ImageId const& image_id) const
 {
 	MetadataByImage::const_iterator it(m_metadataByImage.find(image_id));
 	assert(it != m_metadataByImage.end());
 	ImageMetadata const& metadata = it->second;
 	
-	QDomElement size_el(doc.createElement("size"));
-	size_el.setAttribute("width", metadata.size().width());
-	size_el.setAttribute("height", metadata.size().height());
-	image_el.appendChild(size_el);
+	xml.writeStartElement("size");
+	xml.writeAttribute("width", QString::number(metadata.size().width()));
+	xml.writeAttribute("height", QString::number(metadata.size().height()));
+	xml.writeEndElement();
 	
-	QDomElement dpi_el(doc.createElement("dpi"));
-	dpi_el.setAttribute("horizontal", metadata.dpi().horizontal());
-	dpi_el.setAttribute("vertical", metadata.dpi().vertical());
-	image_el.appendChild(dpi_el);
+	xml.writeStartElement("dpi");
+	xml.writeAttribute("horizontal", QString::number(metadata.dpi().horizontal()));
+	xml.writeAttribute("vertical", QString::number(metadata.dpi().vertical()));
+	xml.writeEndElement();
 }
 
-QDomElement
-ProjectWriter::processPages(QDomDocument& doc) const
+void
+ProjectWriter::processPages(QXmlStreamWriter& xml) const
 {
-	QDomElement pages_el(doc.createElement("pages"));
+	xml.writeStartElement("pages");
 	
 	PageId const sel_opt_1(m_selectedPage.get(IMAGE_VIEW));
 	PageId const sel_opt_2(m_selectedPage.get(PAGE_VIEW));
@@ -207,17 +280,30 @@ ProjectWriter::processPages(QDomDocument& doc) const
 	for (size_t i = 0; i < num_pages; ++i) {
 		PageInfo const& page = m_pageSequence.pageAt(i);
 		PageId const& page_id = page.id();
-		QDomElement page_el(doc.createElement("page"));
-		page_el.setAttribute("id", pageId(page_id));
-		page_el.setAttribute("imageId", imageId(page_id.imageId()));
-		page_el.setAttribute("subPage", page_id.subPageAsString());
+		xml.writeStartElement("page");
+		xml.writeAttribute("id", QString::number(pageId(page_id)));
+		xml.writeAttribute("imageId", QString::number(imageId(page_id.imageId())));
+		xml.writeAttribute("subPage", page_id.subPageAsString());
 		if (page_id == sel_opt_1 || page_id == sel_opt_2) {
-			page_el.setAttribute("selected", "selected");
+			xml.writeAttribute("selected", "selected");
 		}
-		pages_el.appendChild(page_el);
+		xml.writeEndElement();
 	}
 	
-	return pages_el;
+	xml.writeEndElement();
+}
+
+void
+ProjectWriter::processDisambiguator(QXmlStreamWriter& xml) const
+{
+	// This one is small enough to go through DOM.
+	QDomDocument doc;
+	XmlStreamUtils::writeElement(
+		xml, m_outFileNameGen.disambiguator()->toXml(
+			doc, "file-name-disambiguation",
+			boost::bind(&ProjectWriter::packFilePath, this, _1)
+		)
+	);
 }
 
 int
@@ -33,6 +33,7 @@
 #include <boost/multi_index/member.hpp>
 #endif
 #include <QString>
+#include <QXmlStreamAttributes>
 #include <Qt>
 #include <vector>
 #include <map>
@@ -40,8 +41,10 @@
 class AbstractFilter;
 class ProjectPages;
 class PageInfo;
-class QDomDocument;
-class QDomElement;
+class ProjectIndexBuilder;
+class QByteArray;
+class XmlFragment;
+class QXmlStreamWriter;
 
 class ProjectWriter
 {
@@ -56,7 +59,36 @@ public:
 	
 	~ProjectWriter();
 	
-	bool write(QString const& file_path, std::vector<FilterPtr> const& filters) const;
+	/**
+	 * \brief Writes the project file.
+	 *
+	 * \param with_index Whether to also write a ProjectIndex to
+	 *        ProjectIndex::indexPathFor(file_path).  Without one, an existing
+	 *        index at that location is removed, as it would no longer match.
+	 *        A failure to write the index is not reported.
+	 * \return true if the project file was written successfully.
+	 */
+	bool write(QString const& file_path,
+		std::vector<FilterPtr> const& filters, bool with_index = false) const;
+	
+	/**
+	 * \brief Starts the settings element of a filter.
+	 *
+	 * Meant to be called from AbstractFilter::saveSettings().
+	 * The element is to be closed with QXmlStreamWriter::writeEndElement().
+	 */
+	void writeSettingsStart(QXmlStreamWriter& xml, QString const& element_name,
+		QXmlStreamAttributes const& attributes = QXmlStreamAttributes()) const;
+	
+	/**
+	 * \brief Writes a per-page (or per-image) settings element of a filter.
+	 *
+	 * Meant to be called from AbstractFilter::saveSettings(), between
+	 * writeSettingsStart() and the corresponding writeEndElement().
+	 * A null fragment writes nothing.
+	 */
+	void writeSettingsEntry(QXmlStreamWriter& xml,
+		int numeric_id, XmlFragment const& fragment) const;
 	
 	/**
 	 * \p out will be called like this: out(ImageId, numeric_image_id)
@@ -152,17 +184,26 @@ private:
 		>
 	> Pages;
 	
-	QDomElement processDirectories(QDomDocument& doc) const;
+	/**
+	 * \param project_hash If not null, receives the hash of the written
+	 *        file, for ProjectIndexBuilder::write().
+	 */
+	bool writeProjectFile(QString const& file_path,
+		std::vector<FilterPtr> const& filters,
+		QByteArray* project_hash = 0) const;
 	
-	QDomElement processFiles(QDomDocument& doc) const;
+	void processDirectories(QXmlStreamWriter& xml) const;
 	
-	QDomElement processImages(QDomDocument& doc) const;
+	void processFiles(QXmlStreamWriter& xml) const;
 	
-	QDomElement processPages(QDomDocument& doc) const;
+	void processImages(QXmlStreamWriter& xml) const;
+	
+	void processPages(QXmlStreamWriter& xml) const;
+
+	void processDisambiguator(QXmlStreamWriter& xml) const;
 	
 	void writeImageMetadata(
-		QDomDocument& doc, QDomElement& image_el,
-		ImageId const& image_id) const;
+		QXmlStreamWriter& xml, ImageId const& image_id) const;
 	
 	int dirId(QString const& dir_path) const;
 	
@@ -187,6 +228,11 @@ private:
 	Pages m_pages;
 	MetadataByImage m_metadataByImage;
 	Qt::LayoutDirection m_layoutDirection;
+	
+	/**
+	 * Set while write() is producing an index along with the project file.
+	 */
+	mutable ProjectIndexBuilder* m_pIndexBuilder;
 };
 
 template<typename OutFunc>
@@ -125,6 +125,8 @@ public:
 	
 	void ensureThumbnailExists(ImageId const& image_id, QImage const& image);
 	
+	bool needsThumbnail(ImageId const& image_id) const;
+	
 	void recreateThumbnail(ImageId const& image_id, QImage const& image);
 protected:
 	virtual void run();
@@ -312,6 +314,12 @@ ThumbnailPixmapCache::ensureThumbnailExists(
 	m_ptrImpl->ensureThumbnailExists(image_id, image);
 }
 
+bool
+ThumbnailPixmapCache::needsThumbnail(ImageId const& image_id) const
+{
+	return m_ptrImpl->needsThumbnail(image_id);
+}
+
 void
 ThumbnailPixmapCache::recreateThumbnail(
 	ImageId const& image_id, QImage const& image)
@@ -521,6 +529,21 @@ ThumbnailPixmapCache::Impl::ensureThumbnailExists(
 	}
 }
 
+bool
+ThumbnailPixmapCache::Impl::needsThumbnail(ImageId const& image_id) const
+{
+	if (m_shuttingDown) {
+		return false;
+	}
+	
+	QMutexLocker locker(&m_mutex);
+	QString const thumb_dir(m_thumbDir);
+	locker.unlock();
+	
+	return QFileInfo(thumb_dir).isDir()
+		&& !QFile::exists(getThumbFilePath(image_id, thumb_dir));
+}
+
 void
 ThumbnailPixmapCache::Impl::recreateThumbnail(
 	ImageId const& image_id, QImage const& image)
@@ -136,6 +136,16 @@ public:
 	 */
 	void ensureThumbnailExists(ImageId const& image_id, QImage const& image);
 	
+	/**
+	 * \brief Checks whether ensureThumbnailExists() would create
+	 *        a thumbnail for this image.
+	 *
+	 * That's the case if there is no thumbnail yet, and the thumbnail
+	 * directory exists, so that one can be created.
+	 * \note This function may be called from any thread, even concurrently.
+	 */
+	bool needsThumbnail(ImageId const& image_id) const;
+	
 	/**
 	 * \brief Re-create and replace the existing thumnail.
 	 *
@@ -18,6 +18,7 @@
 
 #include "TiffWriter.h"
 #include "Dpm.h"
+#include "Profiler.h"
 #include "imageproc/Constants.h"
 #include <QtGlobal>
 #include <QFile>
@@ -168,6 +169,10 @@ TiffWriter::writeImage(QIODevice& device, QImage const& image)
 	if (image.isNull()) {
 		return false;
 	}
+
+	ProfileSpan span("TiffWriter::writeImage");
+	span.setImageSize(image.size());
+
 	if (!device.isWritable()) {
 		return false;
 	}
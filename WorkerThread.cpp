@@ -19,6 +19,7 @@
 #include "WorkerThread.h.moc"
 #include "ThreadPriority.h"
 #include "OutOfMemoryHandler.h"
+#include "MemoryBudget.h"
 #include <QCoreApplication>
 #include <QThread>
 #include <QEvent>
@@ -238,6 +239,8 @@ WorkerThread::Dispatcher::processTask(BackgroundTaskPtr const& task)
 	}
 
 	try {
+		MemoryBudget::Admission const admission;
+		MemoryBudget::ScratchArena const arena;
 		FilterResultPtr const result((*task)());
 		if (result) {
 			QCoreApplication::postEvent(
@@ -0,0 +1,121 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef XMLFRAGMENTCACHE_H_
+#define XMLFRAGMENTCACHE_H_
+
+#include "RevisionMap.h"
+#include "XmlStreamUtils.h"
+#include "ProjectWriter.h"
+#include <QDomElement>
+#include <map>
+
+class QXmlStreamWriter;
+
+/**
+ * \brief Keeps serialized per-page (or per-image) settings of a filter,
+ *        so that unchanged ones are not re-serialized on every save.
+ *
+ * A cached fragment is considered up to date if it was produced for
+ * the same numeric id (ids are assigned by ProjectWriter and change
+ * when pages are added or removed) and the same settings revision.
+ * Fragments are kept pre-tokenized, so writing them involves no parsing.
+ * They are written through ProjectWriter::writeSettingsEntry(), which
+ * also puts them into the project index, if one is being written.
+ *
+ * This class is not thread-safe.  It's meant to be used from
+ * AbstractFilter::saveSettings(), which is never called concurrently.
+ */
+template<typename Key>
+class XmlFragmentCache
+{
+	// Member-wise copying is OK.
+public:
+	typedef typename RevisionMap<Key>::Revision Revision;
+
+	/**
+	 * \brief Writes a cached fragment, provided it's up to date.
+	 *
+	 * \return true if the fragment was written, false if it needs to be
+	 *         produced by writeAndCache().
+	 */
+	bool writeCached(ProjectWriter const& writer, QXmlStreamWriter& xml,
+		Key const& key, int numeric_id, Revision revision) const;
+
+	/**
+	 * \brief Caches the serialized version of \p el, then writes it.
+	 *
+	 * \param el The element to write.  A null element is allowed
+	 *        and means there is nothing to write for this key.
+	 */
+	void writeAndCache(ProjectWriter const& writer, QXmlStreamWriter& xml,
+		Key const& key, int numeric_id, Revision revision, QDomElement const& el);
+
+	void clear() { m_entries.clear(); }
+private:
+	struct Entry
+	{
+		XmlFragment fragment;
+		Revision revision;
+		int numericId;
+
+		Entry() : revision(0), numericId(-1) {}
+	};
+
+	typedef std::map<Key, Entry> Entries;
+
+	Entries m_entries;
+};
+
+
+template<typename Key>
+bool
+XmlFragmentCache<Key>::writeCached(
+	ProjectWriter const& writer, QXmlStreamWriter& xml, Key const& key,
+	int const numeric_id, Revision const revision) const
+{
+	typename Entries::const_iterator const it(m_entries.find(key));
+	if (it == m_entries.end()) {
+		return false;
+	}
+
+	Entry const& entry = it->second;
+	if (entry.numericId != numeric_id || entry.revision != revision) {
+		return false;
+	}
+
+	writer.writeSettingsEntry(xml, numeric_id, entry.fragment);
+	return true;
+}
+
+template<typename Key>
+void
+XmlFragmentCache<Key>::writeAndCache(
+	ProjectWriter const& writer, QXmlStreamWriter& xml, Key const& key,
+	int const numeric_id, Revision const revision, QDomElement const& el)
+{
+	Entry& entry = m_entries[key];
+	entry.fragment = XmlFragment(el);
+	entry.revision = revision;
+	entry.numericId = numeric_id;
+
+	writer.writeSettingsEntry(xml, numeric_id, entry.fragment);
+}
+
+#endif
@@ -0,0 +1,309 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "XmlStreamUtils.h"
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+#include <QDomDocument>
+#include <QDomElement>
+#include <QDomNamedNodeMap>
+#include <QDomAttr>
+#include <QDomText>
+#include <QDomCDATASection>
+#include <QByteArray>
+#include <QBuffer>
+#include <QString>
+#include <QIODevice>
+
+namespace
+{
+
+/**
+ * Advances to the next token that counts when comparing documents.
+ */
+QXmlStreamReader::TokenType nextSignificantToken(QXmlStreamReader& reader)
+{
+	for (;;) {
+		QXmlStreamReader::TokenType const type = reader.readNext();
+		switch (type) {
+			case QXmlStreamReader::StartElement:
+			case QXmlStreamReader::EndElement:
+			case QXmlStreamReader::EndDocument:
+			case QXmlStreamReader::Invalid:
+				return type;
+			case QXmlStreamReader::Characters:
+				if (!reader.isWhitespace()) {
+					return type;
+				}
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+bool sameAttributes(QXmlStreamAttributes const& attrs1, QXmlStreamAttributes const& attrs2)
+{
+	if (attrs1.size() != attrs2.size()) {
+		return false;
+	}
+
+	// XML doesn't allow duplicate attributes, so checking in one
+	// direction is enough.
+	int const num_attrs = attrs1.size();
+	for (int i = 0; i < num_attrs; ++i) {
+		QXmlStreamAttribute const& attr = attrs1[i];
+		QString const name(attr.qualifiedName().toString());
+		if (!attrs2.hasAttribute(name) || attrs2.value(name) != attr.value()) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+} // anonymous namespace
+
+void
+XmlStreamUtils::writeElement(QXmlStreamWriter& writer, QDomElement const& el)
+{
+	writer.writeStartElement(el.tagName());
+
+	QDomNamedNodeMap const attrs(el.attributes());
+	int const num_attrs = attrs.count();
+	for (int i = 0; i < num_attrs; ++i) {
+		QDomAttr const attr(attrs.item(i).toAttr());
+		writer.writeAttribute(attr.name(), attr.value());
+	}
+
+	QDomNode node(el.firstChild());
+	for (; !node.isNull(); node = node.nextSibling()) {
+		if (node.isElement()) {
+			writeElement(writer, node.toElement());
+		} else if (node.isCDATASection()) {
+			writer.writeCDATA(node.toCDATASection().data());
+		} else if (node.isText()) {
+			writer.writeCharacters(node.toText().data());
+		}
+	}
+
+	writer.writeEndElement();
+}
+
+QDomElement
+XmlStreamUtils::readElement(QXmlStreamReader& reader, QDomDocument& doc)
+{
+	QDomElement el(doc.createElement(reader.name().toString()));
+
+	QXmlStreamAttributes const attrs(reader.attributes());
+	int const num_attrs = attrs.size();
+	for (int i = 0; i < num_attrs; ++i) {
+		QXmlStreamAttribute const& attr = attrs[i];
+		el.setAttribute(attr.name().toString(), attr.value().toString());
+	}
+
+	while (!reader.atEnd()) {
+		switch (reader.readNext()) {
+			case QXmlStreamReader::StartElement:
+				el.appendChild(readElement(reader, doc));
+				break;
+			case QXmlStreamReader::EndElement:
+				return el;
+			case QXmlStreamReader::Characters:
+				if (reader.isCDATA()) {
+					el.appendChild(doc.createCDATASection(reader.text().toString()));
+				} else if (!reader.isWhitespace()) {
+					el.appendChild(doc.createTextNode(reader.text().toString()));
+				}
+				break;
+			default:
+				break;
+		}
+	}
+
+	return el;
+}
+
+void
+XmlStreamUtils::writeFragment(QXmlStreamWriter& writer, QByteArray const& fragment)
+{
+	if (fragment.isEmpty()) {
+		return;
+	}
+
+	QXmlStreamReader reader(fragment);
+	while (!reader.atEnd()) {
+		switch (reader.readNext()) {
+			case QXmlStreamReader::StartElement:
+			case QXmlStreamReader::EndElement:
+				writer.writeCurrentToken(reader);
+				break;
+			case QXmlStreamReader::Characters:
+				if (!reader.isWhitespace()) {
+					writer.writeCurrentToken(reader);
+				}
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+QByteArray
+XmlStreamUtils::copyElement(QXmlStreamReader& reader)
+{
+	QByteArray fragment;
+	QBuffer buffer(&fragment);
+	buffer.open(QIODevice::WriteOnly);
+	QXmlStreamWriter writer(&buffer);
+	writer.writeCurrentToken(reader);
+
+	int depth = 1;
+	while (depth > 0 && !reader.atEnd()) {
+		switch (reader.readNext()) {
+			case QXmlStreamReader::StartElement:
+				++depth;
+				writer.writeCurrentToken(reader);
+				break;
+			case QXmlStreamReader::EndElement:
+				--depth;
+				writer.writeCurrentToken(reader);
+				break;
+			case QXmlStreamReader::Characters:
+				if (!reader.isWhitespace()) {
+					writer.writeCurrentToken(reader);
+				}
+				break;
+			default:
+				break;
+		}
+	}
+
+	return fragment;
+}
+
+bool
+XmlStreamUtils::sameContent(QIODevice& doc1, QIODevice& doc2)
+{
+	QXmlStreamReader reader1(&doc1);
+	QXmlStreamReader reader2(&doc2);
+
+	for (;;) {
+		QXmlStreamReader::TokenType const type1 = nextSignificantToken(reader1);
+		QXmlStreamReader::TokenType const type2 = nextSignificantToken(reader2);
+		if (type1 != type2) {
+			return false;
+		}
+
+		switch (type1) {
+			case QXmlStreamReader::Invalid:
+				return false;
+			case QXmlStreamReader::EndDocument:
+				return true;
+			case QXmlStreamReader::StartElement:
+				if (reader1.qualifiedName() != reader2.qualifiedName()) {
+					return false;
+				}
+				if (!sameAttributes(reader1.attributes(), reader2.attributes())) {
+					return false;
+				}
+				break;
+			case QXmlStreamReader::Characters:
+				if (reader1.text() != reader2.text()) {
+					return false;
+				}
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+
+/*=============================== XmlFragment ==============================*/
+
+XmlFragment::XmlFragment(QDomElement const& el)
+{
+	if (!el.isNull()) {
+		appendElement(el);
+	}
+}
+
+void
+XmlFragment::appendElement(QDomElement const& el)
+{
+	m_tokens.push_back(Token(Token::START_ELEMENT, el.tagName()));
+
+	QDomNamedNodeMap const attrs(el.attributes());
+	int const num_attrs = attrs.count();
+	for (int i = 0; i < num_attrs; ++i) {
+		QDomAttr const attr(attrs.item(i).toAttr());
+		m_tokens.back().attributes.append(attr.name(), attr.value());
+	}
+
+	QDomNode node(el.firstChild());
+	for (; !node.isNull(); node = node.nextSibling()) {
+		if (node.isElement()) {
+			appendElement(node.toElement());
+		} else if (node.isCDATASection()) {
+			m_tokens.push_back(Token(Token::CDATA, node.toCDATASection().data()));
+		} else if (node.isText()) {
+			m_tokens.push_back(Token(Token::CHARACTERS, node.toText().data()));
+		}
+	}
+
+	m_tokens.push_back(Token(Token::END_ELEMENT, QString()));
+}
+
+void
+XmlFragment::write(QXmlStreamWriter& writer) const
+{
+	std::vector<Token>::const_iterator it(m_tokens.begin());
+	std::vector<Token>::const_iterator const end(m_tokens.end());
+	for (; it != end; ++it) {
+		switch (it->type) {
+			case Token::START_ELEMENT:
+				writer.writeStartElement(it->text);
+				writer.writeAttributes(it->attributes);
+				break;
+			case Token::END_ELEMENT:
+				writer.writeEndElement();
+				break;
+			case Token::CHARACTERS:
+				writer.writeCharacters(it->text);
+				break;
+			case Token::CDATA:
+				writer.writeCDATA(it->text);
+				break;
+		}
+	}
+}
+
+QByteArray
+XmlFragment::toByteArray() const
+{
+	if (m_bytes.isEmpty() && !isNull()) {
+		QBuffer buffer(&m_bytes);
+		buffer.open(QIODevice::WriteOnly);
+		QXmlStreamWriter writer(&buffer);
+		write(writer);
+	}
+
+	return m_bytes;
+}
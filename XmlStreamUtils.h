@@ -0,0 +1,143 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef XMLSTREAMUTILS_H_
+#define XMLSTREAMUTILS_H_
+
+#include <QByteArray>
+#include <QString>
+#include <QXmlStreamAttributes>
+#include <vector>
+
+class QByteArray;
+class QIODevice;
+class QDomDocument;
+class QDomElement;
+class QXmlStreamReader;
+class QXmlStreamWriter;
+
+/**
+ * \brief Glue between streaming XML I/O and the DOM-based serialization
+ *        of individual settings.
+ *
+ * Project files are read and written as streams, so that the whole
+ * project never has to be in memory as a DOM tree.  Individual pieces
+ * of settings (Params, ZoneSet, etc.) still serialize themselves to and
+ * from DOM elements.  These functions convert such small pieces.
+ */
+class XmlStreamUtils
+{
+public:
+	/**
+	 * \brief Writes a DOM element, along with its subtree, to an XML stream.
+	 */
+	static void writeElement(QXmlStreamWriter& writer, QDomElement const& el);
+
+	/**
+	 * \brief Reads the element a stream is positioned at into a DOM element.
+	 *
+	 * \param reader The stream positioned at a start element.  On return,
+	 *        it's positioned at the corresponding end element.
+	 * \param doc The document to create the element in.
+	 * \return The element, not yet attached to \p doc.
+	 */
+	static QDomElement readElement(QXmlStreamReader& reader, QDomDocument& doc);
+
+	/**
+	 * \brief Writes a fragment produced by toFragment() to an XML stream.
+	 */
+	static void writeFragment(QXmlStreamWriter& writer, QByteArray const& fragment);
+
+	/**
+	 * \brief Copies the element a stream is positioned at into a fragment.
+	 *
+	 * The result is the same as readElement() followed by toFragment(),
+	 * just without going through DOM.
+	 *
+	 * \param reader The stream positioned at a start element.  On return,
+	 *        it's positioned at the corresponding end element.
+	 */
+	static QByteArray copyElement(QXmlStreamReader& reader);
+
+	/**
+	 * \brief Checks if two XML documents have the same content.
+	 *
+	 * Differences in formatting, the XML declaration, comments and
+	 * the order of attributes are ignored.  A document that fails
+	 * to parse is not the same as anything.
+	 */
+	static bool sameContent(QIODevice& doc1, QIODevice& doc2);
+};
+
+
+/**
+ * \brief A serialized DOM element, kept in a form that can be written
+ *        to an XML stream without being parsed again.
+ */
+class XmlFragment
+{
+	// Member-wise copying is OK.
+public:
+	/**
+	 * \brief Constructs a null fragment.
+	 */
+	XmlFragment() {}
+
+	/**
+	 * \brief Captures an element along with its subtree.
+	 *
+	 * A null element produces a null fragment.
+	 */
+	explicit XmlFragment(QDomElement const& el);
+
+	bool isNull() const { return m_tokens.empty(); }
+
+	/**
+	 * \brief Writes the element to an XML stream.  A null fragment
+	 *        writes nothing.
+	 */
+	void write(QXmlStreamWriter& writer) const;
+
+	/**
+	 * \brief Serializes the element into a compact standalone form,
+	 *        as XmlStreamUtils::copyElement() would produce.
+	 *
+	 * A null fragment produces an empty byte array.  The result is
+	 * computed once and shared between copies made afterwards.
+	 */
+	QByteArray toByteArray() const;
+private:
+	struct Token
+	{
+		enum Type { START_ELEMENT, END_ELEMENT, CHARACTERS, CDATA };
+
+		Type type;
+		QString text; /**< The tag name for START_ELEMENT. */
+		QXmlStreamAttributes attributes;
+
+		Token(Type t, QString const& txt) : type(t), text(txt) {}
+	};
+
+	void appendElement(QDomElement const& el);
+
+	std::vector<Token> m_tokens;
+	mutable QByteArray m_bytes;
+};
+
+#endif
@@ -0,0 +1,177 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "SyntheticScan.h"
+#include "imageproc/Grayscale.h"
+#include "imageproc/Constants.h"
+#include <QPainter>
+#include <QLinearGradient>
+#include <QRectF>
+#include <QColor>
+#include <Qt>
+#include <algorithm>
+#include <math.h>
+
+namespace benchmarks
+{
+
+namespace
+{
+
+/**
+ * A linear congruential generator.  Unlike rand(), it produces
+ * the same sequence everywhere.
+ */
+class Lcg
+{
+public:
+	Lcg(unsigned seed) : m_state(seed) {}
+
+	/** Returns a number in [0, 1). */
+	double next() {
+		m_state = m_state * 1664525u + 1013904223u;
+		return (m_state >> 8) / double(1u << 24);
+	}
+private:
+	unsigned m_state;
+};
+
+void drawTextLines(
+	QPainter& painter, SyntheticScanParams const& params,
+	QRectF const& text_area, QRectF const& picture_area)
+{
+	Lcg rng(params.seed);
+	double const dpi = params.dpi;
+	double const line_height = 0.16 * dpi;
+	double const x_height = 0.07 * dpi;
+	double const gutter_x = text_area.left();
+	double const bend = params.curvature * dpi;
+
+	for (double y = text_area.top(); y + line_height < text_area.bottom(); y += line_height) {
+		double x = text_area.left();
+		while (x < text_area.right()) {
+			double const word_width = (0.15 + 0.35 * rng.next()) * dpi;
+			double const word_right = std::min(x + word_width, text_area.right());
+
+			// Lines bend down near the gutter, as they do in thick books.
+			double const dist = (x - gutter_x) / text_area.width();
+			double const dy = bend * (1.0 - dist) * (1.0 - dist);
+
+			QRectF const word(x, y + dy, word_right - x, x_height);
+			if (!word.intersects(picture_area)) {
+				// Split words into letters, so that the result looks like text
+				// to connected component based algorithms.
+				double const letter_width = 0.05 * dpi;
+				for (double lx = word.left(); lx < word.right(); lx += letter_width) {
+					double const ascender = rng.next() < 0.3 ? 0.04 * dpi : 0.0;
+					painter.fillRect(
+						QRectF(
+							lx, word.top() - ascender,
+							letter_width * 0.7, word.height() + ascender
+						), Qt::black
+					);
+				}
+			}
+
+			x = word_right + 0.06 * dpi;
+		}
+	}
+}
+
+void drawHalftone(QPainter& painter, QRectF const& area, int const dpi)
+{
+	// A 85 lpi screen, modulated by a smooth function.
+	double const pitch = dpi / 85.0;
+	painter.setPen(Qt::NoPen);
+	painter.setBrush(Qt::black);
+	for (double y = area.top(); y < area.bottom(); y += pitch) {
+		for (double x = area.left(); x < area.right(); x += pitch) {
+			double const u = (x - area.left()) / area.width();
+			double const v = (y - area.top()) / area.height();
+			double const tone = 0.5 + 0.5 * sin(6.0 * u) * cos(4.0 * v);
+			double const r = 0.5 * pitch * sqrt(tone);
+			if (r > 0.05 * pitch) {
+				painter.drawEllipse(QPointF(x, y), r, r);
+			}
+		}
+	}
+}
+
+void drawShadows(QPainter& painter, QRectF const& page, int const dpi)
+{
+	painter.setCompositionMode(QPainter::CompositionMode_Multiply);
+
+	QLinearGradient left(page.left(), 0, page.left() + 0.4 * dpi, 0);
+	left.setColorAt(0.0, QColor(60, 60, 60));
+	left.setColorAt(1.0, Qt::white);
+	painter.fillRect(page, left);
+
+	QLinearGradient top(0, page.top(), 0, page.top() + 0.25 * dpi);
+	top.setColorAt(0.0, QColor(110, 110, 110));
+	top.setColorAt(1.0, Qt::white);
+	painter.fillRect(page, top);
+
+	painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+}
+
+} // anonymous namespace
+
+QImage generateSyntheticScan(SyntheticScanParams const& params)
+{
+	int const dpi = params.dpi;
+	QImage canvas(4 * dpi, 6 * dpi, QImage::Format_RGB32);
+	canvas.fill(0xffeeeeee); // Slightly off-white paper.
+
+	QRectF const page(canvas.rect());
+	QRectF const text_area(page.adjusted(0.5 * dpi, 0.6 * dpi, -0.4 * dpi, -0.6 * dpi));
+	QRectF const picture_area(
+		text_area.left() + 0.5 * dpi, text_area.top() + 1.8 * dpi,
+		text_area.width() - 1.0 * dpi, 1.4 * dpi
+	);
+
+	{
+		QPainter painter(&canvas);
+		painter.setRenderHint(QPainter::Antialiasing);
+
+		painter.translate(page.center());
+		painter.rotate(params.skewAngle);
+		painter.translate(-page.center());
+
+		drawTextLines(
+			painter, params, text_area,
+			params.halftone ? picture_area : QRectF()
+		);
+		if (params.halftone) {
+			drawHalftone(painter, picture_area, dpi);
+		}
+
+		painter.resetTransform();
+		if (params.shadows) {
+			drawShadows(painter, page, dpi);
+		}
+	}
+
+	QImage gray(imageproc::toGrayscale(canvas));
+	int const dpm = qRound(dpi * imageproc::constants::DPI2DPM);
+	gray.setDotsPerMeterX(dpm);
+	gray.setDotsPerMeterY(dpm);
+	return gray;
+}
+
+} // namespace benchmarks
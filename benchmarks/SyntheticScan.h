@@ -0,0 +1,69 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef BENCHMARKS_SYNTHETICSCAN_H_
+#define BENCHMARKS_SYNTHETICSCAN_H_
+
+#include <QImage>
+
+namespace benchmarks
+{
+
+/**
+ * \brief Parameters of a synthetic scan.
+ *
+ * The same parameters always produce the same image, on any platform.
+ */
+struct SyntheticScanParams
+{
+	/** The resolution of the scan.  The page is always 4x6 inches. */
+	int dpi;
+
+	/** The angle the page content is rotated by, in degrees. */
+	double skewAngle;
+
+	/** How much text lines bend near the gutter, in inches. */
+	double curvature;
+
+	/** Whether to darken the left and top edges, like a book's gutter. */
+	bool shadows;
+
+	/** Whether to put a halftone picture into the middle of the page. */
+	bool halftone;
+
+	/** The seed for the pseudo-random layout of words. */
+	unsigned seed;
+
+	SyntheticScanParams(int dpi_ = 300)
+	: dpi(dpi_), skewAngle(1.5), curvature(0.05),
+	shadows(true), halftone(true), seed(12345) {}
+};
+
+/**
+ * \brief Renders a grayscale page with lines of text-like blocks,
+ *        according to \p params.
+ *
+ * \return A Format_Indexed8 image with a grayscale palette and the
+ *         requested resolution set.
+ */
+QImage generateSyntheticScan(SyntheticScanParams const& params);
+
+} // namespace benchmarks
+
+#endif
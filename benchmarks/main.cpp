@@ -0,0 +1,540 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/**
+ * \file
+ * Throughput benchmarks for the image processing kernels and for
+ * the stages of the processing pipeline.
+ *
+ * Image benchmarks run on deterministic synthetic scans at 300, 600
+ * and 1200 dpi and report millions of input pixels processed per second.
+ * Project benchmarks run on a synthetic project of 20000 pages and
+ * report thousands of pages processed per second.  Results can be saved
+ * as a baseline, and later runs compared against it, failing if any
+ * benchmark got slower than the tolerance allows.
+ */
+
+#include "SyntheticScan.h"
+#include "TaskStatus.h"
+#include "FilterData.h"
+#include "ImageTransformation.h"
+#include "Despeckle.h"
+#include "Dpi.h"
+#include "filters/page_split/VertLineFinder.h"
+#include "filters/select_content/ContentBoxFinder.h"
+#include "filters/output/OutputGenerator.h"
+#include "filters/output/ColorParams.h"
+#include "filters/output/DewarpingMode.h"
+#include "filters/output/DepthPerception.h"
+#include "filters/output/DespeckleLevel.h"
+#include "filters/page_layout/Settings.h"
+#include "filters/page_layout/Params.h"
+#include "PageId.h"
+#include "ImageId.h"
+#include "ZoneSet.h"
+#include "dewarping/DistortionModel.h"
+#include "dewarping/CylindricalSurfaceDewarper.h"
+#include "dewarping/RasterDewarper.h"
+#include "imageproc/BinaryImage.h"
+#include "imageproc/GrayImage.h"
+#include "imageproc/Binarize.h"
+#include "imageproc/Morphology.h"
+#include "imageproc/SEDM.h"
+#include "imageproc/SeedFill.h"
+#include "imageproc/Connectivity.h"
+#include "imageproc/Transform.h"
+#include "imageproc/Scale.h"
+#include "imageproc/SkewFinder.h"
+#include <QCoreApplication>
+#include <QStringList>
+#include <QString>
+#include <QFile>
+#include <QTextStream>
+#include <QTime>
+#include <QTransform>
+#include <QPolygonF>
+#include <QPointF>
+#include <QColor>
+#include <QSizeF>
+#include <map>
+#include <algorithm>
+#include <vector>
+#include <utility>
+#include <iostream>
+#include <stdio.h>
+
+using namespace imageproc;
+using namespace benchmarks;
+
+namespace
+{
+
+class NullTaskStatus : public TaskStatus
+{
+public:
+	virtual void cancel() {}
+
+	virtual bool isCancelled() const { return false; }
+
+	virtual void throwIfCancelled() const {}
+};
+
+/**
+ * Inputs shared by all benchmarks at a given resolution.
+ */
+struct Fixture
+{
+	int dpi;
+	QImage scan;
+	GrayImage gray;
+	BinaryImage binary;
+	BinaryImage seed;
+	std::vector<QPointF> topDirectrix;
+	std::vector<QPointF> bottomDirectrix;
+	NullTaskStatus status;
+
+	Fixture(int resolution)
+	: dpi(resolution),
+	scan(generateSyntheticScan(SyntheticScanParams(resolution))),
+	gray(scan),
+	binary(binarizeOtsu(scan)),
+	seed(openBrick(binary, QSize(9, 1))) {
+		// The text lines of the synthetic scan bend down towards the left.
+		double const w = scan.width();
+		double const h = scan.height();
+		double const bend = 0.05 * dpi;
+		for (int i = 0; i <= 32; ++i) {
+			double const x = w * i / 32.0;
+			double const t = 1.0 - x / w;
+			topDirectrix.push_back(QPointF(x, 0.1 * h + bend * t * t));
+			bottomDirectrix.push_back(QPointF(x, 0.9 * h + bend * t * t));
+		}
+	}
+};
+
+typedef void (*BenchmarkFn)(Fixture const&);
+
+struct Benchmark
+{
+	char const* name;
+	BenchmarkFn fn;
+};
+
+void binarizeOtsuBench(Fixture const& f)
+{
+	binarizeOtsu(f.scan);
+}
+
+void binarizeWolfBench(Fixture const& f)
+{
+	binarizeWolf(f.scan, QSize(51, 51));
+}
+
+void dilateBench(Fixture const& f)
+{
+	dilateBrick(f.binary, QSize(3, 3));
+}
+
+void openBench(Fixture const& f)
+{
+	openBrick(f.binary, QSize(200, 14), BLACK);
+}
+
+void sedmBench(Fixture const& f)
+{
+	SEDM const sedm(f.binary);
+}
+
+void seedFillBench(Fixture const& f)
+{
+	seedFill(f.seed, f.binary, CONN8);
+}
+
+void transformBench(Fixture const& f)
+{
+	QTransform xform;
+	xform.translate(0.5 * f.scan.width(), 0.5 * f.scan.height());
+	xform.rotate(2.0);
+	xform.translate(-0.5 * f.scan.width(), -0.5 * f.scan.height());
+	transformToGray(
+		f.scan, xform, f.scan.rect(), OutsidePixels::assumeWeakNearest()
+	);
+}
+
+void scaleBench(Fixture const& f)
+{
+	scaleToGray(f.gray, f.gray.size() / 2);
+}
+
+void skewFinderBench(Fixture const& f)
+{
+	SkewFinder().findSkew(f.binary);
+}
+
+void vertLineFinderBench(Fixture const& f)
+{
+	page_split::VertLineFinder::findLines(f.scan, FilterData(f.scan).xform(), 2);
+}
+
+void contentBoxFinderBench(Fixture const& f)
+{
+	select_content::ContentBoxFinder::findContentBox(f.status, FilterData(f.scan));
+}
+
+void despeckleBench(Fixture const& f)
+{
+	BinaryImage image(f.binary);
+	Despeckle::despeckleInPlace(
+		image, Dpi(f.dpi, f.dpi), Despeckle::NORMAL, f.status
+	);
+}
+
+void outputGeneratorBench(Fixture const& f)
+{
+	FilterData const data(f.scan);
+	QRectF const content_rect(
+		f.scan.rect().adjusted(f.dpi / 2, f.dpi / 2, -f.dpi / 2, -f.dpi / 2)
+	);
+
+	output::OutputGenerator const generator(
+		Dpi(f.dpi, f.dpi), output::ColorParams(), output::DESPECKLE_NORMAL,
+		data.xform(), QPolygonF(content_rect)
+	);
+
+	dewarping::DistortionModel distortion_model;
+	generator.process(
+		f.status, data, ZoneSet(), ZoneSet(),
+		output::DewarpingMode::OFF, distortion_model,
+		output::DepthPerception()
+	);
+}
+
+void rasterDewarperBench(Fixture const& f)
+{
+	dewarping::CylindricalSurfaceDewarper const dewarper(
+		f.topDirectrix, f.bottomDirectrix, 2.0
+	);
+	dewarping::RasterDewarper::dewarp(
+		f.scan, f.scan.size(), dewarper,
+		QRectF(f.scan.rect()), Qt::white, f.status
+	);
+}
+
+Benchmark const BENCHMARKS[] = {
+	{ "Binarize.Otsu", &binarizeOtsuBench },
+	{ "Binarize.Wolf", &binarizeWolfBench },
+	{ "Morphology.Dilate3x3", &dilateBench },
+	{ "Morphology.Open200x14", &openBench },
+	{ "SEDM", &sedmBench },
+	{ "SeedFill", &seedFillBench },
+	{ "Transform.Rotate", &transformBench },
+	{ "Scale.Half", &scaleBench },
+	{ "SkewFinder", &skewFinderBench },
+	{ "VertLineFinder", &vertLineFinderBench },
+	{ "ContentBoxFinder", &contentBoxFinderBench },
+	{ "Despeckle", &despeckleBench },
+	{ "OutputGenerator.BlackAndWhite", &outputGeneratorBench },
+	{ "RasterDewarper", &rasterDewarperBench }
+};
+
+typedef void (*ProjectBenchmarkFn)(std::vector<PageId> const&);
+
+struct ProjectBenchmark
+{
+	char const* name;
+	ProjectBenchmarkFn fn;
+};
+
+QSizeF contentSizeMM(size_t page_idx)
+{
+	return QSizeF(100.0 + page_idx % 37, 150.0 + page_idx % 53);
+}
+
+void pageLayoutSettingsBench(std::vector<PageId> const& pages)
+{
+	page_layout::Settings settings;
+	size_t const num_pages = pages.size();
+
+	// Page Layout seeing every page for the first time.
+	QSizeF agg_before, agg_after;
+	for (size_t i = 0; i < num_pages; ++i) {
+		settings.updateContentSizeAndGetParams(
+			pages[i], contentSizeMM(i), &agg_before, &agg_after
+		);
+	}
+
+	// Every thumbnail asks for the aggregate size.
+	for (size_t i = 0; i < num_pages; ++i) {
+		settings.getAggregateHardSizeMM();
+	}
+
+	// Re-processing, where one page in a hundred gets a different content box.
+	for (size_t i = 0; i < num_pages; ++i) {
+		QSizeF size(contentSizeMM(i));
+		if (i % 100 == 0) {
+			size += QSizeF(5.0, 5.0);
+		}
+		settings.setContentSizeMM(pages[i], size);
+		settings.updateContentSizeAndGetParams(
+			pages[i], size, &agg_before, &agg_after
+		);
+	}
+
+	for (size_t i = 0; i < num_pages; i += 10) {
+		settings.invalidateContentSize(pages[i]);
+	}
+}
+
+ProjectBenchmark const PROJECT_BENCHMARKS[] = {
+	{ "PageLayout.Settings", &pageLayoutSettingsBench }
+};
+
+typedef std::map<std::pair<QString, int>, double> Results;
+
+/**
+ * Collects results and compares them against a baseline.
+ */
+class Reporter
+{
+public:
+	Reporter(Results const& baseline, double tolerance)
+	: m_baseline(baseline), m_tolerance(tolerance), m_numRegressions(0) {}
+
+	/**
+	 * \param param The resolution for image benchmarks,
+	 *        and the number of pages for project benchmarks.
+	 */
+	void report(char const* name, int param, int iterations, int elapsed_msec, double rate);
+
+	Results const& results() const { return m_results; }
+
+	int numRegressions() const { return m_numRegressions; }
+private:
+	Results const& m_baseline;
+	Results m_results;
+	double m_tolerance;
+	int m_numRegressions;
+};
+
+void
+Reporter::report(
+	char const* name, int const param, int const iterations,
+	int const elapsed_msec, double const rate)
+{
+	std::pair<QString, int> const key(QString::fromAscii(name), param);
+	m_results[key] = rate;
+
+	char comparison[32] = "-";
+	Results::const_iterator const base(m_baseline.find(key));
+	if (base != m_baseline.end() && base->second > 0) {
+		double const change = rate / base->second - 1.0;
+		bool const regressed = change < -m_tolerance;
+		if (regressed) {
+			++m_numRegressions;
+		}
+		snprintf(
+			comparison, sizeof(comparison), "%+.1f%%%s",
+			change * 100.0, regressed ? " FAIL" : ""
+		);
+	}
+
+	printf("%-32s %6d %6d %10.2f %10.2f %10s\n",
+		name, param, iterations,
+		double(elapsed_msec) / iterations, rate, comparison);
+	fflush(stdout);
+}
+
+QString optionValue(QStringList const& args, QString const& name)
+{
+	QString const prefix(QString::fromAscii("--%1=").arg(name));
+	foreach (QString const& arg, args) {
+		if (arg.startsWith(prefix)) {
+			return arg.mid(prefix.size());
+		}
+	}
+	return QString();
+}
+
+Results loadBaseline(QString const& path)
+{
+	Results results;
+
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly|QIODevice::Text)) {
+		std::cerr << "Can't read the baseline." << std::endl;
+		return results;
+	}
+
+	QTextStream strm(&file);
+	while (!strm.atEnd()) {
+		QStringList const fields(strm.readLine().split(' ', QString::SkipEmptyParts));
+		if (fields.size() == 3) {
+			results[std::make_pair(fields[0], fields[1].toInt())] = fields[2].toDouble();
+		}
+	}
+
+	return results;
+}
+
+bool saveBaseline(QString const& path, Results const& results)
+{
+	QFile file(path);
+	if (!file.open(QIODevice::WriteOnly|QIODevice::Truncate|QIODevice::Text)) {
+		return false;
+	}
+
+	QTextStream strm(&file);
+	for (Results::const_iterator it(results.begin()); it != results.end(); ++it) {
+		strm << it->first.first << ' ' << it->first.second << ' ' << it->second << '\n';
+	}
+
+	return true;
+}
+
+void printUsage()
+{
+	std::cout << "Usage: benchmarks [options]\n"
+		"\t--dpi=<list>\t\t-- comma-separated resolutions; default: 300,600,1200\n"
+		"\t--quick\t\t\t-- same as --dpi=300\n"
+		"\t--pages=<n>\t\t-- project size for project benchmarks; default: 20000\n"
+		"\t--filter=<text>\t\t-- only run benchmarks whose name contains <text>\n"
+		"\t--min-time=<sec>\t-- minimum time per benchmark; default: 1.0\n"
+		"\t--save-baseline=<file>\t-- store the results as a baseline\n"
+		"\t--baseline=<file>\t-- compare against a baseline\n"
+		"\t--tolerance=<fraction>\t-- allowed slowdown; default: 0.15\n";
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+	QCoreApplication app(argc, argv);
+	QStringList const args(app.arguments());
+
+	if (args.contains("--help") || args.contains("-h")) {
+		printUsage();
+		return 0;
+	}
+
+	std::vector<int> resolutions;
+	QString dpi_list(optionValue(args, "dpi"));
+	if (args.contains("--quick")) {
+		dpi_list = "300";
+	} else if (dpi_list.isEmpty()) {
+		dpi_list = "300,600,1200";
+	}
+	foreach (QString const& dpi, dpi_list.split(',', QString::SkipEmptyParts)) {
+		resolutions.push_back(dpi.toInt());
+	}
+
+	QString const pages_str(optionValue(args, "pages"));
+	int const num_pages = pages_str.isEmpty() ? 20000 : pages_str.toInt();
+
+	QString const filter(optionValue(args, "filter"));
+	QString const min_time_str(optionValue(args, "min-time"));
+	int const min_msec = min_time_str.isEmpty() ? 1000 : int(min_time_str.toDouble() * 1000);
+	QString const tolerance_str(optionValue(args, "tolerance"));
+	double const tolerance = tolerance_str.isEmpty() ? 0.15 : tolerance_str.toDouble();
+
+	Results baseline;
+	QString const baseline_file(optionValue(args, "baseline"));
+	if (!baseline_file.isEmpty()) {
+		baseline = loadBaseline(baseline_file);
+	}
+
+	Reporter reporter(baseline, tolerance);
+
+	printf("%-32s %6s %6s %10s %10s %10s\n",
+		"image benchmark", "dpi", "iters", "ms/iter", "Mpix/s", "vs base");
+
+	for (size_t r = 0; r < resolutions.size(); ++r) {
+		Fixture const fixture(resolutions[r]);
+		double const mpixels = fixture.scan.width() * fixture.scan.height() / 1e6;
+
+		for (size_t b = 0; b < sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]); ++b) {
+			Benchmark const& bench = BENCHMARKS[b];
+			if (!filter.isEmpty() && !QString::fromAscii(bench.name).contains(filter)) {
+				continue;
+			}
+
+			bench.fn(fixture); // Warm up.
+
+			int iterations = 0;
+			QTime timer;
+			timer.start();
+			do {
+				bench.fn(fixture);
+				++iterations;
+			} while (timer.elapsed() < min_msec);
+			int const elapsed = std::max(1, timer.elapsed());
+
+			reporter.report(
+				bench.name, fixture.dpi, iterations, elapsed,
+				mpixels * iterations * 1000.0 / elapsed
+			);
+		}
+	}
+
+	std::vector<PageId> pages;
+	pages.reserve(num_pages);
+	for (int i = 0; i < num_pages; ++i) {
+		pages.push_back(
+			PageId(ImageId(QString::fromAscii("page%1.tif").arg(i)))
+		);
+	}
+
+	printf("\n%-32s %6s %6s %10s %10s %10s\n",
+		"project benchmark", "pages", "iters", "ms/iter", "kpages/s", "vs base");
+
+	for (size_t b = 0; b < sizeof(PROJECT_BENCHMARKS) / sizeof(PROJECT_BENCHMARKS[0]); ++b) {
+		ProjectBenchmark const& bench = PROJECT_BENCHMARKS[b];
+		if (!filter.isEmpty() && !QString::fromAscii(bench.name).contains(filter)) {
+			continue;
+		}
+
+		int iterations = 0;
+		QTime timer;
+		timer.start();
+		do {
+			bench.fn(pages);
+			++iterations;
+		} while (timer.elapsed() < min_msec);
+		int const elapsed = std::max(1, timer.elapsed());
+
+		// Pages per millisecond is thousands of pages per second.
+		reporter.report(
+			bench.name, num_pages, iterations, elapsed,
+			double(num_pages) * iterations / elapsed
+		);
+	}
+
+	QString const save_file(optionValue(args, "save-baseline"));
+	if (!save_file.isEmpty() && !saveBaseline(save_file, reporter.results())) {
+		std::cerr << "Can't write the baseline." << std::endl;
+		return 2;
+	}
+
+	if (reporter.numRegressions() > 0) {
+		std::cerr << reporter.numRegressions() << " benchmark(s) regressed by more than "
+			<< tolerance * 100.0 << "%." << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -20,6 +20,7 @@
 #include "CylindricalSurfaceDewarper.h"
 #include "HomographicTransform.h"
 #include "VecNT.h"
+#include "TaskStatus.h"
 #include "imageproc/ColorMixer.h"
 #include "imageproc/GrayImage.h"
 #include <QtGlobal>
@@ -51,7 +52,8 @@ void dewarpGeneric(
 	int const src_stride, PixelType* const dst_data,
 	QSize const dst_size, int const dst_stride,
 	CylindricalSurfaceDewarper const& distortion_model,
-	QRectF const& model_domain, PixelType const bg_color)
+	QRectF const& model_domain, PixelType const bg_color,
+	TaskStatus const& status)
 {
 	int const src_width = src_size.width();
 	int const src_height = src_size.height();
@@ -67,6 +69,8 @@ void dewarpGeneric(
 	float const model_y_scale = 1.0 / (model_domain.bottom() - model_domain.top());
 
 	for (int dst_x = 0; dst_x < dst_width; ++dst_x) {
+		status.throwIfCancelled();
+		
 		double const model_x = (dst_x - model_domain_left) * model_x_scale;
 		CylindricalSurfaceDewarper::Generatrix const generatrix(
 			distortion_model.mapGeneratrix(model_x, state)
@@ -98,7 +102,8 @@ void dewarpGeneric(
 	int const src_stride, PixelType* const dst_data,
 	QSize const dst_size, int const dst_stride,
 	CylindricalSurfaceDewarper const& distortion_model,
-	QRectF const& model_domain, PixelType const bg_color)
+	QRectF const& model_domain, PixelType const bg_color,
+	TaskStatus const& status)
 {
 	int const src_width = src_size.width();
 	int const src_height = src_size.height();
@@ -114,6 +119,8 @@ void dewarpGeneric(
 	float const model_y_scale = 1.0 / (model_domain.bottom() - model_domain.top());
 
 	for (int dst_x = 0; dst_x < dst_width; ++dst_x) {
+		status.throwIfCancelled();
+		
 		double const model_x = (dst_x - model_domain_left) * model_x_scale;
 		CylindricalSurfaceDewarper::Generatrix const generatrix(
 			distortion_model.mapGeneratrix(model_x, state)
@@ -426,7 +433,8 @@ void dewarpGeneric(
 	int const src_stride, PixelType* const dst_data,
 	QSize const dst_size, int const dst_stride,
 	CylindricalSurfaceDewarper const& distortion_model,
-	QRectF const& model_domain, PixelType const bg_color)
+	QRectF const& model_domain, PixelType const bg_color,
+	TaskStatus const& status)
 {
 	int const src_width = src_size.width();
 	int const src_height = src_size.height();
@@ -445,6 +453,8 @@ void dewarpGeneric(
 	std::vector<Vec2f> next_grid_column(dst_height + 1);
 
 	for (int dst_x = 0; dst_x <= dst_width; ++dst_x) {
+		status.throwIfCancelled();
+		
 		double const model_x = (dst_x - model_domain_left) * model_x_scale;
 		CylindricalSurfaceDewarper::Generatrix const generatrix(
 			distortion_model.mapGeneratrix(model_x, state)
@@ -481,7 +491,8 @@ typedef unsigned MixingWeight;
 QImage dewarpGrayscale(
 	QImage const& src, QSize const& dst_size,
 	CylindricalSurfaceDewarper const& distortion_model,
-	QRectF const& model_domain, QColor const& bg_color)
+	QRectF const& model_domain, QColor const& bg_color,
+	TaskStatus const& status)
 {
 	GrayImage dst(dst_size);
 	uint8_t const bg_sample = qGray(bg_color.rgb());
@@ -489,7 +500,7 @@ QImage dewarpGrayscale(
 	dewarpGeneric<GrayColorMixer<MixingWeight>, uint8_t>(
 		src.bits(), src.size(), src.bytesPerLine(),
 		dst.data(), dst_size, dst.stride(),
-		distortion_model, model_domain, bg_sample
+		distortion_model, model_domain, bg_sample, status
 	);
 	return dst.toQImage();
 }
@@ -497,14 +508,15 @@ QImage dewarpGrayscale(
 QImage dewarpRgb(
 	QImage const& src, QSize const& dst_size,
 	CylindricalSurfaceDewarper const& distortion_model,
-	QRectF const& model_domain, QColor const& bg_color)
+	QRectF const& model_domain, QColor const& bg_color,
+	TaskStatus const& status)
 {
 	QImage dst(dst_size, QImage::Format_RGB32);
 	dst.fill(bg_color.rgb());
 	dewarpGeneric<RgbColorMixer<MixingWeight>, uint32_t>(
 		(uint32_t const*)src.bits(), src.size(), src.bytesPerLine()/4,
 		(uint32_t*)dst.bits(), dst_size, dst.bytesPerLine()/4,
-		distortion_model, model_domain, bg_color.rgb()
+		distortion_model, model_domain, bg_color.rgb(), status
 	);
 	return dst;
 }
@@ -512,14 +524,15 @@ QImage dewarpRgb(
 QImage dewarpArgb(
 	QImage const& src, QSize const& dst_size,
 	CylindricalSurfaceDewarper const& distortion_model,
-	QRectF const& model_domain, QColor const& bg_color)
+	QRectF const& model_domain, QColor const& bg_color,
+	TaskStatus const& status)
 {
 	QImage dst(dst_size, QImage::Format_ARGB32);
 	dst.fill(bg_color.rgba());
 	dewarpGeneric<ArgbColorMixer<MixingWeight>, uint32_t>(
 		(uint32_t const*)src.bits(), src.size(), src.bytesPerLine()/4,
 		(uint32_t*)dst.bits(), dst_size, dst.bytesPerLine()/4,
-		distortion_model, model_domain, bg_color.rgba()
+		distortion_model, model_domain, bg_color.rgba(), status
 	);
 	return dst;
 }
@@ -530,7 +543,8 @@ QImage
 RasterDewarper::dewarp(
 	QImage const& src, QSize const& dst_size,
 	CylindricalSurfaceDewarper const& distortion_model,
-	QRectF const& model_domain, QColor const& bg_color)
+	QRectF const& model_domain, QColor const& bg_color,
+	TaskStatus const& status)
 {
 	if (model_domain.isEmpty()) {
 		throw std::invalid_argument("RasterDewarper: model_domain is empty.");
@@ -540,17 +554,17 @@ RasterDewarper::dewarp(
 		case QImage::Format_Invalid:
 			return QImage();
 		case QImage::Format_RGB32:
-			return dewarpRgb(src, dst_size, distortion_model, model_domain, bg_color);
+			return dewarpRgb(src, dst_size, distortion_model, model_domain, bg_color, status);
 		case QImage::Format_ARGB32:
-			return dewarpArgb(src, dst_size, distortion_model, model_domain, bg_color);
+			return dewarpArgb(src, dst_size, distortion_model, model_domain, bg_color, status);
 		case QImage::Format_Indexed8:
 			if (src.isGrayscale()) {
-				return dewarpGrayscale(src, dst_size, distortion_model, model_domain, bg_color);
+				return dewarpGrayscale(src, dst_size, distortion_model, model_domain, bg_color, status);
 			} else if (src.allGray()) {
 				// Only shades of gray but non-standard palette.
 				return dewarpGrayscale(
 					GrayImage(src).toQImage(), dst_size, distortion_model,
-					model_domain, bg_color
+					model_domain, bg_color, status
 				);
 			}
 			break;
@@ -559,7 +573,7 @@ RasterDewarper::dewarp(
 			if (src.allGray()) {
 				return dewarpGrayscale(
 					GrayImage(src).toQImage(),
-					dst_size, distortion_model, model_domain, bg_color
+					dst_size, distortion_model, model_domain, bg_color, status
 				);
 			}
 			break;
@@ -570,12 +584,12 @@ RasterDewarper::dewarp(
 	if (src.hasAlphaChannel()) {
 		return dewarpArgb(
 			src.convertToFormat(QImage::Format_ARGB32),
-			dst_size, distortion_model, model_domain, bg_color
+			dst_size, distortion_model, model_domain, bg_color, status
 		);
 	} else {
 		return dewarpRgb(
 			src.convertToFormat(QImage::Format_RGB32),
-			dst_size, distortion_model, model_domain, bg_color
+			dst_size, distortion_model, model_domain, bg_color, status
 		);
 	}
 }
@@ -23,6 +23,7 @@ class QImage;
 class QSize;
 class QRectF;
 class QColor;
+class TaskStatus;
 
 namespace dewarping
 {
@@ -35,7 +36,8 @@ public:
 	static QImage dewarp(
 		QImage const& src, QSize const& dst_size,
 		CylindricalSurfaceDewarper const& distortion_model,
-		QRectF const& model_domain, QColor const& background_color
+		QRectF const& model_domain, QColor const& background_color,
+		TaskStatus const& status
 	);
 };
 
@@ -25,9 +25,12 @@
 #include "IntrusivePtr.h"
 #include "FilterResult.h"
 #include "SafeDeletingQObjectPtr.h"
+#include "XmlFragmentCache.h"
+#include "PageId.h"
 
-class PageId;
 class QString;
+class QXmlStreamReader;
+class QXmlStreamWriter;
 class PageSelectionAccessor;
 
 namespace select_content
@@ -60,11 +63,16 @@ public:
 
 	virtual void preUpdateUI(FilterUiInterface* ui, PageId const& page_id);
 	
-	virtual QDomElement saveSettings(
-		ProjectWriter const& writer, QDomDocument& doc) const;
+	virtual QString settingsElementName() const;
+
+	virtual void saveSettings(
+		ProjectWriter const& writer, QXmlStreamWriter& xml) const;
 	
 	virtual void loadSettings(
-		ProjectReader const& reader, QDomElement const& filters_el);
+		ProjectReader const& reader, QXmlStreamReader& xml);
+
+	virtual bool loadDeferredSettings(
+		ProjectReader const& reader, ProjectIndexSection const& section);
 	
 	IntrusivePtr<Task> createTask(
 		PageId const& page_id,
@@ -78,10 +86,11 @@ public:
 	Settings* getSettings() { return m_ptrSettings.get(); };
 private:
 	void writePageSettings(
-		QDomDocument& doc, QDomElement& filter_el,
+		ProjectWriter const& writer, QXmlStreamWriter& xml,
 		PageId const& page_id, int numeric_id) const;
 	
 	IntrusivePtr<Settings> m_ptrSettings;
+	mutable XmlFragmentCache<PageId> m_fragmentCache;
 	SafeDeletingQObjectPtr<OptionsWidget> m_ptrOptionsWidget;
 };
 
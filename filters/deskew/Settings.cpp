@@ -21,6 +21,8 @@
 #include "RelinkablePath.h"
 #include "AbstractRelinker.h"
 #include <QMutexLocker>
+#include <QDomDocument>
+#include <QDomElement>
 #ifndef Q_MOC_RUN
 #include <boost/foreach.hpp>
 #endif
@@ -41,12 +43,16 @@ Settings::clear()
 {
 	QMutexLocker locker(&m_mutex);
 	m_perPageParams.clear();
+	m_deferredParams.clear();
+	m_revisions.touchAll();
 }
 
 void
 Settings::performRelinking(AbstractRelinker const& relinker)
 {
 	QMutexLocker locker(&m_mutex);
+	loadAllDeferredLocked();
+
 	PerPageParams new_params;
 
 	BOOST_FOREACH(PerPageParams::value_type const& kv, m_perPageParams) {
@@ -57,26 +63,32 @@ Settings::performRelinking(AbstractRelinker const& relinker)
 	}
 
 	m_perPageParams.swap(new_params);
+	m_revisions.touchAll();
 }
 
 void
 Settings::setPageParams(PageId const& page_id, Params const& params)
 {
 	QMutexLocker locker(&m_mutex);
+	loadDeferredLocked(page_id);
 	Utils::mapSetValue(m_perPageParams, page_id, params);
+	m_revisions.touch(page_id);
 }
 
 void
 Settings::clearPageParams(PageId const& page_id)
 {
 	QMutexLocker locker(&m_mutex);
+	loadDeferredLocked(page_id);
 	m_perPageParams.erase(page_id);
+	m_revisions.touch(page_id);
 }
 
 std::auto_ptr<Params>
 Settings::getPageParams(PageId const& page_id) const
 {
 	QMutexLocker locker(&m_mutex);
+	loadDeferredLocked(page_id);
 	
 	PerPageParams::const_iterator it(m_perPageParams.find(page_id));
 	if (it != m_perPageParams.end()) {
@@ -86,12 +98,48 @@ Settings::getPageParams(PageId const& page_id) const
 	}
 }
 
+RevisionMap<PageId>::Revision
+Settings::pageRevision(PageId const& page_id) const
+{
+	QMutexLocker locker(&m_mutex);
+	return m_revisions.revision(page_id);
+}
+
+void
+Settings::setDeferredPageParams(
+	PageId const& page_id, ProjectIndexFragment const& fragment)
+{
+	QMutexLocker locker(&m_mutex);
+	m_deferredParams.add(page_id, fragment);
+}
+
+void
+Settings::loadDeferredLocked(PageId const& page_id) const
+{
+	QDomDocument doc;
+	QDomElement const page_el(m_deferredParams.take(page_id, doc));
+	QDomElement const params_el(page_el.namedItem("params").toElement());
+	if (!params_el.isNull()) {
+		Utils::mapSetValue(m_perPageParams, page_id, Params(params_el));
+	}
+}
+
+void
+Settings::loadAllDeferredLocked()
+{
+	BOOST_FOREACH(PageId const& page_id, m_deferredParams.keys()) {
+		loadDeferredLocked(page_id);
+	}
+}
+
 void
 Settings::setDegress(std::set<PageId> const& pages, Params const& params)
 {
 	QMutexLocker const locker(&m_mutex);
 	BOOST_FOREACH(PageId const& page, pages) {
+		loadDeferredLocked(page);
 		Utils::mapSetValue(m_perPageParams, page, params);
+		m_revisions.touch(page);
 	}
 }
 
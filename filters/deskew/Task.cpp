@@ -28,12 +28,12 @@
 #include "FilterUiInterface.h"
 #include "ImageView.h"
 #include "FilterData.h"
+#include "Profiler.h"
 #include "Dpi.h"
 #include "Dpm.h"
 #include "ImageTransformation.h"
 #include "imageproc/BinaryImage.h"
 #include "imageproc/BWColor.h"
-#include "imageproc/OrthogonalRotation.h"
 #include "imageproc/SkewFinder.h"
 #include "imageproc/RasterOp.h"
 #include "imageproc/ReduceThreshold.h"
@@ -72,6 +72,8 @@ public:
 	
 	virtual void updateUI(FilterUiInterface* ui);
 	
+	virtual void updateThumbnails(FilterUiInterface* ui);
+	
 	virtual IntrusivePtr<AbstractFilter> filter() { return m_ptrFilter; }
 private:
 	IntrusivePtr<Filter> m_ptrFilter;
@@ -107,6 +109,8 @@ Task::~Task()
 FilterResultPtr
 Task::process(TaskStatus const& status, FilterData const& data)
 {
+	ProfileSpan const span("deskew::Task::process");
+
 	status.throwIfCancelled();
 
 	Dependencies const deps(data.xform().preCropArea(), data.xform().preRotation());
@@ -146,12 +150,8 @@ Task::process(TaskStatus const& status, FilterData const& data)
 		
 		if (bounded_image_area.isValid()) {
 			BinaryImage rotated_image(
-				orthogonalRotation(
-					BinaryImage(
-						data.grayImage(), bounded_image_area,
-						data.bwThreshold()
-					),
-					data.xform().preRotation().toDegrees()
+				data.derivedImages().rotatedBinary(
+					bounded_image_area, data.xform().preRotation()
 				)
 			);
 			if (m_ptrDbg.get()) {
@@ -191,6 +191,10 @@ Task::process(TaskStatus const& status, FilterData const& data)
 		}
 	}
 	
+	// Stages past this one don't use derived images.  In particular,
+	// select_content binarizes the deskewed image on its own.
+	data.releaseDerivedImages();
+	
 	ImageTransformation new_xform(data.xform());
 	new_xform.setPostRotation(ui_data.effectiveDeskewAngle());
 	
@@ -240,7 +244,7 @@ Task::cleanup(TaskStatus const& status, BinaryImage& image, Dpi const& dpi)
 	
 	status.throwIfCancelled();
 	
-	BinaryImage garbage(seedFill(seed, image, CONN8));
+	BinaryImage garbage(seedFill(seed, image, CONN8, &status));
 	seed.release();
 	
 	status.throwIfCancelled();
@@ -287,6 +291,12 @@ Task::UiUpdater::UiUpdater(
 {
 }
 
+void
+Task::UiUpdater::updateThumbnails(FilterUiInterface* ui)
+{
+	ui->invalidateThumbnail(m_pageId);
+}
+
 void
 Task::UiUpdater::updateUI(FilterUiInterface* ui)
 {
@@ -296,7 +306,7 @@ Task::UiUpdater::updateUI(FilterUiInterface* ui)
 	opt_widget->postUpdateUI(m_uiData);
 	ui->setOptionsWidget(opt_widget, ui->KEEP_OWNERSHIP);
 	
-	ui->invalidateThumbnail(m_pageId);
+	updateThumbnails(ui);
 	
 	if (m_batchProcessing) {
 		return;
@@ -29,6 +29,7 @@
 #include "ProjectWriter.h"
 #include "XmlMarshaller.h"
 #include "XmlUnmarshaller.h"
+#include "XmlStreamUtils.h"
 #ifndef Q_MOC_RUN
 #include <boost/lambda/lambda.hpp>
 #include <boost/lambda/bind.hpp>
@@ -39,6 +40,9 @@
 #include <QDomDocument>
 #include <QDomElement>
 #include <QDomNode>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+#include <QLatin1String>
 #include <iostream>
 #include "CommandLine.h"
 
@@ -92,40 +96,41 @@ Filter::preUpdateUI(FilterUiInterface* ui, PageId const& page_id)
 	}
 }
 
-QDomElement
+QString
+Filter::settingsElementName() const
+{
+	return "fix-orientation";
+}
+
+void
 Filter::saveSettings(
-	ProjectWriter const& writer, QDomDocument& doc) const
+	ProjectWriter const& writer, QXmlStreamWriter& xml) const
 {
 	using namespace boost::lambda;
 	
-	QDomElement filter_el(doc.createElement("fix-orientation"));
+	writer.writeSettingsStart(xml, settingsElementName());
 	writer.enumImages(
 		boost::lambda::bind(
-			&Filter::writeImageSettings,
-			this, boost::ref(doc), var(filter_el), boost::lambda::_1, boost::lambda::_2
+			&Filter::writeImageSettings, this, boost::cref(writer),
+			boost::ref(xml), boost::lambda::_1, boost::lambda::_2
 		)
 	);
-	
-	return filter_el;
+	xml.writeEndElement();
 }
 
 void
-Filter::loadSettings(ProjectReader const& reader, QDomElement const& filters_el)
+Filter::loadSettings(ProjectReader const& reader, QXmlStreamReader& xml)
 {
 	m_ptrSettings->clear();
 	
-	QDomElement filter_el(filters_el.namedItem("fix-orientation").toElement());
-	
-	QString const image_tag_name("image");
-	QDomNode node(filter_el.firstChild());
-	for (; !node.isNull(); node = node.nextSibling()) {
-		if (!node.isElement()) {
+	while (xml.readNextStartElement()) {
+		if (xml.name() != QLatin1String("image")) {
+			xml.skipCurrentElement();
 			continue;
 		}
-		if (node.nodeName() != image_tag_name) {
-			continue;
-		}
-		QDomElement el(node.toElement());
+
+		QDomDocument doc;
+		QDomElement const el(XmlStreamUtils::readElement(xml, doc));
 		
 		bool ok = true;
 		int const id = el.attribute("id").toInt(&ok);
@@ -173,20 +178,30 @@ Filter::createCacheDrivenTask(
 
 void
 Filter::writeImageSettings(
-	QDomDocument& doc, QDomElement& filter_el,
+	ProjectWriter const& writer, QXmlStreamWriter& xml,
 	ImageId const& image_id, int const numeric_id) const
 {
-	OrthogonalRotation const rotation(m_ptrSettings->getRotationFor(image_id));
-	if (rotation.toDegrees() == 0) {
+	// Take the revision before the settings, so that a concurrent
+	// modification can only make the cached version look outdated.
+	RevisionMap<ImageId>::Revision const revision(
+		m_ptrSettings->imageRevision(image_id)
+	);
+	if (m_fragmentCache.writeCached(writer, xml, image_id, numeric_id, revision)) {
 		return;
 	}
-	
-	XmlMarshaller marshaller(doc);
-	
-	QDomElement image_el(doc.createElement("image"));
-	image_el.setAttribute("id", numeric_id);
-	image_el.appendChild(marshaller.rotation(rotation, "rotation"));
-	filter_el.appendChild(image_el);
+
+	QDomDocument doc;
+	QDomElement image_el;
+
+	OrthogonalRotation const rotation(m_ptrSettings->getRotationFor(image_id));
+	if (rotation.toDegrees() != 0) {
+		XmlMarshaller marshaller(doc);
+		image_el = doc.createElement("image");
+		image_el.setAttribute("id", numeric_id);
+		image_el.appendChild(marshaller.rotation(rotation, "rotation"));
+	}
+
+	m_fragmentCache.writeAndCache(writer, xml, image_id, numeric_id, revision, image_el);
 }
 
 } // namespace fix_orientation
@@ -25,13 +25,14 @@
 #include "FilterResult.h"
 #include "IntrusivePtr.h"
 #include "SafeDeletingQObjectPtr.h"
+#include "XmlFragmentCache.h"
+#include "ImageId.h"
 
 class PageId;
-class ImageId;
 class PageSelectionAccessor;
 class QString;
-class QDomDocument;
-class QDomElement;
+class QXmlStreamReader;
+class QXmlStreamWriter;
 
 namespace page_split
 {
@@ -67,11 +68,13 @@ public:
 
 	virtual void preUpdateUI(FilterUiInterface* ui, PageId const&);
 	
-	virtual QDomElement saveSettings(
-		ProjectWriter const& writer, QDomDocument& doc) const;
+	virtual QString settingsElementName() const;
+
+	virtual void saveSettings(
+		ProjectWriter const& writer, QXmlStreamWriter& xml) const;
 	
 	virtual void loadSettings(
-		ProjectReader const& reader, QDomElement const& filters_el);
+		ProjectReader const& reader, QXmlStreamReader& xml);
 	
 	IntrusivePtr<Task> createTask(
 		PageId const& page_id,
@@ -86,10 +89,11 @@ public:
 	Settings* getSettings() { return m_ptrSettings.get(); };
 private:
 	void writeImageSettings(
-		QDomDocument& doc, QDomElement& filter_el,
+		ProjectWriter const& writer, QXmlStreamWriter& xml,
 		ImageId const& image_id, int numeric_id) const;
 	
 	IntrusivePtr<Settings> m_ptrSettings;
+	mutable XmlFragmentCache<ImageId> m_fragmentCache;
 	SafeDeletingQObjectPtr<OptionsWidget> m_ptrOptionsWidget;
 };
 
@@ -40,6 +40,7 @@ Settings::clear()
 {
 	QMutexLocker locker(&m_mutex);
 	m_perImageRotation.clear();
+	m_revisions.touchAll();
 }
 
 void
@@ -56,6 +57,7 @@ Settings::performRelinking(AbstractRelinker const& relinker)
 	}
 
 	m_perImageRotation.swap(new_rotations);
+	m_revisions.touchAll();
 }
 
 void
@@ -90,11 +92,19 @@ Settings::getRotationFor(ImageId const& image_id) const
 	}
 }
 
+RevisionMap<ImageId>::Revision
+Settings::imageRevision(ImageId const& image_id) const
+{
+	QMutexLocker locker(&m_mutex);
+	return m_revisions.revision(image_id);
+}
+
 void
 Settings::setImageRotationLocked(
 	ImageId const& image_id, OrthogonalRotation const& rotation)
 {
 	Utils::mapSetValue(m_perImageRotation, image_id, rotation);
+	m_revisions.touch(image_id);
 }
 
 } // namespace fix_orientation
@@ -24,6 +24,7 @@
 #include "OrthogonalRotation.h"
 #include "ImageId.h"
 #include "PageId.h"
+#include "RevisionMap.h"
 #include <QMutex>
 #include <map>
 #include <set>
@@ -50,6 +51,12 @@ public:
 	void applyRotation(std::set<PageId> const& pages, OrthogonalRotation rotation);
 	
 	OrthogonalRotation getRotationFor(ImageId const& image_id) const;
+
+	/**
+	 * \brief Returns a number that changes whenever the settings
+	 *        for the given image change.
+	 */
+	RevisionMap<ImageId>::Revision imageRevision(ImageId const& image_id) const;
 private:
 	typedef std::map<ImageId, OrthogonalRotation> PerImageRotation;
 	
@@ -58,6 +65,7 @@ private:
 	
 	mutable QMutex m_mutex;
 	PerImageRotation m_perImageRotation;
+	RevisionMap<ImageId> m_revisions;
 };
 
 } // namespace fix_orientation
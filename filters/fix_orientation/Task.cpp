@@ -21,6 +21,7 @@
 #include "OptionsWidget.h"
 #include "Settings.h"
 #include "FilterData.h"
+#include "Profiler.h"
 #include "ImageTransformation.h"
 #include "filters/page_split/Task.h"
 #include "TaskStatus.h"
@@ -44,6 +45,8 @@ public:
 	
 	virtual void updateUI(FilterUiInterface* wnd);
 	
+	virtual void updateThumbnails(FilterUiInterface* ui);
+	
 	virtual IntrusivePtr<AbstractFilter> filter() { return m_ptrFilter; }
 private:
 	IntrusivePtr<Filter> m_ptrFilter;
@@ -78,6 +81,8 @@ Task::process(TaskStatus const& status, FilterData const& data)
 {
 	// This function is executed from the worker thread.
 	
+	ProfileSpan const span("fix_orientation::Task::process");
+
 	status.throwIfCancelled();
 	
 	ImageTransformation xform(data.xform());
@@ -112,6 +117,12 @@ Task::UiUpdater::UiUpdater(
 {
 }
 
+void
+Task::UiUpdater::updateThumbnails(FilterUiInterface* ui)
+{
+	ui->invalidateThumbnail(PageId(m_imageId));
+}
+
 void
 Task::UiUpdater::updateUI(FilterUiInterface* ui)
 {
@@ -120,7 +131,7 @@ Task::UiUpdater::updateUI(FilterUiInterface* ui)
 	opt_widget->postUpdateUI(m_xform.preRotation());
 	ui->setOptionsWidget(opt_widget, ui->KEEP_OWNERSHIP);
 	
-	ui->invalidateThumbnail(PageId(m_imageId));
+	updateThumbnails(ui);
 	
 	if (m_batchProcessing) {
 		return;
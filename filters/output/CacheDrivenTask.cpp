@@ -21,6 +21,8 @@
 #include "PictureZoneComparator.h"
 #include "FillZoneComparator.h"
 #include "Settings.h"
+#include "OutputWriter.h"
+#include "OutputParams.h"
 #include "Params.h"
 #include "Thumbnail.h"
 #include "IncompleteThumbnail.h"
@@ -43,8 +45,10 @@ namespace output
 
 CacheDrivenTask::CacheDrivenTask(
 	IntrusivePtr<Settings> const& settings,
+	IntrusivePtr<OutputWriter> const& writer,
 	OutputFileNameGenerator const& out_file_name_gen)
 :	m_ptrSettings(settings),
+	m_ptrWriter(writer),
 	m_outFileNameGen(out_file_name_gen)
 {
 }
@@ -70,9 +74,16 @@ CacheDrivenTask::process(
 
 		do { // Just to be able to break from it.
 
+			// The writer has to be asked first, as it commits to m_ptrSettings
+			// once a page is written.  Files of a page being written are not
+			// complete yet, but the thumbnail is already in the cache.
 			std::auto_ptr<OutputParams> stored_output_params(
-				m_ptrSettings->getOutputParams(page_info.id())
+				m_ptrWriter->pendingOutputParams(page_info.id())
 			);
+			bool const write_pending = stored_output_params.get() != 0;
+			if (!write_pending) {
+				stored_output_params = m_ptrSettings->getOutputParams(page_info.id());
+			}
 
 			if (!stored_output_params.get()) {
 				need_reprocess = true;
@@ -107,6 +118,10 @@ CacheDrivenTask::process(
 				break;
 			}
 			
+			if (write_pending) {
+				break;
+			}
+			
 			QFileInfo const out_file_info(out_file_path);
 
 			if (!out_file_info.exists()) {
@@ -33,6 +33,7 @@ namespace output
 {
 
 class Settings;
+class OutputWriter;
 
 class CacheDrivenTask : public RefCountable
 {
@@ -40,6 +41,7 @@ class CacheDrivenTask : public RefCountable
 public:
 	CacheDrivenTask(
 		IntrusivePtr<Settings> const& settings,
+		IntrusivePtr<OutputWriter> const& writer,
 		OutputFileNameGenerator const& out_file_name_gen);
 	
 	virtual ~CacheDrivenTask();
@@ -49,6 +51,7 @@ public:
 		ImageTransformation const& xform, QPolygonF const& content_rect_phys);
 private:
 	IntrusivePtr<Settings> m_ptrSettings;
+	IntrusivePtr<OutputWriter> m_ptrWriter;
 	OutputFileNameGenerator m_outFileNameGen;
 };
 
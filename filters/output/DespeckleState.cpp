@@ -21,7 +21,10 @@
 #include "Despeckle.h"
 #include "TaskStatus.h"
 #include "DebugImages.h"
+#include "ImageLoader.h"
 #include "imageproc/RasterOp.h"
+#include <QFile>
+#include <QMutexLocker>
 #include <new>
 #include <stdint.h>
 
@@ -42,9 +45,52 @@ DespeckleState::DespeckleState(
 	m_everythingBW = extractBW(m_everythingMixed);
 }
 
+DespeckleState::DespeckleState(
+	QImage const& output, QString const& speckles_file_path,
+	IntrusivePtr<OutputWriter> const& writer, PageId const& page_id,
+	DespeckleLevel level, Dpi const& dpi)
+:	m_everythingMixed(output),
+	m_ptrDeferredSpeckles(
+		new DeferredSpeckles(speckles_file_path, writer, page_id)
+	),
+	m_dpi(dpi),
+	m_despeckleLevel(level)
+{
+}
+
+DespeckleState
+DespeckleState::resolved() const
+{
+	DespeckleState state(*this);
+	m_ptrDeferredSpeckles->resolve(state);
+	return state;
+}
+
+BinaryImage
+DespeckleState::loadSpeckles(QString const& file_path, QSize const& size)
+{
+	QFile file(file_path);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return BinaryImage();
+	}
+	
+	QImage const image(ImageLoader::load(file, 0));
+	if (image.isNull() || image.size() != size) {
+		// The file may have been replaced by one belonging to
+		// a newer output image.
+		return BinaryImage();
+	}
+	
+	return BinaryImage(image);
+}
+
 DespeckleVisualization
 DespeckleState::visualize() const
 {
+	if (m_ptrDeferredSpeckles.get()) {
+		return resolved().visualize();
+	}
+	
 	return DespeckleVisualization(m_everythingMixed, m_speckles, m_dpi);
 }
 
@@ -53,6 +99,10 @@ DespeckleState::redespeckle(
 	DespeckleLevel const level,
 	TaskStatus const& status, DebugImages* dbg) const
 {
+	if (m_ptrDeferredSpeckles.get()) {
+		return resolved().redespeckle(level, status, dbg);
+	}
+	
 	DespeckleState new_state(*this);
 
 	if (level == m_despeckleLevel) {
@@ -158,4 +208,44 @@ DespeckleState::extractBW(QImage const& mixed)
 	return result;
 }
 
+
+/*==================== DespeckleState::DeferredSpeckles ===================*/
+
+DespeckleState::DeferredSpeckles::DeferredSpeckles(
+	QString const& file_path,
+	IntrusivePtr<OutputWriter> const& writer, PageId const& page_id)
+:	m_filePath(file_path),
+	m_ptrWriter(writer),
+	m_pageId(page_id),
+	m_resolved(false)
+{
+}
+
+void
+DespeckleState::DeferredSpeckles::resolve(DespeckleState& state)
+{
+	QMutexLocker const locker(&m_mutex);
+	
+	if (!m_resolved) {
+		m_ptrWriter->waitForPage(m_pageId);
+		
+		BinaryImage const speckles(
+			loadSpeckles(m_filePath, state.m_everythingMixed.size())
+		);
+		m_everythingMixed = overlaySpeckles(state.m_everythingMixed, speckles);
+		m_everythingBW = extractBW(m_everythingMixed);
+		m_speckles = speckles;
+		m_resolved = true;
+		
+		// We no longer need it, and it's shared by everyone
+		// holding a copy of this state.
+		m_ptrWriter.reset();
+	}
+	
+	state.m_everythingMixed = m_everythingMixed;
+	state.m_everythingBW = m_everythingBW;
+	state.m_speckles = m_speckles;
+	state.m_ptrDeferredSpeckles.reset();
+}
+
 } // namespace output
@@ -22,8 +22,15 @@
 
 #include "DespeckleLevel.h"
 #include "Dpi.h"
+#include "PageId.h"
+#include "OutputWriter.h"
+#include "NonCopyable.h"
+#include "RefCountable.h"
+#include "IntrusivePtr.h"
 #include "imageproc/BinaryImage.h"
 #include <QImage>
+#include <QString>
+#include <QMutex>
 
 class TaskStatus;
 class DebugImages;
@@ -45,6 +52,24 @@ public:
 		imageproc::BinaryImage const& speckles,
 		DespeckleLevel level, Dpi const& dpi);
 
+	/**
+	 * \brief Constructs a state that reads the speckles file and does
+	 *        the rest of the preparations only when it's first used.
+	 *
+	 * That's cheap enough to be done for every page being viewed,
+	 * while the full preparation only takes place if the despeckling
+	 * tab is shown.  The file is read at most once, by whichever copy
+	 * of this state needs it first, and only after \p writer has no
+	 * pending jobs for \p page_id, so a file that's still being written
+	 * is never read.  A missing or unreadable speckles file, or one not
+	 * matching the output image in size, is equivalent to having
+	 * no speckles.
+	 */
+	DespeckleState(QImage const& output,
+		QString const& speckles_file_path,
+		IntrusivePtr<OutputWriter> const& writer, PageId const& page_id,
+		DespeckleLevel level, Dpi const& dpi);
+
 	DespeckleLevel level() const { return m_despeckleLevel; }
 
 	DespeckleVisualization visualize() const;
@@ -52,6 +77,40 @@ public:
 	DespeckleState redespeckle(DespeckleLevel level,
 		TaskStatus const& status, DebugImages* dbg = 0) const;
 private:
+	/**
+	 * \brief The lazily built part of a deferred DespeckleState.
+	 *
+	 * Shared by all copies of such a state, including the ones
+	 * handed over to background threads.
+	 */
+	class DeferredSpeckles : public RefCountable
+	{
+		DECLARE_NON_COPYABLE(DeferredSpeckles)
+	public:
+		DeferredSpeckles(QString const& file_path,
+			IntrusivePtr<OutputWriter> const& writer, PageId const& page_id);
+		
+		/**
+		 * Builds \p state from the output image it holds and the
+		 * speckles file.  Only the first call does the actual work.
+		 */
+		void resolve(DespeckleState& state);
+	private:
+		QMutex m_mutex;
+		QString m_filePath;
+		IntrusivePtr<OutputWriter> m_ptrWriter;
+		PageId m_pageId;
+		QImage m_everythingMixed;
+		imageproc::BinaryImage m_everythingBW;
+		imageproc::BinaryImage m_speckles;
+		bool m_resolved;
+	};
+	
+	DespeckleState resolved() const;
+
+	static imageproc::BinaryImage loadSpeckles(
+		QString const& file_path, QSize const& size);
+
 	static QImage overlaySpeckles(
 		QImage const& mixed, imageproc::BinaryImage const& speckles);
 	
@@ -76,6 +135,13 @@ private:
 	 */
 	imageproc::BinaryImage m_speckles;
 
+	/**
+	 * If not null, speckles are yet to be read from a file, in which
+	 * case m_everythingMixed holds the output image as is, while
+	 * m_everythingBW and m_speckles are not built yet.
+	 */
+	IntrusivePtr<DeferredSpeckles> m_ptrDeferredSpeckles;
+
 	/**
 	 * The DPI of all 3 above images.
 	 */
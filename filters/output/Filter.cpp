@@ -24,8 +24,11 @@
 #include "Settings.h"
 #include "Params.h"
 #include "OutputParams.h"
+#include "OutputWriter.h"
 #include "ProjectReader.h"
 #include "ProjectWriter.h"
+#include "ProjectIndex.h"
+#include "XmlStreamUtils.h"
 #include "CacheDrivenTask.h"
 #include <boost/lambda/lambda.hpp>
 #include <boost/lambda/bind.hpp>
@@ -34,6 +37,9 @@
 #include <QCoreApplication>
 #include <QDomDocument>
 #include <QDomElement>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+#include <QLatin1String>
 #include <memory>
 
 #include "CommandLine.h"
@@ -44,11 +50,12 @@ namespace output
 
 Filter::Filter(
 	PageSelectionAccessor const& page_selection_accessor)
-:	m_ptrSettings(new Settings)
+:	m_ptrSettings(new Settings),
+	m_ptrWriter(new OutputWriter(m_ptrSettings))
 {
 	if (CommandLine::get().isGui()) {
 		m_ptrOptionsWidget.reset(
-			new OptionsWidget(m_ptrSettings, page_selection_accessor)
+			new OptionsWidget(m_ptrSettings, m_ptrWriter, page_selection_accessor)
 		);
 	}
 }
@@ -82,31 +89,43 @@ Filter::preUpdateUI(FilterUiInterface* ui, PageId const& page_id)
 	ui->setOptionsWidget(m_ptrOptionsWidget.get(), ui->KEEP_OWNERSHIP);
 }
 
-QDomElement
+QString
+Filter::settingsElementName() const
+{
+	return "output";
+}
+
+void
 Filter::saveSettings(
-	ProjectWriter const& writer, QDomDocument& doc) const
+	ProjectWriter const& writer, QXmlStreamWriter& xml) const
 {
-	
 	using namespace boost::lambda;
 	
-	QDomElement filter_el(doc.createElement("output"));
+	writer.writeSettingsStart(xml, settingsElementName());
 	writer.enumPages(
 		boost::lambda::bind(
-			&Filter::writePageSettings,
-			this, boost::ref(doc), var(filter_el), boost::lambda::_1, boost::lambda::_2
+			&Filter::writePageSettings, this, boost::cref(writer),
+			boost::ref(xml), boost::lambda::_1, boost::lambda::_2
 		)
 	);
-	
-	return filter_el;
+	xml.writeEndElement();
 }
 
 void
 Filter::writePageSettings(
-	QDomDocument& doc, QDomElement& filter_el,
-	PageId const& page_id, int numeric_id) const
+	ProjectWriter const& writer, QXmlStreamWriter& xml,
+	PageId const& page_id, int const numeric_id) const
 {
+	RevisionMap<PageId>::Revision const revision(
+		m_ptrSettings->pageRevision(page_id)
+	);
+	if (m_fragmentCache.writeCached(writer, xml, page_id, numeric_id, revision)) {
+		return;
+	}
+
 	Params const params(m_ptrSettings->getParams(page_id));
 	
+	QDomDocument doc;
 	QDomElement page_el(doc.createElement("page"));
 	page_el.setAttribute("id", numeric_id);
 
@@ -114,33 +133,36 @@ Filter::writePageSettings(
 	page_el.appendChild(m_ptrSettings->fillZonesForPage(page_id).toXml(doc, "fill-zones"));
 	page_el.appendChild(params.toXml(doc, "params"));
 	
-	std::auto_ptr<OutputParams> output_params(m_ptrSettings->getOutputParams(page_id));
+	// Output params of a page still being written are not in m_ptrSettings
+	// yet.  We don't wait for them, but save what the pending job is going
+	// to commit.  Without the file params, which are not known yet, that
+	// makes the page get reprocessed, should the project be reopened
+	// before it's saved again.  Any change to the pending jobs of a page
+	// touches its revision, so the cached fragment stays valid.
+	std::auto_ptr<OutputParams> output_params(m_ptrWriter->pendingOutputParams(page_id));
+	if (!output_params.get()) {
+		output_params = m_ptrSettings->getOutputParams(page_id);
+	}
 	if (output_params.get()) {
 		page_el.appendChild(output_params->toXml(doc, "output-params"));
 	}
 	
-	filter_el.appendChild(page_el);
+	m_fragmentCache.writeAndCache(writer, xml, page_id, numeric_id, revision, page_el);
 }
 
 void
-Filter::loadSettings(ProjectReader const& reader, QDomElement const& filters_el)
+Filter::loadSettings(ProjectReader const& reader, QXmlStreamReader& xml)
 {
 	m_ptrSettings->clear();
 	
-	QDomElement const filter_el(
-		filters_el.namedItem("output").toElement()
-	);
-	
-	QString const page_tag_name("page");
-	QDomNode node(filter_el.firstChild());
-	for (; !node.isNull(); node = node.nextSibling()) {
-		if (!node.isElement()) {
-			continue;
-		}
-		if (node.nodeName() != page_tag_name) {
+	while (xml.readNextStartElement()) {
+		if (xml.name() != QLatin1String("page")) {
+			xml.skipCurrentElement();
 			continue;
 		}
-		QDomElement const el(node.toElement());
+
+		QDomDocument doc;
+		QDomElement const el(XmlStreamUtils::readElement(xml, doc));
 		
 		bool ok = true;
 		int const id = el.attribute("id").toInt(&ok);
@@ -177,6 +199,23 @@ Filter::loadSettings(ProjectReader const& reader, QDomElement const& filters_el)
 	}
 }
 
+bool
+Filter::loadDeferredSettings(
+	ProjectReader const& reader, ProjectIndexSection const& section)
+{
+	m_ptrSettings->clear();
+
+	size_t const num_entries = section.numEntries();
+	for (size_t i = 0; i < num_entries; ++i) {
+		PageId const page_id(reader.pageId(section.entryId(i)));
+		if (!page_id.isNull()) {
+			m_ptrSettings->setDeferredPage(page_id, section.entryFragment(i));
+		}
+	}
+
+	return true;
+}
+
 IntrusivePtr<Task>
 Filter::createTask(
 	PageId const& page_id,
@@ -189,7 +228,7 @@ Filter::createTask(
 		lastTab = m_ptrOptionsWidget->lastTab();
 	return IntrusivePtr<Task>(
 		new Task(
-			IntrusivePtr<Filter>(this), m_ptrSettings,
+			IntrusivePtr<Filter>(this), m_ptrSettings, m_ptrWriter,
 			thumbnail_cache, page_id, out_file_name_gen,
 			lastTab, batch, debug
 		)
@@ -200,8 +239,14 @@ IntrusivePtr<CacheDrivenTask>
 Filter::createCacheDrivenTask(OutputFileNameGenerator const& out_file_name_gen)
 {
 	return IntrusivePtr<CacheDrivenTask>(
-		new CacheDrivenTask(m_ptrSettings, out_file_name_gen)
+		new CacheDrivenTask(m_ptrSettings, m_ptrWriter, out_file_name_gen)
 	);
 }
 
+void
+Filter::waitForOutputFiles()
+{
+	m_ptrWriter->waitForIdle();
+}
+
 } // namespace output
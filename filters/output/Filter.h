@@ -27,12 +27,15 @@
 #include "SafeDeletingQObjectPtr.h"
 #include "PictureZonePropFactory.h"
 #include "FillZonePropFactory.h"
+#include "XmlFragmentCache.h"
+#include "PageId.h"
 
-class PageId;
 class PageSelectionAccessor;
 class ThumbnailPixmapCache;
 class OutputFileNameGenerator;
 class QString;
+class QXmlStreamReader;
+class QXmlStreamWriter;
 
 namespace output
 {
@@ -41,6 +44,7 @@ class OptionsWidget;
 class Task;
 class CacheDrivenTask;
 class Settings;
+class OutputWriter;
 
 class Filter : public AbstractFilter
 {
@@ -58,11 +62,16 @@ public:
 
 	virtual void preUpdateUI(FilterUiInterface* ui, PageId const& page_id);
 	
-	virtual QDomElement saveSettings(
-		ProjectWriter const& writer, QDomDocument& doc) const;
+	virtual QString settingsElementName() const;
+
+	virtual void saveSettings(
+		ProjectWriter const& writer, QXmlStreamWriter& xml) const;
 	
 	virtual void loadSettings(
-		ProjectReader const& reader, QDomElement const& filters_el);
+		ProjectReader const& reader, QXmlStreamReader& xml);
+
+	virtual bool loadDeferredSettings(
+		ProjectReader const& reader, ProjectIndexSection const& section);
 	
 	IntrusivePtr<Task> createTask(
 		PageId const& page_id,
@@ -73,14 +82,22 @@ public:
 	IntrusivePtr<CacheDrivenTask> createCacheDrivenTask(
 		OutputFileNameGenerator const& out_file_name_gen);
 	
+	/**
+	 * \brief Waits until the output files of all the tasks that
+	 *        have finished so far have been written.
+	 */
+	void waitForOutputFiles();
+	
 	OptionsWidget* optionsWidget() { return m_ptrOptionsWidget.get(); };
 	Settings* getSettings() { return m_ptrSettings.get(); };
 private:
 	void writePageSettings(
-		QDomDocument& doc, QDomElement& filter_el,
+		ProjectWriter const& writer, QXmlStreamWriter& xml,
 		PageId const& page_id, int numeric_id) const;
 	
 	IntrusivePtr<Settings> m_ptrSettings;
+	IntrusivePtr<OutputWriter> m_ptrWriter;
+	mutable XmlFragmentCache<PageId> m_fragmentCache;
 	SafeDeletingQObjectPtr<OptionsWidget> m_ptrOptionsWidget;
 	PictureZonePropFactory m_pictureZonePropFactory;
 	FillZonePropFactory m_fillZonePropFactory;
@@ -22,6 +22,8 @@
 #include "ChangeDewarpingDialog.h"
 #include "ApplyColorsDialog.h"
 #include "Settings.h"
+#include "OutputWriter.h"
+#include "OutputParams.h"
 #include "Params.h"
 #include "dewarping/DistortionModel.h"
 #include "DespeckleLevel.h"
@@ -50,8 +52,10 @@ namespace output
 
 OptionsWidget::OptionsWidget(
 	IntrusivePtr<Settings> const& settings,
+	IntrusivePtr<OutputWriter> const& writer,
 	PageSelectionAccessor const& page_selection_accessor)
 :	m_ptrSettings(settings),
+	m_ptrWriter(writer),
 	m_pageSelectionAccessor(page_selection_accessor),
 	m_despeckleLevel(DESPECKLE_NORMAL),
 	m_lastTab(TAB_OUTPUT),
@@ -536,7 +540,11 @@ OptionsWidget::reloadIfNecessary()
 	DepthPerception saved_depth_perception;
 	DespeckleLevel saved_despeckle_level = DESPECKLE_CAUTIOUS;
 	
-	std::auto_ptr<OutputParams> output_params(m_ptrSettings->getOutputParams(m_pageId));
+	// The output of this page may still be waiting to be written.
+	std::auto_ptr<OutputParams> output_params(m_ptrWriter->pendingOutputParams(m_pageId));
+	if (!output_params.get()) {
+		output_params = m_ptrSettings->getOutputParams(m_pageId);
+	}
 	if (output_params.get()) {
 		saved_picture_zones = output_params->pictureZones();
 		saved_fill_zones = output_params->fillZones();
@@ -41,6 +41,7 @@ namespace output
 {
 
 class Settings;
+class OutputWriter;
 class DewarpingParams;
 
 class OptionsWidget
@@ -49,6 +50,7 @@ class OptionsWidget
 	Q_OBJECT
 public:
 	OptionsWidget(IntrusivePtr<Settings> const& settings,
+		IntrusivePtr<OutputWriter> const& writer,
 		PageSelectionAccessor const& page_selection_accessor);
 	
 	virtual ~OptionsWidget();
@@ -124,6 +126,7 @@ private:
 	void updateDewarpingDisplay();
 	
 	IntrusivePtr<Settings> m_ptrSettings;
+	IntrusivePtr<OutputWriter> m_ptrWriter;
 	PageSelectionAccessor m_pageSelectionAccessor;
 	PageId m_pageId;
 	Dpi m_outputDpi;
@@ -22,6 +22,8 @@
 #include "TaskStatus.h"
 #include "Utils.h"
 #include "DebugImages.h"
+#include "Profiler.h"
+#include "MemoryBudget.h"
 #include "EstimateBackground.h"
 #include "Despeckle.h"
 #include "RenderParams.h"
@@ -234,6 +236,14 @@ void combineMixed(
 	}
 }
 
+/**
+ * The size of the pixel buffer, for MemoryBudget::Reservation.
+ */
+qint64 imageBytes(QImage const& image)
+{
+	return qint64(image.bytesPerLine()) * image.height();
+}
+
 } // anonymous namespace
 
 
@@ -302,6 +312,9 @@ OutputGenerator::normalizeIlluminationGray(
 	QTransform const& xform, QRect const& target_rect,
 	GrayImage* background, DebugImages* const dbg)
 {
+	ProfileSpan span("output::OutputGenerator::normalizeIlluminationGray");
+	span.setImageSize(target_rect.size());
+
 	GrayImage to_be_normalized(
 		transformToGray(
 			input, xform, target_rect, OutsidePixels::assumeWeakNearest()
@@ -468,6 +481,10 @@ OutputGenerator::processImpl(
 		return processAsIs(
 			input, status, fill_zones, depth_perception, dbg
 		);
+	} else if (render_params.binaryOutput() && isBitonal(input.origImage())) {
+		return processBitonal(
+			status, input, fill_zones, speckles_image, dbg
+		);
 	} else {
 		return processWithoutDewarping(
 			status, input, picture_zones, fill_zones,
@@ -593,6 +610,11 @@ OutputGenerator::processWithoutDewarping(
 			normalize_illumination_rect, OutsidePixels::assumeColor(Qt::white)
 		);
 	}
+	
+	// At high resolutions, these are the largest buffers of a task,
+	// and they are not allocated through MemoryBudget.
+	MemoryBudget::Reservation normalized_reservation(imageBytes(maybe_normalized));
+	MemoryBudget::Reservation smoothed_reservation;
 
 	status.throwIfCancelled();
 	
@@ -603,6 +625,7 @@ OutputGenerator::processWithoutDewarping(
 		maybe_smoothed = maybe_normalized;
 	} else {
 		maybe_smoothed = smoothToGrayscale(maybe_normalized, m_dpi);
+		smoothed_reservation.reset(imageBytes(maybe_smoothed));
 		if (dbg) {
 			dbg->add(maybe_smoothed, "smoothed");
 		}
@@ -611,6 +634,8 @@ OutputGenerator::processWithoutDewarping(
 	status.throwIfCancelled();
 	
 	if (render_params.binaryOutput() || m_outRect.isEmpty()) {
+		maybe_normalized = QImage(); // Save memory.
+		normalized_reservation.reset();
 		BinaryImage dst(m_outRect.size().expandedTo(QSize(1, 1)), WHITE);
 		
 		if (!m_contentRect.isEmpty()) {
@@ -702,6 +727,7 @@ OutputGenerator::processWithoutDewarping(
 		
 		adjustBrightnessGrayscale(tmp, maybe_normalized);
 		maybe_normalized = tmp;
+		normalized_reservation.reset(imageBytes(maybe_normalized));
 		if (dbg) {
 			dbg->add(maybe_normalized, "norm_illum_color");
 		}
@@ -709,12 +735,17 @@ OutputGenerator::processWithoutDewarping(
 	
 	if (!render_params.mixedOutput()) {
 		// It's "Color / Grayscale" mode, as we handle B/W above.
+		// maybe_smoothed shares its data with maybe_normalized,
+		// so we drop it to modify maybe_normalized without copying it.
+		maybe_smoothed = QImage();
+		smoothed_reservation.reset();
 		reserveBlackAndWhite(maybe_normalized);
 	} else {
 		BinaryImage bw_content(
 			binarize(maybe_smoothed, normalize_illumination_crop_area, &bw_mask)
 		);
 		maybe_smoothed = QImage(); // Save memory.
+		smoothed_reservation.reset();
 		if (dbg) {
 			dbg->add(bw_content, "binarized_and_cropped");
 		}
@@ -779,6 +810,7 @@ OutputGenerator::processWithoutDewarping(
 		// Both the constructor and setColorTable() above can leave the image null.
 		throw std::bad_alloc();
 	}
+	MemoryBudget::Reservation const dst_reservation(imageBytes(dst));
 
 	if (!m_contentRect.isEmpty()) {
 		QRect const src_rect(m_contentRect.translated(-small_margins_rect.topLeft()));
@@ -790,6 +822,64 @@ OutputGenerator::processWithoutDewarping(
 	return dst;
 }
 
+/**
+ * Black and white output from a 1-bit source.  There is no illumination
+ * to normalize and no threshold to pick, so we transform the source
+ * without ever leaving the binary domain.
+ */
+QImage
+OutputGenerator::processBitonal(
+	TaskStatus const& status, FilterData const& input,
+	ZoneSet const& fill_zones,
+	imageproc::BinaryImage* speckles_image,
+	DebugImages* dbg) const
+{
+	ProfileSpan const span("output::OutputGenerator::processBitonal");
+
+	BinaryImage dst(m_outRect.size().expandedTo(QSize(1, 1)), WHITE);
+	
+	if (!m_contentRect.isEmpty()) {
+		BinaryImage bw_content(
+			transformBinary(
+				BinaryImage(input.origImage()), m_xform.transform(),
+				m_contentRect, WHITE
+			)
+		);
+		
+		status.throwIfCancelled();
+		
+		// Crop area in bw_content coordinates.
+		QPolygonF crop_area(m_xform.resultingPreCropArea());
+		crop_area.translate(-m_contentRect.topLeft());
+		PolygonRasterizer::fillExcept(bw_content, WHITE, crop_area, Qt::WindingFill);
+		if (dbg) {
+			dbg->add(bw_content, "transformed_and_cropped");
+		}
+		
+		status.throwIfCancelled();
+		
+		morphologicalSmoothInPlace(bw_content, status);
+		if (dbg) {
+			dbg->add(bw_content, "edges_smoothed");
+		}
+		
+		status.throwIfCancelled();
+		
+		rasterOp<RopSrc>(dst, m_contentRect, bw_content, QPoint(0, 0));
+		bw_content.release(); // Save memory.
+		
+		// Despeckling has to be the last operation affecting the
+		// binary output.  See processWithoutDewarping().
+		maybeDespeckleInPlace(
+			dst, m_outRect, m_outRect, m_despeckleLevel,
+			speckles_image, m_dpi, status, dbg
+		);
+	}
+	
+	applyFillZonesInPlace(dst, fill_zones);
+	return dst.toQImage();
+}
+
 QImage
 OutputGenerator::processWithDewarping(
 	TaskStatus const& status, FilterData const& input,
@@ -927,6 +1017,16 @@ OutputGenerator::processWithDewarping(
 		}
 	}
 
+	// See the comment in processWithoutDewarping().  When normalized_original
+	// shares its data with input.grayImage(), FilterData already accounts for it.
+	MemoryBudget::Reservation const normalized_reservation(
+		normalized_original.cacheKey() == input.grayImage().toQImage().cacheKey()
+		? 0 : imageBytes(normalized_original)
+	);
+	MemoryBudget::Reservation const warped_gray_reservation(
+		imageBytes(warped_gray_output.toQImage())
+	);
+
 	status.throwIfCancelled();
 
 	if (render_params.binaryOutput()) {
@@ -1025,14 +1125,14 @@ OutputGenerator::processWithDewarping(
 	QImage dewarped;
 	try {
 		dewarped = dewarp(
-			QTransform(), normalized_original, m_xform.transform(),
+			status, QTransform(), normalized_original, m_xform.transform(),
 			distortion_model, depth_perception, bg_color
 		);
 	} catch (std::runtime_error const&) {
 		// Probably an impossible distortion model.  Let's fall back to a trivial one.
 		setupTrivialDistortionModel(distortion_model);
 		dewarped = dewarp(
-			QTransform(), normalized_original, m_xform.transform(),
+			status, QTransform(), normalized_original, m_xform.transform(),
 			distortion_model, depth_perception, bg_color
 		);
 	}
@@ -1065,6 +1165,7 @@ OutputGenerator::processWithDewarping(
 	);
 
 	if (render_params.binaryOutput()) {	
+		dewarped = QImage(); // Save memory.
 		BinaryImage dewarped_bw_content(dewarped_and_maybe_smoothed, bw_threshold);
 		dewarped_and_maybe_smoothed = QImage(); // Save memory.
 		if (dbg) {
@@ -1096,6 +1197,9 @@ OutputGenerator::processWithDewarping(
 
 	if (!render_params.mixedOutput()) {
 		// It's "Color / Grayscale" mode, as we handle B/W above.
+		// dewarped_and_maybe_smoothed shares its data with dewarped,
+		// so we drop it to modify dewarped without copying it.
+		dewarped_and_maybe_smoothed = QImage();
 		reserveBlackAndWhite(dewarped);
 	} else {
 		status.throwIfCancelled();
@@ -1113,7 +1217,7 @@ OutputGenerator::processWithDewarping(
 		);
 		BinaryImage const dewarped_bw_mask(
 			dewarp(
-				orig_to_small_margins, warped_bw_mask.toQImage(),
+				status, orig_to_small_margins, warped_bw_mask.toQImage(),
 				small_margins_to_output, distortion_model,
 				depth_perception, Qt::black
 			)
@@ -1240,10 +1344,14 @@ OutputGenerator::createDewarper(
  */
 QImage
 OutputGenerator::dewarp(
+	TaskStatus const& status,
 	QTransform const& orig_to_src, QImage const& src,
 	QTransform const& src_to_output, DistortionModel const& distortion_model,
 	DepthPerception const& depth_perception, QColor const& bg_color) const
 {
+	ProfileSpan span("output::OutputGenerator::dewarp");
+	span.setImageSize(m_outRect.size());
+
 	CylindricalSurfaceDewarper const dewarper(
 		createDewarper(distortion_model, orig_to_src, depth_perception.value())
 	);
@@ -1262,7 +1370,7 @@ OutputGenerator::dewarp(
 	}
 
 	return RasterDewarper::dewarp(
-		src, m_outRect.size(), dewarper, model_domain, bg_color
+		src, m_outRect.size(), dewarper, model_domain, bg_color, status
 	);
 }
 
@@ -1295,6 +1403,13 @@ OutputGenerator::convertToRGBorRGBA(QImage const& src)
 	return src.convertToFormat(fmt);
 }
 
+bool
+OutputGenerator::isBitonal(QImage const& image)
+{
+	return image.format() == QImage::Format_Mono
+		|| image.format() == QImage::Format_MonoLSB;
+}
+
 void
 OutputGenerator::fillMarginsInPlace(
 	QImage& image, QPolygonF const& content_poly, QColor const& color)
@@ -1473,6 +1588,9 @@ OutputGenerator::calcBinarizationThreshold(
 BinaryImage
 OutputGenerator::binarize(QImage const& image, BinaryImage const& mask) const
 {
+	ProfileSpan span("output::OutputGenerator::binarize(mask)");
+	span.setImageSize(image.size());
+
 	GrayscaleHistogram hist(image, mask);
 	BinaryThreshold const bw_thresh(BinaryThreshold::otsuThreshold(hist));
 	BinaryImage binarized(image, adjustThreshold(bw_thresh));
@@ -1487,6 +1605,9 @@ BinaryImage
 OutputGenerator::binarize(QImage const& image,
 	QPolygonF const& crop_area, BinaryImage const* mask) const
 {
+	ProfileSpan span("output::OutputGenerator::binarize");
+	span.setImageSize(image.size());
+
 	QPainterPath path;
 	path.addPolygon(crop_area);
 	
@@ -1563,6 +1684,8 @@ OutputGenerator::maybeDespeckleInPlace(
 			default:;
 		}
 
+		ProfileSpan span("output::OutputGenerator::despeckle");
+		span.setImageSize(image.size());
 		Despeckle::despeckleInPlace(image, dpi, lvl, status, dbg);
 
 		if (dbg) {
@@ -136,6 +136,12 @@ private:
 		imageproc::BinaryImage* speckles_image = 0,
 		DebugImages* dbg = 0) const;
 
+	QImage processBitonal(
+		TaskStatus const& status, FilterData const& input,
+		ZoneSet const& fill_zones,
+		imageproc::BinaryImage* speckles_image = 0,
+		DebugImages* dbg = 0) const;
+
 	QImage processWithDewarping(
 		TaskStatus const& status, FilterData const& input,
 		ZoneSet const& picture_zones, ZoneSet const& fill_zones,
@@ -153,6 +159,7 @@ private:
 		QTransform const& distortion_model_to_target, double depth_perception);
 
 	QImage dewarp(
+		TaskStatus const& status,
 		QTransform const& orig_to_src, QImage const& src,
 		QTransform const& src_to_output, dewarping::DistortionModel const& distortion_model,
 		DepthPerception const& depth_perception, QColor const& bg_color) const;
@@ -163,6 +170,8 @@ private:
 	
 	static QImage convertToRGBorRGBA(QImage const& src);
 
+	static bool isBitonal(QImage const& image);
+
 	static void fillMarginsInPlace(
 		QImage& image, QPolygonF const& content_poly, QColor const& color);
 
@@ -0,0 +1,429 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "OutputWriter.h"
+#include "OutputParams.h"
+#include "OutputFileParams.h"
+#include "Settings.h"
+#include "TiffWriter.h"
+#include "MemoryBudget.h"
+#include "Profiler.h"
+#include <QThread>
+#include <QMutexLocker>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <exception>
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace output
+{
+
+namespace
+{
+
+bool syncToDisk(QFile& file)
+{
+	if (!file.flush()) {
+		return false;
+	}
+#ifdef Q_OS_WIN
+	return _commit(file.handle()) == 0;
+#else
+	return fsync(file.handle()) == 0;
+#endif
+}
+
+bool writeTiff(QString const& file_path, QImage const& image)
+{
+	QFile file(file_path);
+	if (!file.open(QFile::WriteOnly)) {
+		return false;
+	}
+	
+	if (!TiffWriter::writeImage(file, image) || !syncToDisk(file)) {
+		file.remove();
+		return false;
+	}
+	
+	return true;
+}
+
+qint64 imageBytes(QImage const& image)
+{
+	return qint64(image.bytesPerLine()) * image.height();
+}
+
+} // anonymous namespace
+
+
+class OutputWriter::Worker : public QThread
+{
+public:
+	Worker(OutputWriter* owner) : m_pOwner(owner) {}
+protected:
+	virtual void run() { m_pOwner->processJobs(); }
+private:
+	OutputWriter* m_pOwner;
+};
+
+
+/*============================= OutputWriter::Job ===========================*/
+
+OutputWriter::Job::Job(
+	PageId const& page_id, OutputImageParams const& output_image_params,
+	ZoneSet const& picture_zones, ZoneSet const& fill_zones)
+:	m_pageId(page_id),
+	m_outputImageParams(output_image_params),
+	m_pictureZones(picture_zones),
+	m_fillZones(fill_zones)
+{
+}
+
+void
+OutputWriter::Job::setOutputFile(QString const& file_path, QImage const& image)
+{
+	m_outputFilePath = file_path;
+	m_outputImage = image;
+}
+
+void
+OutputWriter::Job::setAutomaskFile(QString const& file_path, QImage const& image)
+{
+	m_automaskFilePath = file_path;
+	m_automaskImage = image;
+}
+
+void
+OutputWriter::Job::setSpecklesFile(QString const& file_path, QImage const& image)
+{
+	m_specklesFilePath = file_path;
+	m_specklesImage = image;
+}
+
+void
+OutputWriter::Job::addObsoleteFile(QString const& file_path)
+{
+	m_obsoleteFiles.push_back(file_path);
+}
+
+void
+OutputWriter::Job::setProfileLabel(QString const& label)
+{
+	m_profileLabel = label;
+}
+
+qint64
+OutputWriter::Job::bytes() const
+{
+	return imageBytes(m_outputImage) + imageBytes(m_automaskImage)
+		+ imageBytes(m_specklesImage);
+}
+
+
+/*=============================== OutputWriter ==============================*/
+
+qint64 const OutputWriter::DEFAULT_MEMORY_LIMIT = qint64(512) << 20;
+
+OutputWriter::OutputWriter(
+	IntrusivePtr<Settings> const& settings, qint64 const memory_limit)
+:	m_ptrSettings(settings),
+	m_memoryLimit(memory_limit),
+	m_bytesPending(0),
+	m_exiting(false)
+{
+	// Encoding is CPU bound, but we don't want to compete too much
+	// with the threads producing the images.
+	int const num_threads = 2;
+	for (int i = 0; i < num_threads; ++i) {
+		m_workers.push_back(boost::shared_ptr<Worker>(new Worker(this)));
+	}
+}
+
+OutputWriter::~OutputWriter()
+{
+	{
+		QMutexLocker const locker(&m_mutex);
+		m_exiting = true;
+	}
+	
+	m_jobsAvailable.wakeAll();
+	
+	std::vector<boost::shared_ptr<Worker> >::iterator it(m_workers.begin());
+	for (; it != m_workers.end(); ++it) {
+		(*it)->wait();
+	}
+}
+
+void
+OutputWriter::enqueue(Job const& job)
+{
+	m_ptrSettings->removeOutputParams(job.pageId());
+	
+	qint64 const job_bytes = job.bytes();
+	qint64 const memory_limit = memoryLimit();
+	qint64 dropped_bytes = 0;
+	
+	// Reserved before the job is queued, as a worker may finish it
+	// and give the memory back as soon as it's there.
+	MemoryBudget::instance().reserve(job_bytes);
+	
+	{
+		QMutexLocker const locker(&m_mutex);
+		
+		// A job that hasn't started yet would write files that are
+		// already obsolete, so we just drop it.
+		JobList::iterator it(m_queuedJobs.begin());
+		for (; it != m_queuedJobs.end(); ++it) {
+			if (it->pageId() == job.pageId()) {
+				dropped_bytes = it->bytes();
+				m_bytesPending -= dropped_bytes;
+				m_queuedJobs.erase(it);
+				m_jobFinished.wakeAll();
+				break;
+			}
+		}
+		
+		while (m_bytesPending > 0 && m_bytesPending + job_bytes > memory_limit) {
+			m_jobFinished.wait(&m_mutex);
+		}
+		
+		m_queuedJobs.push_back(job);
+		m_bytesPending += job_bytes;
+		
+		// Threads are started lazily, so that we don't create them
+		// if nothing is ever written.
+		bool started = false;
+		std::vector<boost::shared_ptr<Worker> >::iterator w(m_workers.begin());
+		for (; w != m_workers.end(); ++w) {
+			if (!(*w)->isRunning()) {
+				(*w)->start();
+				started = true;
+				break;
+			}
+		}
+		if (!started) {
+			m_jobsAvailable.wakeOne();
+		}
+	}
+	
+	if (dropped_bytes > 0) {
+		MemoryBudget::instance().unreserve(dropped_bytes);
+	}
+}
+
+qint64
+OutputWriter::memoryLimit() const
+{
+	if (m_memoryLimit > 0) {
+		return m_memoryLimit;
+	}
+	
+	qint64 const budget = MemoryBudget::instance().limit();
+	return budget > 0 ? budget / 2 : DEFAULT_MEMORY_LIMIT;
+}
+
+std::auto_ptr<OutputParams>
+OutputWriter::pendingOutputParams(PageId const& page_id) const
+{
+	QMutexLocker const locker(&m_mutex);
+	
+	// A queued job is newer than the one in progress for the same page.
+	JobList const* lists[] = { &m_queuedJobs, &m_jobsInProgress };
+	for (int i = 0; i < 2; ++i) {
+		JobList::const_reverse_iterator it(lists[i]->rbegin());
+		for (; it != lists[i]->rend(); ++it) {
+			if (it->pageId() == page_id) {
+				return std::auto_ptr<OutputParams>(
+					new OutputParams(
+						it->m_outputImageParams, OutputFileParams(),
+						OutputFileParams(), OutputFileParams(),
+						it->m_pictureZones, it->m_fillZones
+					)
+				);
+			}
+		}
+	}
+	
+	return std::auto_ptr<OutputParams>();
+}
+
+void
+OutputWriter::waitForPage(PageId const& page_id)
+{
+	QMutexLocker const locker(&m_mutex);
+	
+	while (isPendingLocked(page_id)) {
+		m_jobFinished.wait(&m_mutex);
+	}
+}
+
+void
+OutputWriter::waitForIdle()
+{
+	QMutexLocker const locker(&m_mutex);
+	
+	while (!m_queuedJobs.empty() || !m_jobsInProgress.empty()) {
+		m_jobFinished.wait(&m_mutex);
+	}
+}
+
+bool
+OutputWriter::isPendingLocked(PageId const& page_id) const
+{
+	JobList const* lists[] = { &m_queuedJobs, &m_jobsInProgress };
+	for (int i = 0; i < 2; ++i) {
+		JobList::const_iterator it(lists[i]->begin());
+		for (; it != lists[i]->end(); ++it) {
+			if (it->pageId() == page_id) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+void
+OutputWriter::processJobs()
+{
+	QMutexLocker locker(&m_mutex);
+	
+	for (;;) {
+		// Pick the oldest job for a page that isn't being written already.
+		JobList::iterator it(m_queuedJobs.begin());
+		for (; it != m_queuedJobs.end(); ++it) {
+			JobList::iterator in_progress(m_jobsInProgress.begin());
+			for (; in_progress != m_jobsInProgress.end(); ++in_progress) {
+				if (in_progress->pageId() == it->pageId()) {
+					break;
+				}
+			}
+			if (in_progress == m_jobsInProgress.end()) {
+				break;
+			}
+		}
+		
+		if (it == m_queuedJobs.end()) {
+			if (m_exiting && m_queuedJobs.empty()) {
+				break;
+			}
+			m_jobsAvailable.wait(&m_mutex);
+			continue;
+		}
+		
+		m_jobsInProgress.splice(m_jobsInProgress.end(), m_queuedJobs, it);
+		Job const& job = m_jobsInProgress.back();
+		
+		locker.unlock();
+		
+		bool success = false;
+		try {
+			success = writeFiles(job);
+		} catch (std::exception const&) {
+			// Just fail this job.  The page will be reprocessed later.
+		} catch (...) {
+			// Same as above.  We are on our own thread, with nobody
+			// to propagate the exception to.
+		}
+		commit(job, success);
+		
+		if (success) {
+			for (int i = 0; i < job.m_obsoleteFiles.size(); ++i) {
+				QFile::remove(job.m_obsoleteFiles[i]);
+			}
+		}
+		
+		MemoryBudget::instance().unreserve(job.bytes());
+		
+		locker.relock();
+		
+		m_bytesPending -= job.bytes();
+		JobList::iterator self(m_jobsInProgress.begin());
+		while (&*self != &job) {
+			++self;
+		}
+		m_jobsInProgress.erase(self);
+		
+		m_jobFinished.wakeAll();
+		
+		// Another job for the same page may have been waiting for this one.
+		m_jobsAvailable.wakeAll();
+	}
+}
+
+bool
+OutputWriter::writeFiles(Job const& job) const
+{
+	ProfileSpan const span("output::OutputWriter::writeFiles", job.m_profileLabel);
+	
+	if (!writeTiff(job.m_outputFilePath, job.m_outputImage)) {
+		return false;
+	}
+	
+	if (!job.m_automaskFilePath.isEmpty()) {
+		// Note that QDir::mkdir() will fail if the parent directory,
+		// that is $OUT/cache doesn't exist. We want that behaviour,
+		// as otherwise when loading a project from a different machine,
+		// a whole bunch of bogus directories would be created.
+		QDir().mkdir(QFileInfo(job.m_automaskFilePath).absolutePath());
+		// Also note that QDir::mkdir() will fail if the directory already exists,
+		// so we ignore its return value here.
+		
+		if (!writeTiff(job.m_automaskFilePath, job.m_automaskImage)) {
+			return false;
+		}
+	}
+	
+	if (!job.m_specklesFilePath.isEmpty()) {
+		if (!QDir().mkpath(QFileInfo(job.m_specklesFilePath).absolutePath())) {
+			return false;
+		}
+		if (!writeTiff(job.m_specklesFilePath, job.m_specklesImage)) {
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+void
+OutputWriter::commit(Job const& job, bool const success) const
+{
+	if (!success) {
+		m_ptrSettings->removeOutputParams(job.pageId());
+		return;
+	}
+	
+	OutputParams const out_params(
+		job.m_outputImageParams,
+		OutputFileParams(QFileInfo(job.m_outputFilePath)),
+		job.m_automaskFilePath.isEmpty() ? OutputFileParams()
+		: OutputFileParams(QFileInfo(job.m_automaskFilePath)),
+		job.m_specklesFilePath.isEmpty() ? OutputFileParams()
+		: OutputFileParams(QFileInfo(job.m_specklesFilePath)),
+		job.m_pictureZones, job.m_fillZones
+	);
+	
+	m_ptrSettings->setOutputParams(job.pageId(), out_params);
+}
+
+} // namespace output
@@ -0,0 +1,199 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OUTPUT_OUTPUT_WRITER_H_
+#define OUTPUT_OUTPUT_WRITER_H_
+
+#include "NonCopyable.h"
+#include "RefCountable.h"
+#include "IntrusivePtr.h"
+#include "PageId.h"
+#include "OutputImageParams.h"
+#include "ZoneSet.h"
+#include <QString>
+#include <QStringList>
+#include <QImage>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QtGlobal>
+#include <boost/shared_ptr.hpp>
+#include <vector>
+#include <list>
+#include <memory>
+
+namespace output
+{
+
+class Settings;
+class OutputParams;
+
+/**
+ * \brief Encodes and writes output files on background threads.
+ *
+ * Encoding a large TIFF takes a noticeable amount of time, which a worker
+ * thread would rather spend on the next page.  Task hands its images over
+ * to this class and returns without waiting for them to be written.
+ *
+ * Output params are committed to Settings only after all files of a page
+ * have been written and synced to disk.  Until then, they are available
+ * from pendingOutputParams().  If writing fails, the page's output params
+ * are removed, so that it gets reprocessed the next time.
+ *
+ * Jobs for the same page are executed in the order they were submitted,
+ * and a job that hasn't started yet is replaced by a newer one for the
+ * same page.  The total size of images waiting to be written is limited,
+ * and enqueue() blocks until there is room for a new job.  These images
+ * are also accounted for in MemoryBudget, so that new tasks wait for
+ * them to be written when memory is tight.
+ *
+ * This class is thread-safe.
+ */
+class OutputWriter : public RefCountable
+{
+	DECLARE_NON_COPYABLE(OutputWriter)
+public:
+	class Job
+	{
+		// Member-wise copying is OK.
+	public:
+		Job(PageId const& page_id, OutputImageParams const& output_image_params,
+			ZoneSet const& picture_zones, ZoneSet const& fill_zones);
+		
+		PageId const& pageId() const { return m_pageId; }
+		
+		void setOutputFile(QString const& file_path, QImage const& image);
+		
+		/**
+		 * The automask directory will be created if its parent exists.
+		 */
+		void setAutomaskFile(QString const& file_path, QImage const& image);
+		
+		/**
+		 * The speckles directory will be created, including any parents.
+		 */
+		void setSpecklesFile(QString const& file_path, QImage const& image);
+		
+		/**
+		 * \brief Schedules a file to be removed once all the files of this
+		 *        job have been written.
+		 *
+		 * That's for output files the new ones make obsolete.  If writing
+		 * fails, the file is kept.
+		 */
+		void addObsoleteFile(QString const& file_path);
+		
+		/**
+		 * The page label for Profiler, which doesn't follow
+		 * the job to the writer thread by itself.
+		 */
+		void setProfileLabel(QString const& label);
+		
+		qint64 bytes() const;
+	private:
+		friend class OutputWriter;
+		
+		PageId m_pageId;
+		OutputImageParams m_outputImageParams;
+		ZoneSet m_pictureZones;
+		ZoneSet m_fillZones;
+		QString m_outputFilePath;
+		QImage m_outputImage;
+		QString m_automaskFilePath;
+		QImage m_automaskImage;
+		QString m_specklesFilePath;
+		QImage m_specklesImage;
+		QStringList m_obsoleteFiles;
+		QString m_profileLabel;
+	};
+	
+	/**
+	 * The memory limit used when MemoryBudget doesn't have one.
+	 */
+	static qint64 const DEFAULT_MEMORY_LIMIT;
+	
+	/**
+	 * \param settings The settings to commit output params to.
+	 * \param memory_limit The maximum total size in bytes of images waiting
+	 *        to be written.  A single job exceeding it is still accepted.
+	 *        Zero means half of MemoryBudget::limit(), as it is at the time
+	 *        of enqueue(), or DEFAULT_MEMORY_LIMIT if the budget is unlimited.
+	 */
+	explicit OutputWriter(
+		IntrusivePtr<Settings> const& settings, qint64 memory_limit = 0);
+	
+	/**
+	 * \brief Writes everything that's still pending and stops the threads.
+	 */
+	virtual ~OutputWriter();
+	
+	/**
+	 * \brief Schedules a job, blocking while the memory limit is reached.
+	 *
+	 * Output params for the page are removed from Settings right away,
+	 * as the files they describe are about to be overwritten.
+	 */
+	void enqueue(Job const& job);
+	
+	/**
+	 * \brief Returns the output params a pending job for the page will
+	 *        commit, or null if there is no such job.
+	 *
+	 * The file params in the returned object are null, as the files
+	 * are not written yet.
+	 */
+	std::auto_ptr<OutputParams> pendingOutputParams(PageId const& page_id) const;
+	
+	/**
+	 * \brief Waits until there are no pending jobs for the page.
+	 */
+	void waitForPage(PageId const& page_id);
+	
+	/**
+	 * \brief Waits until there are no pending jobs at all.
+	 */
+	void waitForIdle();
+private:
+	class Worker;
+	
+	typedef std::list<Job> JobList;
+	
+	void processJobs();
+	
+	qint64 memoryLimit() const;
+	
+	bool writeFiles(Job const& job) const;
+	
+	void commit(Job const& job, bool success) const;
+	
+	bool isPendingLocked(PageId const& page_id) const;
+	
+	IntrusivePtr<Settings> m_ptrSettings;
+	qint64 const m_memoryLimit;
+	std::vector<boost::shared_ptr<Worker> > m_workers;
+	JobList m_queuedJobs;
+	JobList m_jobsInProgress;
+	qint64 m_bytesPending;
+	mutable QMutex m_mutex;
+	QWaitCondition m_jobsAvailable;
+	QWaitCondition m_jobFinished;
+	bool m_exiting;
+};
+
+} // namespace output
+
+#endif
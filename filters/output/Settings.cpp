@@ -29,6 +29,8 @@
 #include <Qt>
 #include <QColor>
 #include <QMutexLocker>
+#include <QDomDocument>
+#include <QDomElement>
 
 namespace output
 {
@@ -54,12 +56,15 @@ Settings::clear()
 	m_perPageOutputParams.clear();
 	m_perPagePictureZones.clear();
 	m_perPageFillZones.clear();
+	m_deferredPages.clear();
+	m_revisions.touchAll();
 }
 
 void
 Settings::performRelinking(AbstractRelinker const& relinker)
 {
 	QMutexLocker const locker(&m_mutex);
+	loadAllDeferredLocked();
 
 	PerPageParams new_params;
 	PerPageOutputParams new_output_params;
@@ -98,12 +103,14 @@ Settings::performRelinking(AbstractRelinker const& relinker)
 	m_perPageOutputParams.swap(new_output_params);
 	m_perPagePictureZones.swap(new_picture_zones);
 	m_perPageFillZones.swap(new_fill_zones);
+	m_revisions.touchAll();
 }
 
 Params
 Settings::getParams(PageId const& page_id) const
 {
 	QMutexLocker const locker(&m_mutex);
+	loadDeferredLocked(page_id);
 	
 	PerPageParams::const_iterator const it(m_perPageParams.find(page_id));
 	if (it != m_perPageParams.end()) {
@@ -117,6 +124,8 @@ void
 Settings::setParams(PageId const& page_id, Params const& params)
 {
 	QMutexLocker const locker(&m_mutex);
+	loadDeferredLocked(page_id);
+	m_revisions.touch(page_id);
 	Utils::mapSetValue(m_perPageParams, page_id, params);
 }
 
@@ -124,6 +133,8 @@ void
 Settings::setColorParams(PageId const& page_id, ColorParams const& prms)
 {
 	QMutexLocker const locker(&m_mutex);
+	loadDeferredLocked(page_id);
+	m_revisions.touch(page_id);
 
 	PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
 	if (it == m_perPageParams.end() || m_perPageParams.key_comp()(page_id, it->first)) {
@@ -139,6 +150,8 @@ void
 Settings::setDpi(PageId const& page_id, Dpi const& dpi)
 {
 	QMutexLocker const locker(&m_mutex);
+	loadDeferredLocked(page_id);
+	m_revisions.touch(page_id);
 
 	PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
 	if (it == m_perPageParams.end() || m_perPageParams.key_comp()(page_id, it->first)) {
@@ -154,6 +167,8 @@ void
 Settings::setDewarpingMode(PageId const& page_id, DewarpingMode const& mode)
 {
 	QMutexLocker const locker(&m_mutex);
+	loadDeferredLocked(page_id);
+	m_revisions.touch(page_id);
 
 	PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
 	if (it == m_perPageParams.end() || m_perPageParams.key_comp()(page_id, it->first)) {
@@ -169,6 +184,8 @@ void
 Settings::setDistortionModel(PageId const& page_id, dewarping::DistortionModel const& model)
 {
 	QMutexLocker const locker(&m_mutex);
+	loadDeferredLocked(page_id);
+	m_revisions.touch(page_id);
 
 	PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
 	if (it == m_perPageParams.end() || m_perPageParams.key_comp()(page_id, it->first)) {
@@ -184,6 +201,8 @@ void
 Settings::setDepthPerception(PageId const& page_id, DepthPerception const& depth_perception)
 {
 	QMutexLocker const locker(&m_mutex);
+	loadDeferredLocked(page_id);
+	m_revisions.touch(page_id);
 
 	PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
 	if (it == m_perPageParams.end() || m_perPageParams.key_comp()(page_id, it->first)) {
@@ -199,6 +218,8 @@ void
 Settings::setDespeckleLevel(PageId const& page_id, DespeckleLevel level)
 {
 	QMutexLocker const locker(&m_mutex);
+	loadDeferredLocked(page_id);
+	m_revisions.touch(page_id);
 
 	PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
 	if (it == m_perPageParams.end() || m_perPageParams.key_comp()(page_id, it->first)) {
@@ -214,6 +235,7 @@ std::auto_ptr<OutputParams>
 Settings::getOutputParams(PageId const& page_id) const
 {
 	QMutexLocker const locker(&m_mutex);
+	loadDeferredLocked(page_id);
 	
 	PerPageOutputParams::const_iterator const it(m_perPageOutputParams.find(page_id));
 	if (it != m_perPageOutputParams.end()) {
@@ -227,6 +249,8 @@ void
 Settings::removeOutputParams(PageId const& page_id)
 {
 	QMutexLocker const locker(&m_mutex);
+	loadDeferredLocked(page_id);
+	m_revisions.touch(page_id);
 	m_perPageOutputParams.erase(page_id);
 }
 
@@ -234,6 +258,8 @@ void
 Settings::setOutputParams(PageId const& page_id, OutputParams const& params)
 {
 	QMutexLocker const locker(&m_mutex);
+	loadDeferredLocked(page_id);
+	m_revisions.touch(page_id);
 	Utils::mapSetValue(m_perPageOutputParams, page_id, params);
 }
 
@@ -241,6 +267,7 @@ ZoneSet
 Settings::pictureZonesForPage(PageId const& page_id) const
 {
 	QMutexLocker const locker(&m_mutex);
+	loadDeferredLocked(page_id);
 
 	PerPageZones::const_iterator const it(m_perPagePictureZones.find(page_id));
 	if (it != m_perPagePictureZones.end()) {
@@ -254,6 +281,7 @@ ZoneSet
 Settings::fillZonesForPage(PageId const& page_id) const
 {
 	QMutexLocker const locker(&m_mutex);
+	loadDeferredLocked(page_id);
 
 	PerPageZones::const_iterator const it(m_perPageFillZones.find(page_id));
 	if (it != m_perPageFillZones.end()) {
@@ -267,6 +295,8 @@ void
 Settings::setPictureZones(PageId const& page_id, ZoneSet const& zones)
 {
 	QMutexLocker const locker(&m_mutex);
+	loadDeferredLocked(page_id);
+	m_revisions.touch(page_id);
 	Utils::mapSetValue(m_perPagePictureZones, page_id, zones);
 }
 
@@ -274,6 +304,8 @@ void
 Settings::setFillZones(PageId const& page_id, ZoneSet const& zones)
 {
 	QMutexLocker const locker(&m_mutex);
+	loadDeferredLocked(page_id);
+	m_revisions.touch(page_id);
 	Utils::mapSetValue(m_perPageFillZones, page_id, zones);
 }
 
@@ -305,6 +337,58 @@ Settings::setDefaultFillZoneProperties(PropertySet const& props)
 	m_defaultFillZoneProps = props;
 }
 
+RevisionMap<PageId>::Revision
+Settings::pageRevision(PageId const& page_id) const
+{
+	QMutexLocker const locker(&m_mutex);
+	return m_revisions.revision(page_id);
+}
+
+void
+Settings::setDeferredPage(PageId const& page_id, ProjectIndexFragment const& fragment)
+{
+	QMutexLocker const locker(&m_mutex);
+	m_deferredPages.add(page_id, fragment);
+}
+
+void
+Settings::loadDeferredLocked(PageId const& page_id) const
+{
+	QDomDocument doc;
+	QDomElement const el(m_deferredPages.take(page_id, doc));
+	if (el.isNull()) {
+		return;
+	}
+
+	ZoneSet const picture_zones(el.namedItem("zones").toElement(), m_pictureZonePropFactory);
+	if (!picture_zones.empty()) {
+		Utils::mapSetValue(m_perPagePictureZones, page_id, picture_zones);
+	}
+
+	ZoneSet const fill_zones(el.namedItem("fill-zones").toElement(), m_fillZonePropFactory);
+	if (!fill_zones.empty()) {
+		Utils::mapSetValue(m_perPageFillZones, page_id, fill_zones);
+	}
+
+	QDomElement const params_el(el.namedItem("params").toElement());
+	if (!params_el.isNull()) {
+		Utils::mapSetValue(m_perPageParams, page_id, Params(params_el));
+	}
+
+	QDomElement const output_params_el(el.namedItem("output-params").toElement());
+	if (!output_params_el.isNull()) {
+		Utils::mapSetValue(m_perPageOutputParams, page_id, OutputParams(output_params_el));
+	}
+}
+
+void
+Settings::loadAllDeferredLocked()
+{
+	BOOST_FOREACH(PageId const& page_id, m_deferredPages.keys()) {
+		loadDeferredLocked(page_id);
+	}
+}
+
 PropertySet
 Settings::initialPictureZoneProps()
 {
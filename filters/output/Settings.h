@@ -30,6 +30,10 @@
 #include "DespeckleLevel.h"
 #include "ZoneSet.h"
 #include "PropertySet.h"
+#include "RevisionMap.h"
+#include "DeferredFragments.h"
+#include "PictureZonePropFactory.h"
+#include "FillZonePropFactory.h"
 #include <QMutex>
 #include <map>
 #include <memory>
@@ -94,6 +98,18 @@ public:
 	void setDefaultPictureZoneProperties(PropertySet const& props);
 
 	void setDefaultFillZoneProperties(PropertySet const& props);
+
+	/**
+	 * \brief Returns a number that changes whenever any of the per-page
+	 *        settings of the given page change.
+	 */
+	RevisionMap<PageId>::Revision pageRevision(PageId const& page_id) const;
+
+	/**
+	 * \brief Registers the serialized settings of a page, to be parsed
+	 *        when they are first accessed.
+	 */
+	void setDeferredPage(PageId const& page_id, ProjectIndexFragment const& fragment);
 private:
 	typedef std::map<PageId, Params> PerPageParams;
 	typedef std::map<PageId, OutputParams> PerPageOutputParams;
@@ -103,11 +119,24 @@ private:
 
 	static PropertySet initialFillZoneProps();
 
+	void loadDeferredLocked(PageId const& page_id) const;
+
+	void loadAllDeferredLocked();
+
 	mutable QMutex m_mutex;
-	PerPageParams m_perPageParams;
-	PerPageOutputParams m_perPageOutputParams;
-	PerPageZones m_perPagePictureZones;
-	PerPageZones m_perPageFillZones;
+	PictureZonePropFactory m_pictureZonePropFactory;
+	FillZonePropFactory m_fillZonePropFactory;
+	mutable DeferredFragments<PageId> m_deferredPages;
+
+	/*
+	 * The per-page maps are mutable, as pages from m_deferredPages
+	 * are moved there on first access.
+	 */
+	mutable PerPageParams m_perPageParams;
+	mutable PerPageOutputParams m_perPageOutputParams;
+	mutable PerPageZones m_perPagePictureZones;
+	mutable PerPageZones m_perPageFillZones;
+	RevisionMap<PageId> m_revisions;
 	PropertySet m_defaultPictureZoneProps;
 	PropertySet m_defaultFillZoneProps;
 };
@@ -29,6 +29,7 @@
 #include "FilterUiInterface.h"
 #include "TaskStatus.h"
 #include "FilterData.h"
+#include "Profiler.h"
 #include "ImageView.h"
 #include "ImageViewTab.h"
 #include "TabbedImageView.h"
@@ -53,7 +54,7 @@
 #include "ThumbnailPixmapCache.h"
 #include "DebugImages.h"
 #include "OutputGenerator.h"
-#include "TiffWriter.h"
+#include "OutputWriter.h"
 #include "ImageLoader.h"
 #include "ErrorWidget.h"
 #include "imageproc/BinaryImage.h"
@@ -64,6 +65,7 @@
 #endif
 #include <QImage>
 #include <QString>
+#include <QStringList>
 #include <QObject>
 #include <QFile>
 #include <QDir>
@@ -96,10 +98,12 @@ public:
 		BinaryImage const& picture_mask,
 		DespeckleState const& despeckle_state,
 		DespeckleVisualization const& despeckle_visualization,
-		bool batch, bool debug);
+		bool debug);
 	
 	virtual void updateUI(FilterUiInterface* ui);
 	
+	virtual void updateThumbnails(FilterUiInterface* ui);
+	
 	virtual IntrusivePtr<AbstractFilter> filter() { return m_ptrFilter; }
 private:
 	IntrusivePtr<Filter> m_ptrFilter;
@@ -117,18 +121,37 @@ private:
 	DespeckleState m_despeckleState;
 	DespeckleVisualization m_despeckleVisualization;
 	DespeckleLevel m_despeckleLevel;
-	bool m_batchProcessing;
 	bool m_debug;
 };
 
 
+/**
+ * In batch mode, only the thumbnail of a page needs to be updated,
+ * so we don't carry any images around.
+ */
+class Task::BatchUiUpdater : public FilterResult
+{
+public:
+	BatchUiUpdater(IntrusivePtr<Filter> const& filter, PageId const& page_id);
+	
+	virtual void updateUI(FilterUiInterface* ui);
+	
+	virtual IntrusivePtr<AbstractFilter> filter() { return m_ptrFilter; }
+private:
+	IntrusivePtr<Filter> m_ptrFilter;
+	PageId m_pageId;
+};
+
+
 Task::Task(IntrusivePtr<Filter> const& filter,
 	IntrusivePtr<Settings> const& settings,
+	IntrusivePtr<OutputWriter> const& writer,
 	IntrusivePtr<ThumbnailPixmapCache> const& thumbnail_cache,
 	PageId const& page_id, OutputFileNameGenerator const& out_file_name_gen,
 	ImageViewTab const last_tab, bool const batch, bool const debug)
 :	m_ptrFilter(filter),
 	m_ptrSettings(settings),
+	m_ptrWriter(writer),
 	m_ptrThumbnailCache(thumbnail_cache),
 	m_pageId(page_id),
 	m_outFileNameGen(out_file_name_gen),
@@ -150,6 +173,8 @@ Task::process(
 	TaskStatus const& status, FilterData const& data,
 	QPolygonF const& content_rect_phys)
 {
+	ProfileSpan const span("output::Task::process");
+
 	status.throwIfCancelled();
 
 	Params params(m_ptrSettings->getParams(m_pageId));
@@ -191,6 +216,10 @@ Task::process(
 	ZoneSet const new_picture_zones(m_ptrSettings->pictureZonesForPage(m_pageId));
 	ZoneSet const new_fill_zones(m_ptrSettings->fillZonesForPage(m_pageId));
 	
+	// If the files of this page are still being written, we can neither
+	// trust the stored output params nor read the files.
+	m_ptrWriter->waitForPage(m_pageId);
+	
 	bool need_reprocess = false;
 	do { // Just to be able to break from it.
 		
@@ -257,7 +286,16 @@ Task::process(
 	BinaryImage automask_img;
 	BinaryImage speckles_img;
 	
-	if (!need_reprocess) {
+	// In batch mode nothing but the thumbnail is shown, and that one
+	// comes from the thumbnail cache, so matching OutputFileParams are
+	// enough to skip decoding the files we already have.
+	bool const need_images = !m_batchProcessing && CommandLine::get().isGui();
+	
+	// The speckles file is only needed on the despeckling tab.  If it's not
+	// the current one, it's read when (and if) that tab gets shown.
+	bool const defer_speckles = need_speckles_image && m_lastTab != TAB_DESPECKLING;
+	
+	if (!need_reprocess && need_images) {
 		QFile out_file(out_file_path);
 		if (out_file.open(QIODevice::ReadOnly)) {
 			out_img = ImageLoader::load(out_file, 0);
@@ -272,7 +310,7 @@ Task::process(
 			need_reprocess = automask_img.isNull() || automask_img.size() != out_img.size();
 		}
 
-		if (need_speckles_image && !need_reprocess) {
+		if (need_speckles_image && !defer_speckles && !need_reprocess) {
 			QFile speckles_file(speckles_file_path);
 			if (speckles_file.open(QIODevice::ReadOnly)) {
 				speckles_img = BinaryImage(ImageLoader::load(speckles_file, 0));
@@ -325,58 +363,43 @@ Task::process(
 			BinaryImage(out_img.size(), WHITE).swap(speckles_img);
 		}
 
-		bool invalidate_params = false;
-		
-		if (!TiffWriter::writeImage(out_file_path, out_img)) {
-			invalidate_params = true;
-		} else {
-			deleteMutuallyExclusiveOutputFiles();
-		}
-
+		// The files are encoded and written in background.  Output params
+		// will be committed once that's done.
+		OutputWriter::Job job(
+			m_pageId, new_output_image_params, new_picture_zones, new_fill_zones
+		);
+		job.setOutputFile(out_file_path, out_img);
 		if (write_automask) {
-			// Note that QDir::mkdir() will fail if the parent directory,
-			// that is $OUT/cache doesn't exist. We want that behaviour,
-			// as otherwise when loading a project from a different machine,
-			// a whole bunch of bogus directories would be created.
-			QDir().mkdir(automask_dir);
-			// Also note that QDir::mkdir() will fail if the directory already exists,
-			// so we ignore its return value here.
-
-			if (!TiffWriter::writeImage(automask_file_path, automask_img.toQImage())) {
-				invalidate_params = true;
-			}
+			job.setAutomaskFile(automask_file_path, automask_img.toQImage());
 		}
 		if (write_speckles_file) {
-			if (!QDir().mkpath(speckles_dir)) {
-				invalidate_params = true;
-			} else if (!TiffWriter::writeImage(speckles_file_path, speckles_img.toQImage())) {
-				invalidate_params = true;
-			}
+			job.setSpecklesFile(speckles_file_path, speckles_img.toQImage());
 		}
-
-		if (invalidate_params) {
-			m_ptrSettings->removeOutputParams(m_pageId);
-		} else {
-			// Note that we can't reuse *_file_info objects
-			// as we've just overwritten those files.
-			OutputParams const out_params(
-				new_output_image_params,
-				OutputFileParams(QFileInfo(out_file_path)),
-				write_automask ? OutputFileParams(QFileInfo(automask_file_path))
-				: OutputFileParams(),
-				write_speckles_file ? OutputFileParams(QFileInfo(speckles_file_path))
-				: OutputFileParams(),
-				new_picture_zones, new_fill_zones
-			);
-
-			m_ptrSettings->setOutputParams(m_pageId, out_params);
+		QStringList const obsolete_files(mutuallyExclusiveOutputFiles());
+		for (int i = 0; i < obsolete_files.size(); ++i) {
+			job.addObsoleteFile(obsolete_files[i]);
 		}
+		if (Profiler::isEnabled()) {
+			job.setProfileLabel(Profiler::instance().currentPage());
+		}
+		m_ptrWriter->enqueue(job);
 		
 		m_ptrThumbnailCache->recreateThumbnail(ImageId(out_file_path), out_img);
 	}
 
+	if (!CommandLine::get().isGui()) {
+		return FilterResultPtr(0);
+	} else if (m_batchProcessing) {
+		return FilterResultPtr(new BatchUiUpdater(m_ptrFilter, m_pageId));
+	}
+
 	DespeckleState const despeckle_state(
-		out_img, speckles_img, params.despeckleLevel(), params.outputDpi()
+		!need_reprocess && defer_speckles
+		? DespeckleState(
+			out_img, speckles_file_path, m_ptrWriter, m_pageId,
+			params.despeckleLevel(), params.outputDpi()
+		)
+		: DespeckleState(out_img, speckles_img, params.despeckleLevel(), params.outputDpi())
 	);
 
 	DespeckleVisualization despeckle_visualization;
@@ -387,35 +410,32 @@ Task::process(
 		despeckle_visualization = despeckle_state.visualize();
 	}
 
-	if (CommandLine::get().isGui()) {
-		return FilterResultPtr(
-			new UiUpdater(
-				m_ptrFilter, m_ptrSettings, m_ptrDbg, params,
-				new_xform, generator.outputContentRect(),
-				m_pageId, data.origImage(), out_img, automask_img,
-				despeckle_state, despeckle_visualization,
-				m_batchProcessing, m_debug
-			)
-		);
-	} else {
-		return FilterResultPtr(0);
-	}
+	return FilterResultPtr(
+		new UiUpdater(
+			m_ptrFilter, m_ptrSettings, m_ptrDbg, params,
+			new_xform, generator.outputContentRect(),
+			m_pageId, data.origImage(), out_img, automask_img,
+			despeckle_state, despeckle_visualization, m_debug
+		)
+	);
 }
 
 /**
- * Delete output files mutually exclusive to m_pageId.
+ * Output files mutually exclusive to m_pageId.  They are removed
+ * by OutputWriter once the files of m_pageId are written.
  */
-void
-Task::deleteMutuallyExclusiveOutputFiles()
+QStringList
+Task::mutuallyExclusiveOutputFiles() const
 {
+	QStringList files;
 	switch (m_pageId.subPage()) {
 		case PageId::SINGLE_PAGE:
-			QFile::remove(
+			files.push_back(
 				m_outFileNameGen.filePathFor(
 					PageId(m_pageId.imageId(), PageId::LEFT_PAGE)
 				)
 			);
-			QFile::remove(
+			files.push_back(
 				m_outFileNameGen.filePathFor(
 					PageId(m_pageId.imageId(), PageId::RIGHT_PAGE)
 				)
@@ -423,13 +443,14 @@ Task::deleteMutuallyExclusiveOutputFiles()
 			break;
 		case PageId::LEFT_PAGE:
 		case PageId::RIGHT_PAGE:
-			QFile::remove(
+			files.push_back(
 				m_outFileNameGen.filePathFor(
 					PageId(m_pageId.imageId(), PageId::SINGLE_PAGE)
 				)
 			);
 			break;
 	}
+	return files;
 }
 
 
@@ -448,7 +469,7 @@ Task::UiUpdater::UiUpdater(
 	BinaryImage const& picture_mask,
 	DespeckleState const& despeckle_state,
 	DespeckleVisualization const& despeckle_visualization,
-	bool const batch, bool const debug)
+	bool const debug)
 :	m_ptrFilter(filter),
 	m_ptrSettings(settings),
 	m_ptrDbg(dbg_img),
@@ -463,11 +484,16 @@ Task::UiUpdater::UiUpdater(
 	m_pictureMask(picture_mask),
 	m_despeckleState(despeckle_state),
 	m_despeckleVisualization(despeckle_visualization),
-	m_batchProcessing(batch),
 	m_debug(debug)
 {
 }
 
+void
+Task::UiUpdater::updateThumbnails(FilterUiInterface* ui)
+{
+	ui->invalidateThumbnail(m_pageId);
+}
+
 void
 Task::UiUpdater::updateUI(FilterUiInterface* ui)
 {
@@ -477,11 +503,7 @@ Task::UiUpdater::updateUI(FilterUiInterface* ui)
 	opt_widget->postUpdateUI();
 	ui->setOptionsWidget(opt_widget, ui->KEEP_OWNERSHIP);
 	
-	ui->invalidateThumbnail(m_pageId);
-	
-	if (m_batchProcessing) {
-		return;
-	}
+	updateThumbnails(ui);
 
 	std::auto_ptr<ImageViewBase> image_view(
 		new ImageView(m_outputImage, m_downscaledOutputImage)
@@ -595,4 +617,26 @@ Task::UiUpdater::updateUI(FilterUiInterface* ui)
 	ui->setImageWidget(tab_widget.release(), ui->TRANSFER_OWNERSHIP, m_ptrDbg.get());
 }
 
+
+/*============================ Task::BatchUiUpdater ==========================*/
+
+Task::BatchUiUpdater::BatchUiUpdater(
+	IntrusivePtr<Filter> const& filter, PageId const& page_id)
+:	m_ptrFilter(filter),
+	m_pageId(page_id)
+{
+}
+
+void
+Task::BatchUiUpdater::updateUI(FilterUiInterface* ui)
+{
+	// This function is executed from the GUI thread.
+	
+	OptionsWidget* const opt_widget = m_ptrFilter->optionsWidget();
+	opt_widget->postUpdateUI();
+	ui->setOptionsWidget(opt_widget, ui->KEEP_OWNERSHIP);
+	
+	ui->invalidateThumbnail(m_pageId);
+}
+
 } // namespace output
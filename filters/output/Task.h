@@ -26,6 +26,7 @@
 #include "ImageViewTab.h"
 #include "OutputFileNameGenerator.h"
 #include <QColor>
+#include <QStringList>
 #include <memory>
 
 class DebugImages;
@@ -48,6 +49,7 @@ namespace output
 
 class Filter;
 class Settings;
+class OutputWriter;
 
 class Task : public RefCountable
 {
@@ -55,6 +57,7 @@ class Task : public RefCountable
 public:
 	Task(IntrusivePtr<Filter> const& filter,
 		IntrusivePtr<Settings> const& settings,
+		IntrusivePtr<OutputWriter> const& writer,
 		IntrusivePtr<ThumbnailPixmapCache> const& thumbnail_cache,
 		PageId const& page_id, OutputFileNameGenerator const& out_file_name_gen,
 		ImageViewTab last_tab, bool batch, bool debug);
@@ -66,11 +69,13 @@ public:
 		QPolygonF const& content_rect_phys);
 private:
 	class UiUpdater;
+	class BatchUiUpdater;
 	
-	void deleteMutuallyExclusiveOutputFiles();
+	QStringList mutuallyExclusiveOutputFiles() const;
 
 	IntrusivePtr<Filter> m_ptrFilter;
 	IntrusivePtr<Settings> m_ptrSettings;
+	IntrusivePtr<OutputWriter> m_ptrWriter;
 	IntrusivePtr<ThumbnailPixmapCache> m_ptrThumbnailCache;
 	std::auto_ptr<DebugImages> m_ptrDbg;
 	PageId m_pageId;
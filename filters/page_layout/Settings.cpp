@@ -156,11 +156,18 @@ public:
 	QSizeF getAggregateHardSizeMM(
 		PageId const& page_id, QSizeF const& hard_size_mm,
 		Alignment const& alignment) const;
+
+	RevisionMap<PageId>::Revision pageRevision(PageId const& page_id) const;
 private:
 	class SequencedTag;
 	class DescWidthTag;
 	class DescHeightTag;
 	
+	/**
+	 * The DescWidthTag and DescHeightTag indices keep the aggregate
+	 * hard size up to date as items change, at O(log N) per change.
+	 * Reading it is then just a matter of looking at their first items.
+	 */
 	typedef multi_index_container<
 		Item,
 		indexed_by<
@@ -201,6 +208,7 @@ private:
 	
 	mutable QMutex m_mutex;
 	Container m_items;
+	RevisionMap<PageId> m_revisions;
 	UnorderedItems& m_unorderedItems;
 	DescWidthOrder& m_descWidthOrder;
 	DescHeightOrder& m_descHeightOrder;
@@ -320,6 +328,12 @@ Settings::getAggregateHardSizeMM(
 	return m_ptrImpl->getAggregateHardSizeMM(page_id, hard_size_mm, alignment);
 }
 
+RevisionMap<PageId>::Revision
+Settings::pageRevision(PageId const& page_id) const
+{
+	return m_ptrImpl->pageRevision(page_id);
+}
+
 
 /*============================== Settings::Item =============================*/
 
@@ -380,6 +394,7 @@ Settings::Impl::clear()
 {
 	QMutexLocker const locker(&m_mutex);
 	m_items.clear();
+	m_revisions.touchAll();
 }
 
 void
@@ -396,6 +411,7 @@ Settings::Impl::performRelinking(AbstractRelinker const& relinker)
 	}
 
 	m_items.swap(new_items);
+	m_revisions.touchAll();
 }
 
 void
@@ -420,6 +436,8 @@ Settings::Impl::removePagesMissingFrom(PageSequence const& pages)
 			m_unorderedItems.erase(it++);
 		}
 	}
+
+	m_revisions.touchAll();
 }
 
 bool
@@ -462,6 +480,7 @@ void
 Settings::Impl::setPageParams(PageId const& page_id, Params const& params)
 {
 	QMutexLocker const locker(&m_mutex);
+	m_revisions.touch(page_id);
 	
 	Item const new_item(
 		page_id, params.hardMarginsMM(),
@@ -495,8 +514,13 @@ Settings::Impl::updateContentSizeAndGetParams(
 			content_size_mm, m_defaultAlignment
 		);
 		item_it = m_items.insert(it, item);
-	} else {
+		m_revisions.touch(page_id);
+	} else if (it->contentSizeMM != content_size_mm) {
+		// Re-processing a page usually yields the same content size,
+		// in which case there is no need to re-sort the ordered indices,
+		// nor to bump the page's revision.
 		m_items.modify(it, ModifyContentSize(content_size_mm));
+		m_revisions.touch(page_id);
 	}
 	
 	if (agg_hard_size_after) {
@@ -527,6 +551,7 @@ Settings::Impl::setHardMarginsMM(
 	PageId const& page_id, Margins const& margins_mm)
 {
 	QMutexLocker const locker(&m_mutex);
+	m_revisions.touch(page_id);
 	
 	Container::iterator const it(m_items.lower_bound(page_id));
 	if (it == m_items.end() || page_id < it->pageId) {
@@ -557,6 +582,7 @@ Settings::Impl::setPageAlignment(
 	PageId const& page_id, Alignment const& alignment)
 {
 	QMutexLocker const locker(&m_mutex);
+	m_revisions.touch(page_id);
 	
 	QSizeF const agg_size_before(getAggregateHardSizeMMLocked());
 
@@ -593,8 +619,10 @@ Settings::Impl::setContentSizeMM(
 			content_size_mm, m_defaultAlignment
 		);
 		m_items.insert(it, item);
-	} else {
+		m_revisions.touch(page_id);
+	} else if (it->contentSizeMM != content_size_mm) {
 		m_items.modify(it, ModifyContentSize(content_size_mm));
+		m_revisions.touch(page_id);
 	}
 	
 	QSizeF const agg_size_after(getAggregateHardSizeMMLocked());
@@ -611,8 +639,9 @@ Settings::Impl::invalidateContentSize(PageId const& page_id)
 	QMutexLocker const locker(&m_mutex);
 	
 	Container::iterator const it(m_items.find(page_id));
-	if (it != m_items.end()) {
+	if (it != m_items.end() && it->contentSizeMM != m_invalidSize) {
 		m_items.modify(it, ModifyContentSize(m_invalidSize));
+		m_revisions.touch(page_id);
 	}
 }
 
@@ -693,4 +722,11 @@ Settings::Impl::getAggregateHardSizeMM(
 	return QSizeF(width, height);
 }
 
+RevisionMap<PageId>::Revision
+Settings::Impl::pageRevision(PageId const& page_id) const
+{
+	QMutexLocker const locker(&m_mutex);
+	return m_revisions.revision(page_id);
+}
+
 } // namespace page_layout
@@ -22,9 +22,10 @@
 #include "NonCopyable.h"
 #include "RefCountable.h"
 #include "Margins.h"
+#include "PageId.h"
+#include "RevisionMap.h"
 #include <memory>
 
-class PageId;
 class Margins;
 class PageSequence;
 class AbstractRelinker;
@@ -155,6 +156,12 @@ public:
 	QSizeF getAggregateHardSizeMM(
 		PageId const& page_id, QSizeF const& hard_size_mm,
 		Alignment const& alignment) const;
+
+	/**
+	 * \brief Returns a number that changes whenever the parameters
+	 *        of the given page change.
+	 */
+	RevisionMap<PageId>::Revision pageRevision(PageId const& page_id) const;
 private:
 	class Impl;
 	class Item;
@@ -26,6 +26,7 @@
 #include "FilterUiInterface.h"
 #include "TaskStatus.h"
 #include "FilterData.h"
+#include "Profiler.h"
 #include "ImageView.h"
 #include "ImageTransformation.h"
 #include "PhysicalTransformation.h"
@@ -55,6 +56,8 @@ public:
 	
 	virtual void updateUI(FilterUiInterface* ui);
 	
+	virtual void updateThumbnails(FilterUiInterface* ui);
+	
 	virtual IntrusivePtr<AbstractFilter> filter() { return m_ptrFilter; }
 private:
 	IntrusivePtr<Filter> m_ptrFilter;
@@ -90,6 +93,8 @@ Task::process(
 	TaskStatus const& status, FilterData const& data,
 	QRectF const& content_rect)
 {
+	ProfileSpan const span("page_layout::Task::process");
+
 	status.throwIfCancelled();
 	
 	QSizeF const content_size_mm(
@@ -162,6 +167,16 @@ Task::UiUpdater::UiUpdater(
 {
 }
 
+void
+Task::UiUpdater::updateThumbnails(FilterUiInterface* ui)
+{
+	if (m_aggSizeChanged) {
+		ui->invalidateAllThumbnails();
+	} else {
+		ui->invalidateThumbnail(m_pageId);
+	}
+}
+
 void
 Task::UiUpdater::updateUI(FilterUiInterface* ui)
 {
@@ -171,11 +186,7 @@ Task::UiUpdater::updateUI(FilterUiInterface* ui)
 	opt_widget->postUpdateUI();
 	ui->setOptionsWidget(opt_widget, ui->KEEP_OWNERSHIP);
 	
-	if (m_aggSizeChanged) {
-		ui->invalidateAllThumbnails();
-	} else {
-		ui->invalidateThumbnail(m_pageId);
-	}
+	updateThumbnails(ui);
 	
 	if (m_batchProcessing) {
 		return;
@@ -31,6 +31,7 @@
 #include "Params.h"
 #include "CacheDrivenTask.h"
 #include "OrthogonalRotation.h"
+#include "XmlStreamUtils.h"
 #ifndef Q_MOC_RUN
 #include <boost/lambda/lambda.hpp>
 #include <boost/lambda/bind.hpp>
@@ -38,7 +39,11 @@
 #include <QString>
 #include <QObject>
 #include <QCoreApplication>
+#include <QDomDocument>
 #include <QDomElement>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+#include <QLatin1String>
 #include <stddef.h>
 #include "CommandLine.h"
 #include "OrderBySplitTypeProvider.h"
@@ -97,52 +102,55 @@ Filter::preUpdateUI(FilterUiInterface* ui, PageId const& page_id)
 	ui->setOptionsWidget(m_ptrOptionsWidget.get(), ui->KEEP_OWNERSHIP);
 }
 
-QDomElement
+QString
+Filter::settingsElementName() const
+{
+	return "page-split";
+}
+
+void
 Filter::saveSettings(
-	ProjectWriter const& writer, QDomDocument& doc) const
+	ProjectWriter const& writer, QXmlStreamWriter& xml) const
 {
 	using namespace boost::lambda;
 	
-	QDomElement filter_el(doc.createElement("page-split"));
-	filter_el.setAttribute(
+	QXmlStreamAttributes attributes;
+	attributes.append(
 		"defaultLayoutType",
 		layoutTypeToString(m_ptrSettings->defaultLayoutType())
 	);
+	writer.writeSettingsStart(xml, settingsElementName(), attributes);
 	
 	writer.enumImages(
 		boost::lambda::bind(
-			&Filter::writeImageSettings,
-			this, boost::ref(doc), var(filter_el), boost::lambda::_1, boost::lambda::_2
+			&Filter::writeImageSettings, this, boost::cref(writer),
+			boost::ref(xml), boost::lambda::_1, boost::lambda::_2
 		)
 	);
 	
-	return filter_el;
+	xml.writeEndElement();
 }
 
 void
-Filter::loadSettings(
-	ProjectReader const& reader, QDomElement const& filters_el)
+Filter::loadSettings(ProjectReader const& reader, QXmlStreamReader& xml)
 {
 	m_ptrSettings->clear();
 	
-	QDomElement const filter_el(filters_el.namedItem("page-split").toElement());
 	QString const default_layout_type(
-		filter_el.attribute("defaultLayoutType")
+		xml.attributes().value(QLatin1String("defaultLayoutType")).toString()
 	);
 	m_ptrSettings->setLayoutTypeForAllPages(
 		layoutTypeFromString(default_layout_type)
 	);
 	
-	QString const image_tag_name("image");
-	QDomNode node(filter_el.firstChild());
-	for (; !node.isNull(); node = node.nextSibling()) {
-		if (!node.isElement()) {
+	while (xml.readNextStartElement()) {
+		if (xml.name() != QLatin1String("image")) {
+			xml.skipCurrentElement();
 			continue;
 		}
-		if (node.nodeName() != image_tag_name) {
-			continue;
-		}
-		QDomElement el(node.toElement());
+
+		QDomDocument doc;
+		QDomElement const el(XmlStreamUtils::readElement(xml, doc));
 		
 		bool ok = true;
 		int const id = el.attribute("id").toInt(&ok);
@@ -193,23 +201,32 @@ Filter::pageOrientationUpdate(
 
 void
 Filter::writeImageSettings(
-	QDomDocument& doc, QDomElement& filter_el,
+	ProjectWriter const& writer, QXmlStreamWriter& xml,
 	ImageId const& image_id, int const numeric_id) const
 {
-	Settings::Record const record(m_ptrSettings->getPageRecord(image_id));
-	
-	QDomElement image_el(doc.createElement("image"));
-	image_el.setAttribute("id", numeric_id);
-	if (LayoutType const* layout_type = record.layoutType()) {
-		image_el.setAttribute(
-			"layoutType", layoutTypeToString(*layout_type)
-		);
+	RevisionMap<ImageId>::Revision const revision(
+		m_ptrSettings->imageRevision(image_id)
+	);
+	if (m_fragmentCache.writeCached(writer, xml, image_id, numeric_id, revision)) {
+		return;
 	}
+
+	Settings::Record const record(m_ptrSettings->getPageRecord(image_id));
 	
+	QDomDocument doc;
+	QDomElement image_el;
 	if (Params const* params = record.params()) {
+		image_el = doc.createElement("image");
+		image_el.setAttribute("id", numeric_id);
+		if (LayoutType const* layout_type = record.layoutType()) {
+			image_el.setAttribute(
+				"layoutType", layoutTypeToString(*layout_type)
+			);
+		}
 		image_el.appendChild(params->toXml(doc, "params"));
-		filter_el.appendChild(image_el);
 	}
+
+	m_fragmentCache.writeAndCache(writer, xml, image_id, numeric_id, revision, image_el);
 }
 
 IntrusivePtr<Task>
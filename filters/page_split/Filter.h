@@ -25,16 +25,19 @@
 #include "IntrusivePtr.h"
 #include "FilterResult.h"
 #include "SafeDeletingQObjectPtr.h"
+#include "XmlFragmentCache.h"
+#include "ImageId.h"
 #include <set>
 #include "PageOrderOption.h"
 #include <QCoreApplication>
 
 class PageId;
-class ImageId;
 class PageInfo;
 class ProjectPages;
 class PageSelectionAccessor;
 class OrthogonalRotation;
+class QXmlStreamReader;
+class QXmlStreamWriter;
 
 namespace deskew
 {
@@ -69,11 +72,13 @@ public:
 	
 	virtual void preUpdateUI(FilterUiInterface* ui, PageId const& page_id);
 	
-	virtual QDomElement saveSettings(
-		ProjectWriter const& wirter, QDomDocument& doc) const;
+	virtual QString settingsElementName() const;
+
+	virtual void saveSettings(
+		ProjectWriter const& writer, QXmlStreamWriter& xml) const;
 	
 	virtual void loadSettings(
-		ProjectReader const& reader, QDomElement const& filters_el);
+		ProjectReader const& reader, QXmlStreamReader& xml);
 	
 	IntrusivePtr<Task> createTask(PageInfo const& page_info,
 		IntrusivePtr<deskew::Task> const& next_task,
@@ -94,11 +99,12 @@ public:
 	virtual void selectPageOrder(int option);
 private:
 	void writeImageSettings(
-		QDomDocument& doc, QDomElement& filter_el,
+		ProjectWriter const& writer, QXmlStreamWriter& xml,
 		ImageId const& image_id, int const numeric_id) const;
 	
 	IntrusivePtr<ProjectPages> m_ptrPages;
 	IntrusivePtr<Settings> m_ptrSettings;
+	mutable XmlFragmentCache<ImageId> m_fragmentCache;
 	SafeDeletingQObjectPtr<OptionsWidget> m_ptrOptionsWidget;
 	std::vector<PageOrderOption> m_pageOrderOptions;
 	int m_selectedPageOrder;
@@ -26,6 +26,7 @@
 #include "DebugImages.h"
 #include "Dpi.h"
 #include "ImageTransformation.h"
+#include "DerivedImageCache.h"
 #include "foundation/Span.h"
 #include "imageproc/Binarize.h"
 #include "imageproc/BinaryThreshold.h"
@@ -248,7 +249,7 @@ PageLayout
 PageLayoutEstimator::estimatePageLayout(
 	LayoutType const layout_type, QImage const& input,
 	ImageTransformation const& pre_xform,
-	BinaryThreshold const bw_threshold,
+	DerivedImageCache& derived_images,
 	DebugImages* const dbg)
 {
 	if (layout_type == SINGLE_PAGE_UNCUT) {
@@ -262,7 +263,7 @@ PageLayoutEstimator::estimatePageLayout(
 		return *layout;
 	}
 	
-	return cutAtWhitespace(layout_type, input, pre_xform, bw_threshold, dbg);
+	return cutAtWhitespace(layout_type, input, pre_xform, derived_images, dbg);
 }
 
 namespace
@@ -388,7 +389,7 @@ PageLayoutEstimator::tryCutAtFoldingLine(
  *        it's already grayscale.
  * \param pre_xform The logical transformation applied to the input image.
  *        The resulting page layout will be in transformed coordinates.
- * \param bw_threshold The global binarization threshold for the input image.
+ * \param derived_images Binarized versions of the input image.
  * \param dbg An optional sink for debugging images.
  * \return Even if no suitable whitespace was found, this function
  *         will return a PageLayout consistent with the layout_type requested.
@@ -397,17 +398,17 @@ PageLayout
 PageLayoutEstimator::cutAtWhitespace(
 	LayoutType const layout_type, QImage const& input,
 	ImageTransformation const& pre_xform,
-	BinaryThreshold const bw_threshold,
+	DerivedImageCache& derived_images,
 	DebugImages* const dbg)
 {
 	QTransform xform;
 	
 	// Convert to B/W and rotate.
-	BinaryImage img(to300DpiBinary(input, xform, bw_threshold));
-	
 	// Note: here we assume the only transformation applied
 	// to the input image is orthogonal rotation.
-	img = orthogonalRotation(img, pre_xform.preRotation().toDegrees());
+	BinaryImage img(
+		derived_images.rotatedBinary300(pre_xform.preRotation(), &xform)
+	);
 	if (dbg) {
 		dbg->add(img, "bw300");
 	}
@@ -549,29 +550,6 @@ PageLayoutEstimator::cutAtWhitespaceDeskewed150(
 	}
 }
 
-imageproc::BinaryImage
-PageLayoutEstimator::to300DpiBinary(
-	QImage const& img, QTransform& xform,
-	BinaryThreshold const binary_threshold)
-{
-	double const xfactor = (300.0 * constants::DPI2DPM) / img.dotsPerMeterX();
-	double const yfactor = (300.0 * constants::DPI2DPM) / img.dotsPerMeterY();
-	if (fabs(xfactor - 1.0) < 0.1 && fabs(yfactor - 1.0) < 0.1) {
-		return BinaryImage(img, binary_threshold);
-	}
-	
-	QTransform scale_xform;
-	scale_xform.scale(xfactor, yfactor);
-	xform *= scale_xform;
-	QSize const new_size(
-		std::max(1, (int)ceil(xfactor * img.width())),
-		std::max(1, (int)ceil(yfactor * img.height()))
-	);
-	
-	GrayImage const new_image(scaleToGray(GrayImage(img), new_size));
-	return BinaryImage(new_image, binary_threshold);
-}
-
 BinaryImage
 PageLayoutEstimator::removeGarbageAnd2xDownscale(
 	BinaryImage const& image, DebugImages* dbg)
@@ -30,6 +30,7 @@ class QPoint;
 class QImage;
 class QTransform;
 class ImageTransformation;
+class DerivedImageCache;
 class DebugImages;
 class Span;
 
@@ -57,8 +58,7 @@ public:
 	 *        it's already grayscale.
 	 * \param pre_xform The logical transformation applied to the input image.
 	 *        The resulting page layout will be in transformed coordinates.
-	 * \param bw_threshold The global binarization threshold for the
-	 *        input image.
+	 * \param derived_images Binarized versions of the input image.
 	 * \param dbg An optional sink for debugging images.
 	 * \return The estimated PageLayout of type consistent with the
 	 *         requested layout type.
@@ -66,7 +66,7 @@ public:
 	static PageLayout estimatePageLayout(
 		LayoutType layout_type, QImage const& input,
 		ImageTransformation const& pre_xform,
-		imageproc::BinaryThreshold bw_threshold,
+		DerivedImageCache& derived_images,
 		DebugImages* dbg = 0);
 private:
 	static std::auto_ptr<PageLayout> tryCutAtFoldingLine(
@@ -76,7 +76,7 @@ private:
 	static PageLayout cutAtWhitespace(
 		LayoutType layout_type, QImage const& input,
 		ImageTransformation const& pre_xform,
-		imageproc::BinaryThreshold const bw_threshold,
+		DerivedImageCache& derived_images,
 		DebugImages* dbg);
 	
 	static PageLayout cutAtWhitespaceDeskewed150(
@@ -84,10 +84,6 @@ private:
 		imageproc::BinaryImage const& input,
 		bool left_offcut, bool right_offcut, DebugImages* dbg);
 	
-	static imageproc::BinaryImage to300DpiBinary(
-		QImage const& img, QTransform& xform,
-		imageproc::BinaryThreshold threshold);
-	
 	static imageproc::BinaryImage removeGarbageAnd2xDownscale(
 		imageproc::BinaryImage const& image, DebugImages* dbg);
 	
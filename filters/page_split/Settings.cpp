@@ -43,6 +43,7 @@ Settings::clear()
 	QMutexLocker locker(&m_mutex);
 	
 	m_perPageRecords.clear();
+	m_revisions.touchAll();
 	m_defaultLayoutType = AUTO_LAYOUT_TYPE;
 }
 
@@ -60,6 +61,7 @@ Settings::performRelinking(AbstractRelinker const& relinker)
 	}
 
 	m_perPageRecords.swap(new_records);
+	m_revisions.touchAll();
 }
 
 LayoutType
@@ -85,6 +87,7 @@ Settings::setLayoutTypeForAllPages(LayoutType const layout_type)
 		}
 	}
 	
+	m_revisions.touchAll();
 	m_defaultLayoutType = layout_type;
 }
 
@@ -129,6 +132,8 @@ Settings::updatePage(ImageId const& image_id, UpdateAction const& action)
 void
 Settings::updatePageLocked(ImageId const& image_id, UpdateAction const& action)
 {
+	m_revisions.touch(image_id);
+
 	PerPageRecords::iterator it(m_perPageRecords.lower_bound(image_id));
 	if (it == m_perPageRecords.end() ||
 			m_perPageRecords.key_comp()(image_id, it->first)) {
@@ -194,6 +199,7 @@ Settings::conditionalUpdate(
 			m_perPageRecords.insert(
 				it, PerPageRecords::value_type(image_id, record)
 			);
+			m_revisions.touch(image_id);
 		}
 		
 		if (conflict) {
@@ -216,6 +222,8 @@ Settings::conditionalUpdate(
 		if (conflict) {
 			*conflict = false;
 		}
+
+		m_revisions.touch(image_id);
 		
 		if (record.isNull()) {
 			m_perPageRecords.erase(it);
@@ -228,6 +236,14 @@ Settings::conditionalUpdate(
 }
 
 
+RevisionMap<ImageId>::Revision
+Settings::imageRevision(ImageId const& image_id) const
+{
+	QMutexLocker locker(&m_mutex);
+	return m_revisions.revision(image_id);
+}
+
+
 /*======================= Settings::BaseRecord ======================*/
 
 Settings::BaseRecord::BaseRecord()
@@ -26,6 +26,7 @@
 #include "Params.h"
 #include "ImageId.h"
 #include "PageId.h"
+#include "RevisionMap.h"
 #include <QMutex>
 #include <memory>
 #include <map>
@@ -181,6 +182,12 @@ public:
 	Record conditionalUpdate(
 		ImageId const& image_id, UpdateAction const& action,
 		bool* conflict = 0);
+
+	/**
+	 * \brief Returns a number that changes whenever the record
+	 *        for the given image changes.
+	 */
+	RevisionMap<ImageId>::Revision imageRevision(ImageId const& image_id) const;
 private:
 	typedef std::map<ImageId, BaseRecord> PerPageRecords;
 	
@@ -192,6 +199,7 @@ private:
 	
 	mutable QMutex m_mutex;
 	PerPageRecords m_perPageRecords;
+	RevisionMap<ImageId> m_revisions;
 	LayoutType m_defaultLayoutType;
 };
 
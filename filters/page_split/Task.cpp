@@ -30,6 +30,7 @@
 #include "Dependencies.h"
 #include "Params.h"
 #include "FilterData.h"
+#include "Profiler.h"
 #include "ImageMetadata.h"
 #include "Dpm.h"
 #include "Dpi.h"
@@ -63,6 +64,8 @@ public:
 	
 	virtual void updateUI(FilterUiInterface* ui);
 	
+	virtual void updateThumbnails(FilterUiInterface* ui);
+	
 	virtual IntrusivePtr<AbstractFilter> filter() { return m_ptrFilter; }
 private:
 	IntrusivePtr<Filter> m_ptrFilter;
@@ -116,13 +119,15 @@ Task::~Task()
 FilterResultPtr
 Task::process(TaskStatus const& status, FilterData const& data)
 {
+	ProfileSpan const span("page_split::Task::process");
+
 	status.throwIfCancelled();
 	
 	Settings::Record record(m_ptrSettings->getPageRecord(m_pageInfo.imageId()));
 	
 	OrthogonalRotation const pre_rotation(data.xform().preRotation());
 	Dependencies const deps(
-		data.origImage().size(), pre_rotation,
+		data.xform().origRect().size().toSize(), pre_rotation,
 		record.combinedLayoutType()
 	);
 	
@@ -138,7 +143,7 @@ Task::process(TaskStatus const& status, FilterData const& data)
 			new_layout = PageLayoutEstimator::estimatePageLayout(
 				record.combinedLayoutType(),
 				data.grayImage(), data.xform(),
-				data.bwThreshold(), m_ptrDbg.get()
+				data.derivedImages(), m_ptrDbg.get()
 			);
 			status.throwIfCancelled();
 		} else if (params->pageLayout().uncutOutline().isEmpty()) {
@@ -230,6 +235,12 @@ Task::UiUpdater::UiUpdater(
 {
 }
 
+void
+Task::UiUpdater::updateThumbnails(FilterUiInterface* ui)
+{
+	ui->invalidateThumbnail(m_pageInfo.id());
+}
+
 void
 Task::UiUpdater::updateUI(FilterUiInterface* ui)
 {
@@ -239,7 +250,7 @@ Task::UiUpdater::updateUI(FilterUiInterface* ui)
 	opt_widget->postUpdateUI(m_uiData);
 	ui->setOptionsWidget(opt_widget, ui->KEEP_OWNERSHIP);
 	
-	ui->invalidateThumbnail(m_pageInfo.id());
+	updateThumbnails(ui);
 	
 	if (m_batchProcessing) {
 		return;
@@ -41,6 +41,7 @@
 #include <Qt>
 #include <QDebug>
 #include <list>
+#include <vector>
 #include <algorithm>
 #include <math.h>
 
@@ -152,12 +153,14 @@ VertLineFinder::findLines(
 	int const height = raster_lines.height();
 	uint8_t const* line = raster_lines.data();
 	int const stride = raster_lines.stride();
+	std::vector<unsigned> weights(std::max(x_limit - margin, 0));
 	for (int y = 0; y < height; ++y, line += stride) {
 		for (int x = margin; x < x_limit; ++x) {
 			unsigned const val = line[x];
-			if (val > 1) {
-				line_detector.process(x, y, weight_table[val]);
-			}
+			weights[x - margin] = val > 1 ? weight_table[val] : 0;
+		}
+		if (!weights.empty()) {
+			line_detector.processRow(y, margin, x_limit, &weights[0]);
 		}
 	}
 	
@@ -48,6 +48,7 @@
 #include <QRect>
 #include <QRectF>
 #include <QPolygonF>
+#include <QPointF>
 #include <QImage>
 #include <QColor>
 #include <QPainter>
@@ -110,11 +111,39 @@ struct PreferVertical
 	}
 };
 
+/**
+ * The heuristics below were tuned for 150 dpi.  This converts
+ * a distance in pixels at 150 dpi to the resolution we work at.
+ */
+int scaledFrom150Dpi(int const pixels, int const dpi)
+{
+	return std::max(1, (pixels * dpi + 75) / 150);
+}
+
+Despeckle::Level contentDespeckleLevel()
+{
+	CommandLine const& cli = CommandLine::get();
+	if (cli.hasContentRect()) {
+		return cli.getContentDetection();
+	}
+	return Despeckle::NORMAL;
+}
+
 } // anonymous namespace
 
 QRectF
 ContentBoxFinder::findContentBox(
 	TaskStatus const& status, FilterData const& data, DebugImages* dbg)
+{
+	Mode const mode = CommandLine::get().hasFastContentDetection()
+		? COARSE_TO_FINE : FULL_RESOLUTION;
+	return findContentBox(status, data, mode, dbg);
+}
+
+QRectF
+ContentBoxFinder::findContentBox(
+	TaskStatus const& status, FilterData const& data,
+	Mode const mode, DebugImages* dbg)
 {
 	ImageTransformation xform_150dpi(data.xform());
 	xform_150dpi.preScaleToDpi(Dpi(150, 150));
@@ -123,13 +152,49 @@ ContentBoxFinder::findContentBox(
 		return QRectF();
 	}
 	
+	ImageTransformation xform_75dpi(data.xform());
+	xform_75dpi.preScaleToDpi(Dpi(75, 75));
+	
+	QRect content_rect;
+	if (mode == FULL_RESOLUTION
+			|| xform_75dpi.resultingRect().toRect().isEmpty()) {
+		content_rect = detectContentRect(
+			status, data, xform_150dpi, 150, 0, dbg
+		);
+	} else {
+		BinaryImage coarse_garbage;
+		QRect const coarse_rect(
+			detectContentRect(
+				status, data, xform_75dpi, 75, &coarse_garbage, dbg
+			)
+		);
+		if (!coarse_rect.isEmpty()) {
+			content_rect = refineContentRect(
+				status, data, xform_75dpi, coarse_garbage,
+				coarse_rect, xform_150dpi, dbg
+			);
+		}
+	}
+	
+	// Transform back from 150dpi.
+	QTransform combined_xform(xform_150dpi.transform().inverted());
+	combined_xform *= data.xform().transform();
+	return combined_xform.map(QRectF(content_rect)).boundingRect();
+}
+
+QRect
+ContentBoxFinder::detectContentRect(
+	TaskStatus const& status, FilterData const& data,
+	ImageTransformation const& xform, int const dpi,
+	BinaryImage* garbage_out, DebugImages* dbg)
+{
 	uint8_t const darkest_gray_level = darkestGrayLevel(data.grayImage());
 	QColor const outside_color(darkest_gray_level, darkest_gray_level, darkest_gray_level);
 
-	QImage gray150(
+	QImage gray(
 		transformToGray(
-			data.grayImage(), xform_150dpi.transform(),
-			xform_150dpi.resultingRect().toRect(),
+			data.grayImage(), xform.transform(),
+			xform.resultingRect().toRect(),
 			OutsidePixels::assumeColor(outside_color)
 		)
 	);
@@ -137,29 +202,37 @@ ContentBoxFinder::findContentBox(
 	// rotation with black, not white.  Filling them with white
 	// may be bad for detecting the shadow around the page.
 	if (dbg) {
-		dbg->add(gray150, "gray150");
+		dbg->add(gray, "gray");
 	}
 	
-	BinaryImage bw150(binarizeWolf(gray150, QSize(51, 51), 50));
+	int const window = scaledFrom150Dpi(51, dpi);
+	BinaryImage bw(binarizeWolf(gray, QSize(window, window), 50));
+	gray = QImage();
 	if (dbg) {
-		dbg->add(bw150, "bw150");
+		dbg->add(bw, "bw");
 	}
 	
 	PolygonRasterizer::fillExcept(
-		bw150, BLACK, xform_150dpi.resultingPreCropArea(), Qt::WindingFill
+		bw, BLACK, xform.resultingPreCropArea(), Qt::WindingFill
 	);
 	if (dbg) {
-		dbg->add(bw150, "page_mask_applied");
+		dbg->add(bw, "page_mask_applied");
 	}
 	
-	BinaryImage hor_shadows_seed(openBrick(bw150, QSize(200, 14), BLACK));
+	int const long_side = scaledFrom150Dpi(200, dpi);
+	int const short_side = scaledFrom150Dpi(14, dpi);
+	BinaryImage hor_shadows_seed(
+		openBrick(bw, QSize(long_side, short_side), BLACK)
+	);
 	if (dbg) {
 		dbg->add(hor_shadows_seed, "hor_shadows_seed");
 	}
 	
 	status.throwIfCancelled();
 	
-	BinaryImage ver_shadows_seed(openBrick(bw150, QSize(14, 300), BLACK));
+	BinaryImage ver_shadows_seed(
+		openBrick(bw, QSize(short_side, scaledFrom150Dpi(300, dpi)), BLACK)
+	);
 	if (dbg) {
 		dbg->add(ver_shadows_seed, "ver_shadows_seed");
 	}
@@ -175,14 +248,15 @@ ContentBoxFinder::findContentBox(
 	
 	status.throwIfCancelled();
 	
-	BinaryImage dilated(dilateBrick(bw150, QSize(3, 3)));
+	int const dilation = scaledFrom150Dpi(3, dpi);
+	BinaryImage dilated(dilateBrick(bw, QSize(dilation, dilation)));
 	if (dbg) {
 		dbg->add(dilated, "dilated");
 	}
 	
 	status.throwIfCancelled();
 	
-	BinaryImage shadows_dilated(seedFill(shadows_seed, dilated, CONN8));
+	BinaryImage shadows_dilated(seedFill(shadows_seed, dilated, CONN8, &status));
 	dilated.release();
 	if (dbg) {
 		dbg->add(shadows_dilated, "shadows_dilated");
@@ -190,7 +264,7 @@ ContentBoxFinder::findContentBox(
 	
 	status.throwIfCancelled();
 	
-	rasterOp<RopAnd<RopSrc, RopDst> >(shadows_dilated, bw150);
+	rasterOp<RopAnd<RopSrc, RopDst> >(shadows_dilated, bw);
 	BinaryImage garbage(shadows_dilated.release());
 	if (dbg) {
 		dbg->add(garbage, "shadows");
@@ -198,14 +272,17 @@ ContentBoxFinder::findContentBox(
 	
 	status.throwIfCancelled();
 	
-	filterShadows(status, garbage, dbg);
+	filterShadows(status, garbage, dpi, dbg);
 	if (dbg) {
 		dbg->add(garbage, "filtered_shadows");
 	}
+	if (garbage_out) {
+		*garbage_out = garbage;
+	}
 	
 	status.throwIfCancelled();
 	
-	BinaryImage content(bw150.release());
+	BinaryImage content(bw.release());
 	rasterOp<RopSubtract<RopDst, RopSrc> >(content, garbage);
 	if (dbg) {
 		dbg->add(content, "content");
@@ -213,13 +290,11 @@ ContentBoxFinder::findContentBox(
 	
 	status.throwIfCancelled();
 	
-	CommandLine const& cli = CommandLine::get();
-	Despeckle::Level despeckleLevel = Despeckle::NORMAL;
-	if (cli.hasContentRect()) {
-		despeckleLevel = cli.getContentDetection();
-	}
-
-	BinaryImage despeckled(Despeckle::despeckle(content, Dpi(150, 150), despeckleLevel, status, dbg));
+	BinaryImage despeckled(
+		Despeckle::despeckle(
+			content, Dpi(dpi, dpi), contentDespeckleLevel(), status, dbg
+		)
+	);
 	if (dbg) {
 		dbg->add(despeckled, "despeckled");
 	}
@@ -227,7 +302,7 @@ ContentBoxFinder::findContentBox(
 	status.throwIfCancelled();
 	
 	BinaryImage content_blocks(content.size(), BLACK);
-	int const area_threshold = std::min(content.width(), content.height());
+	int const area_threshold = std::min(content.width(), content.height()) * dpi / 150;
 	
 	{
 		MaxWhitespaceFinder hor_ws_finder(PreferHorizontal(), despeckled);
@@ -281,7 +356,8 @@ ContentBoxFinder::findContentBox(
 	{
 		BinaryImage tmp(content);
 		rasterOp<RopOr<RopNot<RopSrc>, RopDst> >(tmp, content_blocks);
-		MaxWhitespaceFinder ws_finder(tmp.release(), QSize(4, 4));
+		int const min_ws_size = scaledFrom150Dpi(4, dpi);
+		MaxWhitespaceFinder ws_finder(tmp.release(), QSize(min_ws_size, min_ws_size));
 		
 		for (int i = 0; i < 10; ++i) {
 			QRect ws(ws_finder.next());
@@ -310,7 +386,7 @@ ContentBoxFinder::findContentBox(
 		dbg->add(content_blocks, "except_bordering");
 	}
 	
-	BinaryImage text_mask(estimateTextMask(content, content_blocks, dbg));
+	BinaryImage text_mask(estimateTextMask(status, content, content_blocks, dpi, dbg));
 	if (dbg) {
 		QImage text_mask_visualized(content.size(), QImage::Format_ARGB32_Premultiplied);
 		text_mask_visualized.fill(0xffffffff); // Opaque white.
@@ -338,7 +414,7 @@ ContentBoxFinder::findContentBox(
 	
 	// Temporarily reuse hor_shadows_seed and ver_shadows_seed.
 	// It's OK they are null.
-	segmentGarbage(garbage, hor_shadows_seed, ver_shadows_seed, dbg);
+	segmentGarbage(garbage, hor_shadows_seed, ver_shadows_seed, dpi, dbg);
 	garbage.release();
 	
 	if (dbg) {
@@ -360,7 +436,7 @@ ContentBoxFinder::findContentBox(
 			old_content_rect = content_rect;
 			content_rect = trimLeft(
 				content, content_blocks, text_mask,
-				content_rect, vert_garbage, dbg
+				content_rect, vert_garbage, dpi, dbg
 			);
 			
 			status.throwIfCancelled();
@@ -378,7 +454,7 @@ ContentBoxFinder::findContentBox(
 			old_content_rect = content_rect;
 			content_rect = trimRight(
 				content, content_blocks, text_mask,
-				content_rect, vert_garbage, dbg
+				content_rect, vert_garbage, dpi, dbg
 			);
 			
 			status.throwIfCancelled();
@@ -396,7 +472,7 @@ ContentBoxFinder::findContentBox(
 			old_content_rect = content_rect;
 			content_rect = trimTop(
 				content, content_blocks, text_mask,
-				content_rect, hor_garbage, dbg
+				content_rect, hor_garbage, dpi, dbg
 			);
 			
 			status.throwIfCancelled();
@@ -414,7 +490,7 @@ ContentBoxFinder::findContentBox(
 			old_content_rect = content_rect;
 			content_rect = trimBottom(
 				content, content_blocks, text_mask,
-				content_rect, hor_garbage, dbg
+				content_rect, hor_garbage, dpi, dbg
 			);
 			
 			status.throwIfCancelled();
@@ -427,10 +503,11 @@ ContentBoxFinder::findContentBox(
 			}
 		}
 		
-		if (content_rect.width() < 8 || content_rect.height() < 8) {
+		int const min_size = scaledFrom150Dpi(8, dpi);
+		if (content_rect.width() < min_size || content_rect.height() < min_size) {
 			content_rect = QRect();
 			break;
-		} else if (content_rect.width() < 30 &&
+		} else if (content_rect.width() < scaledFrom150Dpi(30, dpi) &&
 				content_rect.height() >
 				content_rect.width() * 20) {
 			content_rect = QRect();
@@ -438,10 +515,179 @@ ContentBoxFinder::findContentBox(
 		}
 	}
 	
-	// Transform back from 150dpi.
-	QTransform combined_xform(xform_150dpi.transform().inverted());
-	combined_xform *= data.xform().transform();
-	return combined_xform.map(QRectF(content_rect)).boundingRect();
+	return content_rect;
+}
+
+
+QRect
+ContentBoxFinder::refineContentRect(
+	TaskStatus const& status, FilterData const& data,
+	ImageTransformation const& coarse_xform,
+	BinaryImage const& coarse_garbage, QRect const& coarse_rect,
+	ImageTransformation const& fine_xform, DebugImages* dbg)
+{
+	QTransform const coarse_to_fine(
+		coarse_xform.transform().inverted() * fine_xform.transform()
+	);
+	QRect const fine_image_rect(fine_xform.resultingRect().toRect());
+	QRect const fine_rect(
+		coarse_to_fine.mapRect(QRectF(coarse_rect))
+		.toAlignedRect().intersected(fine_image_rect)
+	);
+	if (fine_rect.isEmpty()) {
+		return fine_rect;
+	}
+	
+	uint8_t const darkest_gray_level = darkestGrayLevel(data.grayImage());
+	QColor const outside_color(darkest_gray_level, darkest_gray_level, darkest_gray_level);
+	
+	// Edges found at 75 dpi are within a couple of pixels from where
+	// they are at 150 dpi, so a band of this half-width is enough.
+	int const band_radius = 8;
+	
+	enum Side { LEFT, RIGHT, TOP, BOTTOM };
+	
+	QRect refined_rect(fine_rect);
+	for (int side = LEFT; side <= BOTTOM; ++side) {
+		QRect band(fine_rect);
+		switch (side) {
+			case LEFT:
+				band.setLeft(fine_rect.left() - band_radius);
+				band.setRight(fine_rect.left() + band_radius);
+				break;
+			case RIGHT:
+				band.setLeft(fine_rect.right() - band_radius);
+				band.setRight(fine_rect.right() + band_radius);
+				break;
+			case TOP:
+				band.setTop(fine_rect.top() - band_radius);
+				band.setBottom(fine_rect.top() + band_radius);
+				break;
+			case BOTTOM:
+				band.setTop(fine_rect.bottom() - band_radius);
+				band.setBottom(fine_rect.bottom() + band_radius);
+				break;
+		}
+		band &= fine_image_rect;
+		
+		BinaryImage const connected(
+			fineContentInBand(
+				status, data, coarse_xform, coarse_garbage,
+				fine_xform, outside_color, band, band.intersected(fine_rect)
+			)
+		);
+		if (dbg) {
+			dbg->add(connected, "refined_band");
+		}
+		
+		status.throwIfCancelled();
+		
+		QRect const box(connected.contentBoundingBox().translated(band.topLeft()));
+		if (box.isEmpty()) {
+			// Nothing in the band is connected to the content inside.
+			// The coarse edge is then as good a guess as any.
+			continue;
+		}
+		
+		switch (side) {
+			case LEFT:
+				refined_rect.setLeft(box.left());
+				break;
+			case RIGHT:
+				refined_rect.setRight(box.right());
+				break;
+			case TOP:
+				refined_rect.setTop(box.top());
+				break;
+			case BOTTOM:
+				refined_rect.setBottom(box.bottom());
+				break;
+		}
+	}
+	
+	if (refined_rect.isEmpty()) {
+		return fine_rect;
+	}
+	
+	return refined_rect;
+}
+
+imageproc::BinaryImage
+ContentBoxFinder::fineContentInBand(
+	TaskStatus const& status, FilterData const& data,
+	ImageTransformation const& coarse_xform,
+	BinaryImage const& coarse_garbage,
+	ImageTransformation const& fine_xform, QColor const& outside_color,
+	QRect const& band, QRect const& inner_area)
+{
+	// Binarization needs some context around the band.
+	int const window = 51;
+	QRect const context(
+		band.adjusted(-window / 2, -window / 2, window / 2, window / 2)
+		.intersected(fine_xform.resultingRect().toRect())
+	);
+	
+	BinaryImage bw(
+		binarizeWolf(
+			transformToGray(
+				data.grayImage(), fine_xform.transform(), context,
+				OutsidePixels::assumeColor(outside_color)
+			), QSize(window, window), 50
+		)
+	);
+	PolygonRasterizer::fillExcept(
+		bw, BLACK, fine_xform.resultingPreCropArea().translated(-context.topLeft()),
+		Qt::WindingFill
+	);
+	
+	BinaryImage content(band.size());
+	rasterOp<RopSrc>(content, content.rect(), bw, band.topLeft() - context.topLeft());
+	bw.release();
+	
+	// Remove whatever the coarse pass classified as shadows.
+	QTransform const fine_to_coarse(
+		fine_xform.transform().inverted() * coarse_xform.transform()
+	);
+	QRect const garbage_rect(coarse_garbage.rect());
+	uint32_t const* const garbage_data = coarse_garbage.data();
+	int const garbage_stride = coarse_garbage.wordsPerLine();
+	uint32_t* content_line = content.data();
+	int const content_stride = content.wordsPerLine();
+	uint32_t const msb = uint32_t(1) << 31;
+	for (int y = 0; y < band.height(); ++y) {
+		for (int x = 0; x < band.width(); ++x) {
+			QPointF const pt(
+				fine_to_coarse.map(
+					QPointF(band.left() + x + 0.5, band.top() + y + 0.5)
+				)
+			);
+			int const gx = (int)floor(pt.x());
+			int const gy = (int)floor(pt.y());
+			if (!garbage_rect.contains(gx, gy)) {
+				continue;
+			}
+			if (garbage_data[gy * garbage_stride + (gx >> 5)] & (msb >> (gx & 31))) {
+				content_line[x >> 5] &= ~(msb >> (x & 31));
+			}
+		}
+		content_line += content_stride;
+	}
+	
+	status.throwIfCancelled();
+	
+	BinaryImage const despeckled(
+		Despeckle::despeckle(
+			content, Dpi(150, 150), contentDespeckleLevel(), status
+		)
+	);
+	content.release();
+	
+	// Keep only what is connected to the content inside the coarse box.
+	BinaryImage seed(band.size(), WHITE);
+	QRect const seed_rect(inner_area.translated(-band.topLeft()));
+	rasterOp<RopSrc>(seed, seed_rect, despeckled, seed_rect.topLeft());
+	
+	return seedFill(seed, despeckled, CONN8, &status);
 }
 
 namespace
@@ -655,9 +901,11 @@ ContentBoxFinder::segmentGarbage(
 	imageproc::BinaryImage const& garbage,
 	imageproc::BinaryImage& hor_garbage,
 	imageproc::BinaryImage& vert_garbage,
-	DebugImages* dbg)
+	int const dpi, DebugImages* dbg)
 {
-	hor_garbage = openBrick(garbage, QSize(200, 1), WHITE);
+	int const min_length = scaledFrom150Dpi(200, dpi);
+	
+	hor_garbage = openBrick(garbage, QSize(min_length, 1), WHITE);
 	
 	QRect rect(garbage.rect());
 	rect.setHeight(1);
@@ -669,7 +917,7 @@ ContentBoxFinder::segmentGarbage(
 		hor_garbage, rect, garbage, rect.topLeft()
 	);
 	
-	vert_garbage = openBrick(garbage, QSize(1, 200), WHITE);
+	vert_garbage = openBrick(garbage, QSize(1, min_length), WHITE);
 	
 	rect = garbage.rect();
 	rect.setWidth(1);
@@ -721,8 +969,9 @@ ContentBoxFinder::segmentGarbage(
 	}
 	
 	BinaryImage unconnected_garbage(garbage);
-	rasterOp<RopSubtract<RopDst, RopSrc> >(unconnected_garbage, hor_garbage);
-	rasterOp<RopSubtract<RopDst, RopSrc> >(unconnected_garbage, vert_garbage);
+	rasterOp<RopSubtract<RopSubtract<RopDst, RopSrc>, RopSrc2> >(
+		unconnected_garbage, hor_garbage, vert_garbage
+	);
 	
 	rasterOp<RopOr<RopSrc, RopDst> >(hor_garbage, unconnected_garbage);
 	rasterOp<RopOr<RopSrc, RopDst> >(vert_garbage, unconnected_garbage);
@@ -730,9 +979,9 @@ ContentBoxFinder::segmentGarbage(
 
 imageproc::BinaryImage
 ContentBoxFinder::estimateTextMask(
-	imageproc::BinaryImage const& content,
+	TaskStatus const& status, imageproc::BinaryImage const& content,
 	imageproc::BinaryImage const& content_blocks,
-	DebugImages* dbg)
+	int const dpi, DebugImages* dbg)
 {
 	// We differentiate between a text line and a slightly skewed straight
 	// line (which may have a fill factor similar to that of text) by the
@@ -764,10 +1013,12 @@ ContentBoxFinder::estimateTextMask(
 	
 	BinaryImage text_mask(content.size(), WHITE);
 	
-	int const min_text_height = 6;
+	int const min_text_height = scaledFrom150Dpi(6, dpi);
 	
 	ConnCompEraserExt eraser(content_blocks, CONN4);
 	for (;;) {
+		status.throwIfCancelled();
+		
 		ConnComp const cc(eraser.nextConnComp());
 		if (cc.isNull()) {
 			break;
@@ -972,7 +1223,7 @@ ContentBoxFinder::trimLeft(
 	imageproc::BinaryImage const& content,
 	imageproc::BinaryImage const& content_blocks,
 	imageproc::BinaryImage const& text, QRect const& area,
-	Garbage& garbage, DebugImages* const dbg)
+	Garbage& garbage, int const dpi, DebugImages* const dbg)
 {
 	SlicedHistogram const hist(content_blocks, area, SlicedHistogram::COLS);
 	
@@ -1006,7 +1257,7 @@ ContentBoxFinder::trimLeft(
 		QRect const res = trim(
 			content, content_blocks, text,
 			area, new_area, removed_area,
-			garbage, can_retry_grouped, dbg
+			garbage, can_retry_grouped, dpi, dbg
 		);
 		if (can_retry_grouped) {
 			start = first_non_ws - area.left();
@@ -1023,7 +1274,7 @@ ContentBoxFinder::trimRight(
 	imageproc::BinaryImage const& content,
 	imageproc::BinaryImage const& content_blocks,
 	imageproc::BinaryImage const& text, QRect const& area,
-	Garbage& garbage, DebugImages* const dbg)
+	Garbage& garbage, int const dpi, DebugImages* const dbg)
 {
 	SlicedHistogram const hist(content_blocks, area, SlicedHistogram::COLS);
 	
@@ -1057,7 +1308,7 @@ ContentBoxFinder::trimRight(
 		QRect const res = trim(
 			content, content_blocks, text,
 			area, new_area, removed_area,
-			garbage, can_retry_grouped, dbg
+			garbage, can_retry_grouped, dpi, dbg
 		);
 		if (can_retry_grouped) {
 			start = first_non_ws - area.left();
@@ -1074,7 +1325,7 @@ ContentBoxFinder::trimTop(
 	imageproc::BinaryImage const& content,
 	imageproc::BinaryImage const& content_blocks,
 	imageproc::BinaryImage const& text, QRect const& area,
-	Garbage& garbage, DebugImages* const dbg)
+	Garbage& garbage, int const dpi, DebugImages* const dbg)
 {
 	SlicedHistogram const hist(content_blocks, area, SlicedHistogram::ROWS);
 	
@@ -1108,7 +1359,7 @@ ContentBoxFinder::trimTop(
 		QRect const res = trim(
 			content, content_blocks, text,
 			area, new_area, removed_area,
-			garbage, can_retry_grouped, dbg
+			garbage, can_retry_grouped, dpi, dbg
 		);
 		if (can_retry_grouped) {
 			start = first_non_ws - area.top();
@@ -1125,7 +1376,7 @@ ContentBoxFinder::trimBottom(
 	imageproc::BinaryImage const& content,
 	imageproc::BinaryImage const& content_blocks,
 	imageproc::BinaryImage const& text, QRect const& area,
-	Garbage& garbage, DebugImages* const dbg)
+	Garbage& garbage, int const dpi, DebugImages* const dbg)
 {
 	SlicedHistogram const hist(content_blocks, area, SlicedHistogram::ROWS);
 	
@@ -1159,7 +1410,7 @@ ContentBoxFinder::trimBottom(
 		QRect const res = trim(
 			content, content_blocks, text,
 			area, new_area, removed_area,
-			garbage, can_retry_grouped, dbg
+			garbage, can_retry_grouped, dpi, dbg
 		);
 		if (can_retry_grouped) {
 			start = first_non_ws - area.top();
@@ -1178,7 +1429,7 @@ ContentBoxFinder::trim(
 	imageproc::BinaryImage const& text,
 	QRect const& area, QRect const& new_area,
 	QRect const& removed_area, Garbage& garbage,
-	bool& can_retry_grouped, DebugImages* const dbg)
+	bool& can_retry_grouped, int const dpi, DebugImages* const dbg)
 {
 	can_retry_grouped = false;
 	
@@ -1210,7 +1461,8 @@ ContentBoxFinder::trim(
 		
 		// There is a special case when there is nothing but
 		// garbage on the page.  Let's try to handle it here.
-		if (removed_area.width() < 6 || removed_area.height() < 6) {
+		int const min_size = scaledFrom150Dpi(6, dpi);
+		if (removed_area.width() < min_size || removed_area.height() < min_size) {
 			break;
 		}
 		
@@ -1253,7 +1505,7 @@ ContentBoxFinder::trim(
 		
 		double const min_text_influence = 0.2;
 		double const max_text_influence = 1.0;
-		int const upper_threshold = 5000;
+		int const upper_threshold = 5000 * dpi / 150 * dpi / 150;
 		double text_influence = max_text_influence;
 		if (num_text_pixels < upper_threshold) {
 			text_influence = min_text_influence +
@@ -1350,7 +1602,7 @@ ContentBoxFinder::trim(
 void
 ContentBoxFinder::filterShadows(
 	TaskStatus const& status, imageproc::BinaryImage& shadows,
-	DebugImages* const dbg)
+	int const dpi, DebugImages* const dbg)
 {
 	// The input image should only contain shadows from the edges
 	// of a page, but in practice it may also contain things like
@@ -1362,7 +1614,7 @@ ContentBoxFinder::filterShadows(
 	BinaryImage borders(shadows.size(), WHITE);
 	borders.fillExcept(borders.rect().adjusted(1, 1, -1, -1), BLACK);
 	
-	BinaryImage touching_shadows(seedFill(borders, shadows, CONN8));
+	BinaryImage touching_shadows(seedFill(borders, shadows, CONN8, &status));
 	rasterOp<RopXor<RopSrc, RopDst> >(shadows, touching_shadows);
 	if (dbg) {
 		dbg->add(shadows, "non_border_shadows");
@@ -1370,17 +1622,17 @@ ContentBoxFinder::filterShadows(
 	
 	if (shadows.countBlackPixels()) {
 		BinaryImage inv_shadows(shadows.inverted());
-		BinaryImage mask(seedFill(borders, inv_shadows, CONN8));
+		BinaryImage mask(seedFill(borders, inv_shadows, CONN8, &status));
 		borders.release();
 		rasterOp<RopOr<RopNot<RopDst>, RopSrc> >(mask, shadows);
 		if (dbg) {
 			dbg->add(mask, "shadows_no_holes");
 		}
 		
-		BinaryImage text_mask(estimateTextMask(inv_shadows, mask, dbg));
+		BinaryImage text_mask(estimateTextMask(status, inv_shadows, mask, dpi, dbg));
 		inv_shadows.release();
 		mask.release();
-		text_mask = seedFill(text_mask, shadows, CONN8);
+		text_mask = seedFill(text_mask, shadows, CONN8, &status);
 		if (dbg) {
 			dbg->add(text_mask, "misclassified_shadows");
 		}
@@ -1447,7 +1699,7 @@ ContentBoxFinder::filterShadows(
 	
 	status.throwIfCancelled();
 	
-	BinaryImage non_shadows(seedFill(opened, shadows, CONN8));
+	BinaryImage non_shadows(seedFill(opened, shadows, CONN8, &status));
 	opened.release();
 	if (dbg) {
 		dbg->add(non_shadows, "non_shadows");
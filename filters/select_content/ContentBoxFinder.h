@@ -24,7 +24,9 @@
 class TaskStatus;
 class DebugImages;
 class FilterData;
+class ImageTransformation;
 class QImage;
+class QColor;
 class QRect;
 class QRectF;
 
@@ -41,17 +43,75 @@ namespace select_content
 class ContentBoxFinder
 {
 public:
+	enum Mode {
+		/** The whole page is analyzed at 150 dpi. */
+		FULL_RESOLUTION,
+		
+		/**
+		 * The page is analyzed at 75 dpi, and only narrow bands around
+		 * the edges of the resulting box are then examined at 150 dpi.
+		 */
+		COARSE_TO_FINE
+	};
+	
+	/**
+	 * \brief Finds the content box of a page.
+	 *
+	 * COARSE_TO_FINE mode is used with --fast-content-detection,
+	 * FULL_RESOLUTION otherwise.
+	 */
 	static QRectF findContentBox(
 		TaskStatus const& status, FilterData const& data,
 		DebugImages* dbg = 0);
+	
+	static QRectF findContentBox(
+		TaskStatus const& status, FilterData const& data,
+		Mode mode, DebugImages* dbg = 0);
 private:
 	class Garbage;
 	
+	/**
+	 * \brief Runs the complete content detection at a given resolution.
+	 *
+	 * \param xform Transforms the original image into \p dpi.
+	 * \param garbage_out If provided, receives the shadows found
+	 *        around the page.
+	 * \return The content rectangle in \p xform coordinates.
+	 */
+	static QRect detectContentRect(
+		TaskStatus const& status, FilterData const& data,
+		ImageTransformation const& xform, int dpi,
+		imageproc::BinaryImage* garbage_out, DebugImages* dbg);
+	
+	/**
+	 * \brief Moves the edges of a content rectangle found at a lower
+	 *        resolution to where they are at 150 dpi.
+	 *
+	 * Only bands of a few pixels around each edge are binarized at
+	 * the higher resolution.  Within its band, an edge goes to the
+	 * extent of content connected to what is already inside the coarse
+	 * rectangle, which may move it either outwards or inwards.  An edge
+	 * whose band has no such content stays where the coarse pass put it.
+	 */
+	static QRect refineContentRect(
+		TaskStatus const& status, FilterData const& data,
+		ImageTransformation const& coarse_xform,
+		imageproc::BinaryImage const& coarse_garbage,
+		QRect const& coarse_rect,
+		ImageTransformation const& fine_xform, DebugImages* dbg);
+	
+	static imageproc::BinaryImage fineContentInBand(
+		TaskStatus const& status, FilterData const& data,
+		ImageTransformation const& coarse_xform,
+		imageproc::BinaryImage const& coarse_garbage,
+		ImageTransformation const& fine_xform, QColor const& outside_color,
+		QRect const& band, QRect const& inner_area);
+	
 	static void segmentGarbage(
 		imageproc::BinaryImage const& garbage,
 		imageproc::BinaryImage& hor_garbage,
 		imageproc::BinaryImage& vert_garbage,
-		DebugImages* dbg);
+		int dpi, DebugImages* dbg);
 	
 	static void trimContentBlocksInPlace(
 		imageproc::BinaryImage const& content,
@@ -61,37 +121,37 @@ private:
 		imageproc::BinaryImage& content_blocks, DebugImages* dbg);
 	
 	static imageproc::BinaryImage estimateTextMask(
-		imageproc::BinaryImage const& content,
+		TaskStatus const& status, imageproc::BinaryImage const& content,
 		imageproc::BinaryImage const& content_blocks,
-		DebugImages* dbg);
+		int dpi, DebugImages* dbg);
 	
 	static void filterShadows(
 		TaskStatus const& status, imageproc::BinaryImage& shadows,
-		DebugImages* dbg);
+		int dpi, DebugImages* dbg);
 	
 	static QRect trimLeft(
 		imageproc::BinaryImage const& content,
 		imageproc::BinaryImage const& content_blocks,
 		imageproc::BinaryImage const& text_mask, QRect const& area,
-		Garbage& garbage, DebugImages* dbg);
+		Garbage& garbage, int dpi, DebugImages* dbg);
 	
 	static QRect trimRight(
 		imageproc::BinaryImage const& content,
 		imageproc::BinaryImage const& content_blocks,
 		imageproc::BinaryImage const& text_mask, QRect const& area,
-		Garbage& garbage, DebugImages* dbg);
+		Garbage& garbage, int dpi, DebugImages* dbg);
 	
 	static QRect trimTop(
 		imageproc::BinaryImage const& content,
 		imageproc::BinaryImage const& content_blocks,
 		imageproc::BinaryImage const& text_mask, QRect const& area,
-		Garbage& garbage, DebugImages* dbg);
+		Garbage& garbage, int dpi, DebugImages* dbg);
 	
 	static QRect trimBottom(
 		imageproc::BinaryImage const& content,
 		imageproc::BinaryImage const& content_blocks,
 		imageproc::BinaryImage const& text_mask, QRect const& area,
-		Garbage& garbage, DebugImages* dbg);
+		Garbage& garbage, int dpi, DebugImages* dbg);
 	
 	static QRect trim(
 		imageproc::BinaryImage const& content,
@@ -99,7 +159,7 @@ private:
 		imageproc::BinaryImage const& text_mask,
 		QRect const& area, QRect const& new_area,
 		QRect const& removed_area, Garbage& garbage,
-		bool& can_retry_grouped, DebugImages* dbg);
+		bool& can_retry_grouped, int dpi, DebugImages* dbg);
 };
 
 } // namespace select_content
@@ -25,6 +25,8 @@
 #include "Params.h"
 #include "ProjectReader.h"
 #include "ProjectWriter.h"
+#include "ProjectIndex.h"
+#include "XmlStreamUtils.h"
 #include "CacheDrivenTask.h"
 #include "OrderByWidthProvider.h"
 #include "OrderByHeightProvider.h"
@@ -36,6 +38,9 @@
 #include <QObject>
 #include <QDomDocument>
 #include <QDomElement>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+#include <QLatin1String>
 #include <assert.h>
 #include "CommandLine.h"
 
@@ -111,59 +116,65 @@ Filter::preUpdateUI(FilterUiInterface* ui, PageId const& page_id)
 	ui->setOptionsWidget(m_ptrOptionsWidget.get(), ui->KEEP_OWNERSHIP);
 }
 
-QDomElement
-Filter::saveSettings(
-	ProjectWriter const& writer, QDomDocument& doc) const
+QString
+Filter::settingsElementName() const
+{
+	return "select-content";
+}
+
+void
+Filter::saveSettings(ProjectWriter const& writer, QXmlStreamWriter& xml) const
 {
 	using namespace boost::lambda;
 	
-	QDomElement filter_el(doc.createElement("select-content"));
+	writer.writeSettingsStart(xml, settingsElementName());
 	writer.enumPages(
 		boost::lambda::bind(
-			&Filter::writePageSettings,
-			this, boost::ref(doc), var(filter_el), boost::lambda::_1, boost::lambda::_2
+			&Filter::writePageSettings, this, boost::cref(writer),
+			boost::ref(xml), boost::lambda::_1, boost::lambda::_2
 		)
 	);
-	
-	return filter_el;
+	xml.writeEndElement();
 }
 
 void
 Filter::writePageSettings(
-	QDomDocument& doc, QDomElement& filter_el,
-	PageId const& page_id, int numeric_id) const
+	ProjectWriter const& writer, QXmlStreamWriter& xml,
+	PageId const& page_id, int const numeric_id) const
 {
-	std::auto_ptr<Params> const params(m_ptrSettings->getPageParams(page_id));
-	if (!params.get()) {
+	RevisionMap<PageId>::Revision const revision(
+		m_ptrSettings->pageRevision(page_id)
+	);
+	if (m_fragmentCache.writeCached(writer, xml, page_id, numeric_id, revision)) {
 		return;
 	}
+
+	QDomDocument doc;
+	QDomElement page_el;
+
+	std::auto_ptr<Params> const params(m_ptrSettings->getPageParams(page_id));
+	if (params.get()) {
+		page_el = doc.createElement("page");
+		page_el.setAttribute("id", numeric_id);
+		page_el.appendChild(params->toXml(doc, "params"));
+	}
 	
-	QDomElement page_el(doc.createElement("page"));
-	page_el.setAttribute("id", numeric_id);
-	page_el.appendChild(params->toXml(doc, "params"));
-	
-	filter_el.appendChild(page_el);
+	m_fragmentCache.writeAndCache(writer, xml, page_id, numeric_id, revision, page_el);
 }
 
 void
-Filter::loadSettings(ProjectReader const& reader, QDomElement const& filters_el)
+Filter::loadSettings(ProjectReader const& reader, QXmlStreamReader& xml)
 {
 	m_ptrSettings->clear();
 	
-	QDomElement const filter_el(
-		filters_el.namedItem("select-content").toElement()
-	);
-	
-	QString const page_tag_name("page");
-	QDomNode node(filter_el.firstChild());
-	for (; !node.isNull(); node = node.nextSibling()) {
-		if (!node.isElement()) {
-			continue;
-		}
-		if (node.nodeName() != page_tag_name) {
+	while (xml.readNextStartElement()) {
+		if (xml.name() != QLatin1String("page")) {
+			xml.skipCurrentElement();
 			continue;
 		}
-		QDomElement const el(node.toElement());
+
+		QDomDocument doc;
+		QDomElement const el(XmlStreamUtils::readElement(xml, doc));
 		
 		bool ok = true;
 		int const id = el.attribute("id").toInt(&ok);
@@ -186,6 +197,25 @@ Filter::loadSettings(ProjectReader const& reader, QDomElement const& filters_el)
 	}
 }
 
+bool
+Filter::loadDeferredSettings(
+	ProjectReader const& reader, ProjectIndexSection const& section)
+{
+	m_ptrSettings->clear();
+
+	size_t const num_entries = section.numEntries();
+	for (size_t i = 0; i < num_entries; ++i) {
+		PageId const page_id(reader.pageId(section.entryId(i)));
+		if (!page_id.isNull()) {
+			m_ptrSettings->setDeferredPageParams(
+				page_id, section.entryFragment(i)
+			);
+		}
+	}
+
+	return true;
+}
+
 IntrusivePtr<Task>
 Filter::createTask(
 	PageId const& page_id,
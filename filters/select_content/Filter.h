@@ -25,13 +25,16 @@
 #include "IntrusivePtr.h"
 #include "FilterResult.h"
 #include "SafeDeletingQObjectPtr.h"
+#include "XmlFragmentCache.h"
+#include "PageId.h"
 #include "PageOrderOption.h"
 #include <QCoreApplication>
 #include <vector>
 
-class PageId;
 class PageSelectionAccessor;
 class QString;
+class QXmlStreamReader;
+class QXmlStreamWriter;
 
 namespace page_layout
 {
@@ -70,11 +73,16 @@ public:
 
 	virtual void preUpdateUI(FilterUiInterface* ui, PageId const& page_id);
 	
-	virtual QDomElement saveSettings(
-		ProjectWriter const& writer, QDomDocument& doc) const;
+	virtual QString settingsElementName() const;
+
+	virtual void saveSettings(
+		ProjectWriter const& writer, QXmlStreamWriter& xml) const;
 	
 	virtual void loadSettings(
-		ProjectReader const& reader, QDomElement const& filters_el);
+		ProjectReader const& reader, QXmlStreamReader& xml);
+
+	virtual bool loadDeferredSettings(
+		ProjectReader const& reader, ProjectIndexSection const& section);
 	
 	IntrusivePtr<Task> createTask(
 		PageId const& page_id,
@@ -88,11 +96,12 @@ public:
 	Settings* getSettings() { return m_ptrSettings.get(); };
 private:
 	void writePageSettings(
-		QDomDocument& doc, QDomElement& filter_el,
+		ProjectWriter const& writer, QXmlStreamWriter& xml,
 		PageId const& page_id, int numeric_id) const;
 	
 	
 	IntrusivePtr<Settings> m_ptrSettings;
+	mutable XmlFragmentCache<PageId> m_fragmentCache;
 	SafeDeletingQObjectPtr<OptionsWidget> m_ptrOptionsWidget;
 	std::vector<PageOrderOption> m_pageOrderOptions;
 	int m_selectedPageOrder;
@@ -21,6 +21,8 @@
 #include "RelinkablePath.h"
 #include "AbstractRelinker.h"
 #include <QMutexLocker>
+#include <QDomDocument>
+#include <QDomElement>
 #ifndef Q_MOC_RUN
 #include <boost/foreach.hpp>
 #endif
@@ -41,12 +43,16 @@ Settings::clear()
 {
 	QMutexLocker locker(&m_mutex);
 	m_pageParams.clear();
+	m_deferredParams.clear();
+	m_revisions.touchAll();
 }
 
 void
 Settings::performRelinking(AbstractRelinker const& relinker)
 {
 	QMutexLocker locker(&m_mutex);
+	loadAllDeferredLocked();
+
 	PageParams new_params;
 
 	BOOST_FOREACH(PageParams::value_type const& kv, m_pageParams) {
@@ -57,26 +63,32 @@ Settings::performRelinking(AbstractRelinker const& relinker)
 	}
 
 	m_pageParams.swap(new_params);
+	m_revisions.touchAll();
 }
 
 void
 Settings::setPageParams(PageId const& page_id, Params const& params)
 {
 	QMutexLocker locker(&m_mutex);
+	loadDeferredLocked(page_id);
 	Utils::mapSetValue(m_pageParams, page_id, params);
+	m_revisions.touch(page_id);
 }
 
 void
 Settings::clearPageParams(PageId const& page_id)
 {
 	QMutexLocker locker(&m_mutex);
+	loadDeferredLocked(page_id);
 	m_pageParams.erase(page_id);
+	m_revisions.touch(page_id);
 }
 
 std::auto_ptr<Params>
 Settings::getPageParams(PageId const& page_id) const
 {
 	QMutexLocker locker(&m_mutex);
+	loadDeferredLocked(page_id);
 	
 	PageParams::const_iterator const it(m_pageParams.find(page_id));
 	if (it != m_pageParams.end()) {
@@ -86,4 +98,38 @@ Settings::getPageParams(PageId const& page_id) const
 	}
 }
 
+RevisionMap<PageId>::Revision
+Settings::pageRevision(PageId const& page_id) const
+{
+	QMutexLocker locker(&m_mutex);
+	return m_revisions.revision(page_id);
+}
+
+void
+Settings::setDeferredPageParams(
+	PageId const& page_id, ProjectIndexFragment const& fragment)
+{
+	QMutexLocker locker(&m_mutex);
+	m_deferredParams.add(page_id, fragment);
+}
+
+void
+Settings::loadDeferredLocked(PageId const& page_id) const
+{
+	QDomDocument doc;
+	QDomElement const page_el(m_deferredParams.take(page_id, doc));
+	QDomElement const params_el(page_el.namedItem("params").toElement());
+	if (!params_el.isNull()) {
+		Utils::mapSetValue(m_pageParams, page_id, Params(params_el));
+	}
+}
+
+void
+Settings::loadAllDeferredLocked()
+{
+	BOOST_FOREACH(PageId const& page_id, m_deferredParams.keys()) {
+		loadDeferredLocked(page_id);
+	}
+}
+
 } // namespace select_content
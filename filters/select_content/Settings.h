@@ -22,6 +22,8 @@
 #include "RefCountable.h"
 #include "NonCopyable.h"
 #include "PageId.h"
+#include "RevisionMap.h"
+#include "DeferredFragments.h"
 #include "Params.h"
 #include <QMutex>
 #include <memory>
@@ -49,11 +51,34 @@ public:
 	void clearPageParams(PageId const& page_id);
 	
 	std::auto_ptr<Params> getPageParams(PageId const& page_id) const;
+
+	/**
+	 * \brief Returns a number that changes whenever the parameters
+	 *        of the given page change.
+	 */
+	RevisionMap<PageId>::Revision pageRevision(PageId const& page_id) const;
+
+	/**
+	 * \brief Registers the serialized parameters of a page, to be parsed
+	 *        when they are first accessed.
+	 */
+	void setDeferredPageParams(
+		PageId const& page_id, ProjectIndexFragment const& fragment);
 private:
 	typedef std::map<PageId, Params> PageParams;
+
+	void loadDeferredLocked(PageId const& page_id) const;
+
+	void loadAllDeferredLocked();
 	
 	mutable QMutex m_mutex;
-	PageParams m_pageParams;
+	RevisionMap<PageId> m_revisions;
+	mutable DeferredFragments<PageId> m_deferredParams;
+
+	/**
+	 * Mutable, as pages from m_deferredParams are moved here on first access.
+	 */
+	mutable PageParams m_pageParams;
 };
 
 } // namespace select_content
@@ -19,6 +19,7 @@
 #include "Task.h"
 #include "Filter.h"
 #include "FilterData.h"
+#include "Profiler.h"
 #include "DebugImages.h"
 #include "OptionsWidget.h"
 #include "AutoManualMode.h"
@@ -52,6 +53,8 @@ public:
 	
 	virtual void updateUI(FilterUiInterface* ui);
 	
+	virtual void updateThumbnails(FilterUiInterface* ui);
+	
 	virtual IntrusivePtr<AbstractFilter> filter() { return m_ptrFilter; }
 private:
 	IntrusivePtr<Filter> m_ptrFilter;
@@ -87,6 +90,8 @@ Task::~Task()
 FilterResultPtr
 Task::process(TaskStatus const& status, FilterData const& data)
 {
+	ProfileSpan const span("select_content::Task::process");
+
 	status.throwIfCancelled();
 	
 	Dependencies const deps(data.xform().resultingPreCropArea());
@@ -173,6 +178,12 @@ Task::UiUpdater::UiUpdater(
 {
 }
 
+void
+Task::UiUpdater::updateThumbnails(FilterUiInterface* ui)
+{
+	ui->invalidateThumbnail(m_pageId);
+}
+
 void
 Task::UiUpdater::updateUI(FilterUiInterface* ui)
 {
@@ -182,7 +193,7 @@ Task::UiUpdater::updateUI(FilterUiInterface* ui)
 	opt_widget->postUpdateUI(m_uiData);
 	ui->setOptionsWidget(opt_widget, ui->KEEP_OWNERSHIP);
 	
-	ui->invalidateThumbnail(m_pageId);
+	updateThumbnails(ui);
 	
 	if (m_batchProcessing) {
 		return;
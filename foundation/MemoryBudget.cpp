@@ -0,0 +1,519 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "MemoryBudget.h"
+#include <QMutexLocker>
+#include <QTemporaryFile>
+#include <QDir>
+#ifndef Q_MOC_RUN
+#include <boost/static_assert.hpp>
+#endif
+#include <new>
+#include <memory>
+#include <stdlib.h>
+#include <assert.h>
+
+/**
+ * Precedes every block returned by allocate().
+ */
+struct MemoryBudget::BlockHeader
+{
+	/** Null for blocks allocated in RAM. */
+	QTemporaryFile* file;
+
+	/** The size requested by the caller. */
+	size_t size;
+};
+
+namespace
+{
+
+/**
+ * The offset of user data from the beginning of a block.  Both malloc()
+ * and QFile::map() return addresses aligned for any fundamental type,
+ * so this offset preserves that alignment.
+ */
+size_t const HEADER_SIZE = 16;
+
+BOOST_STATIC_ASSERT(sizeof(void*) + sizeof(size_t) <= HEADER_SIZE);
+
+/**
+ * Smaller buffers are left to malloc(), which handles them well enough.
+ */
+size_t const MIN_RECYCLED_SIZE = 64 * 1024;
+
+} // anonymous namespace
+
+
+/*========================= MemoryBudget::Admission ========================*/
+
+MemoryBudget::Admission::Admission()
+{
+	MemoryBudget::instance().admit();
+}
+
+MemoryBudget::Admission::~Admission()
+{
+	MemoryBudget::instance().leave();
+}
+
+
+/*======================= MemoryBudget::Reservation ========================*/
+
+MemoryBudget::Reservation::Reservation(qint64 const bytes)
+:	m_bytes(0)
+{
+	reset(bytes);
+}
+
+MemoryBudget::Reservation::~Reservation()
+{
+	reset();
+}
+
+void
+MemoryBudget::Reservation::reset(qint64 const bytes)
+{
+	if (bytes == m_bytes) {
+		return;
+	}
+
+	MemoryBudget& budget = MemoryBudget::instance();
+	if (bytes > m_bytes) {
+		budget.reserve(bytes - m_bytes);
+	} else {
+		budget.unreserve(m_bytes - bytes);
+	}
+	m_bytes = bytes;
+}
+
+
+/*======================= MemoryBudget::ScratchArena =======================*/
+
+MemoryBudget::ScratchArena::ScratchArena()
+:	m_pPrev(0),
+	m_heldBytes(0),
+	m_peakBytes(0)
+{
+	ThreadState* const state = MemoryBudget::instance().threadState();
+	m_pPrev = state->arena;
+	state->arena = this;
+}
+
+MemoryBudget::ScratchArena::~ScratchArena()
+{
+	MemoryBudget& budget = MemoryBudget::instance();
+
+	ThreadState* const state = budget.m_threadState.localData();
+	assert(state->arena == this);
+	state->arena = m_pPrev;
+
+	releaseKept();
+
+	QMutexLocker const locker(&budget.m_mutex);
+	if (m_peakBytes > budget.m_peakTaskBytes) {
+		budget.m_peakTaskBytes = m_peakBytes;
+	}
+}
+
+void*
+MemoryBudget::ScratchArena::take(size_t const bytes)
+{
+	if (bytes < MIN_RECYCLED_SIZE) {
+		return 0;
+	}
+
+	// The smallest kept buffer that fits, unless it's too wasteful.
+	FreeBlocks::iterator const it(m_freeBlocks.lower_bound(bytes));
+	if (it == m_freeBlocks.end() || it->first > bytes + bytes / 8) {
+		return 0;
+	}
+
+	void* const addr = it->second;
+	m_freeBlocks.erase(it);
+	return addr;
+}
+
+void
+MemoryBudget::ScratchArena::keep(void* const addr, size_t const capacity)
+{
+	m_freeBlocks.insert(FreeBlocks::value_type(capacity, addr));
+}
+
+bool
+MemoryBudget::ScratchArena::releaseKept()
+{
+	if (m_freeBlocks.empty()) {
+		return false;
+	}
+
+	MemoryBudget& budget = MemoryBudget::instance();
+
+	FreeBlocks::iterator it(m_freeBlocks.begin());
+	FreeBlocks::iterator const end(m_freeBlocks.end());
+	for (; it != end; ++it) {
+		noteReleased(it->first);
+		budget.freeInRam(it->second);
+	}
+	m_freeBlocks.clear();
+
+	return true;
+}
+
+void
+MemoryBudget::ScratchArena::noteAllocated(size_t const bytes)
+{
+	m_heldBytes += qint64(bytes);
+	if (m_heldBytes > m_peakBytes) {
+		m_peakBytes = m_heldBytes;
+	}
+}
+
+void
+MemoryBudget::ScratchArena::noteReleased(size_t const bytes)
+{
+	// The buffer may have been allocated before the arena was created.
+	m_heldBytes -= qint64(bytes);
+	if (m_heldBytes < 0) {
+		m_heldBytes = 0;
+	}
+}
+
+
+/*=============================== MemoryBudget =============================*/
+
+MemoryBudget::MemoryBudget()
+:	m_limit(0),
+	m_used(0),
+	m_spilled(0),
+	m_totalAllocated(0),
+	m_peakTaskBytes(0),
+	m_spillThreshold(16 * 1024 * 1024),
+	m_numAdmitted(0),
+	m_numWaiting(0)
+{
+}
+
+MemoryBudget&
+MemoryBudget::instance()
+{
+	// See the comment in OutOfMemoryHandler::instance().
+	static MemoryBudget object;
+	return object;
+}
+
+void
+MemoryBudget::setLimit(qint64 const bytes)
+{
+	QMutexLocker const locker(&m_mutex);
+	m_limit = bytes;
+	m_memoryReleased.wakeAll();
+}
+
+qint64
+MemoryBudget::limit() const
+{
+	QMutexLocker const locker(&m_mutex);
+	return m_limit;
+}
+
+qint64
+MemoryBudget::used() const
+{
+	QMutexLocker const locker(&m_mutex);
+	return m_used;
+}
+
+qint64
+MemoryBudget::spilled() const
+{
+	QMutexLocker const locker(&m_mutex);
+	return m_spilled;
+}
+
+qint64
+MemoryBudget::totalAllocated() const
+{
+	QMutexLocker const locker(&m_mutex);
+	return m_totalAllocated;
+}
+
+qint64
+MemoryBudget::allocatedByThisThread() const
+{
+	if (!m_threadState.hasLocalData()) {
+		return 0;
+	}
+	return m_threadState.localData()->allocated;
+}
+
+qint64
+MemoryBudget::peakTaskBytes() const
+{
+	QMutexLocker const locker(&m_mutex);
+	return m_peakTaskBytes;
+}
+
+void
+MemoryBudget::setSpillThreshold(size_t const bytes)
+{
+	QMutexLocker const locker(&m_mutex);
+	m_spillThreshold = bytes;
+}
+
+size_t
+MemoryBudget::spillThreshold() const
+{
+	QMutexLocker const locker(&m_mutex);
+	return m_spillThreshold;
+}
+
+void
+MemoryBudget::setSpillDirectory(QString const& dir)
+{
+	QMutexLocker const locker(&m_mutex);
+	m_spillDir = dir;
+}
+
+void*
+MemoryBudget::allocate(size_t const bytes)
+{
+	ThreadState* const state = threadState();
+	ScratchArena* const arena = state->arena;
+	if (arena) {
+		if (void* const addr = arena->take(bytes)) {
+			state->allocated += bytes;
+
+			// The buffer is already accounted for in m_used.
+			QMutexLocker const locker(&m_mutex);
+			m_totalAllocated += bytes;
+			return addr;
+		}
+	}
+
+	bool spill = shouldSpill(bytes);
+	if (spill && arena && arena->releaseKept()) {
+		// Buffers kept for recycling are counted as used, yet they
+		// shouldn't push an allocation out of RAM.
+		spill = shouldSpill(bytes);
+	}
+
+	void* addr = 0;
+	if (spill) {
+		addr = allocateInFile(bytes);
+	}
+	if (!addr) {
+		addr = allocateInRam(bytes);
+		if (!addr && arena && arena->releaseKept()) {
+			addr = allocateInRam(bytes);
+		}
+	}
+	if (!addr && !spill) {
+		// RAM is exhausted, no matter what the budget says.
+		addr = allocateInFile(bytes);
+	}
+	if (!addr) {
+		throw std::bad_alloc();
+	}
+
+	state->allocated += bytes;
+	return addr;
+}
+
+void
+MemoryBudget::deallocate(void* const addr)
+{
+	if (!addr) {
+		return;
+	}
+
+	uchar* const block = static_cast<uchar*>(addr) - HEADER_SIZE;
+	BlockHeader const header(*reinterpret_cast<BlockHeader*>(block));
+
+	if (!header.file) {
+		ScratchArena* const arena = currentArena();
+		if (arena && header.size >= MIN_RECYCLED_SIZE) {
+			bool over_budget;
+			{
+				QMutexLocker const locker(&m_mutex);
+				over_budget = m_limit > 0 && m_used >= m_limit;
+			}
+			if (!over_budget) {
+				// Still counted as used, as it's not returned to the heap.
+				arena->keep(addr, header.size);
+				return;
+			}
+		}
+		if (arena) {
+			arena->noteReleased(header.size);
+		}
+		freeInRam(addr);
+		return;
+	}
+
+	header.file->unmap(block);
+	delete header.file; // Removes the file as well.
+
+	QMutexLocker const locker(&m_mutex);
+	m_spilled -= header.size;
+	if (m_numWaiting > 0) {
+		m_memoryReleased.wakeAll();
+	}
+}
+
+MemoryBudget::ThreadState*
+MemoryBudget::threadState()
+{
+	if (!m_threadState.hasLocalData()) {
+		m_threadState.setLocalData(new ThreadState);
+	}
+	return m_threadState.localData();
+}
+
+MemoryBudget::ScratchArena*
+MemoryBudget::currentArena()
+{
+	if (!m_threadState.hasLocalData()) {
+		return 0;
+	}
+	return m_threadState.localData()->arena;
+}
+
+void*
+MemoryBudget::allocateInRam(size_t const bytes)
+{
+	uchar* const block = static_cast<uchar*>(malloc(HEADER_SIZE + bytes));
+	if (!block) {
+		return 0;
+	}
+
+	BlockHeader* const header = reinterpret_cast<BlockHeader*>(block);
+	header->file = 0;
+	header->size = bytes;
+
+	if (ScratchArena* const arena = currentArena()) {
+		arena->noteAllocated(bytes);
+	}
+
+	QMutexLocker const locker(&m_mutex);
+	m_used += bytes;
+	m_totalAllocated += bytes;
+
+	return block + HEADER_SIZE;
+}
+
+void
+MemoryBudget::freeInRam(void* const addr)
+{
+	uchar* const block = static_cast<uchar*>(addr) - HEADER_SIZE;
+	size_t const size = reinterpret_cast<BlockHeader*>(block)->size;
+	free(block);
+
+	QMutexLocker const locker(&m_mutex);
+	m_used -= size;
+	if (m_numWaiting > 0) {
+		m_memoryReleased.wakeAll();
+	}
+}
+
+void
+MemoryBudget::reserve(qint64 const bytes)
+{
+	QMutexLocker const locker(&m_mutex);
+	m_used += bytes;
+}
+
+void
+MemoryBudget::unreserve(qint64 const bytes)
+{
+	QMutexLocker const locker(&m_mutex);
+	m_used -= bytes;
+	if (m_numWaiting > 0) {
+		m_memoryReleased.wakeAll();
+	}
+}
+
+void*
+MemoryBudget::allocateInFile(size_t const bytes)
+{
+	QString dir;
+	{
+		QMutexLocker const locker(&m_mutex);
+		dir = m_spillDir.isEmpty() ? QDir::tempPath() : m_spillDir;
+	}
+
+	std::auto_ptr<QTemporaryFile> file(
+		new QTemporaryFile(QDir(dir).filePath("scantailor-spill-XXXXXX"))
+	);
+	qint64 const total_size = HEADER_SIZE + bytes;
+	if (!file->open() || !file->resize(total_size)) {
+		return 0;
+	}
+
+	uchar* const block = file->map(0, total_size);
+	if (!block) {
+		return 0;
+	}
+
+	BlockHeader* const header = reinterpret_cast<BlockHeader*>(block);
+	header->file = file.release();
+	header->size = bytes;
+
+	QMutexLocker const locker(&m_mutex);
+	m_spilled += bytes;
+	m_totalAllocated += bytes;
+
+	return block + HEADER_SIZE;
+}
+
+bool
+MemoryBudget::shouldSpill(size_t const bytes) const
+{
+	QMutexLocker const locker(&m_mutex);
+	return m_limit > 0 && bytes >= m_spillThreshold
+		&& m_used + qint64(bytes) > m_limit;
+}
+
+void
+MemoryBudget::admit()
+{
+	QMutexLocker const locker(&m_mutex);
+
+	// Waiting while no other task is running would wait forever,
+	// as there is nobody to release the memory.
+	while (m_limit > 0 && m_used >= m_limit && m_numAdmitted > 0) {
+		++m_numWaiting;
+		m_memoryReleased.wait(&m_mutex);
+		--m_numWaiting;
+	}
+
+	++m_numAdmitted;
+}
+
+void
+MemoryBudget::leave()
+{
+	QMutexLocker const locker(&m_mutex);
+
+	assert(m_numAdmitted > 0);
+	--m_numAdmitted;
+	if (m_numWaiting > 0) {
+		m_memoryReleased.wakeAll();
+	}
+}
@@ -0,0 +1,278 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef MEMORYBUDGET_H_
+#define MEMORYBUDGET_H_
+
+#include "NonCopyable.h"
+#include <QMutex>
+#include <QWaitCondition>
+#include <QThreadStorage>
+#include <QString>
+#include <map>
+#include <stddef.h>
+
+/**
+ * \brief Keeps track of the memory taken by large image buffers and
+ *        enforces a configurable limit on it.
+ *
+ * Image classes allocate their pixel buffers through allocate() and
+ * deallocate().  Allocations that don't fit into the budget and are
+ * at least spillThreshold() bytes large are placed into memory-mapped
+ * temporary files instead.  This trades speed for the ability to process
+ * huge images without running out of memory.  When an ordinary allocation
+ * fails, spilling is attempted as a last resort, before std::bad_alloc
+ * is thrown.
+ *
+ * Buffers of other images, such as QImage and GrayImage, are neither
+ * allocated nor spilled here.  The largest of them, namely the images
+ * held by FilterData and the intermediate images of the output stage,
+ * are accounted for with a Reservation, so they count towards the budget
+ * without being subject to it.
+ *
+ * The scheduler brackets each task with an Admission object, so that
+ * a new task waits for memory to be released when the budget is exhausted,
+ * unless no other task is running.  It also gives each task a ScratchArena,
+ * which recycles the task's temporary buffers.  Note that only the command
+ * line version runs tasks in parallel.  The GUI's WorkerThread runs one task
+ * at a time, so there Admission never makes a task wait, and the budget
+ * only decides what gets spilled.
+ *
+ * This class is thread-safe.
+ */
+class MemoryBudget
+{
+	DECLARE_NON_COPYABLE(MemoryBudget)
+public:
+	/**
+	 * \brief Waits in the constructor until a task may start,
+	 *        and marks its end in the destructor.
+	 */
+	class Admission
+	{
+		DECLARE_NON_COPYABLE(Admission)
+	public:
+		Admission();
+
+		~Admission();
+	};
+
+	/**
+	 * \brief Holds an amount reserve()d for as long as it lives.
+	 *
+	 * That's for buffers allocated by other means, like those of QImage.
+	 */
+	class Reservation
+	{
+		DECLARE_NON_COPYABLE(Reservation)
+	public:
+		explicit Reservation(qint64 bytes = 0);
+
+		~Reservation();
+
+		/**
+		 * \brief Replaces the reserved amount with \p bytes.
+		 */
+		void reset(qint64 bytes = 0);
+
+		qint64 bytes() const { return m_bytes; }
+	private:
+		qint64 m_bytes;
+	};
+
+	/**
+	 * \brief Recycles large buffers released by the current thread.
+	 *
+	 * While an arena is alive, buffers released on its thread are not
+	 * returned to the heap, but kept for later allocations of a similar
+	 * size on the same thread.  That avoids fragmenting the heap with
+	 * lots of page-sized temporary images.  The kept buffers are released
+	 * all at once when the arena is destroyed, or earlier, when an allocation
+	 * on the same thread would otherwise have to be spilled or would fail.
+	 * Nothing is kept while the budget is exceeded.
+	 *
+	 * Arenas may be nested, in which case the innermost one is used.
+	 */
+	class ScratchArena
+	{
+		DECLARE_NON_COPYABLE(ScratchArena)
+	public:
+		ScratchArena();
+
+		~ScratchArena();
+
+		/**
+		 * \brief The highest amount of memory, in bytes, held by the current
+		 *        thread while the arena was alive, including kept buffers.
+		 *
+		 * Memory allocated before the arena was created is not counted.
+		 */
+		qint64 peakBytes() const { return m_peakBytes; }
+	private:
+		friend class MemoryBudget;
+
+		/** Maps the size of a kept buffer to its address. */
+		typedef std::multimap<size_t, void*> FreeBlocks;
+
+		/** Returns a kept buffer suitable for \p bytes, or null. */
+		void* take(size_t bytes);
+
+		void keep(void* addr, size_t capacity);
+
+		/**
+		 * Returns all the kept buffers to the heap.
+		 * \return true if there was anything to release.
+		 */
+		bool releaseKept();
+
+		void noteAllocated(size_t bytes);
+
+		void noteReleased(size_t bytes);
+
+		ScratchArena* m_pPrev;
+		FreeBlocks m_freeBlocks;
+		qint64 m_heldBytes;
+		qint64 m_peakBytes;
+	};
+
+	static MemoryBudget& instance();
+
+	/**
+	 * \brief Sets the budget in bytes.  Zero means unlimited, which is the default.
+	 */
+	void setLimit(qint64 bytes);
+
+	qint64 limit() const;
+
+	/**
+	 * \brief The number of bytes currently allocated in RAM through allocate()
+	 *        or accounted for with reserve().
+	 */
+	qint64 used() const;
+
+	/**
+	 * \brief The number of bytes currently spilled to temporary files.
+	 */
+	qint64 spilled() const;
+
+	/**
+	 * \brief The number of bytes ever allocated through allocate(),
+	 *        whether in RAM or in temporary files.
+	 */
+	qint64 totalAllocated() const;
+
+	/**
+	 * \brief The number of bytes ever allocated through allocate()
+	 *        by the calling thread.
+	 */
+	qint64 allocatedByThisThread() const;
+
+	/**
+	 * \brief The largest ScratchArena::peakBytes() of all the arenas
+	 *        destroyed so far.
+	 *
+	 * This is the memory a single task needed at most for buffers
+	 * allocated through allocate(), that is for BinaryImage data.
+	 * Other images are not counted.  It's meant for deciding how many
+	 * tasks may run in parallel.
+	 */
+	qint64 peakTaskBytes() const;
+
+	/**
+	 * \brief Sets the minimum size of an allocation that may be spilled.
+	 */
+	void setSpillThreshold(size_t bytes);
+
+	size_t spillThreshold() const;
+
+	/**
+	 * \brief Sets the directory for temporary files.  An empty string
+	 *        means the system's temporary directory, which is the default.
+	 */
+	void setSpillDirectory(QString const& dir);
+
+	/**
+	 * \brief Allocates a buffer suitably aligned for any fundamental type.
+	 *
+	 * \throw std::bad_alloc if neither RAM nor a temporary file could be used.
+	 */
+	void* allocate(size_t bytes);
+
+	/**
+	 * \brief Releases a buffer returned by allocate().  Null is ignored.
+	 */
+	void deallocate(void* addr);
+
+	/**
+	 * \brief Accounts for memory allocated by other means, for example
+	 *        for images waiting in a queue.
+	 *
+	 * Reserved bytes count towards used(), so they delay the admission
+	 * of new tasks and make large allocations spill sooner.
+	 */
+	void reserve(qint64 bytes);
+
+	/**
+	 * \brief Gives back memory accounted for with reserve().
+	 */
+	void unreserve(qint64 bytes);
+private:
+	struct BlockHeader;
+
+	struct ThreadState
+	{
+		ScratchArena* arena;
+		qint64 allocated;
+
+		ThreadState() : arena(0), allocated(0) {}
+	};
+
+	MemoryBudget();
+
+	ThreadState* threadState();
+
+	ScratchArena* currentArena();
+
+	void* allocateInRam(size_t bytes);
+
+	void freeInRam(void* addr);
+
+	void* allocateInFile(size_t bytes);
+
+	bool shouldSpill(size_t bytes) const;
+
+	void admit();
+
+	void leave();
+
+	mutable QMutex m_mutex;
+	QWaitCondition m_memoryReleased;
+	QThreadStorage<ThreadState*> m_threadState;
+	QString m_spillDir;
+	qint64 m_limit;
+	qint64 m_used;
+	qint64 m_spilled;
+	qint64 m_totalAllocated;
+	qint64 m_peakTaskBytes;
+	size_t m_spillThreshold;
+	int m_numAdmitted;
+	int m_numWaiting;
+};
+
+#endif
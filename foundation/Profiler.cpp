@@ -0,0 +1,324 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "Profiler.h"
+#include "MemoryBudget.h"
+#include <QMutexLocker>
+#include <QThread>
+#include <QFile>
+#include <QByteArray>
+#include <map>
+#include <memory>
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+namespace
+{
+
+QByteArray jsonString(QString const& str)
+{
+	QByteArray out("\"");
+	QByteArray const utf8(str.toUtf8());
+	for (int i = 0; i < utf8.size(); ++i) {
+		char const ch = utf8[i];
+		switch (ch) {
+			case '"':
+				out += "\\\"";
+				break;
+			case '\\':
+				out += "\\\\";
+				break;
+			case '\n':
+				out += "\\n";
+				break;
+			case '\t':
+				out += "\\t";
+				break;
+			default:
+				if ((unsigned char)ch < 0x20) {
+					out += QByteArray("\\u00") + QByteArray::number((int)ch, 16).rightJustified(2, '0');
+				} else {
+					out += ch;
+				}
+		}
+	}
+	out += '"';
+	return out;
+}
+
+} // anonymous namespace
+
+
+/*================================ Profiler ================================*/
+
+QAtomicInt Profiler::m_sEnabled(0);
+
+Profiler::Profiler()
+:	m_epochUsec(0)
+{
+}
+
+Profiler&
+Profiler::instance()
+{
+	// See the comment in OutOfMemoryHandler::instance().
+	static Profiler object;
+	return object;
+}
+
+void
+Profiler::setEnabled(bool const enabled)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	if (enabled && !isEnabled()) {
+		m_events.clear();
+		m_epochUsec = 0;
+		m_epochUsec = wallClockUsec();
+	}
+	m_sEnabled.fetchAndStoreRelease(enabled ? 1 : 0);
+}
+
+QString
+Profiler::currentPage() const
+{
+	if (!m_threadState.hasLocalData()) {
+		return QString();
+	}
+
+	ThreadState const* const state = m_threadState.localData();
+	return state->innermost ? state->innermost->page : QString();
+}
+
+qint64
+Profiler::wallClockUsec() const
+{
+#ifdef _WIN32
+	LARGE_INTEGER freq, counter;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&counter);
+	return qint64(double(counter.QuadPart) * 1000000.0 / freq.QuadPart) - m_epochUsec;
+#else
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return qint64(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000 - m_epochUsec;
+#endif
+}
+
+qint64
+Profiler::threadCpuUsec()
+{
+#if defined(_WIN32)
+	FILETIME creation, exit, kernel, user;
+	if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) {
+		return 0;
+	}
+	ULARGE_INTEGER k, u;
+	k.LowPart = kernel.dwLowDateTime;
+	k.HighPart = kernel.dwHighDateTime;
+	u.LowPart = user.dwLowDateTime;
+	u.HighPart = user.dwHighDateTime;
+	return qint64(k.QuadPart + u.QuadPart) / 10; // 100 ns units.
+#elif defined(CLOCK_THREAD_CPUTIME_ID)
+	timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return qint64(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+#else
+	// Process-wide, which is the best we can do here.
+	return qint64(double(clock()) * 1000000.0 / CLOCKS_PER_SEC);
+#endif
+}
+
+void
+Profiler::record(Event& event)
+{
+	void* const thread = QThread::currentThreadId();
+
+	QMutexLocker const locker(&m_mutex);
+
+	if (!isEnabled()) {
+		return;
+	}
+
+	size_t idx = 0;
+	for (; idx < m_threads.size() && m_threads[idx] != thread; ++idx) {
+		// Just looking.
+	}
+	if (idx == m_threads.size()) {
+		m_threads.push_back(thread);
+	}
+	event.threadIdx = idx;
+
+	m_events.push_back(event);
+	m_events.back().parent = 0; // Won't outlive the span.
+}
+
+bool
+Profiler::writeReport(QString const& file_path, Format const format) const
+{
+	QByteArray const json(
+		format == TRACE_EVENTS ? traceEventsJson() : summaryJson()
+	);
+
+	QFile file(file_path);
+	if (!file.open(QIODevice::WriteOnly|QIODevice::Truncate)) {
+		return false;
+	}
+	return file.write(json) == json.size();
+}
+
+QByteArray
+Profiler::traceEventsJson() const
+{
+	QMutexLocker const locker(&m_mutex);
+
+	QByteArray json("{\"traceEvents\":[\n");
+	for (size_t i = 0; i < m_events.size(); ++i) {
+		Event const& ev = m_events[i];
+		if (i != 0) {
+			json += ",\n";
+		}
+		json += "{\"name\":" + jsonString(QString::fromAscii(ev.name));
+		json += ",\"cat\":\"scantailor\",\"ph\":\"X\",\"pid\":1";
+		json += ",\"tid\":" + QByteArray::number(ev.threadIdx);
+		json += ",\"ts\":" + QByteArray::number(ev.startUsec);
+		json += ",\"dur\":" + QByteArray::number(ev.wallUsec);
+		json += ",\"args\":{\"cpu_us\":" + QByteArray::number(ev.cpuUsec);
+		json += ",\"bytes_allocated\":" + QByteArray::number(ev.bytesAllocated);
+		if (!ev.page.isEmpty()) {
+			json += ",\"page\":" + jsonString(ev.page);
+		}
+		if (!ev.imageSize.isEmpty()) {
+			json += ",\"width\":" + QByteArray::number(ev.imageSize.width());
+			json += ",\"height\":" + QByteArray::number(ev.imageSize.height());
+		}
+		json += "}}";
+	}
+	json += "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+	return json;
+}
+
+QByteArray
+Profiler::summaryJson() const
+{
+	struct Totals
+	{
+		int count;
+		qint64 wallUsec;
+		qint64 cpuUsec;
+		qint64 selfWallUsec;
+		qint64 selfCpuUsec;
+		qint64 bytesAllocated;
+
+		Totals()
+		: count(0), wallUsec(0), cpuUsec(0),
+		selfWallUsec(0), selfCpuUsec(0), bytesAllocated(0) {}
+	};
+
+	typedef std::map<QString, Totals> TotalsMap;
+	TotalsMap totals;
+
+	{
+		QMutexLocker const locker(&m_mutex);
+		for (size_t i = 0; i < m_events.size(); ++i) {
+			Event const& ev = m_events[i];
+			Totals& t = totals[QString::fromAscii(ev.name)];
+			++t.count;
+			t.wallUsec += ev.wallUsec;
+			t.cpuUsec += ev.cpuUsec;
+			t.selfWallUsec += ev.wallUsec - ev.childWallUsec;
+			t.selfCpuUsec += ev.cpuUsec - ev.childCpuUsec;
+			t.bytesAllocated += ev.bytesAllocated;
+		}
+	}
+
+	QByteArray json("{\"steps\":[\n");
+	for (TotalsMap::const_iterator it(totals.begin()); it != totals.end(); ++it) {
+		if (it != totals.begin()) {
+			json += ",\n";
+		}
+		json += "{\"name\":" + jsonString(it->first);
+		json += ",\"count\":" + QByteArray::number(it->second.count);
+		json += ",\"wall_us\":" + QByteArray::number(it->second.wallUsec);
+		json += ",\"cpu_us\":" + QByteArray::number(it->second.cpuUsec);
+		json += ",\"self_wall_us\":" + QByteArray::number(it->second.selfWallUsec);
+		json += ",\"self_cpu_us\":" + QByteArray::number(it->second.selfCpuUsec);
+		json += ",\"bytes_allocated\":" + QByteArray::number(it->second.bytesAllocated);
+		json += "}";
+	}
+	json += "\n]}\n";
+
+	return json;
+}
+
+
+/*=============================== ProfileSpan ==============================*/
+
+void
+ProfileSpan::start(char const* name, QString const& page)
+{
+	Profiler& profiler = Profiler::instance();
+
+	if (!profiler.m_threadState.hasLocalData()) {
+		profiler.m_threadState.setLocalData(new Profiler::ThreadState);
+	}
+	Profiler::ThreadState& state = *profiler.m_threadState.localData();
+
+	m_pEvent = new Profiler::Event;
+	m_pEvent->name = name;
+	m_pEvent->parent = state.innermost;
+	if (!page.isEmpty() || !state.innermost) {
+		m_pEvent->page = page;
+	} else {
+		m_pEvent->page = state.innermost->page;
+	}
+	m_pEvent->threadIdx = 0;
+	m_pEvent->childWallUsec = 0;
+	m_pEvent->childCpuUsec = 0;
+	m_pEvent->bytesAllocated = MemoryBudget::instance().allocatedByThisThread();
+	m_pEvent->cpuUsec = Profiler::threadCpuUsec();
+	m_pEvent->startUsec = profiler.wallClockUsec();
+	m_pEvent->wallUsec = 0;
+
+	state.innermost = m_pEvent;
+}
+
+void
+ProfileSpan::finish()
+{
+	Profiler& profiler = Profiler::instance();
+	std::auto_ptr<Profiler::Event> const event(m_pEvent);
+	m_pEvent = 0;
+
+	event->wallUsec = profiler.wallClockUsec() - event->startUsec;
+	event->cpuUsec = Profiler::threadCpuUsec() - event->cpuUsec;
+	event->bytesAllocated = MemoryBudget::instance().allocatedByThisThread()
+		- event->bytesAllocated;
+
+	if (Profiler::Event* parent = event->parent) {
+		parent->childWallUsec += event->wallUsec;
+		parent->childCpuUsec += event->cpuUsec;
+	}
+	profiler.m_threadState.localData()->innermost = event->parent;
+
+	profiler.record(*event);
+}
@@ -0,0 +1,178 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include "NonCopyable.h"
+#include <QAtomicInt>
+#include <QMutex>
+#include <QString>
+#include <QSize>
+#include <QThreadStorage>
+#include <vector>
+
+/**
+ * \brief Collects timing spans for a machine-readable performance report.
+ *
+ * Spans are recorded by ProfileSpan objects.  When profiling is disabled,
+ * which is the default, constructing and destroying a ProfileSpan costs
+ * a single atomic read of a flag.  Profiling is meant to be enabled once, before
+ * processing starts, and the report written once processing has finished.
+ *
+ * This class is thread-safe.
+ */
+class Profiler
+{
+	DECLARE_NON_COPYABLE(Profiler)
+public:
+	enum Format {
+		/** Chrome's trace event format, as understood by chrome://tracing. */
+		TRACE_EVENTS,
+
+		/** Per-step totals, both including and excluding nested spans. */
+		SUMMARY
+	};
+
+	static Profiler& instance();
+
+	static bool isEnabled() { return m_sEnabled.fetchAndAddRelaxed(0) != 0; }
+
+	void setEnabled(bool enabled);
+
+	/**
+	 * \brief The page label of the innermost span on the calling thread.
+	 *
+	 * That's for passing the label on to work continued on another
+	 * thread, where spans don't inherit it.  Empty if there is no span.
+	 */
+	QString currentPage() const;
+
+	/**
+	 * \brief Writes the collected spans as JSON.
+	 *
+	 * \return true on success.
+	 */
+	bool writeReport(QString const& file_path, Format format) const;
+private:
+	friend class ProfileSpan;
+
+	struct Event
+	{
+		char const* name;
+		QString page;
+		Event* parent; // The enclosing span on the same thread.
+		QSize imageSize;
+		int threadIdx;
+		qint64 startUsec;
+		qint64 wallUsec;
+		qint64 cpuUsec;
+		qint64 childWallUsec;
+		qint64 childCpuUsec;
+		qint64 bytesAllocated;
+	};
+
+	struct ThreadState
+	{
+		Event* innermost;
+
+		ThreadState() : innermost(0) {}
+	};
+
+	Profiler();
+
+	/** Microseconds since the profiler was enabled. */
+	qint64 wallClockUsec() const;
+
+	/** CPU time consumed by the calling thread, in microseconds. */
+	static qint64 threadCpuUsec();
+
+	void record(Event& event);
+
+	QByteArray traceEventsJson() const;
+
+	QByteArray summaryJson() const;
+
+	static QAtomicInt m_sEnabled;
+
+	QThreadStorage<ThreadState*> m_threadState;
+
+	mutable QMutex m_mutex;
+	std::vector<Event> m_events;
+	std::vector<void*> m_threads;
+	qint64 m_epochUsec;
+};
+
+
+/**
+ * \brief Records the wall time, CPU time and memory allocated between
+ *        its construction and destruction.
+ *
+ * Both CPU time and allocated memory are those of the calling thread.
+ * Allocated memory is what went through MemoryBudget, which covers
+ * BinaryImage data, but not other images.
+ *
+ * \code
+ * ProfileSpan span("output::OutputGenerator::binarize", page_label);
+ * span.setImageSize(image.size());
+ * \endcode
+ *
+ * \p name must be a string literal or otherwise outlive the Profiler.
+ */
+class ProfileSpan
+{
+	DECLARE_NON_COPYABLE(ProfileSpan)
+public:
+	explicit ProfileSpan(char const* name) : m_pEvent(0) {
+		if (Profiler::isEnabled()) {
+			start(name, QString());
+		}
+	}
+
+	/**
+	 * \param name The name of the step.
+	 * \param page A label of the page being processed.  Spans nested into
+	 *        this one on the same thread inherit it.
+	 */
+	ProfileSpan(char const* name, QString const& page) : m_pEvent(0) {
+		if (Profiler::isEnabled()) {
+			start(name, page);
+		}
+	}
+
+	~ProfileSpan() {
+		if (m_pEvent) {
+			finish();
+		}
+	}
+
+	void setImageSize(QSize const& size) {
+		if (m_pEvent) {
+			m_pEvent->imageSize = size;
+		}
+	}
+private:
+	void start(char const* name, QString const& page);
+
+	void finish();
+
+	Profiler::Event* m_pEvent;
+};
+
+#endif
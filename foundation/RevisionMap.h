@@ -0,0 +1,74 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef REVISIONMAP_H_
+#define REVISIONMAP_H_
+
+#include <map>
+
+/**
+ * \brief Tracks modifications of per-key (typically per-page) settings.
+ *
+ * Each modification gets a revision number greater than any previously
+ * issued one.  Comparing a stored revision with the current one tells
+ * whether anything changed since then.
+ *
+ * This class is not thread-safe.  It's meant to be protected by the same
+ * mutex that protects the settings being tracked.
+ */
+template<typename Key>
+class RevisionMap
+{
+	// Member-wise copying is OK.
+public:
+	typedef unsigned long long Revision;
+
+	RevisionMap() : m_lastRevision(0), m_baseRevision(0) {}
+
+	/**
+	 * \brief Marks settings associated with \p key as modified.
+	 */
+	void touch(Key const& key) { m_revisions[key] = ++m_lastRevision; }
+
+	/**
+	 * \brief Marks settings associated with all keys as modified.
+	 */
+	void touchAll() {
+		m_revisions.clear();
+		m_baseRevision = ++m_lastRevision;
+	}
+
+	/**
+	 * \brief Returns the revision of settings associated with \p key.
+	 */
+	Revision revision(Key const& key) const {
+		typename std::map<Key, Revision>::const_iterator const it(m_revisions.find(key));
+		if (it == m_revisions.end()) {
+			return m_baseRevision;
+		} else {
+			return it->second;
+		}
+	}
+private:
+	std::map<Key, Revision> m_revisions;
+	Revision m_lastRevision;
+	Revision m_baseRevision;
+};
+
+#endif
@@ -19,6 +19,7 @@
 #include "BinaryImage.h"
 #include "ByteOrder.h"
 #include "BitOps.h"
+#include "MemoryBudget.h"
 #include <QAtomicInt>
 #include <QImage>
 #include <QRect>
@@ -1180,7 +1181,7 @@ BinaryImage::SharedData::unref() const
 {
 	if (!m_refCounter.deref()) {
 		this->~SharedData();
-		free((void*)this);
+		MemoryBudget::instance().deallocate((void*)this);
 	}
 }
 
@@ -1188,17 +1189,15 @@ void*
 BinaryImage::SharedData::operator new(size_t, NumWords const num_words)
 {
 	SharedData* sd = 0;
-	void* addr = malloc(((char*)&sd->m_data[0] - (char*)sd) + num_words.numWords * 4);
-	if (!addr) {
-		throw std::bad_alloc();
-	}
-	return addr;
+	return MemoryBudget::instance().allocate(
+		((char*)&sd->m_data[0] - (char*)sd) + num_words.numWords * 4
+	);
 }
 
 void
 BinaryImage::SharedData::operator delete(void* addr, NumWords)
 {
-	free(addr);
+	MemoryBudget::instance().deallocate(addr);
 }
 
 } // namespace imageproc
@@ -24,6 +24,7 @@
 #include <QColor>
 #include <QtGlobal>
 #include <stdexcept>
+#include <vector>
 #include <algorithm>
 #include <new>
 #include <string.h>
@@ -32,41 +33,128 @@
 namespace imageproc
 {
 
-static QImage monoMsbToGrayscale(QImage const& src)
+namespace
 {
-	int const width = src.width();
-	int const height = src.height();
-	
-	QImage dst(width, height, QImage::Format_Indexed8);
-	dst.setColorTable(createGrayscalePalette());
-	if (width > 0 && height > 0 && dst.isNull()) {
-		throw std::bad_alloc();
+
+/**
+ * Accumulates a histogram of 8-bit values in four banks of counters
+ * used in rotation.  With a single bank, runs of identical pixels,
+ * which are very common in scans, make each increment wait until
+ * the previous increment of the same counter is stored.
+ */
+class HistogramBanks
+{
+public:
+	HistogramBanks() {
+		memset(m_banks, 0, sizeof(m_banks));
 	}
-	
-	uint8_t const* src_line = src.bits();
-	uint8_t* dst_line = dst.bits();
-	int const src_bpl = src.bytesPerLine();
-	int const dst_bpl = dst.bytesPerLine();
-	
-	uint8_t bin2gray[2] = { 0, 0xff };
-	if (src.numColors() >= 2) {
-		if (qGray(src.color(0)) > qGray(src.color(1))) {
-			// if color 0 is lighter than color 1
-			bin2gray[0] = 0xff;
-			bin2gray[1] = 0;
+
+	void addLine(uint8_t const* line, int const width) {
+		int x = 0;
+		for (; x + 4 <= width; x += 4) {
+			++m_banks[0][line[x]];
+			++m_banks[1][line[x + 1]];
+			++m_banks[2][line[x + 2]];
+			++m_banks[3][line[x + 3]];
+		}
+		for (; x < width; ++x) {
+			++m_banks[0][line[x]];
+		}
+	}
+
+	void addTo(GrayscaleHistogram& hist) const {
+		for (int i = 0; i < 256; ++i) {
+			hist[i] += m_banks[0][i] + m_banks[1][i] + m_banks[2][i] + m_banks[3][i];
 		}
 	}
+private:
+	uint32_t m_banks[4][256];
+};
+
+/**
+ * Converts scan lines of a non-monochrome image to gray levels,
+ * giving the same results as qGray(src.pixel(x, y)).
+ */
+class GrayLineConverter
+{
+public:
+	explicit GrayLineConverter(QImage const& src);
+
+	void convert(int y, uint8_t* dst) const;
+private:
+	static void rgb32ToGray(uint32_t const* src, uint8_t* dst, int width);
+
+	static void indexed8ToGray(
+		uint8_t const* src, uint8_t* dst, int width, uint8_t const* color_to_gray);
+
+	QImage const& m_src;
+	uint8_t m_colorToGray[256];
+};
+
+GrayLineConverter::GrayLineConverter(QImage const& src)
+:	m_src(src)
+{
+	memset(m_colorToGray, 0, sizeof(m_colorToGray));
+	if (src.format() == QImage::Format_Indexed8) {
+		int const num_colors = std::min(src.numColors(), 256);
+		for (int i = 0; i < num_colors; ++i) {
+			m_colorToGray[i] = static_cast<uint8_t>(qGray(src.color(i)));
+		}
+	}
+}
+
+void
+GrayLineConverter::convert(int const y, uint8_t* dst) const
+{
+	int const width = m_src.width();
 	
-	for (int y = 0; y < height; ++y) {
-		for (int x = 0; x < width;) {
-			uint8_t const b = src_line[x / 8];
-			for (int i = 7; i >= 0 && x < width; --i, ++x) {
-				dst_line[x] = bin2gray[(b >> i) & 1];
-			}
+	switch (m_src.format()) {
+	case QImage::Format_RGB32:
+	case QImage::Format_ARGB32:
+		rgb32ToGray((uint32_t const*)m_src.scanLine(y), dst, width);
+		break;
+	case QImage::Format_Indexed8:
+		indexed8ToGray(m_src.scanLine(y), dst, width, m_colorToGray);
+		break;
+	default:
+		for (int x = 0; x < width; ++x) {
+			dst[x] = static_cast<uint8_t>(qGray(m_src.pixel(x, y)));
 		}
-		
-		src_line += src_bpl;
-		dst_line += dst_bpl;
+	}
+}
+
+void
+GrayLineConverter::rgb32ToGray(uint32_t const* src, uint8_t* dst, int const width)
+{
+	// The same formula as in qGray(), written so that compilers
+	// are able to vectorize it.
+	for (int x = 0; x < width; ++x) {
+		uint32_t const rgb = src[x];
+		uint32_t const r = (rgb >> 16) & 0xff;
+		uint32_t const g = (rgb >> 8) & 0xff;
+		uint32_t const b = rgb & 0xff;
+		dst[x] = static_cast<uint8_t>((r * 11 + g * 16 + b * 5) >> 5);
+	}
+}
+
+void
+GrayLineConverter::indexed8ToGray(
+	uint8_t const* src, uint8_t* dst, int const width,
+	uint8_t const* color_to_gray)
+{
+	for (int x = 0; x < width; ++x) {
+		dst[x] = color_to_gray[src[x]];
+	}
+}
+
+} // anonymous namespace
+
+static QImage createGrayscaleImage(QImage const& src)
+{
+	QImage dst(src.width(), src.height(), QImage::Format_Indexed8);
+	dst.setColorTable(createGrayscalePalette());
+	if (src.width() > 0 && src.height() > 0 && dst.isNull()) {
+		throw std::bad_alloc();
 	}
 	
 	dst.setDotsPerMeterX(src.dotsPerMeterX());
@@ -75,16 +163,12 @@ static QImage monoMsbToGrayscale(QImage const& src)
 	return dst;
 }
 
-static QImage monoLsbToGrayscale(QImage const& src)
+static QImage monoToGrayscale(QImage const& src, GrayscaleHistogram* histogram)
 {
 	int const width = src.width();
 	int const height = src.height();
 	
-	QImage dst(width, height, QImage::Format_Indexed8);
-	dst.setColorTable(createGrayscalePalette());
-	if (width > 0 && height > 0 && dst.isNull()) {
-		throw std::bad_alloc();
-	}
+	QImage dst(createGrayscaleImage(src));
 	
 	uint8_t const* src_line = src.bits();
 	uint8_t* dst_line = dst.bits();
@@ -100,47 +184,69 @@ static QImage monoLsbToGrayscale(QImage const& src)
 		}
 	}
 	
+	// Every possible source byte, expanded to 8 gray pixels.
+	bool const msb_first = (src.format() == QImage::Format_Mono);
+	uint8_t byte2gray[256][8];
+	for (int b = 0; b < 256; ++b) {
+		for (int i = 0; i < 8; ++i) {
+			int const bit = msb_first ? 7 - i : i;
+			byte2gray[b][i] = bin2gray[(b >> bit) & 1];
+		}
+	}
+	
+	int const full_bytes = width >> 3;
+	int const remaining_pixels = width & 7;
+	HistogramBanks banks;
+	
 	for (int y = 0; y < height; ++y) {
-		for (int x = 0; x < width;) {
-			uint8_t const b = src_line[x / 8];
-			for (int i = 0; i < 8 && x < width; ++i, ++x) {
-				dst_line[x] = bin2gray[(b >> i) & 1];
-			}
+		for (int i = 0; i < full_bytes; ++i) {
+			memcpy(dst_line + (i << 3), byte2gray[src_line[i]], 8);
+		}
+		if (remaining_pixels) {
+			memcpy(
+				dst_line + (full_bytes << 3),
+				byte2gray[src_line[full_bytes]], remaining_pixels
+			);
+		}
+		if (histogram) {
+			banks.addLine(dst_line, width);
 		}
 		
 		src_line += src_bpl;
 		dst_line += dst_bpl;
 	}
 	
-	dst.setDotsPerMeterX(src.dotsPerMeterX());
-	dst.setDotsPerMeterY(src.dotsPerMeterY());
+	if (histogram) {
+		banks.addTo(*histogram);
+	}
 	
 	return dst;
 }
 
-static QImage anyToGrayscale(QImage const& src)
+static QImage anyToGrayscale(QImage const& src, GrayscaleHistogram* histogram)
 {
-	int const width = src.width();
 	int const height = src.height();
 	
-	QImage dst(width, height, QImage::Format_Indexed8);
-	dst.setColorTable(createGrayscalePalette());
-	if (width > 0 && height > 0 && dst.isNull()) {
-		throw std::bad_alloc();
-	}
+	QImage dst(createGrayscaleImage(src));
 	
 	uint8_t* dst_line = dst.bits();
 	int const dst_bpl = dst.bytesPerLine();
 	
+	GrayLineConverter const converter(src);
+	HistogramBanks banks;
+	
 	for (int y = 0; y < height; ++y) {
-		for (int x = 0; x < width; ++x) {
-			dst_line[x] = static_cast<uint8_t>(qGray(src.pixel(x, y)));
+		converter.convert(y, dst_line);
+		if (histogram) {
+			// The line is still in cache at this point.
+			banks.addLine(dst_line, src.width());
 		}
 		dst_line += dst_bpl;
 	}
 	
-	dst.setDotsPerMeterX(src.dotsPerMeterX());
-	dst.setDotsPerMeterY(src.dotsPerMeterY());
+	if (histogram) {
+		banks.addTo(*histogram);
+	}
 	
 	return dst;
 }
@@ -154,20 +260,26 @@ QVector<QRgb> createGrayscalePalette()
 	return palette;
 }
 
-QImage toGrayscale(QImage const& src)
+QImage toGrayscale(QImage const& src, GrayscaleHistogram* const histogram)
 {
+	if (histogram) {
+		*histogram = GrayscaleHistogram();
+	}
+	
 	if (src.isNull()) {
 		return src;
 	}
 	
 	switch (src.format()) {
 	case QImage::Format_Mono:
-		return monoMsbToGrayscale(src);
 	case QImage::Format_MonoLSB:
-		return monoLsbToGrayscale(src);
+		return monoToGrayscale(src, histogram);
 	case QImage::Format_Indexed8:
 		if (src.isGrayscale()) {
 			if (src.numColors() == 256) {
+				if (histogram) {
+					*histogram = GrayscaleHistogram(src);
+				}
 				return src;
 			} else {
 				QImage dst(src);
@@ -175,12 +287,15 @@ QImage toGrayscale(QImage const& src)
 				if (!src.isNull() && dst.isNull()) {
 					throw std::bad_alloc();
 				}
+				if (histogram) {
+					*histogram = GrayscaleHistogram(dst);
+				}
 				return dst;
 			}
 		}
 		// fall though
 	default:
-		return anyToGrayscale(src);
+		return anyToGrayscale(src, histogram);
 	}
 }
 
@@ -297,6 +412,11 @@ unsigned char darkestGrayLevel(QImage const& image)
 	return darkest;
 }
 
+GrayscaleHistogram::GrayscaleHistogram()
+{
+	memset(m_pixels, 0, sizeof(m_pixels));
+}
+
 GrayscaleHistogram::GrayscaleHistogram(QImage const& img)
 {
 	memset(m_pixels, 0, sizeof(m_pixels));
@@ -440,12 +560,13 @@ GrayscaleHistogram::fromGrayscaleImage(QImage const& img)
 	int const h = img.height();
 	int const bpl = img.bytesPerLine();
 	uint8_t const* line = img.bits();
+	HistogramBanks banks;
 	
 	for (int y = 0; y < h; ++y, line += bpl) {
-		for (int x = 0; x < w; ++x) {
-			++m_pixels[line[x]];
-		}
+		banks.addLine(line, w);
 	}
+	
+	banks.addTo(*this);
 }
 
 void
@@ -474,11 +595,16 @@ GrayscaleHistogram::fromAnyImage(QImage const& img)
 	int const w = img.width();
 	int const h = img.height();
 	
+	GrayLineConverter const converter(img);
+	std::vector<uint8_t> gray_line(w);
+	HistogramBanks banks;
+	
 	for (int y = 0; y < h; ++y) {
-		for (int x = 0; x < w; ++x) {
-			++m_pixels[qGray(img.pixel(x, y))];
-		}
+		converter.convert(y, &gray_line[0]);
+		banks.addLine(&gray_line[0], w);
 	}
+	
+	banks.addTo(*this);
 }
 
 void
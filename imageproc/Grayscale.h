@@ -34,6 +34,11 @@ class BinaryImage;
 class GrayscaleHistogram
 {
 public:
+	/**
+	 * \brief Constructs a histogram with all counters set to zero.
+	 */
+	GrayscaleHistogram();
+
 	explicit GrayscaleHistogram(QImage const& img);
 	
 	GrayscaleHistogram(QImage const& img, BinaryImage const& mask);
@@ -66,10 +71,13 @@ QVector<QRgb> createGrayscalePalette();
  * \brief Convert an image from any format to grayscale.
  *
  * \param src The source image in any format.
+ * \param histogram If provided, receives the histogram of the returned
+ *        image, computed while converting.  That's cheaper than building
+ *        a GrayscaleHistogram from the result afterwards.
  * \return A grayscale image with proper palette.  Null will be returned
  *         if \p src was null.
  */
-QImage toGrayscale(QImage const& src);
+QImage toGrayscale(QImage const& src, GrayscaleHistogram* histogram = 0);
 
 /**
  * \brief Stetch the distribution of gray levels to cover the whole range.
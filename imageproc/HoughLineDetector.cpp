@@ -100,21 +100,63 @@ HoughLineDetector::HoughLineDetector(
 	m_histWidth = max_bin + 1;
 	m_histHeight = num_angles;
 	m_histogram.resize(m_histWidth * m_histHeight, 0);
+	
+	m_xFactors.reserve(num_angles);
+	m_yFactors.reserve(num_angles);
+	BOOST_FOREACH (QPointF const& uv, m_angleUnitVectors) {
+		m_xFactors.push_back(uv.x() * m_recipDistanceResolution);
+		m_yFactors.push_back(uv.y() * m_recipDistanceResolution);
+	}
+	m_rowTerms.resize(num_angles);
+	m_bins.resize(num_angles);
 }
 
 void
 HoughLineDetector::process(int x, int y, unsigned weight)
 {
-	unsigned* hist_line = &m_histogram[0];
+	processRow(y, x, x + 1, &weight);
+}
+
+void
+HoughLineDetector::processRow(
+	int const y, int const x_begin, int const x_end, unsigned const* weights)
+{
+	if (m_histHeight == 0) {
+		return;
+	}
 	
-	BOOST_FOREACH (QPointF const& uv, m_angleUnitVectors) {
-		double const distance = uv.x() * x + uv.y() * y;
-		double const biased_distance = distance + m_distanceBias;
-		
-		int const bin = (int)(biased_distance * m_recipDistanceResolution + 0.5);
-		assert(bin >= 0 && bin < m_histWidth);
-		hist_line[bin] += weight;
-		
+	double const bias = m_distanceBias * m_recipDistanceResolution + 0.5;
+	double const* const y_factors = &m_yFactors[0];
+	double* const row_terms = &m_rowTerms[0];
+	for (int i = 0; i < m_histHeight; ++i) {
+		row_terms[i] = y_factors[i] * y + bias;
+	}
+	
+	for (int x = x_begin; x < x_end; ++x) {
+		unsigned const weight = weights[x - x_begin];
+		if (weight != 0) {
+			vote(x, row_terms, weight);
+		}
+	}
+}
+
+void
+HoughLineDetector::vote(
+	int const x, double const* const row_terms, unsigned const weight)
+{
+	// Calculating bin indices is kept apart from incrementing bins,
+	// so that the compiler is free to vectorize the former.
+	double const* const x_factors = &m_xFactors[0];
+	int* const bins = &m_bins[0];
+	int const num_angles = m_histHeight;
+	for (int i = 0; i < num_angles; ++i) {
+		bins[i] = (int)(x_factors[i] * x + row_terms[i]);
+	}
+	
+	unsigned* hist_line = &m_histogram[0];
+	for (int i = 0; i < num_angles; ++i) {
+		assert(bins[i] >= 0 && bins[i] < m_histWidth);
+		hist_line[bins[i]] += weight;
 		hist_line += m_histWidth;
 	}
 }
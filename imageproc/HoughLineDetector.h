@@ -102,6 +102,15 @@ public:
 	 */
 	void process(int x, int y, unsigned weight = 1);
 	
+	/**
+	 * \brief Processes a horizontal run of points.
+	 *
+	 * Equivalent to calling process(x, y, weights[x - x_begin])
+	 * for every x in [x_begin, x_end) where the weight is non-zero,
+	 * but faster, as the contribution of y is only calculated once.
+	 */
+	void processRow(int y, int x_begin, int x_end, unsigned const* weights);
+	
 	QImage visualizeHoughSpace(unsigned lower_bound) const;
 	
 	/**
@@ -116,6 +125,14 @@ public:
 private:
 	class GreaterQualityFirst;
 	
+	/**
+	 * \brief Adds \p weight to the bins of every angle.
+	 *
+	 * \param row_terms The biased and scaled distance contributions
+	 *        of the y coordinate, one for each angle.
+	 */
+	void vote(int x, double const* row_terms, unsigned weight);
+	
 	static BinaryImage findHistogramPeaks(
 		std::vector<unsigned> const& hist, int width, int height,
 		unsigned lower_bound);
@@ -158,6 +175,27 @@ private:
 	 */
 	std::vector<QPointF> m_angleUnitVectors;
 	
+	/**
+	 * Cosines of our angles divided by m_distanceResolution.
+	 * Multiplied by x, they give the x contribution to a bin index.
+	 */
+	std::vector<double> m_xFactors;
+	
+	/**
+	 * Sines of our angles divided by m_distanceResolution.
+	 */
+	std::vector<double> m_yFactors;
+	
+	/**
+	 * Scratch space for row terms, one per angle.
+	 */
+	std::vector<double> m_rowTerms;
+	
+	/**
+	 * Scratch space for bin indices, one per angle.
+	 */
+	std::vector<int> m_bins;
+	
 	/**
 	 * \see HoughLineDetector:HoughLineDetector()
 	 */
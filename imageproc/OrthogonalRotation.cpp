@@ -20,17 +20,63 @@
 #include "BinaryImage.h"
 #include "BWColor.h"
 #include "RasterOp.h"
+#include <QImage>
 #include <QRect>
 #include <algorithm>
 #include <stdexcept>
+#include <new>
+#include <string.h>
 #include <stdint.h>
 
 namespace imageproc
 {
 
-static inline uint32_t mask(int x)
+/**
+ * Returns 32 bits of a line, starting from bit \p x.
+ * Bits past the end of the line come out as zeros.
+ */
+static inline uint32_t loadBits(uint32_t const* line, int const x, int const wpl)
 {
-	return (uint32_t(1) << 31) >> (x % 32);
+	int const word = x >> 5;
+	int const shift = x & 31;
+	uint32_t bits = line[word] << shift;
+	if (shift != 0 && word + 1 < wpl) {
+		bits |= line[word + 1] >> (32 - shift);
+	}
+	return bits;
+}
+
+/**
+ * Keeps the first (most significant) \p num_bits bits, clearing the rest.
+ */
+static inline uint32_t keepBits(uint32_t const bits, int const num_bits)
+{
+	return num_bits >= 32 ? bits : bits & ~(~uint32_t(0) >> num_bits);
+}
+
+static inline uint32_t reverseBits(uint32_t x)
+{
+	x = ((x >> 1) & 0x55555555) | ((x & 0x55555555) << 1);
+	x = ((x >> 2) & 0x33333333) | ((x & 0x33333333) << 2);
+	x = ((x >> 4) & 0x0f0f0f0f) | ((x & 0x0f0f0f0f) << 4);
+	x = ((x >> 8) & 0x00ff00ff) | ((x & 0x00ff00ff) << 8);
+	return (x >> 16) | (x << 16);
+}
+
+/**
+ * Transposes a 32x32 bit matrix in place.  Row i is a[i], with
+ * column 0 being its most significant bit.
+ */
+static void transpose32(uint32_t* a)
+{
+	uint32_t m = 0x0000ffff;
+	for (int j = 16; j != 0; j >>= 1, m ^= (m << j)) {
+		for (int k = 0; k < 32; k = ((k | j) + 1) & ~j) {
+			uint32_t const t = (a[k] ^ (a[k | j] >> j)) & m;
+			a[k] ^= t;
+			a[k | j] ^= (t << j);
+		}
+	}
 }
 
 static BinaryImage rotate0(BinaryImage const& src, QRect const& src_rect)
@@ -45,38 +91,62 @@ static BinaryImage rotate0(BinaryImage const& src, QRect const& src_rect)
 	return dst;
 }
 
-static BinaryImage rotate90(BinaryImage const& src, QRect const& src_rect)
+/**
+ * Rotation by 90 or 270 degrees, done in blocks of 32x32 pixels.
+ * Each block is transposed as a bit matrix, which takes about
+ * as long as copying it bit by bit would take for a single line.
+ */
+static BinaryImage rotate90or270(
+	BinaryImage const& src, QRect const& src_rect, bool const clockwise)
 {
 	int const dst_w = src_rect.height();
 	int const dst_h = src_rect.width();
 	BinaryImage dst(dst_w, dst_h);
-	dst.fill(WHITE);
 	int const src_wpl = src.wordsPerLine();
 	int const dst_wpl = dst.wordsPerLine();
-	uint32_t const* const src_data = src.data() + src_rect.bottom() * src_wpl;
-	uint32_t* dst_line = dst.data();
+	uint32_t const* const src_data = src.data();
+	uint32_t* const dst_data = dst.data();
 	
 	/*
-	 *   dst
-	 *  ----->
-	 * ^
-	 * | src
-	 * |
+	 * Clockwise:       Counter-clockwise:
+	 *   dst               dst
+	 *  ----->            ----->
+	 * ^                        |
+	 * | src                src |
+	 * |                        v
 	 */
 	
-	for (int dst_y = 0; dst_y < dst_h; ++dst_y) {
-		int const src_x = src_rect.left() + dst_y;
-		uint32_t const* src_pword = src_data + src_x / 32;
-		uint32_t const src_mask = mask(src_x);
+	uint32_t block[32];
+	
+	for (int dst_x0 = 0; dst_x0 < dst_w; dst_x0 += 32) {
+		int const block_w = std::min(32, dst_w - dst_x0);
 		
-		for (int dst_x = 0; dst_x < dst_w; ++dst_x) {
-			if (*src_pword & src_mask) {
-				dst_line[dst_x / 32] |= mask(dst_x);
+		for (int src_dx = 0; src_dx < dst_h; src_dx += 32) {
+			int const src_x0 = src_rect.left() + src_dx;
+			int const block_h = std::min(32, dst_h - src_dx);
+			
+			// Row i of the block becomes dst column dst_x0 + i.
+			for (int i = 0; i < block_w; ++i) {
+				int const src_y = clockwise
+					? src_rect.bottom() - (dst_x0 + i)
+					: src_rect.top() + dst_x0 + i;
+				uint32_t const* const src_line = src_data + src_y * src_wpl;
+				block[i] = keepBits(loadBits(src_line, src_x0, src_wpl), block_h);
+			}
+			for (int i = block_w; i < 32; ++i) {
+				block[i] = 0;
+			}
+			
+			transpose32(block);
+			
+			// Row j of the transposed block is the part of
+			// the dst line corresponding to src column src_x0 + j.
+			int const dst_word = dst_x0 >> 5;
+			for (int j = 0; j < block_h; ++j) {
+				int const dst_y = clockwise ? src_dx + j : dst_h - 1 - (src_dx + j);
+				dst_data[dst_y * dst_wpl + dst_word] = block[j];
 			}
-			src_pword -= src_wpl;
 		}
-		
-		dst_line += dst_wpl;
 	}
 	
 	return dst;
@@ -87,7 +157,6 @@ static BinaryImage rotate180(BinaryImage const& src, QRect const& src_rect)
 	int const dst_w = src_rect.width();
 	int const dst_h = src_rect.height();
 	BinaryImage dst(dst_w, dst_h);
-	dst.fill(WHITE);
 	int const src_wpl = src.wordsPerLine();
 	int const dst_wpl = dst.wordsPerLine();
 	uint32_t const* src_line = src.data() + src_rect.bottom() * src_wpl;
@@ -101,11 +170,15 @@ static BinaryImage rotate180(BinaryImage const& src, QRect const& src_rect)
 	 */
 	
 	for (int dst_y = 0; dst_y < dst_h; ++dst_y) {
-		int src_x = src_rect.right();
-		for (int dst_x = 0; dst_x < dst_w; --src_x, ++dst_x) {
-			if (src_line[src_x / 32] & mask(src_x)) {
-				dst_line[dst_x / 32] |= mask(dst_x);
-			}
+		for (int dst_x = 0; dst_x < dst_w; dst_x += 32) {
+			int const num_bits = std::min(32, dst_w - dst_x);
+			
+			// The source bits are the num_bits ones ending at
+			// src_x_end, taken in reverse order.
+			int const src_x_end = src_rect.right() - dst_x;
+			int const src_x = src_x_end - num_bits + 1;
+			uint32_t const bits = keepBits(loadBits(src_line, src_x, src_wpl), num_bits);
+			dst_line[dst_x >> 5] = reverseBits(bits) << (32 - num_bits);
 		}
 		
 		src_line -= src_wpl;
@@ -115,43 +188,6 @@ static BinaryImage rotate180(BinaryImage const& src, QRect const& src_rect)
 	return dst;
 }
 
-static BinaryImage rotate270(BinaryImage const& src, QRect const& src_rect)
-{
-	int const dst_w = src_rect.height();
-	int const dst_h = src_rect.width();
-	BinaryImage dst(dst_w, dst_h);
-	dst.fill(WHITE);
-	int const src_wpl = src.wordsPerLine();
-	int const dst_wpl = dst.wordsPerLine();
-	uint32_t const* const src_data = src.data() + src_rect.top() * src_wpl;
-	uint32_t* dst_line = dst.data();
-	
-	/*
-	 *  dst
-	 * ----->
-	 *       |
-	 *   src |
-	 *       v
-	 */
-	
-	for (int dst_y = 0; dst_y < dst_h; ++dst_y) {
-		int const src_x = src_rect.right() - dst_y;
-		uint32_t const* src_pword = src_data + src_x / 32;
-		uint32_t const src_mask = mask(src_x);
-		
-		for (int dst_x = 0; dst_x < dst_w; ++dst_x) {
-			if (*src_pword & src_mask) {
-				dst_line[dst_x / 32] |= mask(dst_x);
-			}
-			src_pword += src_wpl;
-		}
-		
-		dst_line += dst_wpl;
-	}
-	
-	return dst;
-}
-
 BinaryImage orthogonalRotation(
 	BinaryImage const& src, QRect const& src_rect, int const degrees)
 {
@@ -168,13 +204,13 @@ BinaryImage orthogonalRotation(
 		return rotate0(src, src_rect);
 	case 90:
 	case -270:
-		return rotate90(src, src_rect);
+		return rotate90or270(src, src_rect, true);
 	case 180:
 	case -180:
 		return rotate180(src, src_rect);
 	case 270:
 	case -90:
-		return rotate270(src, src_rect);
+		return rotate90or270(src, src_rect, false);
 	default:
 		throw std::invalid_argument("orthogonalRotation: invalid angle");
 	}
@@ -185,4 +221,138 @@ BinaryImage orthogonalRotation(BinaryImage const& src, int const degrees)
 	return orthogonalRotation(src, src.rect(), degrees);
 }
 
+/**
+ * Rotates pixels of type Pixel by 0, 90, 180 or 270 degrees clockwise.
+ */
+template<typename Pixel>
+static void rotatePixels(
+	uint8_t const* const src_data, int const src_bpl, QRect const& src_rect,
+	uint8_t* const dst_data, int const dst_bpl, int const degrees)
+{
+	// A tile of this many pixels a side covers a 64 byte cache line
+	// in each of the source lines it touches.
+	int const tile = 64 / sizeof(Pixel);
+	
+	int const src_w = src_rect.width();
+	int const src_h = src_rect.height();
+	
+	if (degrees == 0 || degrees == 180) {
+		for (int dst_y = 0; dst_y < src_h; ++dst_y) {
+			Pixel* const dst_line = (Pixel*)(dst_data + dst_y * dst_bpl);
+			if (degrees == 0) {
+				Pixel const* const src_line = (Pixel const*)(
+					src_data + (src_rect.top() + dst_y) * src_bpl
+				) + src_rect.left();
+				memcpy(dst_line, src_line, src_w * sizeof(Pixel));
+			} else {
+				Pixel const* const src_line = (Pixel const*)(
+					src_data + (src_rect.bottom() - dst_y) * src_bpl
+				) + src_rect.right();
+				for (int dst_x = 0; dst_x < src_w; ++dst_x) {
+					dst_line[dst_x] = *(src_line - dst_x);
+				}
+			}
+		}
+		return;
+	}
+	
+	bool const clockwise = (degrees == 90);
+	int const dst_w = src_h;
+	int const dst_h = src_w;
+	
+	// Moving along a dst line means moving along a src column.
+	int const src_step = clockwise ? -src_bpl : src_bpl;
+	
+	for (int tile_y = 0; tile_y < dst_h; tile_y += tile) {
+		int const tile_y_end = std::min(tile_y + tile, dst_h);
+		for (int tile_x = 0; tile_x < dst_w; tile_x += tile) {
+			int const tile_x_end = std::min(tile_x + tile, dst_w);
+			int const src_y = clockwise
+				? src_rect.bottom() - tile_x : src_rect.top() + tile_x;
+			for (int dst_y = tile_y; dst_y < tile_y_end; ++dst_y) {
+				int const src_x = clockwise
+					? src_rect.left() + dst_y : src_rect.right() - dst_y;
+				uint8_t const* src_p = src_data + src_y * src_bpl + src_x * sizeof(Pixel);
+				Pixel* const dst_line = (Pixel*)(dst_data + dst_y * dst_bpl);
+				for (int dst_x = tile_x; dst_x < tile_x_end; ++dst_x) {
+					dst_line[dst_x] = *(Pixel const*)src_p;
+					src_p += src_step;
+				}
+			}
+		}
+	}
+}
+
+QImage orthogonalRotation(QImage const& src, QRect const& src_rect, int degrees)
+{
+	if (src.isNull() || src_rect.isNull()) {
+		return QImage();
+	}
+	
+	if (src_rect.intersected(src.rect()) != src_rect) {
+		throw std::invalid_argument("orthogonalRotation: invalid src_rect");
+	}
+	
+	degrees %= 360;
+	if (degrees < 0) {
+		degrees += 360;
+	}
+	if (degrees % 90 != 0) {
+		throw std::invalid_argument("orthogonalRotation: invalid angle");
+	}
+	
+	switch (src.format()) {
+	case QImage::Format_Indexed8:
+	case QImage::Format_RGB32:
+	case QImage::Format_ARGB32:
+	case QImage::Format_ARGB32_Premultiplied:
+		break;
+	case QImage::Format_Mono:
+	case QImage::Format_MonoLSB:
+		return orthogonalRotation(
+			src.convertToFormat(QImage::Format_Indexed8), src_rect, degrees
+		);
+	default:
+		return orthogonalRotation(
+			src.convertToFormat(QImage::Format_ARGB32), src_rect, degrees
+		);
+	}
+	
+	bool const swap_dims = (degrees == 90 || degrees == 270);
+	QSize const dst_size(
+		swap_dims ? src_rect.height() : src_rect.width(),
+		swap_dims ? src_rect.width() : src_rect.height()
+	);
+	
+	QImage dst(dst_size, src.format());
+	if (src.format() == QImage::Format_Indexed8) {
+		dst.setColorTable(src.colorTable());
+	}
+	if (dst.isNull()) {
+		throw std::bad_alloc();
+	}
+	
+	if (src.format() == QImage::Format_Indexed8) {
+		rotatePixels<uint8_t>(
+			src.bits(), src.bytesPerLine(), src_rect,
+			dst.bits(), dst.bytesPerLine(), degrees
+		);
+	} else {
+		rotatePixels<uint32_t>(
+			src.bits(), src.bytesPerLine(), src_rect,
+			dst.bits(), dst.bytesPerLine(), degrees
+		);
+	}
+	
+	dst.setDotsPerMeterX(swap_dims ? src.dotsPerMeterY() : src.dotsPerMeterX());
+	dst.setDotsPerMeterY(swap_dims ? src.dotsPerMeterX() : src.dotsPerMeterY());
+	
+	return dst;
+}
+
+QImage orthogonalRotation(QImage const& src, int const degrees)
+{
+	return orthogonalRotation(src, src.rect(), degrees);
+}
+
 } // namespace imageproc
@@ -21,6 +21,7 @@
 #define IMAGEPROC_ORTHOGONAL_ROTATION_H_
 
 class QRect;
+class QImage;
 
 namespace imageproc
 {
@@ -51,6 +52,33 @@ BinaryImage orthogonalRotation(
  */
 BinaryImage orthogonalRotation(BinaryImage const& src, int degrees);
 
+/**
+ * \brief Rotation of a QImage by 0, 90, 180 or 270 degrees.
+ *
+ * Indexed8, RGB32, ARGB32 and ARGB32_Premultiplied images keep their
+ * format and palette.  Other formats are converted to Indexed8 (1-bit
+ * ones) or ARGB32 first.  Pixels are moved in square tiles, so that
+ * reading the source column-wise doesn't keep missing the cache.
+ *
+ * \param src The source image.  May be null, in which case
+ *        a null rotated image will be returned.
+ * \param src_rect The area that is to be rotated.
+ * \param degrees The rotation angle in degrees.  The angle
+ *        must be a multiple of 90.  Positive values indicate
+ *        clockwise rotation.
+ * \return The rotated area of the source image.  The dimensions
+ *         and DPI of the returned image will correspond to \p src_rect
+ *         and \p src, possibly with horizontal and vertical values swapped.
+ */
+QImage orthogonalRotation(QImage const& src, QRect const& src_rect, int degrees);
+
+/**
+ * \brief Rotation of a whole QImage by 0, 90, 180 or 270 degrees.
+ *
+ * This is an overload provided for convenience.
+ */
+QImage orthogonalRotation(QImage const& src, int degrees);
+
 } // namespace imageproc
 
 #endif
@@ -92,6 +92,11 @@ public:
 	template<typename T, typename PostProcessor>
 	void output(T* values, int num_values, int step, PostProcessor pp) const;
 private:
+	friend class PolynomialLineFitter;
+	
+	explicit PolynomialLine(std::vector<double> const& coeffs)
+	: m_coeffs(coeffs) {}
+	
 	template<typename T>
 	class StaticCastPostProcessor
 	{
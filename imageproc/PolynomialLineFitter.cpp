@@ -0,0 +1,102 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "PolynomialLineFitter.h"
+#include <math.h>
+#include <assert.h>
+
+namespace imageproc
+{
+
+PolynomialLineFitter::PolynomialLineFitter(int degree, int const num_values)
+{
+	PolynomialLine::validateArguments(degree, num_values);
+	
+	if (degree + 1 > num_values) {
+		degree = num_values - 1;
+	}
+	
+	m_numTerms = degree + 1;
+	m_numValues = num_values;
+	
+	// Columns of the design matrix, stored one after another.
+	// Data points are positioned in range of [1, 2], like
+	// PolynomialLine does.
+	std::vector<double> q(m_numTerms * num_values);
+	double const scale = PolynomialLine::calcScale(num_values);
+	for (int i = 0; i < num_values; ++i) {
+		double const position = 1.0 + i * scale;
+		double pow = 1.0;
+		for (int t = 0; t < m_numTerms; ++t, pow *= position) {
+			q[t * num_values + i] = pow;
+		}
+	}
+	
+	// Turn the design matrix into Q * R, where Q has orthonormal columns
+	// and R is upper triangular, using the modified Gram-Schmidt process.
+	// The second orthogonalization pass makes up for the poor conditioning
+	// of a Vandermonde matrix.
+	std::vector<double> r(m_numTerms * m_numTerms, 0.0);
+	for (int t = 0; t < m_numTerms; ++t) {
+		double* const qt = &q[t * num_values];
+		for (int pass = 0; pass < 2; ++pass) {
+			for (int k = 0; k < t; ++k) {
+				double const* const qk = &q[k * num_values];
+				double dot = 0.0;
+				for (int i = 0; i < num_values; ++i) {
+					dot += qk[i] * qt[i];
+				}
+				for (int i = 0; i < num_values; ++i) {
+					qt[i] -= dot * qk[i];
+				}
+				r[k * m_numTerms + t] += dot;
+			}
+		}
+		
+		double norm = 0.0;
+		for (int i = 0; i < num_values; ++i) {
+			norm += qt[i] * qt[i];
+		}
+		norm = sqrt(norm);
+		assert(norm > 0.0);
+		
+		r[t * m_numTerms + t] = norm;
+		for (int i = 0; i < num_values; ++i) {
+			qt[i] /= norm;
+		}
+	}
+	
+	// The least squares solution for data points d is R^-1 * Q^T * d,
+	// so the projection matrix is R^-1 * Q^T.  We get it by back-substitution,
+	// one data point (that is, one column of Q^T) at a time.
+	m_projection.resize(m_numTerms * num_values);
+	std::vector<double> x(m_numTerms);
+	for (int i = 0; i < num_values; ++i) {
+		for (int t = m_numTerms - 1; t >= 0; --t) {
+			double sum = q[t * num_values + i];
+			for (int k = t + 1; k < m_numTerms; ++k) {
+				sum -= r[t * m_numTerms + k] * x[k];
+			}
+			x[t] = sum / r[t * m_numTerms + t];
+			m_projection[t * num_values + i] = x[t];
+		}
+	}
+}
+
+} // namespace imageproc
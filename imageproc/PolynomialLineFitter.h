@@ -0,0 +1,141 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef IMAGEPROC_POLYNOMIAL_LINE_FITTER_H_
+#define IMAGEPROC_POLYNOMIAL_LINE_FITTER_H_
+
+#include "PolynomialLine.h"
+#include <vector>
+
+namespace imageproc
+{
+
+/**
+ * \brief Fits polynomials of the same degree to many sequences
+ *        of the same length.
+ *
+ * The least squares problem PolynomialLine solves depends only on
+ * the degree and the number of values, not on the values themselves.
+ * This class solves it once, reducing each fit to a matrix-vector
+ * product.  The results are the same as those of PolynomialLine's
+ * constructor, up to rounding errors.
+ */
+class PolynomialLineFitter
+{
+	// Member-wise copying is OK.
+public:
+	/**
+	 * \param degree The degree of polynomials to be constructed.
+	 *        If there are too few data points, the degree may
+	 *        be silently reduced.  The minimum degree is 0.
+	 * \param num_values The number of data points in every sequence.
+	 *        Has to be positive.
+	 */
+	PolynomialLineFitter(int degree, int num_values);
+	
+	int numValues() const { return m_numValues; }
+	
+	/**
+	 * \brief Fits a polynomial to a sequence of values.
+	 *
+	 * The data points will be accessed like this:\n
+	 * values[0], values[step], values[step * 2]
+	 */
+	template<typename T>
+	PolynomialLine fit(T const* values, int step) const;
+	
+	/**
+	 * \brief Fits a polynomial to every column of a matrix.
+	 *
+	 * This is faster than calling fit() for every column, as the matrix
+	 * is traversed row by row.
+	 *
+	 * \param values The first element of the first column.
+	 * \param num_columns The number of columns to fit.
+	 * \param stride The distance between vertically adjacent elements.
+	 * \return A polynomial for each of the columns, in order.
+	 */
+	template<typename T>
+	std::vector<PolynomialLine> fitColumns(
+		T const* values, int num_columns, int stride) const;
+private:
+	int m_numTerms;
+	int m_numValues;
+	
+	/**
+	 * A row of m_numValues weights per polynomial coefficient.
+	 * A coefficient is the dot product of its row with the data points.
+	 */
+	std::vector<double> m_projection;
+};
+
+
+template<typename T>
+PolynomialLine
+PolynomialLineFitter::fit(T const* const values, int const step) const
+{
+	std::vector<double> coeffs(m_numTerms);
+	
+	double const* weights = &m_projection[0];
+	for (int t = 0; t < m_numTerms; ++t, weights += m_numValues) {
+		double sum = 0.0;
+		T const* p = values;
+		for (int i = 0; i < m_numValues; ++i, p += step) {
+			sum += weights[i] * *p;
+		}
+		coeffs[t] = sum;
+	}
+	
+	return PolynomialLine(coeffs);
+}
+
+template<typename T>
+std::vector<PolynomialLine>
+PolynomialLineFitter::fitColumns(
+	T const* values, int const num_columns, int const stride) const
+{
+	// Coefficients of all columns, one row per term.
+	std::vector<double> coeffs(m_numTerms * num_columns, 0.0);
+	
+	for (int i = 0; i < m_numValues; ++i, values += stride) {
+		double* coeffs_line = &coeffs[0];
+		for (int t = 0; t < m_numTerms; ++t, coeffs_line += num_columns) {
+			double const weight = m_projection[t * m_numValues + i];
+			for (int x = 0; x < num_columns; ++x) {
+				coeffs_line[x] += weight * values[x];
+			}
+		}
+	}
+	
+	std::vector<PolynomialLine> lines;
+	lines.reserve(num_columns);
+	std::vector<double> column_coeffs(m_numTerms);
+	for (int x = 0; x < num_columns; ++x) {
+		for (int t = 0; t < m_numTerms; ++t) {
+			column_coeffs[t] = coeffs[t * num_columns + x];
+		}
+		lines.push_back(PolynomialLine(column_coeffs));
+	}
+	
+	return lines;
+}
+
+} // namespace imageproc
+
+#endif
@@ -17,12 +17,10 @@
 */
 
 #include "PolynomialSurface.h"
-#include "LeastSquaresFit.h"
 #include "AlignedArray.h"
 #include "BinaryImage.h"
 #include "GrayImage.h"
 #include "Grayscale.h"
-#include "BitOps.h"
 #include <QDebug>
 #ifndef Q_MOC_RUN
 #include <boost/foreach.hpp>
@@ -36,6 +34,68 @@
 namespace imageproc
 {
 
+namespace
+{
+
+/**
+ * Solves gram * x = rhs, where gram is a symmetric non-negative definite
+ * matrix, by Cholesky decomposition.  Both gram and rhs are destroyed.
+ */
+void solveNormalEquations(
+	int const n, std::vector<double>& gram,
+	std::vector<double>& rhs, std::vector<double>& x)
+{
+	// Data points may not pin down every coefficient (think of a mask
+	// with a single black line).  A tiny ridge keeps the system positive
+	// definite and makes such coefficients zero.
+	double max_diag = 0.0;
+	for (int i = 0; i < n; ++i) {
+		max_diag = std::max(max_diag, gram[i * n + i]);
+	}
+	double const ridge = max_diag > 0.0 ? max_diag * 1e-12 : 1.0;
+	for (int i = 0; i < n; ++i) {
+		gram[i * n + i] += ridge;
+	}
+	
+	// Replace the lower triangle of gram with L, where gram = L * L^T.
+	for (int j = 0; j < n; ++j) {
+		double diag = gram[j * n + j];
+		for (int k = 0; k < j; ++k) {
+			diag -= gram[j * n + k] * gram[j * n + k];
+		}
+		diag = sqrt(std::max(diag, ridge));
+		gram[j * n + j] = diag;
+		
+		for (int i = j + 1; i < n; ++i) {
+			double sum = gram[i * n + j];
+			for (int k = 0; k < j; ++k) {
+				sum -= gram[i * n + k] * gram[j * n + k];
+			}
+			gram[i * n + j] = sum / diag;
+		}
+	}
+	
+	// Solve L * z = rhs, storing z in rhs.
+	for (int i = 0; i < n; ++i) {
+		double sum = rhs[i];
+		for (int k = 0; k < i; ++k) {
+			sum -= gram[i * n + k] * rhs[k];
+		}
+		rhs[i] = sum / gram[i * n + i];
+	}
+	
+	// Solve L^T * x = z.
+	for (int i = n - 1; i >= 0; --i) {
+		double sum = rhs[i];
+		for (int k = i + 1; k < n; ++k) {
+			sum -= gram[k * n + i] * x[k];
+		}
+		x[i] = sum / gram[i * n + i];
+	}
+}
+
+} // anonymous namespace
+
 PolynomialSurface::PolynomialSurface(
 	int const hor_degree, int const vert_degree, GrayImage const& src)
 :	m_horDegree(hor_degree),
@@ -59,20 +119,7 @@ PolynomialSurface::PolynomialSurface(
 	}
 	
 	maybeReduceDegrees(num_data_points);
-	
-	int const num_terms = calcNumTerms();
-	QSize const dimensions(num_terms, num_data_points);
-	std::vector<double> equations;
-	std::vector<double> data_points;
-	equations.reserve(dimensions.width() * dimensions.height());
-	data_points.reserve(dimensions.height());
-	m_coeffs.resize(dimensions.width());
-	
-	prepareEquationsAndDataPoints(src, equations, data_points);
-	assert(int(equations.size()) == dimensions.width() * dimensions.height());
-	assert(int(data_points.size()) == num_data_points);
-	
-	leastSquaresFit(dimensions, &equations[0], &m_coeffs[0], &data_points[0]);
+	fit(src, 0);
 }
 
 PolynomialSurface::PolynomialSurface(
@@ -102,21 +149,7 @@ PolynomialSurface::PolynomialSurface(
 	}
 	
 	maybeReduceDegrees(num_data_points);
-	
-	int const num_terms = calcNumTerms();
-	QSize const dimensions(num_terms, num_data_points);
-	
-	std::vector<double> equations;
-	std::vector<double> data_points;
-	equations.reserve(dimensions.width() * dimensions.height());
-	data_points.reserve(dimensions.height());
-	m_coeffs.resize(dimensions.width());
-	
-	prepareEquationsAndDataPoints(src, mask, equations, data_points);
-	assert(int(equations.size()) == dimensions.width() * dimensions.height());
-	assert(int(data_points.size()) == num_data_points);
-	
-	leastSquaresFit(dimensions, &equations[0], &m_coeffs[0], &data_points[0]);
+	fit(src, &mask);
 }
 
 GrayImage
@@ -131,49 +164,41 @@ PolynomialSurface::render(QSize const& size) const
 	int const height = size.height();
 	unsigned char* line = image.data();
 	int const bpl = image.stride();
-	int const num_coeffs = m_coeffs.size();
+	int const hor_terms = m_horDegree + 1;
+	int const vert_terms = m_vertDegree + 1;
 	
-	// Pretend that both x and y positions of pixels
-	// lie in range of [0, 1].
-	double const xscale = calcScale(width);
-	double const yscale = calcScale(height);
+	std::vector<double> vert_basis;
+	calcBasis(vert_basis, m_vertDegree, height);
 	
-	AlignedArray<float, 4> vert_matrix(num_coeffs * height);
-	float* out = &vert_matrix[0];
-	for (int y = 0; y < height; ++y) {
-		double const y_adjusted = y * yscale;
-		double pow = 1.0;
-		int pos = 0;
-		for (int i = 0; i <= m_vertDegree; ++i) {
-			for (int j = 0; j <= m_horDegree; ++j, ++pos, ++out) {
-				*out = static_cast<float>(m_coeffs[pos] * pow);
-			}
-			pow *= y_adjusted;
-		}
+	std::vector<double> hor_basis;
+	calcBasis(hor_basis, m_horDegree, width);
+	AlignedArray<float, 4> hor_matrix(hor_terms * width);
+	for (int i = 0; i < hor_terms * width; ++i) {
+		hor_matrix[i] = static_cast<float>(hor_basis[i]);
 	}
 	
-	AlignedArray<float, 4> hor_matrix(num_coeffs * width);
-	out = &hor_matrix[0];
-	for (int x = 0; x < width; ++x) {
-		double const x_adjusted = x * xscale;
-		for (int i = 0; i <= m_vertDegree; ++i) {
-			double pow = 1.0;
-			for (int j = 0; j <= m_horDegree; ++j, ++out) {
-				*out = static_cast<float>(pow);
-				pow *= x_adjusted;
+	// Within a row, the surface is a polynomial in x.  Its coefficients
+	// are calculated once per row, leaving hor_terms multiplications
+	// per pixel rather than hor_terms * vert_terms.
+	std::vector<float> row_coeffs(hor_terms);
+	
+	double const* vert_line = &vert_basis[0];
+	for (int y = 0; y < height; ++y, line += bpl, vert_line += vert_terms) {
+		for (int j = 0; j < hor_terms; ++j) {
+			double sum = 0.0;
+			for (int i = 0; i < vert_terms; ++i) {
+				sum += m_coeffs[i * hor_terms + j] * vert_line[i];
 			}
+			row_coeffs[j] = static_cast<float>(sum * 255.0);
 		}
-	}
-	
-	float const* vert_line = &vert_matrix[0];
-	for (int y = 0; y < height; ++y, line += bpl, vert_line += num_coeffs) {
+		
 		float const* hor_line = &hor_matrix[0];
-		for (int x = 0; x < width; ++x, hor_line += num_coeffs) {
-			float sum = 0.5f / 255.0f; // for rounding purposes.
-			for (int i = 0; i < num_coeffs; ++i) {
-				sum += hor_line[i] * vert_line[i];
+		for (int x = 0; x < width; ++x, hor_line += hor_terms) {
+			float sum = 0.5f; // for rounding purposes.
+			for (int j = 0; j < hor_terms; ++j) {
+				sum += hor_line[j] * row_coeffs[j];
 			}
-			int const isum = (int)(sum * 255.0);
+			int const isum = (int)sum;
 			line[x] = static_cast<unsigned char>(qBound(0, isum, 255));
 		}
 	}
@@ -212,124 +237,108 @@ PolynomialSurface::calcScale(int const dimension)
 }
 
 void
-PolynomialSurface::prepareEquationsAndDataPoints(
-	GrayImage const& image,
-	std::vector<double>& equations,
-	std::vector<double>& data_points) const
+PolynomialSurface::calcBasis(
+	std::vector<double>& basis, int const degree, int const num_positions)
 {
-	int const width = image.width();
-	int const height = image.height();
+	int const num_terms = degree + 1;
+	basis.resize(num_terms * num_positions);
 	
-	uint8_t const* line = image.data();
-	int const bpl = image.stride();
-	
-	// Pretend that both x and y positions of pixels
-	// lie in range of [0, 1].
-	double const xscale = calcScale(width);
-	double const yscale = calcScale(height);
-	
-	for (int y = 0; y < height; ++y, line += bpl) {
-		double const y_adjusted = yscale * y;
+	double const scale = 2.0 * calcScale(num_positions);
+	double* out = basis.empty() ? 0 : &basis[0];
+	for (int i = 0; i < num_positions; ++i, out += num_terms) {
+		double const t = i * scale - 1.0;
 		
-		for (int x = 0; x < width; ++x) {
-			double const x_adjusted = xscale * x;
-			
-			data_points.push_back((1.0 / 255.0) * line[x]);
-			
-			double pow1 = 1.0;
-			for (int i = 0; i <= m_vertDegree; ++i) {
-				double pow2 = pow1;
-				for (int j = 0; j <= m_horDegree; ++j) {
-					equations.push_back(pow2);
-					pow2 *= x_adjusted;
-				}
-				pow1 *= y_adjusted;
-			}
+		// (n + 1) * P[n + 1](t) = (2n + 1) * t * P[n](t) - n * P[n - 1](t)
+		out[0] = 1.0;
+		if (degree > 0) {
+			out[1] = t;
+		}
+		for (int n = 1; n < degree; ++n) {
+			out[n + 1] = ((2 * n + 1) * t * out[n] - n * out[n - 1]) / (n + 1);
 		}
 	}
 }
 
 void
-PolynomialSurface::prepareEquationsAndDataPoints(
-	GrayImage const& image, BinaryImage const& mask,
-	std::vector<double>& equations,
-	std::vector<double>& data_points) const
+PolynomialSurface::fit(GrayImage const& image, BinaryImage const* mask)
 {
 	int const width = image.width();
 	int const height = image.height();
+	int const hor_terms = m_horDegree + 1;
+	int const vert_terms = m_vertDegree + 1;
+	int const num_terms = hor_terms * vert_terms;
 	
-	double const xscale = calcScale(width);
-	double const yscale = calcScale(height);
+	std::vector<double> hor_basis;
+	calcBasis(hor_basis, m_horDegree, width);
+	
+	std::vector<double> vert_basis;
+	calcBasis(vert_basis, m_vertDegree, height);
+	
+	// We build the normal equations: gram * m_coeffs = rhs.
+	// Every basis function is a product of a horizontal and a vertical
+	// polynomial, so we first sum products of horizontal polynomials over
+	// a row of pixels, and only then spread those sums over the full
+	// matrix, weighting them by products of vertical polynomials.
+	std::vector<double> gram(num_terms * num_terms, 0.0);
+	std::vector<double> rhs(num_terms, 0.0);
+	std::vector<double> row_gram(hor_terms * hor_terms);
+	std::vector<double> row_rhs(hor_terms);
 	
 	uint8_t const* image_line = image.data();
 	int const image_bpl = image.stride();
-	
-	uint32_t const* mask_line = mask.data();
-	int const mask_wpl = mask.wordsPerLine();
-	int const last_word_idx = (width - 1) >> 5;
-	int const last_word_mask = ~uint32_t(0) << (31 - ((width - 1) & 31));
+	uint32_t const* mask_line = mask ? mask->data() : 0;
+	int const mask_wpl = mask ? mask->wordsPerLine() : 0;
+	uint32_t const msb = uint32_t(1) << 31;
 	
 	for (int y = 0; y < height; ++y) {
-		double const y_adjusted = y * yscale;
-		int idx = 0;
+		std::fill(row_gram.begin(), row_gram.end(), 0.0);
+		std::fill(row_rhs.begin(), row_rhs.end(), 0.0);
+		bool row_empty = true;
 		
-		// Full words.
-		for (; idx < last_word_idx; ++idx) {
-			processMaskWord(
-				image_line, mask_line[idx], idx, y,
-				y_adjusted, xscale, equations, data_points
-			);
+		for (int x = 0; x < width; ++x) {
+			if (mask_line && !(mask_line[x >> 5] & (msb >> (x & 31)))) {
+				continue;
+			}
+			row_empty = false;
+			
+			double const value = (1.0 / 255.0) * image_line[x];
+			double const* const hor = &hor_basis[x * hor_terms];
+			for (int j = 0; j < hor_terms; ++j) {
+				row_rhs[j] += value * hor[j];
+				double* const row_gram_line = &row_gram[j * hor_terms];
+				for (int l = 0; l < hor_terms; ++l) {
+					row_gram_line[l] += hor[j] * hor[l];
+				}
+			}
 		}
 		
-		// Last word.
-		processMaskWord(
-			image_line, mask_line[idx] & last_word_mask,
-			idx, y, y_adjusted, xscale, equations, data_points
-		);
-		
-		image_line += image_bpl;
-		mask_line += mask_wpl;
-	}
-}
-
-void
-PolynomialSurface::processMaskWord(
-	uint8_t const* const image_line,
-	uint32_t word, int const word_idx, int const y,
-	double const y_adjusted, double const xscale,
-	std::vector<double>& equations,
-	std::vector<double>& data_points) const
-{
-	uint32_t const msb = uint32_t(1) << 31;
-	int const xbase = word_idx << 5;
-	
-	int x = xbase;
-	uint32_t mask = msb;
-	
-	for (; word; word &= ~mask, mask >>= 1, ++x) {
-		if (!(word & mask)) {
-			// Skip a group of zero bits.
-			int const offset = countMostSignificantZeroes(word);
-			x = xbase + offset;
-			mask = msb >> offset;
-			assert(word & mask);
+		if (!row_empty) {
+			double const* const vert = &vert_basis[y * vert_terms];
+			for (int i = 0; i < vert_terms; ++i) {
+				for (int j = 0; j < hor_terms; ++j) {
+					int const row = i * hor_terms + j;
+					rhs[row] += vert[i] * row_rhs[j];
+					
+					double const* const row_gram_line = &row_gram[j * hor_terms];
+					double* gram_line = &gram[row * num_terms];
+					for (int k = 0; k < vert_terms; ++k, gram_line += hor_terms) {
+						double const weight = vert[i] * vert[k];
+						for (int l = 0; l < hor_terms; ++l) {
+							gram_line[l] += weight * row_gram_line[l];
+						}
+					}
+				}
+			}
 		}
 		
-		data_points.push_back((1.0 / 255.0) * image_line[x]);
-		
-		double const x_adjusted = xscale * x;
-		double pow1 = 1.0;
-		for (int i = 0; i <= m_vertDegree; ++i) {
-			double pow2 = pow1;
-			
-			for (int j = 0; j <= m_horDegree; ++j) {
-				equations.push_back(pow2);
-				pow2 *= x_adjusted;
-			}
-			
-			pow1 *= y_adjusted;
+		image_line += image_bpl;
+		if (mask_line) {
+			mask_line += mask_wpl;
 		}
 	}
+	
+	m_coeffs.resize(num_terms);
+	solveNormalEquations(num_terms, gram, rhs, m_coeffs);
 }
 
 }
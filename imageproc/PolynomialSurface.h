@@ -31,6 +31,11 @@ class GrayImage;
 
 /**
  * \brief A polynomial function describing a 2D surface.
+ *
+ * Internally, the polynomial is a combination of products of Legendre
+ * polynomials in x and y.  Unlike powers of x and y, those are close
+ * to orthogonal, which allows fitting a surface by solving the normal
+ * equations rather than a large least squares system.
  */
 class PolynomialSurface
 {
@@ -91,22 +96,22 @@ private:
 	
 	static double calcScale(int dimension);
 	
-	void prepareEquationsAndDataPoints(
-		GrayImage const& image,
-		std::vector<double>& equations,
-		std::vector<double>& data_points) const;
-	
-	void prepareEquationsAndDataPoints(
-		GrayImage const& image, BinaryImage const& mask,
-		std::vector<double>& equations,
-		std::vector<double>& data_points) const;
+	/**
+	 * \brief Evaluates Legendre polynomials of degrees 0 to \p degree
+	 *        at \p num_positions points spread evenly over [-1, 1].
+	 *
+	 * The value for position i and degree d goes to
+	 * basis[i * (degree + 1) + d].
+	 */
+	static void calcBasis(
+		std::vector<double>& basis, int degree, int num_positions);
 	
-	void processMaskWord(
-		uint8_t const* image_line, uint32_t word,
-		int mask_word_idx, int y,
-		double y_adjusted, double xscale,
-		std::vector<double>& equations,
-		std::vector<double>& data_points) const;
+	/**
+	 * \brief Sets m_coeffs to the least squares fit of the pixels
+	 *        of \p image that are black in \p mask, or of all of them
+	 *        if \p mask is null.
+	 */
+	void fit(GrayImage const& image, BinaryImage const* mask);
 	
 	std::vector<double> m_coeffs;
 	int m_horDegree;
@@ -62,6 +62,26 @@ void rasterOp(BinaryImage& dst, QRect const& dr,
 template<typename Rop>
 void rasterOp(BinaryImage& dst, BinaryImage const& src);
 
+/**
+ * \brief Perform pixel-wise logical operations on whole images,
+ *        taking two source images.
+ *
+ * This allows expressions like dst & ~src & ~src2 to be evaluated in
+ * a single pass over memory, rather than by several calls to rasterOp(),
+ * each of them sweeping through the whole images.
+ *
+ * \param dst The destination image.  Changes will be written there.
+ * \param src The first source image.
+ * \param src2 The second source image.
+ *
+ * All three images must have the same dimensions.  The source images
+ * may be the same as the destination one.  The template argument is
+ * the operation to perform, where RopSrc2 refers to \p src2.
+ * For example, RopSubtract\<RopSubtract\<RopDst, RopSrc\>, RopSrc2\>.
+ */
+template<typename Rop>
+void rasterOp(BinaryImage& dst, BinaryImage const& src, BinaryImage const& src2);
+
 /**
  * \brief Raster operation that takes source pixels as they are.
  * \see rasterOp()
@@ -72,6 +92,10 @@ public:
 	static uint32_t transform(uint32_t src, uint32_t /*dst*/) {
 		return src;
 	}
+	
+	static uint32_t transform(uint32_t src, uint32_t /*src2*/, uint32_t /*dst*/) {
+		return src;
+	}
 };
 
 /**
@@ -84,6 +108,25 @@ public:
 	static uint32_t transform(uint32_t /*src*/, uint32_t dst) {
 		return dst;
 	}
+	
+	static uint32_t transform(uint32_t /*src*/, uint32_t /*src2*/, uint32_t dst) {
+		return dst;
+	}
+};
+
+/**
+ * \brief Raster operation that takes pixels of the second source image
+ *        as they are.
+ *
+ * Only usable with the rasterOp() overload taking two source images.
+ * \see rasterOp()
+ */
+class RopSrc2
+{
+public:
+	static uint32_t transform(uint32_t /*src*/, uint32_t src2, uint32_t /*dst*/) {
+		return src2;
+	}
 };
 
 /**
@@ -97,6 +140,10 @@ public:
 	static uint32_t transform(uint32_t src, uint32_t dst) {
 		return ~Arg::transform(src, dst);
 	}
+	
+	static uint32_t transform(uint32_t src, uint32_t src2, uint32_t dst) {
+		return ~Arg::transform(src, src2, dst);
+	}
 };
 
 /**
@@ -110,6 +157,10 @@ public:
 	static uint32_t transform(uint32_t src, uint32_t dst) {
 		return Arg1::transform(src, dst) & Arg2::transform(src, dst);
 	}
+	
+	static uint32_t transform(uint32_t src, uint32_t src2, uint32_t dst) {
+		return Arg1::transform(src, src2, dst) & Arg2::transform(src, src2, dst);
+	}
 };
 
 /**
@@ -123,6 +174,10 @@ public:
 	static uint32_t transform(uint32_t src, uint32_t dst) {
 		return Arg1::transform(src, dst) | Arg2::transform(src, dst);
 	}
+	
+	static uint32_t transform(uint32_t src, uint32_t src2, uint32_t dst) {
+		return Arg1::transform(src, src2, dst) | Arg2::transform(src, src2, dst);
+	}
 };
 
 /**
@@ -136,6 +191,10 @@ public:
 	static uint32_t transform(uint32_t src, uint32_t dst) {
 		return Arg1::transform(src, dst) ^ Arg2::transform(src, dst);
 	}
+	
+	static uint32_t transform(uint32_t src, uint32_t src2, uint32_t dst) {
+		return Arg1::transform(src, src2, dst) ^ Arg2::transform(src, src2, dst);
+	}
 };
 
 /**
@@ -151,6 +210,12 @@ public:
 		uint32_t rhs = Arg2::transform(src, dst);
 		return lhs & (lhs ^ rhs);
 	}
+	
+	static uint32_t transform(uint32_t src, uint32_t src2, uint32_t dst) {
+		uint32_t lhs = Arg1::transform(src, src2, dst);
+		uint32_t rhs = Arg2::transform(src, src2, dst);
+		return lhs & (lhs ^ rhs);
+	}
 };
 
 /**
@@ -166,6 +231,12 @@ public:
 		uint32_t rhs = Arg2::transform(src, dst);
 		return lhs | ~(lhs ^ rhs);
 	}
+	
+	static uint32_t transform(uint32_t src, uint32_t src2, uint32_t dst) {
+		uint32_t lhs = Arg1::transform(src, src2, dst);
+		uint32_t rhs = Arg2::transform(src, src2, dst);
+		return lhs | ~(lhs ^ rhs);
+	}
 };
 
 /**
@@ -243,6 +314,13 @@ void rasterOpInDirection(
 	int dst_span_delta;
 	uint32_t* dst_span;
 	uint32_t const* src_span;
+	
+	// Note that dst.data() has to be called first, as it detaches dst
+	// from src if they are different objects sharing the same data.
+	// The operands of == are unsequenced, hence a separate statement.
+	uint32_t const* const dst_data = dst.data();
+	bool const same_data = (dst_data == src.data());
+	
 	if (dy == 1) {
 		src_span_delta = src.wordsPerLine();
 		dst_span_delta = dst.wordsPerLine();
@@ -294,10 +372,17 @@ void rasterOpInDirection(
 				uint32_t new_dst_word = Rop::transform(src_word, dst_word);
 				dst_span[widx] = (dst_word & ~first_dst_mask) | (new_dst_word & first_dst_mask);
 				
-				while ((widx += dx) != last_dst_word) {
-					src_word = src_span[widx];
-					dst_word = dst_span[widx];
-					dst_span[widx] = Rop::transform(src_word, dst_word);
+				if (dx == 1) {
+					// A plain counted loop, which compilers are able to vectorize.
+					for (++widx; widx < last_dst_word; ++widx) {
+						dst_span[widx] = Rop::transform(src_span[widx], dst_span[widx]);
+					}
+				} else {
+					while ((widx += dx) != last_dst_word) {
+						src_word = src_span[widx];
+						dst_word = dst_span[widx];
+						dst_span[widx] = Rop::transform(src_word, dst_word);
+					}
 				}
 				
 				// Handle the last (possibly incomplete) dst word in the line.
@@ -331,6 +416,50 @@ void rasterOpInDirection(
 			uint32_t const new_dst_word = Rop::transform(src_word, dst_word);
 			dst_span[0] = (dst_word & ~mask) | (new_dst_word & mask);
 		}
+	} else if (dx == 1 && !same_data) {
+		// Without the possibility of src and dst overlapping, the middle
+		// of each line is a plain counted loop that compilers are able
+		// to vectorize.
+		uint32_t const can_first_word1 = (~uint32_t(0) << src_word1_shift) & first_dst_mask;
+		uint32_t const can_first_word2 = (~uint32_t(0) >> src_word2_shift) & first_dst_mask;
+		uint32_t const can_last_word1 = (~uint32_t(0) << src_word1_shift) & last_dst_mask;
+		uint32_t const can_last_word2 = (~uint32_t(0) >> src_word2_shift) & last_dst_mask;
+		
+		for (int i = dr.height(); i > 0; --i,
+		     src_span += src_span_delta, dst_span += dst_span_delta) {
+			
+			// Handle the first (possibly incomplete) dst word in the line.
+			uint32_t src_word = 0;
+			if (can_first_word1) {
+				src_word |= src_span[0] << src_word1_shift;
+			}
+			if (can_first_word2) {
+				src_word |= src_span[1] >> src_word2_shift;
+			}
+			uint32_t dst_word = dst_span[0];
+			uint32_t new_dst_word = Rop::transform(src_word, dst_word);
+			dst_span[0] = (dst_word & ~first_dst_mask) | (new_dst_word & first_dst_mask);
+			
+			for (int widx = 1; widx < last_dst_word; ++widx) {
+				dst_span[widx] = Rop::transform(
+					(src_span[widx] << src_word1_shift) |
+					(src_span[widx + 1] >> src_word2_shift),
+					dst_span[widx]
+				);
+			}
+			
+			// Handle the last (possibly incomplete) dst word in the line.
+			src_word = 0;
+			if (can_last_word1) {
+				src_word |= src_span[last_dst_word] << src_word1_shift;
+			}
+			if (can_last_word2) {
+				src_word |= src_span[last_dst_word + 1] >> src_word2_shift;
+			}
+			dst_word = dst_span[last_dst_word];
+			new_dst_word = Rop::transform(src_word, dst_word);
+			dst_span[last_dst_word] = (dst_word & ~last_dst_mask) | (new_dst_word & last_dst_mask);
+		}
 	} else {
 		uint32_t const can_first_word1 = (~uint32_t(0) << src_word1_shift) & first_dst_mask;
 		uint32_t const can_first_word2 = (~uint32_t(0) >> src_word2_shift) & first_dst_mask;
@@ -455,6 +584,43 @@ void rasterOp(BinaryImage& dst, BinaryImage const& src)
 	rasterOpInDirection<Rop>(dst, dst.rect(), src, QPoint(0, 0), 1, 1);
 }
 
+template<typename Rop>
+void rasterOp(BinaryImage& dst, BinaryImage const& src, BinaryImage const& src2)
+{
+	if (dst.isNull() || src.isNull() || src2.isNull()) {
+		throw std::invalid_argument("rasterOp: can't operate on null images");
+	}
+	
+	if (dst.size() != src.size() || dst.size() != src2.size()) {
+		throw std::invalid_argument("rasterOp: images have different sizes");
+	}
+	
+	int const width = dst.width();
+	int const height = dst.height();
+	int const wpl = dst.wordsPerLine();
+	int const last_word = (width - 1) >> 5;
+	uint32_t const last_word_mask = ~uint32_t(0) << (31 - ((width - 1) & 31));
+	
+	// dst.data() goes first, as it may detach dst from the source images.
+	uint32_t* dst_line = dst.data();
+	uint32_t const* src_line = src.data();
+	uint32_t const* src2_line = src2.data();
+	
+	for (int y = 0; y < height; ++y,
+	     dst_line += wpl, src_line += wpl, src2_line += wpl) {
+		for (int i = 0; i < last_word; ++i) {
+			dst_line[i] = Rop::transform(src_line[i], src2_line[i], dst_line[i]);
+		}
+		
+		// The last (possibly incomplete) word.
+		uint32_t const dst_word = dst_line[last_word];
+		uint32_t const new_dst_word = Rop::transform(
+			src_line[last_word], src2_line[last_word], dst_word
+		);
+		dst_line[last_word] = (dst_word & ~last_word_mask) | (new_dst_word & last_word_mask);
+	}
+}
+
 } // namespace imageproc
 
 #endif
@@ -19,6 +19,7 @@
 #include "SeedFill.h"
 #include "SeedFillGeneric.h"
 #include "GrayImage.h"
+#include "TaskStatus.h"
 #include <QSize>
 #include <QImage>
 #include <QDebug>
@@ -498,7 +499,7 @@ uint8_t seedFillGray8SlowIteration(GrayImage& seed, GrayImage const& mask)
 
 BinaryImage seedFill(
 	BinaryImage const& seed, BinaryImage const& mask,
-	Connectivity const connectivity)
+	Connectivity const connectivity, TaskStatus const* const status)
 {
 	if (seed.size() != mask.size()) {
 		throw std::invalid_argument("seedFill: seed and mask have different sizes");
@@ -508,6 +509,9 @@ BinaryImage seedFill(
 	BinaryImage img(seed);
 	
 	do {
+		if (status) {
+			status->throwIfCancelled();
+		}
 		prev = img;
 		if (connectivity == CONN4) {
 			seedFill4Iteration(img, mask);
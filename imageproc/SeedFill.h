@@ -23,6 +23,7 @@
 #include "Connectivity.h"
 
 class QImage;
+class TaskStatus;
 
 namespace imageproc
 {
@@ -41,10 +42,13 @@ class GrayImage;
  * \par
  * The underlying code implements Luc Vincent's iterative seed-fill
  * algorithm: http://www.vincent-net.com/luc/papers/93ieeeip_recons.pdf
+ * \par
+ * The number of iterations depends on how winding the filled areas are.
+ * If \p status is provided, cancellation is checked between iterations.
  */
 BinaryImage seedFill(
 	BinaryImage const& seed, BinaryImage const& mask,
-	Connectivity connectivity);
+	Connectivity connectivity, TaskStatus const* status = 0);
 
 /**
  * \brief Spread darker colors from seed as long as mask allows it.
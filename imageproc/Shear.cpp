@@ -19,8 +19,13 @@
 #include "Shear.h"
 #include "RasterOp.h"
 #include "BinaryImage.h"
+#include "Constants.h"
 #include <QRect>
+#include <QRectF>
 #include <QPoint>
+#include <QPointF>
+#include <QPolygonF>
+#include <QTransform>
 #include <stdexcept>
 #include <math.h>
 #include <stdlib.h>
@@ -197,4 +202,84 @@ void vShearInPlace(
 	vShearFromTo(image, image, shear, x_origin, background_color);
 }
 
+BinaryImage rotateBinary(
+	BinaryImage const& src, double const angle_deg, QPointF const& center,
+	QRect const& dst_rect, BWColor const background_color)
+{
+	if (src.isNull() || dst_rect.isEmpty()) {
+		return BinaryImage();
+	}
+	if (fabs(angle_deg) > 45.0) {
+		throw std::invalid_argument("rotateBinary: angle is out of range");
+	}
+	
+	double const angle_rad = angle_deg * constants::DEG2RAD;
+	double const h_shear = -tan(0.5 * angle_rad);
+	double const v_shear = sin(angle_rad);
+	
+	// The individual shears in point form, with center as the origin.
+	QTransform to_origin;
+	to_origin.translate(-center.x(), -center.y());
+	QTransform from_origin;
+	from_origin.translate(center.x(), center.y());
+	QTransform const h_shear_xform(
+		to_origin * QTransform(1, 0, h_shear, 1, 0, 0) * from_origin
+	);
+	QTransform const v_shear_xform(
+		to_origin * QTransform(1, v_shear, 0, 1, 0, 0) * from_origin
+	);
+	QTransform rotation;
+	rotation.rotate(angle_deg);
+	rotation = to_origin * rotation * from_origin;
+	
+	// The part of the source image that ends up in dst_rect.
+	QRect const src_rect(
+		rotation.inverted().mapRect(QRectF(dst_rect)).toAlignedRect()
+		.adjusted(-1, -1, 1, 1).intersected(src.rect())
+	);
+	
+	BinaryImage dst(dst_rect.size(), background_color);
+	if (src_rect.isEmpty()) {
+		return dst;
+	}
+	
+	// The canvas has to hold src_rect at every stage of shearing,
+	// as well as dst_rect at the end.
+	QPolygonF const src_poly(QRectF(src_rect));
+	QPolygonF const h_sheared_poly(h_shear_xform.map(src_poly));
+	QRect const canvas_rect(
+		(
+			src_poly.boundingRect() | h_sheared_poly.boundingRect()
+			| v_shear_xform.map(h_sheared_poly).boundingRect()
+			| QRectF(dst_rect)
+		).toAlignedRect().adjusted(-1, -1, 1, 1)
+	);
+	
+	BinaryImage canvas(canvas_rect.size(), background_color);
+	rasterOp<RopSrc>(
+		canvas, src_rect.translated(-canvas_rect.topLeft()),
+		src, src_rect.topLeft()
+	);
+	
+	double const x_origin = center.x() - canvas_rect.left();
+	double const y_origin = center.y() - canvas_rect.top();
+	hShearInPlace(canvas, h_shear, y_origin, background_color);
+	vShearInPlace(canvas, v_shear, x_origin, background_color);
+	hShearInPlace(canvas, h_shear, y_origin, background_color);
+	
+	rasterOp<RopSrc>(
+		dst, dst.rect(), canvas, dst_rect.topLeft() - canvas_rect.topLeft()
+	);
+	
+	return dst;
+}
+
+BinaryImage rotateBinary(
+	BinaryImage const& src, double const angle_deg,
+	BWColor const background_color)
+{
+	QPointF const center(0.5 * src.width(), 0.5 * src.height());
+	return rotateBinary(src, angle_deg, center, src.rect(), background_color);
+}
+
 } // namespace imageproc
@@ -22,6 +22,9 @@
 
 #include "BWColor.h"
 
+class QPointF;
+class QRect;
+
 namespace imageproc
 {
 
@@ -97,6 +100,43 @@ void vShearInPlace(
 	BinaryImage& image, double shear,
 	double x_origin, BWColor background_color);
 
+/**
+ * \brief Rotation by an arbitrary angle, composed of three shears.
+ *
+ * The rotation is decomposed into horizontal, vertical and again
+ * horizontal shears (Paeth's method), each of which moves whole blocks
+ * of lines or columns at once.  Pixels are moved, never interpolated,
+ * so the result is the same as point sampling, only much faster.
+ *
+ * \param src The source image.
+ * \param angle_deg The rotation angle in degrees.  Positive values
+ *        indicate clockwise rotation, just like in QTransform::rotate().
+ *        The angle must be within [-45, 45].  Larger angles should be
+ *        handled by combining this function with orthogonalRotation().
+ * \param center The point to rotate around, in \p src coordinates.
+ * \param dst_rect The area of the rotated image to return.  The rotated
+ *        image is in the same coordinate system as \p src, with
+ *        \p center staying where it was.  It may extend beyond
+ *        src.rect().
+ * \param background_color The color used to fill areas not represented
+ *        in the source image.
+ * \return The rotated image of dst_rect.size(), or a null image if
+ *         \p src is null or \p dst_rect is empty.
+ */
+BinaryImage rotateBinary(
+	BinaryImage const& src, double angle_deg, QPointF const& center,
+	QRect const& dst_rect, BWColor background_color);
+
+/**
+ * \brief Rotation around the image center, preserving image dimensions.
+ *
+ * Same as rotateBinary() above, with \p center being the center of
+ * \p src and \p dst_rect being src.rect().  Corners that would end up
+ * outside of the image are lost.
+ */
+BinaryImage rotateBinary(
+	BinaryImage const& src, double angle_deg, BWColor background_color);
+
 } // namespace imageproc
 
 #endif
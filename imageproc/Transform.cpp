@@ -19,6 +19,12 @@
 #include "Transform.h"
 #include "Grayscale.h"
 #include "GrayImage.h"
+#include "BinaryImage.h"
+#include "ReduceThreshold.h"
+#include "UpscaleIntegerTimes.h"
+#include "OrthogonalRotation.h"
+#include "Shear.h"
+#include "Constants.h"
 #include <QImage>
 #include <QRect>
 #include <QSizeF>
@@ -31,6 +37,7 @@
 #include <stdexcept>
 #include <algorithm>
 #include <stdint.h>
+#include <stdlib.h>
 #include <math.h>
 #include <assert.h>
 
@@ -392,6 +399,117 @@ static void transformGeneric(
 	}
 }
 
+/**
+ * Recognizes transformations that only rearrange whole pixels, that is
+ * rotations by multiples of 90 degrees combined with integer offsets.
+ * Such transformations are typical for pages that only had their
+ * orientation fixed.
+ *
+ * \param[out] degrees The clockwise rotation angle.
+ * \param[out] src_rect The area of the source image mapping to \p dst_rect.
+ * \return true if \p xform is such a transformation and \p dst_rect
+ *         maps to an area entirely within \p src_image_rect.
+ */
+static bool isOrthogonalPixelMapping(
+	QTransform const& xform, QRect const& dst_rect,
+	QRect const& src_image_rect, int& degrees, QRect& src_rect)
+{
+	double const eps = 1e-9;
+	
+	int const m11 = qRound(xform.m11());
+	int const m12 = qRound(xform.m12());
+	if (fabs(xform.m11() - m11) > eps || fabs(xform.m12() - m12) > eps
+			|| fabs(xform.m21() + m12) > eps || fabs(xform.m22() - m11) > eps
+			|| abs(m11) + abs(m12) != 1) {
+		return false;
+	}
+	
+	if (fabs(xform.dx() - qRound(xform.dx())) > eps
+			|| fabs(xform.dy() - qRound(xform.dy())) > eps) {
+		return false;
+	}
+	
+	if (m11 == 1) {
+		degrees = 0;
+	} else if (m12 == 1) {
+		degrees = 90;
+	} else if (m11 == -1) {
+		degrees = 180;
+	} else {
+		degrees = 270;
+	}
+	
+	QRectF const src_rectf(xform.inverted().mapRect(QRectF(dst_rect)));
+	src_rect = QRect(
+		qRound(src_rectf.left()), qRound(src_rectf.top()),
+		qRound(src_rectf.width()), qRound(src_rectf.height())
+	);
+	
+	return src_image_rect.contains(src_rect);
+}
+
+/**
+ * Carries out transformBinary() with integer upscaling, orthogonal
+ * rotation and shears, all of which work on whole words rather than
+ * on individual pixels.  That's only possible if \p xform is a rotation
+ * combined with an integer uniform scaling, which is the case when
+ * a page is deskewed without changing its resolution or with doubling it.
+ *
+ * \return false if \p xform doesn't qualify.
+ */
+static bool transformBinaryWithShears(
+	BinaryImage const& src, QTransform const& xform,
+	QRect const& dst_rect, BWColor const outside_color, BinaryImage& dst)
+{
+	double const scale = sqrt(xform.m11() * xform.m11() + xform.m12() * xform.m12());
+	double const tolerance = 1e-6 * scale;
+	if (fabs(xform.m22() - xform.m11()) > tolerance
+			|| fabs(xform.m21() + xform.m12()) > tolerance) {
+		// Not a rotation with uniform scaling.
+		return false;
+	}
+	
+	int const int_scale = qRound(scale);
+	if (int_scale < 1 || fabs(scale - int_scale) > 1e-6) {
+		return false;
+	}
+	
+	double const angle_deg = atan2(xform.m12(), xform.m11()) * constants::RAD2DEG;
+	int const quadrants = qRound(angle_deg / 90.0);
+	double const residual_deg = angle_deg - 90.0 * quadrants;
+	
+	BinaryImage image(src);
+	
+	// Maps image coordinates to destination coordinates.
+	QTransform image_to_dst(xform);
+	
+	if (int_scale > 1) {
+		image = upscaleIntegerTimes(image, int_scale, int_scale);
+		image_to_dst = QTransform().scale(1.0 / int_scale, 1.0 / int_scale) * image_to_dst;
+	}
+	
+	int const degrees = (quadrants * 90 + 360) % 360;
+	if (degrees != 0) {
+		QTransform rotation;
+		rotation.rotate(degrees);
+		QRectF const rotated_rect(rotation.mapRect(QRectF(image.rect())));
+		rotation *= QTransform().translate(-rotated_rect.left(), -rotated_rect.top());
+		image = orthogonalRotation(image, degrees);
+		image_to_dst = rotation.inverted() * image_to_dst;
+	}
+	
+	// What's left is a rotation by no more than 45 degrees plus
+	// a translation.  rotateBinary() keeps the center in place,
+	// so we move dst_rect by however much the center moves.
+	QPointF const center(0.5 * image.width(), 0.5 * image.height());
+	QPoint const offset((image_to_dst.map(center) - center).toPoint());
+	dst = rotateBinary(
+		image, residual_deg, center,
+		dst_rect.translated(-offset), outside_color
+	);
+	return true;
+}
+
 } // anonymous namespace
 
 QImage transform(
@@ -411,10 +529,19 @@ QImage transform(
 		throw std::invalid_argument("transform: dst_rect is invalid");
 	}
 	
+	int degrees = 0;
+	QRect src_rect;
+	bool const orthogonal = isOrthogonalPixelMapping(
+		xform, dst_rect, src.rect(), degrees, src_rect
+	);
+	
 	if (src.format() == QImage::Format_Indexed8 && src.allGray()) {
 		// The palette of src may be non-standard, so we create a GrayImage,
 		// which is guaranteed to have a standard palette.
-		GrayImage gray_src(src);
+		GrayImage const gray_src(src);
+		if (orthogonal) {
+			return orthogonalRotation(gray_src.toQImage(), src_rect, degrees);
+		}
 		GrayImage gray_dst(dst_rect.size());
 		transformGeneric<uint8_t, Gray>(
 			gray_src.data(), gray_src.stride(), src.size(),
@@ -426,6 +553,9 @@ QImage transform(
 	} else {
 		if (src.hasAlphaChannel() || qAlpha(outside_pixels.rgba()) != 0xff) {
 			QImage const src_argb32(src.convertToFormat(QImage::Format_ARGB32));
+			if (orthogonal) {
+				return orthogonalRotation(src_argb32, src_rect, degrees);
+			}
 			QImage dst(dst_rect.size(), QImage::Format_ARGB32);
 			transformGeneric<uint32_t, ARGB32>(
 				(uint32_t const*)src_argb32.bits(), src_argb32.bytesPerLine() / 4, src_argb32.size(),
@@ -435,6 +565,9 @@ QImage transform(
 			return dst;
 		} else {
 			QImage const src_rgb32(src.convertToFormat(QImage::Format_RGB32));
+			if (orthogonal) {
+				return orthogonalRotation(src_rgb32, src_rect, degrees);
+			}
 			QImage dst(dst_rect.size(), QImage::Format_RGB32);
 			transformGeneric<uint32_t, RGB32>(
 				(uint32_t const*)src_rgb32.bits(), src_rgb32.bytesPerLine() / 4, src_rgb32.size(),
@@ -464,6 +597,13 @@ GrayImage transformToGray(
 	}
 	
 	GrayImage const gray_src(src);
+	
+	int degrees = 0;
+	QRect src_rect;
+	if (isOrthogonalPixelMapping(xform, dst_rect, src.rect(), degrees, src_rect)) {
+		return GrayImage(orthogonalRotation(gray_src.toQImage(), src_rect, degrees));
+	}
+	
 	GrayImage dst(dst_rect.size());
 	
 	transformGeneric<uint8_t, Gray>(
@@ -476,4 +616,90 @@ GrayImage transformToGray(
 	return dst;
 }
 
+BinaryImage transformBinary(
+	BinaryImage const& src, QTransform const& xform,
+	QRect const& dst_rect, BWColor const outside_color)
+{
+	if (src.isNull() || dst_rect.isEmpty()) {
+		return BinaryImage();
+	}
+	
+	if (!xform.isAffine()) {
+		throw std::invalid_argument("transformBinary: only affine transformations are supported");
+	}
+	
+	if (!dst_rect.isValid()) {
+		throw std::invalid_argument("transformBinary: dst_rect is invalid");
+	}
+	
+	BinaryImage dst;
+	if (transformBinaryWithShears(src, xform, dst_rect, outside_color, dst)) {
+		return dst;
+	}
+	
+	BinaryImage reduced(src);
+	QTransform reduced_xform(xform);
+	for (;;) {
+		// How much a unit step along each source axis is scaled.
+		QTransform const& t = reduced_xform;
+		double const x_scale = sqrt(t.m11() * t.m11() + t.m12() * t.m12());
+		double const y_scale = sqrt(t.m21() * t.m21() + t.m22() * t.m22());
+		if (std::max(x_scale, y_scale) > 0.5
+				|| reduced.width() < 2 || reduced.height() < 2) {
+			break;
+		}
+		
+		// Threshold 2 preserves lines 1 pixel thick.
+		reduced = ReduceThreshold(reduced)(2);
+		reduced_xform = QTransform().scale(2.0, 2.0) * reduced_xform;
+	}
+	
+	QTransform const inv_xform(reduced_xform.inverted());
+	
+	int const src_width = reduced.width();
+	int const src_height = reduced.height();
+	int const src_wpl = reduced.wordsPerLine();
+	uint32_t const* const src_data = reduced.data();
+	
+	int const dst_width = dst_rect.width();
+	int const dst_height = dst_rect.height();
+	dst = BinaryImage(dst_rect.size(), WHITE);
+	int const dst_wpl = dst.wordsPerLine();
+	uint32_t* dst_line = dst.data();
+	
+	// Source coordinates are stepped in 32.32 fixed point.
+	double const fixed_one = 4294967296.0;
+	qint64 const dx_step = (qint64)(inv_xform.m11() * fixed_one);
+	qint64 const dy_step = (qint64)(inv_xform.m12() * fixed_one);
+	uint32_t const msb = uint32_t(1) << 31;
+	
+	for (int y = 0; y < dst_height; ++y, dst_line += dst_wpl) {
+		QPointF const first(
+			inv_xform.map(
+				QPointF(dst_rect.left() + 0.5, dst_rect.top() + y + 0.5)
+			)
+		);
+		qint64 sx = (qint64)floor(first.x() * fixed_one);
+		qint64 sy = (qint64)floor(first.y() * fixed_one);
+		
+		for (int x = 0; x < dst_width; ++x, sx += dx_step, sy += dy_step) {
+			// Arithmetic right shift rounds towards negative infinity.
+			int const src_x = (int)(sx >> 32);
+			int const src_y = (int)(sy >> 32);
+			
+			BWColor color = outside_color;
+			if ((unsigned)src_x < (unsigned)src_width
+					&& (unsigned)src_y < (unsigned)src_height) {
+				uint32_t const word = src_data[src_y * src_wpl + (src_x >> 5)];
+				color = (word & (msb >> (src_x & 31))) ? BLACK : WHITE;
+			}
+			if (color == BLACK) {
+				dst_line[x >> 5] |= msb >> (x & 31);
+			}
+		}
+	}
+	
+	return dst;
+}
+
 } // namespace imageproc
@@ -19,6 +19,7 @@
 #ifndef IMAGEPROC_TRANSFORM_H_
 #define IMAGEPROC_TRANSFORM_H_
 
+#include "BWColor.h"
 #include <QSizeF>
 #include <QColor>
 #include <stdint.h>
@@ -30,6 +31,7 @@ class QTransform;
 namespace imageproc
 {
 
+class BinaryImage;
 class GrayImage;
 
 class OutsidePixels
@@ -123,6 +125,30 @@ GrayImage transformToGray(
 	QRect const& dst_rect, OutsidePixels outside_pixels,
 	QSizeF const& min_mapping_area = QSizeF(0.9, 0.9));
 
+/**
+ * \brief Apply an affine transformation to a 1-bit image, keeping it 1-bit.
+ *
+ * Destination pixels take the value of the source pixel their centers
+ * map to.  When the transformation shrinks the image at least 2x in both
+ * directions, the source is first reduced with ReduceThreshold, which
+ * unlike point sampling doesn't lose thin strokes.  Rotations combined
+ * with integer scaling are done with rotateBinary() instead of mapping
+ * individual pixels, which may shift the result by up to half a pixel.
+ *
+ * \param src The source image.
+ * \param xform The transformation from source to destination.
+ *        Only affine transformations are supported.
+ * \param dst_rect The area in destination image coordinates to return
+ *        as a destination image.
+ * \param outside_color The color of pixels not represented in the
+ *        source image.
+ * \return The transformed image, or a null image if \p src is null
+ *         or \p dst_rect is empty.
+ */
+BinaryImage transformBinary(
+	BinaryImage const& src, QTransform const& xform,
+	QRect const& dst_rect, BWColor outside_color);
+
 } // namespace imageproc
 
 #endif
@@ -81,6 +81,53 @@ BOOST_AUTO_TEST_CASE(test_argb32_to_grayscale)
 	BOOST_CHECK(toGrayscale(argb32) == gray);
 }
 
+BOOST_AUTO_TEST_CASE(test_rgb32_matches_qgray)
+{
+	int const w = 37;
+	int const h = 20;
+	QImage rgb32(w, h, QImage::Format_RGB32);
+	QImage gray(w, h, QImage::Format_Indexed8);
+	gray.setColorTable(createGrayscalePalette());
+	
+	for (int y = 0; y < h; ++y) {
+		for (int x = 0; x < w; ++x) {
+			QRgb const rgb = qRgb(rand() & 0xff, rand() & 0xff, rand() & 0xff);
+			rgb32.setPixel(x, y, rgb);
+			gray.setPixel(x, y, qGray(rgb));
+		}
+	}
+	
+	BOOST_CHECK(toGrayscale(rgb32) == gray);
+}
+
+BOOST_AUTO_TEST_CASE(test_histogram_as_by_product)
+{
+	int const w = 41;
+	int const h = 30;
+	QImage rgb32(w, h, QImage::Format_RGB32);
+	QImage mono(w, h, QImage::Format_Mono);
+	
+	for (int y = 0; y < h; ++y) {
+		for (int x = 0; x < w; ++x) {
+			rgb32.setPixel(x, y, qRgb(rand() & 0xff, rand() & 0xff, rand() & 0xff));
+			mono.setPixel(x, y, rand() & 1);
+		}
+	}
+	
+	QImage const images[] = {
+		rgb32, mono, toGrayscale(rgb32),
+		rgb32.convertToFormat(QImage::Format_RGB16)
+	};
+	for (size_t i = 0; i < sizeof(images) / sizeof(images[0]); ++i) {
+		GrayscaleHistogram by_product;
+		QImage const gray(toGrayscale(images[i], &by_product));
+		GrayscaleHistogram const control(gray);
+		for (int level = 0; level < 256; ++level) {
+			BOOST_REQUIRE_EQUAL(by_product[level], control[level]);
+		}
+	}
+}
+
 BOOST_AUTO_TEST_SUITE_END();
 
 } // namespace tests
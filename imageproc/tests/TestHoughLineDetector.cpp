@@ -0,0 +1,266 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "HoughLineDetector.h"
+#include "Constants.h"
+#include <QSize>
+#include <QPoint>
+#include <QPointF>
+#include <vector>
+#ifndef Q_MOC_RUN
+#include <boost/foreach.hpp>
+#include <boost/test/auto_unit_test.hpp>
+#endif
+#include <algorithm>
+#include <math.h>
+
+namespace imageproc
+{
+
+namespace tests
+{
+
+namespace
+{
+
+/**
+ * Parameters similar to the ones VertLineFinder uses.
+ */
+double const LINE_THICKNESS = 5.0;
+double const MIN_ANGLE = -7.0;
+double const ANGLE_STEP = 0.25;
+int const NUM_ANGLES = 57;
+
+/**
+ * The way HoughLineDetector used to vote before per-row voting was
+ * introduced: every point computes its distance for every angle
+ * from scratch.
+ */
+class ReferenceVoting
+{
+public:
+	ReferenceVoting(QSize const& size, double distance_resolution,
+		double start_angle, double angle_delta, int num_angles);
+	
+	void process(int x, int y, unsigned weight);
+	
+	/**
+	 * The votes the bin \p line was found at would have received.
+	 */
+	unsigned votes(HoughLine const& line) const;
+private:
+	std::vector<unsigned> m_histogram;
+	std::vector<QPointF> m_angleUnitVectors;
+	double m_distanceResolution;
+	double m_recipDistanceResolution;
+	double m_distanceBias;
+	int m_histWidth;
+};
+
+ReferenceVoting::ReferenceVoting(
+	QSize const& size, double const distance_resolution,
+	double const start_angle, double const angle_delta, int const num_angles)
+:	m_distanceResolution(distance_resolution),
+	m_recipDistanceResolution(1.0 / distance_resolution)
+{
+	QPoint checkpoints[3];
+	checkpoints[0] = QPoint(size.width() - 1, size.height() - 1);
+	checkpoints[1] = QPoint(size.width() - 1, 0);
+	checkpoints[2] = QPoint(0, size.height() - 1);
+	
+	double max_distance = 0.0;
+	double min_distance = 0.0;
+	for (int i = 0; i < num_angles; ++i) {
+		double const angle = (start_angle + angle_delta * i) * constants::DEG2RAD;
+		QPointF const uv(cos(angle), sin(angle));
+		BOOST_FOREACH (QPoint const& p, checkpoints) {
+			double const distance = uv.x() * p.x() + uv.y() * p.y();
+			max_distance = std::max(max_distance, distance);
+			min_distance = std::min(min_distance, distance);
+		}
+		m_angleUnitVectors.push_back(uv);
+	}
+	
+	m_distanceBias = -min_distance;
+	m_histWidth = int(
+		(max_distance + m_distanceBias) * m_recipDistanceResolution + 0.5
+	) + 1;
+	m_histogram.resize(m_histWidth * num_angles, 0);
+}
+
+void
+ReferenceVoting::process(int const x, int const y, unsigned const weight)
+{
+	unsigned* hist_line = &m_histogram[0];
+	
+	BOOST_FOREACH (QPointF const& uv, m_angleUnitVectors) {
+		double const distance = uv.x() * x + uv.y() * y;
+		double const biased_distance = distance + m_distanceBias;
+		
+		int const bin = (int)(biased_distance * m_recipDistanceResolution + 0.5);
+		hist_line[bin] += weight;
+		
+		hist_line += m_histWidth;
+	}
+}
+
+unsigned
+ReferenceVoting::votes(HoughLine const& line) const
+{
+	int angle_idx = 0;
+	for (int i = 1; i < (int)m_angleUnitVectors.size(); ++i) {
+		QPointF const d1(m_angleUnitVectors[i] - line.normUnitVector());
+		QPointF const d2(m_angleUnitVectors[angle_idx] - line.normUnitVector());
+		if (d1.x() * d1.x() + d1.y() * d1.y() < d2.x() * d2.x() + d2.y() * d2.y()) {
+			angle_idx = i;
+		}
+	}
+	
+	// HoughLineDetector reports the center of a bin.
+	int const bin = (int)floor(
+		(line.distance() + m_distanceBias) * m_recipDistanceResolution
+	);
+	
+	return m_histogram[angle_idx * m_histWidth + bin];
+}
+
+struct SyntheticLine
+{
+	double angle; // Between the line's normal and the X axis, in degrees.
+	double distance;
+	unsigned weight;
+};
+
+/**
+ * Near-vertical lines of different weights, plus scattered noise,
+ * in a raster of weights.
+ */
+std::vector<unsigned> syntheticImage(
+	QSize const& size, SyntheticLine const* lines, int num_lines)
+{
+	int const width = size.width();
+	int const height = size.height();
+	std::vector<unsigned> weights(width * height, 0);
+	
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			if ((x * 7 + y * 13) % 97 == 0) {
+				weights[y * width + x] = 1;
+			}
+		}
+	}
+	
+	for (int i = 0; i < num_lines; ++i) {
+		double const angle = lines[i].angle * constants::DEG2RAD;
+		for (int y = 0; y < height; ++y) {
+			int const x = (int)floor(
+				(lines[i].distance - y * sin(angle)) / cos(angle) + 0.5
+			);
+			if (x >= 0 && x < width) {
+				weights[y * width + x] = lines[i].weight;
+			}
+		}
+	}
+	
+	return weights;
+}
+
+bool sameLines(HoughLine const& lhs, HoughLine const& rhs)
+{
+	return lhs.normUnitVector() == rhs.normUnitVector()
+		&& lhs.distance() == rhs.distance()
+		&& lhs.quality() == rhs.quality();
+}
+
+bool matches(HoughLine const& line, SyntheticLine const& expected)
+{
+	QPointF const uv(line.normUnitVector());
+	double const angle = atan2(uv.y(), uv.x()) * constants::RAD2DEG;
+	
+	// A line falling between two bins at its own angle may collect
+	// more votes at a neighbouring angle.
+	return fabs(angle - expected.angle) <= ANGLE_STEP + 1e-6
+		&& fabs(line.distance() - expected.distance) <= LINE_THICKNESS;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE(HoughLineDetectorTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_lines_match_original_voting)
+{
+	static SyntheticLine const lines[] = {
+		{ 0.0, 80.0, 3 },
+		{ 2.5, 200.0, 2 },
+		{ -4.25, 320.0, 1 }
+	};
+	int const num_lines = sizeof(lines) / sizeof(lines[0]);
+	
+	QSize const size(400, 300);
+	std::vector<unsigned> const weights(syntheticImage(size, lines, num_lines));
+	
+	HoughLineDetector row_detector(
+		size, LINE_THICKNESS, MIN_ANGLE, ANGLE_STEP, NUM_ANGLES
+	);
+	HoughLineDetector point_detector(
+		size, LINE_THICKNESS, MIN_ANGLE, ANGLE_STEP, NUM_ANGLES
+	);
+	ReferenceVoting reference(
+		size, LINE_THICKNESS, MIN_ANGLE, ANGLE_STEP, NUM_ANGLES
+	);
+	
+	for (int y = 0; y < size.height(); ++y) {
+		unsigned const* row = &weights[y * size.width()];
+		row_detector.processRow(y, 0, size.width(), row);
+		for (int x = 0; x < size.width(); ++x) {
+			if (row[x] != 0) {
+				point_detector.process(x, y, row[x]);
+				reference.process(x, y, row[x]);
+			}
+		}
+	}
+	
+	unsigned const min_quality = 100;
+	std::vector<HoughLine> const row_lines(row_detector.findLines(min_quality));
+	std::vector<HoughLine> const point_lines(point_detector.findLines(min_quality));
+	
+	BOOST_REQUIRE(row_lines.size() == point_lines.size());
+	for (unsigned i = 0; i < row_lines.size(); ++i) {
+		BOOST_CHECK(sameLines(row_lines[i], point_lines[i]));
+		
+		// The votes must be the same as with the original voting code.
+		BOOST_CHECK(row_lines[i].quality() == reference.votes(row_lines[i]));
+	}
+	
+	for (int i = 0; i < num_lines; ++i) {
+		bool found = false;
+		BOOST_FOREACH (HoughLine const& line, row_lines) {
+			if (matches(line, lines[i])) {
+				found = true;
+				break;
+			}
+		}
+		BOOST_CHECK(found);
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace tests
+
+} // namespace imageproc
@@ -21,6 +21,7 @@
 #include "Utils.h"
 #include <QImage>
 #include <QRect>
+#include <QTransform>
 #ifndef Q_MOC_RUN
 #include <boost/test/auto_unit_test.hpp>
 #endif
@@ -177,6 +178,41 @@ BOOST_AUTO_TEST_CASE(test_sub_image)
 	BOOST_REQUIRE(orthogonalRotation(img, rect, -90) == out4_img);
 }
 
+BOOST_AUTO_TEST_CASE(test_large_binary_image)
+{
+	// Large and oddly sized enough to span several 32x32 blocks,
+	// including partial ones.
+	BinaryImage const img(randomBinaryImage(171, 99));
+	QRect const src_rect(5, 3, 150, 90);
+	QImage const src_rect_img(img.toQImage().copy(src_rect));
+	
+	for (int degrees = 0; degrees < 360; degrees += 90) {
+		QImage const control(
+			src_rect_img.transformed(QTransform().rotate(degrees))
+		);
+		BinaryImage const rotated(orthogonalRotation(img, src_rect, degrees));
+		BOOST_CHECK(rotated == BinaryImage(control));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_qimage)
+{
+	QImage const gray(randomGrayImage(123, 77));
+	QImage const rgb(gray.convertToFormat(QImage::Format_RGB32));
+	QRect const src_rect(10, 7, 100, 60);
+	
+	for (int degrees = 0; degrees < 360; degrees += 90) {
+		QTransform rotation;
+		rotation.rotate(degrees);
+		
+		QImage const gray_control(gray.copy(src_rect).transformed(rotation));
+		BOOST_CHECK(orthogonalRotation(gray, src_rect, degrees) == gray_control);
+		
+		QImage const rgb_control(rgb.copy(src_rect).transformed(rotation));
+		BOOST_CHECK(orthogonalRotation(rgb, src_rect, degrees) == rgb_control);
+	}
+}
+
 BOOST_AUTO_TEST_SUITE_END();
 
 } // namespace tests
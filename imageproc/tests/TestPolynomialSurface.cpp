@@ -0,0 +1,135 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "PolynomialSurface.h"
+#include "PolynomialLine.h"
+#include "PolynomialLineFitter.h"
+#include "GrayImage.h"
+#include "BinaryImage.h"
+#include "BWColor.h"
+#include <QSize>
+#include <QRect>
+#ifndef Q_MOC_RUN
+#include <boost/test/auto_unit_test.hpp>
+#endif
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+
+namespace imageproc
+{
+
+namespace tests
+{
+
+BOOST_AUTO_TEST_SUITE(PolynomialSurfaceTestSuite);
+
+static GrayImage makeSmoothImage(QSize const& size)
+{
+	GrayImage image(size);
+	uint8_t* line = image.data();
+	int const stride = image.stride();
+	
+	for (int y = 0; y < size.height(); ++y, line += stride) {
+		double const v = double(y) / (size.height() - 1);
+		for (int x = 0; x < size.width(); ++x) {
+			double const u = double(x) / (size.width() - 1);
+			double const value = 40 + 100 * u + 80 * v * v
+				- 60 * u * u * u + 30 * u * v;
+			line[x] = static_cast<uint8_t>(value + 0.5);
+		}
+	}
+	
+	return image;
+}
+
+static int maxDifference(GrayImage const& img1, GrayImage const& img2)
+{
+	BOOST_REQUIRE(img1.size() == img2.size());
+	
+	int max_diff = 0;
+	for (int y = 0; y < img1.height(); ++y) {
+		uint8_t const* line1 = img1.data() + y * img1.stride();
+		uint8_t const* line2 = img2.data() + y * img2.stride();
+		for (int x = 0; x < img1.width(); ++x) {
+			max_diff = std::max(max_diff, abs(int(line1[x]) - int(line2[x])));
+		}
+	}
+	
+	return max_diff;
+}
+
+BOOST_AUTO_TEST_CASE(test_surface_reproduces_polynomial)
+{
+	GrayImage const image(makeSmoothImage(QSize(301, 217)));
+	PolynomialSurface const surface(5, 5, image);
+	BOOST_CHECK(maxDifference(surface.render(image.size()), image) <= 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_masked_surface_reproduces_polynomial)
+{
+	GrayImage const image(makeSmoothImage(QSize(301, 217)));
+	BinaryImage mask(image.size(), WHITE);
+	for (int y = 0; y < image.height(); y += 3) {
+		for (int x = 0; x < image.width(); x += 5) {
+			mask.fill(QRect(x, y, 1, 1), BLACK);
+		}
+	}
+	
+	PolynomialSurface const surface(5, 5, image, mask);
+	BOOST_CHECK(maxDifference(surface.render(image.size()), image) <= 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_line_fitter_matches_polynomial_line)
+{
+	int const num_values = 123;
+	int const step = 3;
+	std::vector<uint8_t> values(num_values * step);
+	for (size_t i = 0; i < values.size(); ++i) {
+		values[i] = static_cast<uint8_t>(rand() & 0xff);
+	}
+	
+	for (int degree = 0; degree <= 5; ++degree) {
+		std::vector<double> expected(num_values);
+		PolynomialLine(degree, &values[0], num_values, step).output(
+			&expected[0], num_values, 1
+		);
+		
+		PolynomialLineFitter const fitter(degree, num_values);
+		std::vector<double> actual(num_values);
+		fitter.fit(&values[0], step).output(&actual[0], num_values, 1);
+		
+		std::vector<double> actual_columns(num_values);
+		fitter.fitColumns(&values[0], step, step)[0].output(
+			&actual_columns[0], num_values, 1
+		);
+		
+		for (int i = 0; i < num_values; ++i) {
+			BOOST_REQUIRE(fabs(actual[i] - expected[i]) < 1e-6);
+			BOOST_REQUIRE(fabs(actual_columns[i] - expected[i]) < 1e-6);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace tests
+
+} // namespace imageproc
@@ -223,6 +223,32 @@ BOOST_AUTO_TEST_CASE(test_move_blocks)
 	BOOST_REQUIRE(tester.testBlockMove(QRect(51, 35, 199, 200), 1, 1));
 }
 
+BOOST_AUTO_TEST_CASE(test_two_sources)
+{
+	BinaryImage const dst(randomBinaryImage(211, 37));
+	BinaryImage const src(randomBinaryImage(211, 37));
+	BinaryImage const src2(randomBinaryImage(211, 37));
+	
+	// dst & ~src & ~src2, in one pass and in two.
+	BinaryImage fused(dst);
+	rasterOp<RopSubtract<RopSubtract<RopDst, RopSrc>, RopSrc2> >(fused, src, src2);
+	
+	BinaryImage control(dst);
+	rasterOp<RopSubtract<RopDst, RopSrc> >(control, src);
+	rasterOp<RopSubtract<RopDst, RopSrc> >(control, src2);
+	
+	BOOST_CHECK(fused == control);
+	
+	// The destination image may also be a source one.
+	BinaryImage in_place(dst);
+	rasterOp<RopOr<RopXor<RopSrc, RopDst>, RopSrc2> >(in_place, in_place, src2);
+	
+	BinaryImage in_place_control(dst.size(), WHITE);
+	rasterOp<RopSrc>(in_place_control, src2);
+	
+	BOOST_CHECK(in_place == in_place_control);
+}
+
 BOOST_AUTO_TEST_SUITE_END();
 
 } // namespace tests
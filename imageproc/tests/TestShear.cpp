@@ -21,9 +21,14 @@
 #include "BWColor.h"
 #include "Utils.h"
 #include <QImage>
+#include <QPointF>
+#include <QRect>
+#include <QRectF>
+#include <QTransform>
 #ifndef Q_MOC_RUN
 #include <boost/test/auto_unit_test.hpp>
 #endif
+#include <stdexcept>
 
 namespace imageproc
 {
@@ -92,6 +97,69 @@ BOOST_AUTO_TEST_CASE(test_small_image)
 	BOOST_REQUIRE(v_shear_inplace == v_out_img);
 }
 
+BOOST_AUTO_TEST_CASE(test_rotate_by_zero)
+{
+	BinaryImage const img(randomBinaryImage(100, 100));
+	BOOST_CHECK(rotateBinary(img, 0.0, WHITE) == img);
+}
+
+BOOST_AUTO_TEST_CASE(test_rotate_keeps_center)
+{
+	static int const inp[] = {
+		0, 0, 0, 0, 0,
+		0, 0, 0, 0, 0,
+		0, 0, 1, 0, 0,
+		0, 0, 0, 0, 0,
+		0, 0, 0, 0, 0
+	};
+	
+	BinaryImage const img(makeBinaryImage(inp, 5, 5));
+	BOOST_CHECK(rotateBinary(img, 30.0, WHITE) == img);
+	BOOST_CHECK(rotateBinary(img, -30.0, WHITE) == img);
+}
+
+BOOST_AUTO_TEST_CASE(test_rotate_asymmetric_pattern)
+{
+	BinaryImage const img(asymmetricPattern(200, 160));
+	QPointF const center(0.5 * img.width(), 0.5 * img.height());
+	
+	static double const angles[] = { 23.0, -37.5 };
+	for (int i = 0; i < int(sizeof(angles) / sizeof(angles[0])); ++i) {
+		QTransform xform;
+		xform.translate(center.x(), center.y());
+		xform.rotate(angles[i]);
+		xform.translate(-center.x(), -center.y());
+		QRect const dst_rect(xform.mapRect(QRectF(img.rect())).toAlignedRect());
+		
+		BinaryImage const control(pointSampledTransform(img, xform, dst_rect, WHITE));
+		BinaryImage const rotated(rotateBinary(img, angles[i], center, dst_rect, WHITE));
+		BOOST_REQUIRE(rotated.size() == control.size());
+		
+		// Shears may move an edge by a pixel compared to point sampling.
+		int const tolerance = countEdgePixels(control);
+		BOOST_CHECK(hammingDistance(rotated, control) <= tolerance);
+		
+		// Make sure the tolerance is tight enough to catch
+		// a rotation in the wrong direction.
+		BinaryImage const wrong(rotateBinary(img, -angles[i], center, dst_rect, WHITE));
+		BOOST_CHECK(hammingDistance(wrong, control) > tolerance);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_rotate_outside_of_source)
+{
+	BinaryImage const img(randomBinaryImage(20, 20));
+	QRect const dst_rect(100, 100, 10, 10);
+	BinaryImage const control(dst_rect.size(), BLACK);
+	BOOST_CHECK(rotateBinary(img, 10.0, QPointF(10, 10), dst_rect, BLACK) == control);
+}
+
+BOOST_AUTO_TEST_CASE(test_rotate_angle_out_of_range)
+{
+	BinaryImage const img(randomBinaryImage(20, 20));
+	BOOST_CHECK_THROW(rotateBinary(img, 60.0, WHITE), std::invalid_argument);
+}
+
 BOOST_AUTO_TEST_SUITE_END();
 
 } // namespace tests
@@ -18,9 +18,13 @@
 
 #include "Transform.h"
 #include "Grayscale.h"
+#include "BinaryImage.h"
 #include "Utils.h"
 #include <QImage>
 #include <QSize>
+#include <QRect>
+#include <QRectF>
+#include <QTransform>
 #ifndef Q_MOC_RUN
 #include <boost/test/auto_unit_test.hpp>
 #endif
@@ -66,6 +70,81 @@ BOOST_AUTO_TEST_CASE(test_random_image)
 	BOOST_CHECK(transformToGray(img, null_xform, img.rect(), outside_pixels) == img);
 }
 
+BOOST_AUTO_TEST_CASE(test_binary_identity)
+{
+	BinaryImage const img(randomBinaryImage(100, 100));
+	QTransform const null_xform;
+	BOOST_CHECK(transformBinary(img, null_xform, img.rect(), WHITE) == img);
+}
+
+BOOST_AUTO_TEST_CASE(test_binary_translate_and_outside_color)
+{
+	static int const inp[] = {
+		1, 0, 0,
+		0, 1, 0,
+		0, 0, 1
+	};
+
+	static int const out[] = {
+		1, 1, 1,
+		1, 1, 0,
+		1, 0, 1
+	};
+
+	BinaryImage const img(makeBinaryImage(inp, 3, 3));
+	BinaryImage const control(makeBinaryImage(out, 3, 3));
+	QTransform xform;
+	xform.translate(1, 1);
+	BOOST_CHECK(transformBinary(img, xform, img.rect(), BLACK) == control);
+}
+
+BOOST_AUTO_TEST_CASE(test_binary_downscale_keeps_thin_lines)
+{
+	static int const inp[] = {
+		0, 0, 0, 0, 0, 0, 0, 0,
+		0, 0, 0, 0, 0, 0, 0, 0,
+		1, 1, 1, 1, 1, 1, 1, 1,
+		0, 0, 0, 0, 0, 0, 0, 0,
+		0, 0, 0, 0, 0, 0, 0, 0,
+		0, 0, 0, 0, 0, 0, 0, 0,
+		0, 0, 0, 0, 0, 0, 0, 0,
+		0, 0, 0, 0, 0, 0, 0, 0
+	};
+
+	static int const out[] = {
+		0, 0, 0, 0,
+		1, 1, 1, 1,
+		0, 0, 0, 0,
+		0, 0, 0, 0
+	};
+
+	BinaryImage const img(makeBinaryImage(inp, 8, 8));
+	BinaryImage const control(makeBinaryImage(out, 4, 4));
+	QTransform xform;
+	xform.scale(0.5, 0.5);
+	BOOST_CHECK(transformBinary(img, xform, QRect(0, 0, 4, 4), WHITE) == control);
+}
+
+BOOST_AUTO_TEST_CASE(test_binary_rotate_and_upscale)
+{
+	BinaryImage const img(asymmetricPattern(120, 90));
+	
+	// Rotations combined with integer upscaling are done with shears,
+	// which are compared to point sampling here.
+	static double const angles[] = { 7.5, -100.0 };
+	for (int i = 0; i < int(sizeof(angles) / sizeof(angles[0])); ++i) {
+		QTransform xform;
+		xform.rotate(angles[i]);
+		xform.scale(2.0, 2.0);
+		QRect const dst_rect(xform.mapRect(QRectF(img.rect())).toAlignedRect());
+		
+		BinaryImage const control(pointSampledTransform(img, xform, dst_rect, WHITE));
+		BinaryImage const transformed(transformBinary(img, xform, dst_rect, WHITE));
+		BOOST_REQUIRE(transformed.size() == control.size());
+		BOOST_CHECK(hammingDistance(transformed, control) <= countEdgePixels(control));
+	}
+}
+
 BOOST_AUTO_TEST_SUITE_END();
 
 } // namespace tests
@@ -21,10 +21,14 @@
 #include "Grayscale.h"
 #include <QImage>
 #include <QRect>
+#include <QPointF>
+#include <QTransform>
 #include <iostream>
 #include <stdint.h>
 #include <stdlib.h>
+#include <algorithm>
 #include <assert.h>
+#include <math.h>
 
 namespace imageproc
 {
@@ -206,6 +210,89 @@ bool surroundingsIntact(QImage const& img1, QImage const& img2, QRect const& rec
 	return true;
 }
 
+static bool isBlack(BinaryImage const& img, int const x, int const y)
+{
+	uint32_t const word = img.data()[y * img.wordsPerLine() + (x >> 5)];
+	return (word >> (31 - (x & 31))) & 1;
+}
+
+BinaryImage asymmetricPattern(int const width, int const height)
+{
+	int const stroke = std::max(2, std::min(width, height) / 10);
+	
+	BinaryImage img(width, height, WHITE);
+	QRect const body(width / 4, height / 6, width / 2, height * 2 / 3);
+	img.fill(QRect(body.left(), body.top(), stroke, body.height()), BLACK);
+	img.fill(QRect(body.left(), body.top(), body.width(), stroke), BLACK);
+	img.fill(QRect(body.left(), body.center().y(), body.width() * 2 / 3, stroke), BLACK);
+	img.fill(QRect(width - 2 * stroke, height - 2 * stroke, stroke, stroke), BLACK);
+	return img;
+}
+
+BinaryImage pointSampledTransform(
+	BinaryImage const& src, QTransform const& xform,
+	QRect const& dst_rect, BWColor const outside_color)
+{
+	QTransform const inv_xform(xform.inverted());
+	
+	BinaryImage dst(dst_rect.size(), WHITE);
+	for (int y = 0; y < dst_rect.height(); ++y) {
+		for (int x = 0; x < dst_rect.width(); ++x) {
+			QPointF const src_pt(
+				inv_xform.map(
+					QPointF(dst_rect.left() + x + 0.5, dst_rect.top() + y + 0.5)
+				)
+			);
+			int const src_x = (int)floor(src_pt.x());
+			int const src_y = (int)floor(src_pt.y());
+			
+			bool black = (outside_color == BLACK);
+			if (src.rect().contains(src_x, src_y)) {
+				black = isBlack(src, src_x, src_y);
+			}
+			if (black) {
+				dst.fill(QRect(x, y, 1, 1), BLACK);
+			}
+		}
+	}
+	return dst;
+}
+
+int hammingDistance(BinaryImage const& img1, BinaryImage const& img2)
+{
+	assert(img1.size() == img2.size());
+	
+	int distance = 0;
+	for (int y = 0; y < img1.height(); ++y) {
+		for (int x = 0; x < img1.width(); ++x) {
+			if (isBlack(img1, x, y) != isBlack(img2, x, y)) {
+				++distance;
+			}
+		}
+	}
+	return distance;
+}
+
+int countEdgePixels(BinaryImage const& img)
+{
+	int const w = img.width();
+	int const h = img.height();
+	
+	int count = 0;
+	for (int y = 0; y < h; ++y) {
+		for (int x = 0; x < w; ++x) {
+			bool const black = isBlack(img, x, y);
+			if ((x > 0 && isBlack(img, x - 1, y) != black)
+					|| (x + 1 < w && isBlack(img, x + 1, y) != black)
+					|| (y > 0 && isBlack(img, x, y - 1) != black)
+					|| (y + 1 < h && isBlack(img, x, y + 1) != black)) {
+				++count;
+			}
+		}
+	}
+	return count;
+}
+
 } // namespace utils
 
 } // namespace tests
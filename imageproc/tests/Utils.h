@@ -19,8 +19,11 @@
 #ifndef IMAGEPROC_TESTS_UTILS_H_
 #define IMAGEPROC_TESTS_UTILS_H_
 
+#include "BWColor.h"
+
 class QImage;
 class QRect;
+class QTransform;
 
 namespace imageproc
 {
@@ -51,6 +54,34 @@ void dumpGrayImage(QImage const& img, char const* name = 0);
 
 bool surroundingsIntact(QImage const& img1, QImage const& img2, QRect const& rect);
 
+/**
+ * An image with no symmetries: thick strokes forming an "F" and a dot
+ * near one of the corners.  Mirroring or rotating it in the wrong
+ * direction changes a large fraction of its pixels.
+ */
+BinaryImage asymmetricPattern(int width, int height);
+
+/**
+ * A slow but straightforward transformation of a 1-bit image: the center
+ * of every destination pixel is mapped back through \p xform and takes
+ * the color of the source pixel it lands in.
+ */
+BinaryImage pointSampledTransform(
+	BinaryImage const& src, QTransform const& xform,
+	QRect const& dst_rect, BWColor outside_color);
+
+/**
+ * The number of pixels that differ between two images of the same size.
+ */
+int hammingDistance(BinaryImage const& img1, BinaryImage const& img2);
+
+/**
+ * The number of pixels having a 4-connected neighbour of the opposite
+ * color.  Shifting the image content by a pixel changes no more than
+ * half that many pixels.
+ */
+int countEdgePixels(BinaryImage const& img);
+
 } // namespace utils
 
 } // namespace uests
@@ -24,6 +24,11 @@
 
 #include "CommandLine.h"
 #include "ConsoleBatch.h"
+#include "MemoryBudget.h"
+#include "Profiler.h"
+#include "PngMetadataLoader.h"
+#include "TiffMetadataLoader.h"
+#include "JpegMetadataLoader.h"
 
 
 int main(int argc, char **argv)
@@ -44,6 +49,17 @@ int main(int argc, char **argv)
 		return 0;
 	}
 
+	MemoryBudget::instance().setLimit(qint64(cli.getMemoryBudget()) * 1024 * 1024);
+
+	// Used to check image sizes without decoding the images.
+	PngMetadataLoader::registerMyself();
+	TiffMetadataLoader::registerMyself();
+	JpegMetadataLoader::registerMyself();
+
+	if (cli.hasProfile()) {
+		Profiler::instance().setEnabled(true);
+	}
+
 	std::auto_ptr<ConsoleBatch> cbatch;
 
 	try {
@@ -53,11 +69,28 @@ int main(int argc, char **argv)
 			cbatch.reset(new ConsoleBatch(cli.images(), cli.outputDirectory(), cli.getLayoutDirection()));
 		}
 		cbatch->process();
+		
+		// Output files are written on background threads.
+		cbatch->waitForOutputFiles();
 	} catch(std::exception const& e) {
 		std::cerr << e.what() << std::endl;
+		if (cbatch.get()) {
+			// Don't leave truncated files behind.
+			cbatch->waitForOutputFiles();
+		}
 		exit(1);
 	}
 
 	if (cli.hasOutputProject())
 		cbatch->saveProject(cli.outputProjectFile());
+
+	if (cli.hasProfile()) {
+		Profiler::Format const format = cli.isProfileSummary()
+			? Profiler::SUMMARY : Profiler::TRACE_EVENTS;
+		if (!Profiler::instance().writeReport(cli.getProfileFile(), format)) {
+			std::cerr << "Unable to write the profile." << std::endl;
+		}
+		std::cout << "BinaryImage peak per task: "
+			<< (MemoryBudget::instance().peakTaskBytes() >> 20) << " MB" << std::endl;
+	}
 }
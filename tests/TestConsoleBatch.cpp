@@ -0,0 +1,142 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ConsoleBatch.h"
+#include "CommandLine.h"
+#include "TestUtils.h"
+#include "ImageFileInfo.h"
+#include "ImageMetadata.h"
+#include "ImageLoader.h"
+#include "Dpi.h"
+#include <QImage>
+#include <QPainter>
+#include <QColor>
+#include <QDir>
+#include <QFileInfo>
+#include <QString>
+#include <QStringList>
+#include <vector>
+#include <algorithm>
+#ifndef Q_MOC_RUN
+#include <boost/test/auto_unit_test.hpp>
+#endif
+
+namespace Tests
+{
+
+using namespace utils;
+
+namespace
+{
+
+/**
+ * A slightly skewed page with a few "text lines", which gives every
+ * stage something to detect.  The layout depends on \p seed only.
+ */
+QImage syntheticPage(int const seed)
+{
+	QImage image(1000, 1400, QImage::Format_RGB32);
+	image.fill(qRgb(0xff, 0xff, 0xff));
+	image.setDotsPerMeterX(11811);
+	image.setDotsPerMeterY(11811);
+	
+	QPainter painter(&image);
+	painter.translate(500, 700);
+	painter.rotate(0.7 * (seed % 3) - 0.7);
+	painter.translate(-500, -700);
+	
+	unsigned state = seed * 7919 + 1;
+	for (int y = 150 + 10 * seed; y < 1200; y += 40) {
+		for (int x = 120; x < 850;) {
+			state = state * 1103515245 + 12345;
+			int const width = 20 + (state >> 16) % 60;
+			painter.fillRect(x, y, std::min(width, 880 - x), 18, Qt::black);
+			x += width + 15;
+		}
+	}
+	return image;
+}
+
+std::vector<ImageFileInfo> writeImages(QString const& dir, int const count)
+{
+	std::vector<ImageFileInfo> images;
+	for (int i = 0; i < count; ++i) {
+		QString const path(QDir(dir).filePath(QString("page%1.png").arg(i + 1)));
+		BOOST_REQUIRE(syntheticPage(i).save(path));
+		
+		ImageMetadata metadata;
+		metadata.setDpi(Dpi(300, 300));
+		std::vector<ImageMetadata> image_metadata;
+		image_metadata.push_back(metadata);
+		images.push_back(ImageFileInfo(QFileInfo(path), image_metadata));
+	}
+	return images;
+}
+
+/**
+ * Processes the images on \p num_threads threads.
+ */
+void processImages(
+	std::vector<ImageFileInfo> const& images,
+	QString const& output_dir, int const num_threads)
+{
+	ConsoleBatch batch(images, output_dir, Qt::LeftToRight);
+	batch.analyzeAll(num_threads);
+	batch.waitForOutputFiles();
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE(ConsoleBatchTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_parallel_matches_serial)
+{
+	// Filters don't create their GUI parts in command line mode.
+	if (CommandLine::get().isGui()) {
+		CommandLine::set(CommandLine(QStringList(), false));
+	}
+	
+	QString const dir(tempPath("batch"));
+	QString const serial_dir(QDir(dir).filePath("serial"));
+	QString const parallel_dir(QDir(dir).filePath("parallel"));
+	BOOST_REQUIRE(QDir().mkpath(serial_dir));
+	BOOST_REQUIRE(QDir().mkpath(parallel_dir));
+	
+	std::vector<ImageFileInfo> const images(writeImages(dir, 6));
+	processImages(images, serial_dir, 1);
+	processImages(images, parallel_dir, 4);
+	
+	QStringList const serial_files(QDir(serial_dir).entryList(QDir::Files, QDir::Name));
+	QStringList const parallel_files(QDir(parallel_dir).entryList(QDir::Files, QDir::Name));
+	BOOST_CHECK(!serial_files.isEmpty());
+	BOOST_REQUIRE(serial_files == parallel_files);
+	
+	for (int i = 0; i < serial_files.size(); ++i) {
+		QString const& file = serial_files[i];
+		QImage const serial(ImageLoader::load(QDir(serial_dir).filePath(file)));
+		QImage const parallel(ImageLoader::load(QDir(parallel_dir).filePath(file)));
+		BOOST_REQUIRE(!serial.isNull());
+		BOOST_CHECK_MESSAGE(serial == parallel, file.toAscii().constData() << " differs");
+	}
+	
+	removeDirectory(dir);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace Tests
@@ -0,0 +1,122 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "filters/select_content/ContentBoxFinder.h"
+#include "benchmarks/SyntheticScan.h"
+#include "FilterData.h"
+#include "TaskStatus.h"
+#include <QImage>
+#include <QRectF>
+#include <QString>
+#include <vector>
+#ifndef Q_MOC_RUN
+#include <boost/test/auto_unit_test.hpp>
+#endif
+#include <math.h>
+
+namespace Tests
+{
+
+using namespace benchmarks;
+using namespace select_content;
+
+namespace
+{
+
+class NullTaskStatus : public TaskStatus
+{
+public:
+	virtual void cancel() {}
+
+	virtual bool isCancelled() const { return false; }
+
+	virtual void throwIfCancelled() const {}
+};
+
+/**
+ * Whether every edge of \p box1 is within \p tolerance of
+ * the corresponding edge of \p box2.
+ */
+bool sameBox(QRectF const& box1, QRectF const& box2, double const tolerance)
+{
+	return fabs(box1.left() - box2.left()) <= tolerance
+		&& fabs(box1.top() - box2.top()) <= tolerance
+		&& fabs(box1.right() - box2.right()) <= tolerance
+		&& fabs(box1.bottom() - box2.bottom()) <= tolerance;
+}
+
+std::vector<SyntheticScanParams> syntheticScans(int const dpi)
+{
+	std::vector<SyntheticScanParams> scans;
+	
+	scans.push_back(SyntheticScanParams(dpi));
+	
+	SyntheticScanParams plain(dpi);
+	plain.shadows = false;
+	plain.halftone = false;
+	plain.seed = 777;
+	scans.push_back(plain);
+	
+	SyntheticScanParams skewed(dpi);
+	skewed.skewAngle = -3.0;
+	skewed.curvature = 0.0;
+	skewed.seed = 4242;
+	scans.push_back(skewed);
+	
+	return scans;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE(ContentBoxFinderTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_coarse_to_fine_matches_full_resolution)
+{
+	NullTaskStatus const status;
+	
+	static int const resolutions[] = { 300, 600 };
+	for (int i = 0; i < 2; ++i) {
+		int const dpi = resolutions[i];
+		
+		// One pixel at 150 dpi, which is where both modes
+		// place the edges.
+		double const tolerance = dpi / 150.0 + 1e-6;
+		
+		std::vector<SyntheticScanParams> const scans(syntheticScans(dpi));
+		for (unsigned j = 0; j < scans.size(); ++j) {
+			FilterData const data(generateSyntheticScan(scans[j]));
+			QRectF const full(
+				ContentBoxFinder::findContentBox(
+					status, data, ContentBoxFinder::FULL_RESOLUTION
+				)
+			);
+			QRectF const coarse_to_fine(
+				ContentBoxFinder::findContentBox(
+					status, data, ContentBoxFinder::COARSE_TO_FINE
+				)
+			);
+			
+			BOOST_REQUIRE(!full.isEmpty());
+			BOOST_CHECK(sameBox(full, coarse_to_fine, tolerance));
+		}
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace Tests
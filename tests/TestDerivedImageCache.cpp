@@ -0,0 +1,176 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "DerivedImageCache.h"
+#include "OrthogonalRotation.h"
+#include "imageproc/BinaryImage.h"
+#include "imageproc/BinaryThreshold.h"
+#include "imageproc/GrayImage.h"
+#include "imageproc/OrthogonalRotation.h"
+#include <QImage>
+#include <QRect>
+#include <QColor>
+#ifndef Q_MOC_RUN
+#include <boost/test/auto_unit_test.hpp>
+#endif
+#include <stdlib.h>
+
+namespace Tests
+{
+
+using namespace imageproc;
+
+namespace
+{
+
+/**
+ * A random grayscale image at 300 dpi, which DerivedImageCache
+ * won't scale.
+ */
+GrayImage randomGrayImage(int const width, int const height)
+{
+	QImage image(width, height, QImage::Format_RGB32);
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			int const level = rand() & 0xff;
+			image.setPixel(x, y, qRgb(level, level, level));
+		}
+	}
+	image.setDotsPerMeterX(11811);
+	image.setDotsPerMeterY(11811);
+	return GrayImage(image);
+}
+
+bool sameData(BinaryImage const& img1, BinaryImage const& img2)
+{
+	return img1.data() == img2.data();
+}
+
+size_t imageBytes(BinaryImage const& image)
+{
+	return size_t(image.wordsPerLine()) * image.height() * 4;
+}
+
+OrthogonalRotation rotation90()
+{
+	OrthogonalRotation rotation;
+	rotation.nextClockwiseDirection();
+	return rotation;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE(DerivedImageCacheTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_reuse)
+{
+	GrayImage const gray(randomGrayImage(300, 200));
+	BinaryThreshold const threshold(128);
+	QRect const area(10, 20, 100, 50);
+	DerivedImageCache cache(gray, threshold);
+
+	BinaryImage const bin(cache.binary(area));
+	BOOST_CHECK(bin == BinaryImage(gray, area, threshold));
+	BOOST_CHECK(sameData(cache.binary(area), bin));
+
+	BinaryImage const rotated(cache.rotatedBinary(area, rotation90()));
+	BOOST_CHECK(rotated == orthogonalRotation(bin, 90));
+	BOOST_CHECK(sameData(cache.rotatedBinary(area, rotation90()), rotated));
+	BOOST_CHECK(sameData(cache.rotatedBinary(area, OrthogonalRotation()), bin));
+
+	// A 300 dpi image is not scaled, so the full image binarization is shared.
+	QTransform scaling;
+	BinaryImage const full(cache.rotatedBinary300(OrthogonalRotation(), &scaling));
+	BOOST_CHECK(scaling.isIdentity());
+	BOOST_CHECK(sameData(cache.binary(gray.rect()), full));
+
+	BOOST_CHECK_EQUAL(
+		cache.binaryBytes(), imageBytes(bin) + imageBytes(rotated) + imageBytes(full)
+	);
+}
+
+BOOST_AUTO_TEST_CASE(test_eviction)
+{
+	GrayImage const gray(randomGrayImage(256, 256));
+	BinaryThreshold const threshold(128);
+	QRect const top(0, 0, 256, 128);
+	QRect const bottom(0, 128, 256, 128);
+	size_t const half_bytes = imageBytes(BinaryImage(gray, top, threshold));
+
+	// Room for two halves, but not for three.
+	DerivedImageCache cache(gray, threshold, half_bytes * 2);
+
+	BinaryImage const top1(cache.binary(top));
+	BinaryImage const bottom1(cache.binary(bottom));
+	BOOST_CHECK_EQUAL(cache.binaryBytes(), half_bytes * 2);
+	BOOST_CHECK(sameData(cache.binary(top), top1));
+
+	// Rotating the bottom half uses the unrotated one, which leaves
+	// the top half as the least recently used image.
+	BinaryImage const rotated(cache.rotatedBinary(bottom, rotation90()));
+	BOOST_CHECK(rotated == orthogonalRotation(bottom1, 90));
+	BOOST_CHECK_EQUAL(cache.binaryBytes(), half_bytes * 2);
+	BOOST_CHECK(sameData(cache.binary(bottom), bottom1));
+
+	// An evicted image is recomputed.
+	BinaryImage const top2(cache.binary(top));
+	BOOST_CHECK(!sameData(top2, top1));
+	BOOST_CHECK(top2 == top1);
+	BOOST_CHECK_EQUAL(cache.binaryBytes(), half_bytes * 2);
+
+	// Recomputing the top half evicted the rotated image,
+	// as it was used less recently than the unrotated one.
+	BOOST_CHECK(sameData(cache.binary(bottom), bottom1));
+	BOOST_CHECK(!sameData(cache.rotatedBinary(bottom, rotation90()), rotated));
+}
+
+BOOST_AUTO_TEST_CASE(test_oversized_image_is_kept)
+{
+	GrayImage const gray(randomGrayImage(100, 100));
+	BinaryThreshold const threshold(128);
+	DerivedImageCache cache(gray, threshold, 1);
+
+	BinaryImage const first(cache.binary(gray.rect()));
+	BOOST_CHECK_EQUAL(cache.binaryBytes(), imageBytes(first));
+	BOOST_CHECK(sameData(cache.binary(gray.rect()), first));
+
+	BinaryImage const second(cache.binary(QRect(0, 0, 50, 50)));
+	BOOST_CHECK_EQUAL(cache.binaryBytes(), imageBytes(second));
+	BOOST_CHECK(!sameData(cache.binary(gray.rect()), first));
+}
+
+BOOST_AUTO_TEST_CASE(test_clear)
+{
+	GrayImage const gray(randomGrayImage(100, 100));
+	BinaryThreshold const threshold(128);
+	DerivedImageCache cache(gray, threshold);
+
+	BinaryImage const before(cache.rotatedBinary300(rotation90()));
+	BOOST_CHECK(cache.binaryBytes() > 0);
+
+	cache.clear();
+	BOOST_CHECK_EQUAL(cache.binaryBytes(), 0u);
+
+	BinaryImage const after(cache.rotatedBinary300(rotation90()));
+	BOOST_CHECK(!sameData(after, before));
+	BOOST_CHECK(after == before);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace Tests
@@ -0,0 +1,158 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "filters/output/DespeckleState.h"
+#include "filters/output/DespeckleVisualization.h"
+#include "filters/output/DespeckleLevel.h"
+#include "filters/output/OutputWriter.h"
+#include "filters/output/OutputImageParams.h"
+#include "filters/output/Settings.h"
+#include "filters/output/ColorParams.h"
+#include "filters/output/DewarpingMode.h"
+#include "filters/output/DepthPerception.h"
+#include "dewarping/DistortionModel.h"
+#include "imageproc/BinaryImage.h"
+#include "ImageTransformation.h"
+#include "TestUtils.h"
+#include "ZoneSet.h"
+#include "PageId.h"
+#include "ImageId.h"
+#include "Dpi.h"
+#include "IntrusivePtr.h"
+#include <QImage>
+#include <QFile>
+#include <QDir>
+#include <QRect>
+#include <QRectF>
+#include <QSize>
+#include <QString>
+#ifndef Q_MOC_RUN
+#include <boost/test/auto_unit_test.hpp>
+#endif
+
+namespace Tests
+{
+
+using namespace output;
+using namespace imageproc;
+using namespace utils;
+
+namespace
+{
+
+Dpi const dpi(300, 300);
+
+OutputImageParams outputImageParams(QSize const& size)
+{
+	return OutputImageParams(
+		size, QRect(QPoint(0, 0), size),
+		ImageTransformation(QRectF(QPoint(0, 0), size), dpi), dpi,
+		ColorParams(), DewarpingMode(), dewarping::DistortionModel(),
+		DepthPerception(), DESPECKLE_NORMAL
+	);
+}
+
+QImage outputImage(QSize const& size)
+{
+	QImage image(size, QImage::Format_RGB32);
+	image.fill(0xffffffff);
+	return image;
+}
+
+QImage specklesImage(QSize const& size)
+{
+	BinaryImage speckles(size, WHITE);
+	speckles.fill(QRect(10, 10, 4, 4), BLACK);
+	return speckles.toQImage();
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE(DespeckleStateTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_speckles_file_is_read_once)
+{
+	QString const dir(tempPath("despeckle-state"));
+	BOOST_REQUIRE(QDir().mkpath(dir));
+	QString const out_file(QDir(dir).filePath("page.tif"));
+	QString const speckles_file(QDir(dir).filePath("speckles/page.tif"));
+	
+	PageId const page_id(ImageId(QDir(dir).filePath("page.png")));
+	QSize const size(64, 48);
+	IntrusivePtr<Settings> const settings(new Settings);
+	IntrusivePtr<OutputWriter> const writer(new OutputWriter(settings));
+	
+	OutputWriter::Job job(page_id, outputImageParams(size), ZoneSet(), ZoneSet());
+	job.setOutputFile(out_file, outputImage(size));
+	job.setSpecklesFile(speckles_file, specklesImage(size));
+	writer->enqueue(job);
+	
+	// Not waiting for the writer here, as resolving the state does that.
+	DespeckleState const state(
+		outputImage(size), speckles_file, writer, page_id, DESPECKLE_NORMAL, dpi
+	);
+	QImage const with_speckles(state.visualize().image());
+	
+	DespeckleState const no_speckles(
+		outputImage(size), BinaryImage(), DESPECKLE_NORMAL, dpi
+	);
+	BOOST_CHECK(with_speckles != no_speckles.visualize().image());
+	
+	BOOST_REQUIRE(QFile::remove(speckles_file));
+	
+	// Copies share what was read the first time.
+	DespeckleState const copy(state);
+	BOOST_CHECK(copy.visualize().image() == with_speckles);
+	BOOST_CHECK(state.visualize().image() == with_speckles);
+	
+	// A state that never read the file sees no speckles.
+	DespeckleState const missing(
+		outputImage(size), speckles_file, writer, page_id, DESPECKLE_NORMAL, dpi
+	);
+	BOOST_CHECK(missing.visualize().image() == no_speckles.visualize().image());
+	
+	removeDirectory(dir);
+}
+
+BOOST_AUTO_TEST_CASE(test_mismatched_speckles_are_ignored)
+{
+	QString const dir(tempPath("despeckle-state-mismatch"));
+	BOOST_REQUIRE(QDir().mkpath(dir));
+	QString const speckles_file(QDir(dir).filePath("speckles.png"));
+	
+	QSize const size(64, 48);
+	BOOST_REQUIRE(specklesImage(QSize(48, 64)).save(speckles_file));
+	
+	PageId const page_id(ImageId(QDir(dir).filePath("page.png")));
+	IntrusivePtr<Settings> const settings(new Settings);
+	IntrusivePtr<OutputWriter> const writer(new OutputWriter(settings));
+	
+	DespeckleState const state(
+		outputImage(size), speckles_file, writer, page_id, DESPECKLE_NORMAL, dpi
+	);
+	DespeckleState const no_speckles(
+		outputImage(size), BinaryImage(), DESPECKLE_NORMAL, dpi
+	);
+	BOOST_CHECK(state.visualize().image() == no_speckles.visualize().image());
+	
+	removeDirectory(dir);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace Tests
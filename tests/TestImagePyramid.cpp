@@ -0,0 +1,154 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ImagePyramid.h"
+#include <QImage>
+#include <QThread>
+#include <QTransform>
+#include <QColor>
+#ifndef Q_MOC_RUN
+#include <boost/test/auto_unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+#endif
+#include <vector>
+#include <stdlib.h>
+
+namespace Tests
+{
+
+namespace
+{
+
+QImage randomImage(int const width, int const height)
+{
+	QImage image(width, height, QImage::Format_RGB32);
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			image.setPixel(x, y, qRgb(rand() & 0xff, rand() & 0xff, rand() & 0xff));
+		}
+	}
+	return image;
+}
+
+class LevelFetcher : public QThread
+{
+public:
+	LevelFetcher(ImagePyramid const& pyramid, int level)
+	: m_rPyramid(pyramid), m_level(level) {}
+
+	QImage const& result() const { return m_result; }
+protected:
+	virtual void run() {
+		m_result = m_rPyramid.level(m_level);
+	}
+private:
+	ImagePyramid const& m_rPyramid;
+	int m_level;
+	QImage m_result;
+};
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE(ImagePyramidTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_level_sizes)
+{
+	ImagePyramid const pyramid(randomImage(1001, 300));
+	
+	// 1001x300 -> 501x150 -> 251x75, after which we would go below 64.
+	BOOST_REQUIRE_EQUAL(pyramid.numLevels(), 3);
+	BOOST_CHECK(pyramid.level(0).size() == QSize(1001, 300));
+	BOOST_CHECK(pyramid.level(1).size() == QSize(501, 150));
+	BOOST_CHECK(pyramid.level(2).size() == QSize(251, 75));
+	
+	QTransform const xform(pyramid.imageToLevel(2));
+	BOOST_CHECK_CLOSE(xform.m11(), 251.0 / 1001.0, 1e-9);
+	BOOST_CHECK_CLOSE(xform.m22(), 75.0 / 300.0, 1e-9);
+}
+
+BOOST_AUTO_TEST_CASE(test_base_level_is_shared)
+{
+	QImage const image(randomImage(200, 200));
+	ImagePyramid const pyramid(image);
+	BOOST_CHECK(pyramid.level(0).cacheKey() == image.cacheKey());
+}
+
+BOOST_AUTO_TEST_CASE(test_select_level)
+{
+	// 1024 -> 512 -> 256 -> 128 -> 64
+	ImagePyramid const pyramid(randomImage(1024, 1024));
+	BOOST_REQUIRE_EQUAL(pyramid.numLevels(), 5);
+	
+	BOOST_CHECK_EQUAL(pyramid.selectLevel(QTransform()), 0);
+	BOOST_CHECK_EQUAL(pyramid.selectLevel(QTransform().scale(2.0, 2.0)), 0);
+	BOOST_CHECK_EQUAL(pyramid.selectLevel(QTransform().scale(0.6, 0.6)), 0);
+	BOOST_CHECK_EQUAL(pyramid.selectLevel(QTransform().scale(0.45, 0.45)), 1);
+	BOOST_CHECK_EQUAL(pyramid.selectLevel(QTransform().scale(0.3, 0.3)), 1);
+	BOOST_CHECK_EQUAL(pyramid.selectLevel(QTransform().scale(0.2, 0.2)), 2);
+	
+	// We never go beyond the last level.
+	BOOST_CHECK_EQUAL(pyramid.selectLevel(QTransform().scale(0.01, 0.01)), 4);
+	
+	// The larger of the two scales decides.
+	BOOST_CHECK_EQUAL(pyramid.selectLevel(QTransform().scale(0.2, 1.0)), 0);
+	
+	// Rotation doesn't affect the scale.
+	BOOST_CHECK_EQUAL(pyramid.selectLevel(QTransform().rotate(30).scale(0.45, 0.45)), 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_concurrent_requests_match_serial_ones)
+{
+	QImage const image(randomImage(800, 600));
+	
+	ImagePyramid const serial(image);
+	std::vector<QImage> expected;
+	for (int i = 0; i < serial.numLevels(); ++i) {
+		expected.push_back(serial.level(i));
+	}
+	
+	ImagePyramid const concurrent(image);
+	int const num_threads = 8;
+	std::vector<LevelFetcher*> fetchers;
+	for (int i = 0; i < num_threads; ++i) {
+		// Threads requesting different levels race building the shared ones.
+		int const level = concurrent.numLevels() - 1 - i % concurrent.numLevels();
+		fetchers.push_back(new LevelFetcher(concurrent, level));
+	}
+	for (int i = 0; i < num_threads; ++i) {
+		fetchers[i]->start();
+	}
+	for (int i = 0; i < num_threads; ++i) {
+		fetchers[i]->wait();
+	}
+	
+	for (int i = 0; i < num_threads; ++i) {
+		int const level = concurrent.numLevels() - 1 - i % concurrent.numLevels();
+		BOOST_CHECK(fetchers[i]->result() == expected[level]);
+		delete fetchers[i];
+	}
+	
+	// Whichever thread won, every level is built exactly once from now on.
+	for (int i = 0; i < concurrent.numLevels(); ++i) {
+		BOOST_CHECK(concurrent.level(i).cacheKey() == concurrent.level(i).cacheKey());
+		BOOST_CHECK(concurrent.level(i) == expected[i]);
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace Tests
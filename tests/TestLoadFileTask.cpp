@@ -0,0 +1,317 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "LoadFileTask.h"
+#include "BackgroundTask.h"
+#include "FilterResult.h"
+#include "ProjectPages.h"
+#include "StageSequence.h"
+#include "PageSequence.h"
+#include "PageInfo.h"
+#include "PageView.h"
+#include "PageSelectionAccessor.h"
+#include "PageSelectionProvider.h"
+#include "ThumbnailPixmapCache.h"
+#include "OutputFileNameGenerator.h"
+#include "FileNameDisambiguator.h"
+#include "ImageFileInfo.h"
+#include "ImageMetadata.h"
+#include "PngMetadataLoader.h"
+#include "CommandLine.h"
+#include "TestUtils.h"
+#include "Utils.h"
+#include "Dpi.h"
+#include "IntrusivePtr.h"
+#include "filters/fix_orientation/Filter.h"
+#include "filters/fix_orientation/Task.h"
+#include "filters/page_split/Filter.h"
+#include "filters/page_split/Task.h"
+#include "filters/deskew/Filter.h"
+#include "filters/deskew/Task.h"
+#include "filters/select_content/Filter.h"
+#include "filters/select_content/Task.h"
+#include "filters/page_layout/Filter.h"
+#include "filters/page_layout/Task.h"
+#include "filters/output/Filter.h"
+#include "filters/output/Task.h"
+#include <QImage>
+#include <QPainter>
+#include <QColor>
+#include <QByteArray>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+#include <vector>
+#ifndef Q_MOC_RUN
+#include <boost/test/auto_unit_test.hpp>
+#endif
+
+namespace Tests
+{
+
+using namespace utils;
+
+namespace
+{
+
+int countFiles(QString const& dir)
+{
+	return QDir(dir).entryList(QDir::Files).size();
+}
+
+/**
+ * Writes a 300 dpi page with a few "text lines" on it.
+ */
+void writePage(QString const& path, QSize const& size)
+{
+	QImage image(size, QImage::Format_RGB32);
+	image.fill(qRgb(0xff, 0xff, 0xff));
+	image.setDotsPerMeterX(11811);
+	image.setDotsPerMeterY(11811);
+	
+	QPainter painter(&image);
+	for (int y = size.height() / 5; y < size.height() * 4 / 5; y += 30) {
+		painter.fillRect(size.width() / 6, y, size.width() * 2 / 3, 12, Qt::black);
+	}
+	painter.end();
+	
+	BOOST_REQUIRE(image.save(path, "PNG"));
+}
+
+/**
+ * Keeps the header of a PNG file, so that its metadata can still be read,
+ * and cuts off most of the image data, so that the image can't be.
+ */
+void damagePage(QString const& path)
+{
+	QFile file(path);
+	BOOST_REQUIRE(file.open(QIODevice::ReadOnly));
+	QByteArray data(file.readAll());
+	file.close();
+	
+	int const idat = data.indexOf("IDAT");
+	BOOST_REQUIRE(idat > 0);
+	data.truncate(idat + 4 + 16);
+	
+	BOOST_REQUIRE(file.open(QIODevice::WriteOnly|QIODevice::Truncate));
+	BOOST_REQUIRE(file.write(data) == data.size());
+}
+
+/**
+ * Processes a single page through all the stages, the way ConsoleBatch
+ * does it.  Settings are kept between the calls to process().
+ *
+ * In command line mode, a successfully processed page produces no result,
+ * while a page that couldn't be loaded produces an error one.
+ */
+class PageProcessor
+{
+public:
+	PageProcessor(QString const& image_path, QSize const& image_size, QString const& out_dir);
+	
+	FilterResultPtr process();
+	
+	QSize storedImageSize() const;
+private:
+	IntrusivePtr<ProjectPages> m_ptrPages;
+	IntrusivePtr<StageSequence> m_ptrStages;
+	IntrusivePtr<ThumbnailPixmapCache> m_ptrThumbnailCache;
+	OutputFileNameGenerator m_outFileNameGen;
+};
+
+PageProcessor::PageProcessor(
+	QString const& image_path, QSize const& image_size, QString const& out_dir)
+{
+	std::vector<ImageMetadata> metadata;
+	metadata.push_back(ImageMetadata(image_size, Dpi(300, 300)));
+	std::vector<ImageFileInfo> images;
+	images.push_back(ImageFileInfo(QFileInfo(image_path), metadata));
+	
+	m_ptrPages.reset(new ProjectPages(images, ProjectPages::ONE_PAGE, Qt::LeftToRight));
+	
+	PageSelectionAccessor const accessor((IntrusivePtr<PageSelectionProvider>()));
+	m_ptrStages.reset(new StageSequence(m_ptrPages, accessor));
+	
+	m_ptrThumbnailCache = Utils::createThumbnailCache(out_dir);
+	m_outFileNameGen = OutputFileNameGenerator(
+		IntrusivePtr<FileNameDisambiguator>(new FileNameDisambiguator),
+		out_dir, Qt::LeftToRight
+	);
+}
+
+FilterResultPtr
+PageProcessor::process()
+{
+	PageInfo const page(m_ptrPages->toPageSequence(PAGE_VIEW).pageAt(0));
+	bool const batch = true;
+	bool const debug = false;
+	
+	IntrusivePtr<output::Task> const output_task(
+		m_ptrStages->outputFilter()->createTask(
+			page.id(), m_ptrThumbnailCache, m_outFileNameGen, batch, debug
+		)
+	);
+	IntrusivePtr<page_layout::Task> const page_layout_task(
+		m_ptrStages->pageLayoutFilter()->createTask(page.id(), output_task, batch, debug)
+	);
+	IntrusivePtr<select_content::Task> const select_content_task(
+		m_ptrStages->selectContentFilter()->createTask(page.id(), page_layout_task, batch, debug)
+	);
+	IntrusivePtr<deskew::Task> const deskew_task(
+		m_ptrStages->deskewFilter()->createTask(page.id(), select_content_task, batch, debug)
+	);
+	IntrusivePtr<page_split::Task> const page_split_task(
+		m_ptrStages->pageSplitFilter()->createTask(page, deskew_task, batch, debug)
+	);
+	IntrusivePtr<fix_orientation::Task> const fix_orientation_task(
+		m_ptrStages->fixOrientationFilter()->createTask(page.id(), page_split_task, batch)
+	);
+	
+	BackgroundTaskPtr const task(
+		new LoadFileTask(
+			BackgroundTask::BATCH, page, m_ptrThumbnailCache,
+			m_ptrPages, fix_orientation_task
+		)
+	);
+	return (*task)();
+}
+
+QSize
+PageProcessor::storedImageSize() const
+{
+	return m_ptrPages->toPageSequence(IMAGE_VIEW).pageAt(0).metadata().size();
+}
+
+/**
+ * Creates the directory layout ConsoleBatch would use.
+ */
+void setUp(QString const& dir, QString& image_path, QString& out_dir, QString& thumb_dir)
+{
+	// Filters don't create their GUI parts in command line mode.
+	if (CommandLine::get().isGui()) {
+		CommandLine::set(CommandLine(QStringList(), false));
+	}
+	PngMetadataLoader::registerMyself();
+	
+	image_path = QDir(dir).filePath("page.png");
+	out_dir = QDir(dir).filePath("out");
+	thumb_dir = Utils::outputDirToThumbDir(out_dir);
+	BOOST_REQUIRE(QDir().mkpath(thumb_dir));
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE(LoadFileTaskTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_up_to_date_page_is_not_loaded)
+{
+	QString const dir(tempPath("lazy-load"));
+	QString image_path, out_dir, thumb_dir;
+	setUp(dir, image_path, out_dir, thumb_dir);
+	
+	QSize const size(600, 800);
+	writePage(image_path, size);
+	
+	PageProcessor processor(image_path, size, out_dir);
+	BOOST_CHECK(!processor.process());
+	BOOST_CHECK(countFiles(out_dir) == 1);
+	BOOST_CHECK(countFiles(thumb_dir) == 1);
+	
+	// Every stage is up to date, so a page that can't be decoded
+	// is processed without an error.
+	damagePage(image_path);
+	BOOST_CHECK(!processor.process());
+	
+	removeDirectory(dir);
+}
+
+BOOST_AUTO_TEST_CASE(test_missing_thumbnail_is_created)
+{
+	QString const dir(tempPath("lazy-load-thumbnail"));
+	QString image_path, out_dir, thumb_dir;
+	setUp(dir, image_path, out_dir, thumb_dir);
+	
+	QSize const size(600, 800);
+	writePage(image_path, size);
+	
+	PageProcessor processor(image_path, size, out_dir);
+	BOOST_CHECK(!processor.process());
+	
+	removeDirectory(thumb_dir);
+	BOOST_REQUIRE(QDir().mkpath(thumb_dir));
+	
+	// The thumbnail is made from the image, so it has to be loaded
+	// even though every stage is up to date.
+	BOOST_CHECK(!processor.process());
+	BOOST_CHECK(countFiles(thumb_dir) == 1);
+	
+	removeDirectory(dir);
+}
+
+BOOST_AUTO_TEST_CASE(test_resized_image_is_detected_before_processing)
+{
+	QString const dir(tempPath("lazy-load-resized"));
+	QString image_path, out_dir, thumb_dir;
+	setUp(dir, image_path, out_dir, thumb_dir);
+	
+	QSize const old_size(600, 800);
+	QSize const new_size(800, 600);
+	writePage(image_path, old_size);
+	
+	PageProcessor processor(image_path, old_size, out_dir);
+	BOOST_CHECK(!processor.process());
+	
+	writePage(image_path, new_size);
+	BOOST_CHECK(!processor.process());
+	BOOST_CHECK(processor.storedImageSize() == new_size);
+	
+	// No stage was left with results for the old size, so once again
+	// the page is up to date and doesn't need to be decoded.
+	damagePage(image_path);
+	BOOST_CHECK(!processor.process());
+	
+	removeDirectory(dir);
+}
+
+BOOST_AUTO_TEST_CASE(test_damaged_image_is_an_error)
+{
+	QString const dir(tempPath("lazy-load-damaged"));
+	QString image_path, out_dir, thumb_dir;
+	setUp(dir, image_path, out_dir, thumb_dir);
+	
+	QSize const size(600, 800);
+	writePage(image_path, size);
+	
+	// Creates the thumbnail.
+	BOOST_CHECK(!PageProcessor(image_path, size, out_dir).process());
+	
+	// The header matches and the thumbnail exists, so the loading
+	// is deferred, but with fresh settings the first stage needs
+	// the image, which can't be decoded.
+	damagePage(image_path);
+	BOOST_CHECK(PageProcessor(image_path, size, out_dir).process());
+	
+	removeDirectory(dir);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace Tests
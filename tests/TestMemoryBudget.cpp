@@ -0,0 +1,354 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "MemoryBudget.h"
+#include <QThread>
+#include <QAtomicInt>
+#ifndef Q_MOC_RUN
+#include <boost/test/auto_unit_test.hpp>
+#endif
+#include <string.h>
+#include <stddef.h>
+
+namespace Tests
+{
+
+namespace
+{
+
+size_t const MB = 1024 * 1024;
+
+/**
+ * MemoryBudget is a singleton, so each test restores its settings.
+ */
+class BudgetSettingsRestorer
+{
+public:
+	BudgetSettingsRestorer()
+	:	m_limit(MemoryBudget::instance().limit()),
+		m_spillThreshold(MemoryBudget::instance().spillThreshold())
+	{
+	}
+
+	~BudgetSettingsRestorer()
+	{
+		MemoryBudget::instance().setLimit(m_limit);
+		MemoryBudget::instance().setSpillThreshold(m_spillThreshold);
+	}
+private:
+	qint64 m_limit;
+	size_t m_spillThreshold;
+};
+
+/**
+ * Starts a task, the way the scheduler would.
+ */
+class AdmittedTask : public QThread
+{
+public:
+	bool admitted() const { return m_admitted.fetchAndAddAcquire(0) != 0; }
+protected:
+	virtual void run() {
+		MemoryBudget::Admission const admission;
+		m_admitted.fetchAndStoreRelease(1);
+	}
+private:
+	mutable QAtomicInt m_admitted;
+};
+
+class Allocator : public QThread
+{
+protected:
+	virtual void run() {
+		MemoryBudget::instance().deallocate(MemoryBudget::instance().allocate(MB));
+	}
+};
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE(MemoryBudgetTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_arena_recycles_buffers)
+{
+	MemoryBudget& budget = MemoryBudget::instance();
+	qint64 const used_before = budget.used();
+
+	{
+		MemoryBudget::ScratchArena const arena;
+
+		void* const first = budget.allocate(MB);
+		budget.deallocate(first);
+
+		// A kept buffer still takes memory.
+		BOOST_CHECK_EQUAL(budget.used(), used_before + qint64(MB));
+
+		// A slightly smaller request gets the kept buffer.
+		void* const second = budget.allocate(MB - 4096);
+		BOOST_CHECK(second == first);
+		BOOST_CHECK_EQUAL(budget.used(), used_before + qint64(MB));
+
+		// One that would waste too much of it doesn't.
+		budget.deallocate(second);
+		void* const small = budget.allocate(MB / 2);
+		BOOST_CHECK(small != first);
+		BOOST_CHECK_EQUAL(budget.used(), used_before + qint64(MB + MB / 2));
+		budget.deallocate(small);
+	}
+
+	// Kept buffers are released along with the arena.
+	BOOST_CHECK_EQUAL(budget.used(), used_before);
+}
+
+BOOST_AUTO_TEST_CASE(test_arena_ignores_small_buffers)
+{
+	MemoryBudget& budget = MemoryBudget::instance();
+	qint64 const used_before = budget.used();
+
+	MemoryBudget::ScratchArena const arena;
+	void* const addr = budget.allocate(1024);
+	budget.deallocate(addr);
+	BOOST_CHECK_EQUAL(budget.used(), used_before);
+}
+
+BOOST_AUTO_TEST_CASE(test_arena_peak_bytes)
+{
+	MemoryBudget& budget = MemoryBudget::instance();
+
+	// Allocated before the arena, so not counted.
+	void* const outer = budget.allocate(MB);
+
+	qint64 peak = 0;
+	{
+		MemoryBudget::ScratchArena arena;
+
+		void* const a = budget.allocate(2 * MB);
+		void* const b = budget.allocate(MB);
+		budget.deallocate(a);
+		budget.deallocate(b);
+		budget.deallocate(budget.allocate(2 * MB)); // Recycled.
+		budget.deallocate(outer);
+
+		peak = arena.peakBytes();
+	}
+
+	BOOST_CHECK_EQUAL(peak, qint64(3 * MB));
+	BOOST_CHECK(budget.peakTaskBytes() >= peak);
+}
+
+BOOST_AUTO_TEST_CASE(test_arena_nesting)
+{
+	MemoryBudget& budget = MemoryBudget::instance();
+	qint64 const used_before = budget.used();
+
+	MemoryBudget::ScratchArena const outer;
+	void* const addr = budget.allocate(MB);
+	budget.deallocate(addr); // Kept by the outer arena.
+	{
+		MemoryBudget::ScratchArena const inner;
+		void* const other = budget.allocate(MB);
+		BOOST_CHECK(other != addr);
+		budget.deallocate(other);
+	}
+	BOOST_CHECK_EQUAL(budget.used(), used_before + qint64(MB));
+	BOOST_CHECK(budget.allocate(MB) == addr);
+	budget.deallocate(addr);
+}
+
+BOOST_AUTO_TEST_CASE(test_kept_buffers_dont_cause_spilling)
+{
+	BudgetSettingsRestorer const restorer;
+	MemoryBudget& budget = MemoryBudget::instance();
+	qint64 const used_before = budget.used();
+	qint64 const spilled_before = budget.spilled();
+
+	budget.setSpillThreshold(MB);
+	budget.setLimit(used_before + 3 * MB);
+
+	{
+		MemoryBudget::ScratchArena const arena;
+		budget.deallocate(budget.allocate(2 * MB));
+		BOOST_CHECK_EQUAL(budget.used(), used_before + qint64(2 * MB));
+
+		// Too small for the kept buffer to be reused, and too large to fit
+		// into the budget next to it.  The kept buffer has to go instead.
+		void* const addr = budget.allocate(3 * MB / 2);
+		BOOST_CHECK_EQUAL(budget.spilled(), spilled_before);
+		BOOST_CHECK_EQUAL(budget.used(), used_before + qint64(3 * MB / 2));
+		budget.deallocate(addr);
+	}
+
+	BOOST_CHECK_EQUAL(budget.used(), used_before);
+}
+
+BOOST_AUTO_TEST_CASE(test_spill_threshold)
+{
+	BudgetSettingsRestorer const restorer;
+	MemoryBudget& budget = MemoryBudget::instance();
+	qint64 const used_before = budget.used();
+	qint64 const spilled_before = budget.spilled();
+
+	budget.setLimit(used_before + MB);
+	budget.setSpillThreshold(4 * MB);
+
+	// Over the budget, but below the spill threshold.
+	void* const addr = budget.allocate(2 * MB);
+	BOOST_CHECK_EQUAL(budget.used(), used_before + qint64(2 * MB));
+	BOOST_CHECK_EQUAL(budget.spilled(), spilled_before);
+	budget.deallocate(addr);
+
+	// Within the budget and above the threshold.
+	budget.setLimit(used_before + 16 * MB);
+	void* const addr2 = budget.allocate(8 * MB);
+	BOOST_CHECK_EQUAL(budget.used(), used_before + qint64(8 * MB));
+	BOOST_CHECK_EQUAL(budget.spilled(), spilled_before);
+	budget.deallocate(addr2);
+
+	BOOST_CHECK_EQUAL(budget.used(), used_before);
+}
+
+BOOST_AUTO_TEST_CASE(test_spilled_allocation)
+{
+	BudgetSettingsRestorer const restorer;
+	MemoryBudget& budget = MemoryBudget::instance();
+	qint64 const used_before = budget.used();
+	qint64 const spilled_before = budget.spilled();
+	qint64 const total_before = budget.totalAllocated();
+
+	budget.setLimit(used_before + MB);
+	budget.setSpillThreshold(MB);
+
+	size_t const size = 3 * MB + 5;
+	unsigned char* const data = static_cast<unsigned char*>(budget.allocate(size));
+	BOOST_REQUIRE(data);
+	BOOST_CHECK_EQUAL(budget.used(), used_before);
+	BOOST_CHECK_EQUAL(budget.spilled(), spilled_before + qint64(size));
+	BOOST_CHECK_EQUAL(budget.totalAllocated(), total_before + qint64(size));
+	BOOST_CHECK_EQUAL(reinterpret_cast<size_t>(data) % sizeof(double), 0u);
+
+	// The memory is fully usable.
+	memset(data, 0xA5, size);
+	BOOST_CHECK_EQUAL(int(data[0]), 0xA5);
+	BOOST_CHECK_EQUAL(int(data[size - 1]), 0xA5);
+
+	budget.deallocate(data);
+	BOOST_CHECK_EQUAL(budget.spilled(), spilled_before);
+}
+
+BOOST_AUTO_TEST_CASE(test_admission_waits_for_memory)
+{
+	BudgetSettingsRestorer const restorer;
+	MemoryBudget& budget = MemoryBudget::instance();
+
+	budget.setSpillThreshold(64 * MB);
+	budget.setLimit(budget.used() + MB);
+
+	MemoryBudget::Admission const running_task;
+	void* const addr = budget.allocate(2 * MB); // Exhausts the budget.
+
+	AdmittedTask waiting_task;
+	waiting_task.start();
+	BOOST_CHECK(!waiting_task.wait(200));
+	BOOST_CHECK(!waiting_task.admitted());
+
+	// Releasing the memory lets the waiting task in.
+	budget.deallocate(addr);
+	BOOST_REQUIRE(waiting_task.wait(10000));
+	BOOST_CHECK(waiting_task.admitted());
+}
+
+BOOST_AUTO_TEST_CASE(test_reserved_memory_delays_admission)
+{
+	BudgetSettingsRestorer const restorer;
+	MemoryBudget& budget = MemoryBudget::instance();
+
+	qint64 const used_before = budget.used();
+	budget.setLimit(used_before + MB);
+
+	MemoryBudget::Admission const running_task;
+	budget.reserve(2 * MB);
+	BOOST_CHECK_EQUAL(budget.used(), used_before + qint64(2 * MB));
+
+	AdmittedTask waiting_task;
+	waiting_task.start();
+	BOOST_CHECK(!waiting_task.wait(200));
+	BOOST_CHECK(!waiting_task.admitted());
+
+	budget.unreserve(2 * MB);
+	BOOST_REQUIRE(waiting_task.wait(10000));
+	BOOST_CHECK(waiting_task.admitted());
+	BOOST_CHECK_EQUAL(budget.used(), used_before);
+}
+
+BOOST_AUTO_TEST_CASE(test_lone_task_is_admitted)
+{
+	BudgetSettingsRestorer const restorer;
+	MemoryBudget& budget = MemoryBudget::instance();
+
+	budget.setSpillThreshold(64 * MB);
+	budget.setLimit(budget.used() + MB);
+	void* const addr = budget.allocate(2 * MB);
+
+	// Nobody else is running to release memory, so waiting would be forever.
+	AdmittedTask task;
+	task.start();
+	BOOST_REQUIRE(task.wait(10000));
+	BOOST_CHECK(task.admitted());
+
+	budget.deallocate(addr);
+}
+
+BOOST_AUTO_TEST_CASE(test_allocated_by_this_thread)
+{
+	MemoryBudget& budget = MemoryBudget::instance();
+	qint64 const mine_before = budget.allocatedByThisThread();
+	qint64 const total_before = budget.totalAllocated();
+
+	Allocator other_thread;
+	other_thread.start();
+	BOOST_REQUIRE(other_thread.wait(10000));
+	budget.deallocate(budget.allocate(2 * MB));
+
+	BOOST_CHECK_EQUAL(budget.allocatedByThisThread(), mine_before + qint64(2 * MB));
+	BOOST_CHECK_EQUAL(budget.totalAllocated(), total_before + qint64(3 * MB));
+}
+
+BOOST_AUTO_TEST_CASE(test_reservation)
+{
+	MemoryBudget& budget = MemoryBudget::instance();
+	qint64 const used_before = budget.used();
+
+	{
+		MemoryBudget::Reservation reservation(2 * MB);
+		BOOST_CHECK_EQUAL(budget.used(), used_before + qint64(2 * MB));
+
+		reservation.reset(MB / 2);
+		BOOST_CHECK_EQUAL(budget.used(), used_before + qint64(MB / 2));
+		BOOST_CHECK_EQUAL(reservation.bytes(), qint64(MB / 2));
+
+		reservation.reset();
+		BOOST_CHECK_EQUAL(budget.used(), used_before);
+
+		reservation.reset(MB);
+	}
+
+	BOOST_CHECK_EQUAL(budget.used(), used_before);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace Tests
@@ -0,0 +1,179 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "filters/output/OutputWriter.h"
+#include "filters/output/Settings.h"
+#include "filters/output/OutputParams.h"
+#include "filters/output/OutputFileParams.h"
+#include "filters/output/OutputImageParams.h"
+#include "filters/output/ColorParams.h"
+#include "filters/output/DewarpingMode.h"
+#include "filters/output/DepthPerception.h"
+#include "filters/output/DespeckleLevel.h"
+#include "dewarping/DistortionModel.h"
+#include "ImageTransformation.h"
+#include "MemoryBudget.h"
+#include "TestUtils.h"
+#include "ZoneSet.h"
+#include "PageId.h"
+#include "ImageId.h"
+#include "Dpi.h"
+#include "IntrusivePtr.h"
+#include <QImage>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QRect>
+#include <QRectF>
+#include <QSize>
+#include <QString>
+#include <memory>
+#ifndef Q_MOC_RUN
+#include <boost/test/auto_unit_test.hpp>
+#endif
+
+namespace Tests
+{
+
+using namespace output;
+using namespace utils;
+
+namespace
+{
+
+OutputImageParams outputImageParams(QSize const& size)
+{
+	Dpi const dpi(300, 300);
+	return OutputImageParams(
+		size, QRect(QPoint(0, 0), size),
+		ImageTransformation(QRectF(QPoint(0, 0), size), dpi), dpi,
+		ColorParams(), DewarpingMode(), dewarping::DistortionModel(),
+		DepthPerception(), DESPECKLE_OFF
+	);
+}
+
+QImage blankImage(QSize const& size)
+{
+	QImage image(size, QImage::Format_Mono);
+	image.setNumColors(2);
+	image.setColor(0, 0xffffffff);
+	image.setColor(1, 0xff000000);
+	image.fill(0);
+	return image;
+}
+
+bool writeFile(QString const& path)
+{
+	QFile file(path);
+	return file.open(QIODevice::WriteOnly) && file.write("x", 1) == 1;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE(OutputWriterTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_params_are_committed_after_writing)
+{
+	QString const dir(tempPath("output-writer"));
+	BOOST_REQUIRE(QDir().mkpath(dir));
+	QString const out_file(QDir(dir).filePath("page.tif"));
+	QString const obsolete_file(QDir(dir).filePath("page_1L.tif"));
+	BOOST_REQUIRE(writeFile(obsolete_file));
+	
+	PageId const page_id(ImageId(QDir(dir).filePath("page.png")));
+	QSize const size(64, 48);
+	IntrusivePtr<Settings> const settings(new Settings);
+	IntrusivePtr<OutputWriter> const writer(new OutputWriter(settings));
+	
+	OutputWriter::Job job(page_id, outputImageParams(size), ZoneSet(), ZoneSet());
+	job.setOutputFile(out_file, blankImage(size));
+	job.addObsoleteFile(obsolete_file);
+	writer->enqueue(job);
+	writer->waitForPage(page_id);
+	
+	BOOST_CHECK(!writer->pendingOutputParams(page_id).get());
+	
+	std::auto_ptr<OutputParams> const params(settings->getOutputParams(page_id));
+	BOOST_REQUIRE(params.get());
+	BOOST_CHECK(params->outputFileParams().matches(OutputFileParams(QFileInfo(out_file))));
+	BOOST_CHECK(params->outputImageParams().matches(outputImageParams(size)));
+	
+	// Removed only after the new file was written.
+	BOOST_CHECK(!QFile::exists(obsolete_file));
+	
+	removeDirectory(dir);
+}
+
+BOOST_AUTO_TEST_CASE(test_failed_job_keeps_obsolete_files)
+{
+	QString const dir(tempPath("output-writer-failure"));
+	BOOST_REQUIRE(QDir().mkpath(dir));
+	QString const out_file(QDir(dir).filePath("missing/page.tif"));
+	QString const obsolete_file(QDir(dir).filePath("page_1L.tif"));
+	BOOST_REQUIRE(writeFile(obsolete_file));
+	
+	PageId const page_id(ImageId(QDir(dir).filePath("page.png")));
+	QSize const size(64, 48);
+	IntrusivePtr<Settings> const settings(new Settings);
+	IntrusivePtr<OutputWriter> const writer(new OutputWriter(settings));
+	
+	OutputWriter::Job job(page_id, outputImageParams(size), ZoneSet(), ZoneSet());
+	job.setOutputFile(out_file, blankImage(size));
+	job.addObsoleteFile(obsolete_file);
+	writer->enqueue(job);
+	writer->waitForPage(page_id);
+	
+	// The page will be reprocessed, and its old files are still there.
+	BOOST_CHECK(!settings->getOutputParams(page_id).get());
+	BOOST_CHECK(QFile::exists(obsolete_file));
+	
+	removeDirectory(dir);
+}
+
+BOOST_AUTO_TEST_CASE(test_queued_images_are_in_memory_budget)
+{
+	QString const dir(tempPath("output-writer-budget"));
+	BOOST_REQUIRE(QDir().mkpath(dir));
+	
+	MemoryBudget& budget = MemoryBudget::instance();
+	qint64 const used_before = budget.used();
+	
+	IntrusivePtr<Settings> const settings(new Settings);
+	IntrusivePtr<OutputWriter> const writer(new OutputWriter(settings));
+	
+	QSize const size(1024, 1024);
+	for (int i = 0; i < 4; ++i) {
+		QString const name(QString("page%1").arg(i));
+		PageId const page_id(ImageId(QDir(dir).filePath(name + ".png")));
+		OutputWriter::Job job(page_id, outputImageParams(size), ZoneSet(), ZoneSet());
+		job.setOutputFile(QDir(dir).filePath(name + ".tif"), blankImage(size));
+		writer->enqueue(job);
+		
+		// Jobs already written are no longer accounted for.
+		BOOST_CHECK(budget.used() <= used_before + (i + 1) * job.bytes());
+	}
+	
+	writer->waitForIdle();
+	BOOST_CHECK_EQUAL(budget.used(), used_before);
+	
+	removeDirectory(dir);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace Tests
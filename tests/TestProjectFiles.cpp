@@ -0,0 +1,431 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ProjectReader.h"
+#include "ProjectWriter.h"
+#include "ProjectIndex.h"
+#include "ProjectPages.h"
+#include "OutputFileNameGenerator.h"
+#include "FileNameDisambiguator.h"
+#include "XmlStreamUtils.h"
+#include "XmlFragmentCache.h"
+#include "PageSequence.h"
+#include "PageView.h"
+#include "PageSelectionAccessor.h"
+#include "PageSelectionProvider.h"
+#include "SelectedPage.h"
+#include "CommandLine.h"
+#include "IntrusivePtr.h"
+#include "filters/fix_orientation/Filter.h"
+#include "filters/deskew/Filter.h"
+#include <QCoreApplication>
+#include <QDomDocument>
+#include <QDomElement>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+#include <QByteArray>
+#include <QBuffer>
+#include <QString>
+#include <QStringList>
+#include <QLatin1String>
+#include <QFile>
+#include <QDir>
+#include <vector>
+#ifndef Q_MOC_RUN
+#include <boost/test/auto_unit_test.hpp>
+#endif
+
+namespace Tests
+{
+
+namespace
+{
+
+QString tempFilePath(QString const& name)
+{
+	return QDir::temp().filePath(
+		QString("scantailor-test-%1-%2").arg(QCoreApplication::applicationPid()).arg(name)
+	);
+}
+
+bool writeFile(QString const& path, QByteArray const& data)
+{
+	QFile file(path);
+	return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+
+QByteArray readFile(QString const& path)
+{
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return QByteArray();
+	}
+	return file.readAll();
+}
+
+bool sameContent(QByteArray doc1, QByteArray doc2)
+{
+	QBuffer buf1(&doc1);
+	QBuffer buf2(&doc2);
+	buf1.open(QIODevice::ReadOnly);
+	buf2.open(QIODevice::ReadOnly);
+	return XmlStreamUtils::sameContent(buf1, buf2);
+}
+
+/**
+ * A project the way the DOM-based writer of older versions
+ * would produce it: no XML declaration, attributes in no particular
+ * order, a different indentation.
+ */
+QByteArray legacyProject(QString const& dir, QString const& filters = QString())
+{
+	return QString(
+		"<project layoutDirection=\"LTR\" outputDirectory=\"%1/out\">\n"
+		" <directories>\n"
+		"  <directory path=\"%1\" id=\"1\"/>\n"
+		" </directories>\n"
+		" <files>\n"
+		"  <file name=\"a.png\" dirId=\"1\" id=\"2\"/>\n"
+		"  <file name=\"b.png\" dirId=\"1\" id=\"5\"/>\n"
+		" </files>\n"
+		" <images>\n"
+		"  <image subPages=\"1\" fileImage=\"0\" fileId=\"2\" id=\"3\">\n"
+		"   <size height=\"3000\" width=\"2000\"/>\n"
+		"   <dpi vertical=\"300\" horizontal=\"300\"/>\n"
+		"  </image>\n"
+		"  <image fileId=\"5\" id=\"6\" subPages=\"1\" fileImage=\"0\">\n"
+		"   <size width=\"2100\" height=\"3100\"/>\n"
+		"   <dpi horizontal=\"600\" vertical=\"600\"/>\n"
+		"  </image>\n"
+		" </images>\n"
+		" <pages>\n"
+		"  <page subPage=\"single\" imageId=\"3\" id=\"4\"/>\n"
+		"  <page selected=\"selected\" subPage=\"single\" imageId=\"6\" id=\"7\"/>\n"
+		" </pages>\n"
+		" <file-name-disambiguation/>\n"
+		" <filters>%2</filters>\n"
+		"</project>\n"
+	).arg(dir, filters).toUtf8();
+}
+
+/**
+ * Settings of two filters, one keeping them per image and the other per page.
+ */
+QString legacyFilterSettings()
+{
+	return QString(
+		"<fix-orientation>\n"
+		" <image id=\"6\"><rotation degrees=\"90\"/></image>\n"
+		" <image id=\"3\"><rotation degrees=\"270\"/></image>\n"
+		"</fix-orientation>\n"
+		"<deskew>\n"
+		" <page id=\"4\">\n"
+		"  <params mode=\"auto\" angle=\"-0.5\">\n"
+		"   <dependencies>\n"
+		"    <page-outline><point x=\"0\" y=\"0\"/><point x=\"3000\" y=\"2000\"/></page-outline>\n"
+		"    <rotation degrees=\"270\"/>\n"
+		"   </dependencies>\n"
+		"  </params>\n"
+		" </page>\n"
+		" <page id=\"7\">\n"
+		"  <params angle=\"1.25\" mode=\"manual\">\n"
+		"   <dependencies><rotation degrees=\"90\"/><page-outline/></dependencies>\n"
+		"  </params>\n"
+		" </page>\n"
+		"</deskew>\n"
+	);
+}
+
+/**
+ * Filters don't create their GUI parts in command line mode.
+ */
+std::vector<ProjectWriter::FilterPtr> createFilters()
+{
+	if (CommandLine::get().isGui()) {
+		CommandLine::set(CommandLine(QStringList(), false));
+	}
+
+	PageSelectionAccessor const accessor((IntrusivePtr<PageSelectionProvider>()));
+	std::vector<ProjectWriter::FilterPtr> filters;
+	filters.push_back(ProjectWriter::FilterPtr(new fix_orientation::Filter(accessor)));
+	filters.push_back(ProjectWriter::FilterPtr(new deskew::Filter(accessor)));
+	return filters;
+}
+
+bool writeProject(
+	ProjectReader const& reader, QString const& path,
+	std::vector<ProjectWriter::FilterPtr> const& filters =
+		std::vector<ProjectWriter::FilterPtr>(), bool with_index = false)
+{
+	OutputFileNameGenerator const gen(
+		reader.namingDisambiguator(), reader.outputDirectory(),
+		reader.pages()->layoutDirection()
+	);
+	ProjectWriter const writer(reader.pages(), reader.selectedPage(), gen);
+	return writer.write(path, filters, with_index);
+}
+
+/**
+ * Checks that every filter section of the project file is reproduced
+ * by its index.  Returns the number of sections checked.
+ */
+int checkIndexMatchesProject(QString const& project_path)
+{
+	IntrusivePtr<ProjectIndex> const index(
+		ProjectIndex::open(ProjectIndex::indexPathFor(project_path), project_path)
+	);
+	BOOST_REQUIRE(index.get());
+
+	QByteArray const project(readFile(project_path));
+	QXmlStreamReader xml(project);
+	BOOST_REQUIRE(xml.readNextStartElement());
+
+	int num_sections = 0;
+	while (xml.readNextStartElement()) {
+		if (xml.name() != QLatin1String("filters")) {
+			xml.skipCurrentElement();
+			continue;
+		}
+		while (xml.readNextStartElement()) {
+			ProjectIndexSection const* section = index->section(xml.name().toString());
+			BOOST_REQUIRE(section);
+			BOOST_CHECK(sameContent(XmlStreamUtils::copyElement(xml), section->toXml()));
+			++num_sections;
+		}
+	}
+	BOOST_CHECK(!xml.hasError());
+
+	return num_sections;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE(ProjectFilesTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_same_content_ignores_formatting)
+{
+	QByteArray const doc(
+		"<a x=\"1\" y=\"2\">\n  <b>text</b>\n  <c/>\n</a>\n"
+	);
+	BOOST_CHECK(sameContent(doc, doc));
+	BOOST_CHECK(
+		sameContent(
+			doc, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+			"<a y=\"2\" x=\"1\"><!-- comment --><b>text</b><c></c></a>"
+		)
+	);
+	BOOST_CHECK(!sameContent(doc, "<a x=\"1\" y=\"3\"><b>text</b><c/></a>"));
+	BOOST_CHECK(!sameContent(doc, "<a x=\"1\"><b>text</b><c/></a>"));
+	BOOST_CHECK(!sameContent(doc, "<a x=\"1\" y=\"2\"><b>text2</b><c/></a>"));
+	BOOST_CHECK(!sameContent(doc, "<a x=\"1\" y=\"2\"><b>text</b><d/></a>"));
+	BOOST_CHECK(!sameContent(doc, "<a x=\"1\" y=\"2\"><b>text</b></a>"));
+	BOOST_CHECK(!sameContent(doc, "<a x=\"1\" y=\"2\"><b>text</b><c/>"));
+}
+
+BOOST_AUTO_TEST_CASE(test_fragment_writes_like_dom)
+{
+	QDomDocument doc;
+	QDomElement el(doc.createElement("page"));
+	el.setAttribute("id", 5);
+	el.setAttribute("note", "a < b & \"c\"");
+	QDomElement child(doc.createElement("params"));
+	child.appendChild(doc.createTextNode("text"));
+	el.appendChild(child);
+	el.appendChild(doc.createElement("empty"));
+
+	QByteArray expected;
+	{
+		QBuffer buffer(&expected);
+		buffer.open(QIODevice::WriteOnly);
+		QXmlStreamWriter writer(&buffer);
+		XmlStreamUtils::writeElement(writer, el);
+	}
+
+	XmlFragment const fragment(el);
+	BOOST_REQUIRE(!fragment.isNull());
+	BOOST_CHECK(fragment.toByteArray() == expected);
+
+	QXmlStreamReader reader(expected);
+	BOOST_REQUIRE(reader.readNextStartElement());
+	BOOST_CHECK(XmlStreamUtils::copyElement(reader) == expected);
+
+	BOOST_CHECK(XmlFragment(QDomElement()).isNull());
+	BOOST_CHECK(XmlFragment().toByteArray().isEmpty());
+}
+
+BOOST_AUTO_TEST_CASE(test_fragment_cache)
+{
+	QDomDocument doc;
+	QDomElement el(doc.createElement("image"));
+	el.setAttribute("id", 3);
+	el.appendChild(doc.createElement("rotation"));
+
+	ProjectWriter const writer(
+		IntrusivePtr<ProjectPages>(new ProjectPages), SelectedPage(),
+		OutputFileNameGenerator()
+	);
+	XmlFragmentCache<int> cache;
+	QByteArray first;
+	QByteArray second;
+	{
+		QBuffer buffer(&first);
+		buffer.open(QIODevice::WriteOnly);
+		QXmlStreamWriter xml(&buffer);
+		BOOST_CHECK(!cache.writeCached(writer, xml, 1, 3, 7));
+		cache.writeAndCache(writer, xml, 1, 3, 7, el);
+	}
+	{
+		QBuffer buffer(&second);
+		buffer.open(QIODevice::WriteOnly);
+		QXmlStreamWriter xml(&buffer);
+		BOOST_CHECK(!cache.writeCached(writer, xml, 1, 3, 8)); // A newer revision.
+		BOOST_CHECK(!cache.writeCached(writer, xml, 1, 4, 7)); // A different id.
+		BOOST_CHECK(!cache.writeCached(writer, xml, 2, 3, 7)); // A different key.
+		BOOST_CHECK(cache.writeCached(writer, xml, 1, 3, 7));
+	}
+	BOOST_CHECK(!first.isEmpty());
+	BOOST_CHECK(first == second);
+}
+
+BOOST_AUTO_TEST_CASE(test_project_round_trip)
+{
+	QString const dir(QDir::temp().absolutePath());
+	QString const legacy_path(tempFilePath("legacy.ScanTailor"));
+	QString const written_path(tempFilePath("written.ScanTailor"));
+	QString const rewritten_path(tempFilePath("rewritten.ScanTailor"));
+
+	BOOST_REQUIRE(writeFile(legacy_path, legacyProject(dir)));
+
+	// read -> write
+	ProjectReader const reader(legacy_path);
+	BOOST_REQUIRE(reader.success());
+	BOOST_CHECK(reader.outputDirectory() == dir + "/out");
+	BOOST_CHECK_EQUAL(reader.pages()->toPageSequence(PAGE_VIEW).numPages(), 2u);
+	BOOST_REQUIRE(writeProject(reader, written_path));
+
+	// An unchanged project must compare equal to what it was read from,
+	// or closing it would ask to save changes that were never made.
+	QByteArray const written(readFile(written_path));
+	BOOST_CHECK(sameContent(readFile(legacy_path), written));
+	BOOST_CHECK(!written.startsWith("<?xml"));
+
+	// read -> write again
+	ProjectReader const reader2(written_path);
+	BOOST_REQUIRE(reader2.success());
+	BOOST_CHECK(reader2.outputDirectory() == reader.outputDirectory());
+	BOOST_CHECK(
+		reader2.selectedPage().get(PAGE_VIEW) == reader.selectedPage().get(PAGE_VIEW)
+	);
+	BOOST_CHECK(!reader2.selectedPage().isNull());
+	BOOST_REQUIRE(writeProject(reader2, rewritten_path));
+
+	// Once written by us, the output is stable byte for byte.
+	BOOST_CHECK(readFile(rewritten_path) == written);
+
+	QFile::remove(legacy_path);
+	QFile::remove(written_path);
+	QFile::remove(rewritten_path);
+}
+
+BOOST_AUTO_TEST_CASE(test_index_matches_project)
+{
+	QString const dir(QDir::temp().absolutePath());
+	QString const legacy_path(tempFilePath("legacy-filters.ScanTailor"));
+	QString const project_path(tempFilePath("indexed.ScanTailor"));
+	QString const reindexed_path(tempFilePath("reindexed.ScanTailor"));
+	QString const index_path(ProjectIndex::indexPathFor(project_path));
+
+	BOOST_REQUIRE(writeFile(legacy_path, legacyProject(dir, legacyFilterSettings())));
+
+	ProjectReader const reader(legacy_path);
+	BOOST_REQUIRE(reader.success());
+	std::vector<ProjectWriter::FilterPtr> const filters(createFilters());
+	reader.readFilterSettings(filters);
+
+	// Fragments are serialized on the first save and come
+	// from the fragment caches on the second one.
+	for (int pass = 0; pass < 2; ++pass) {
+		BOOST_REQUIRE(writeProject(reader, project_path, filters, true));
+		BOOST_CHECK_EQUAL(checkIndexMatchesProject(project_path), 2);
+	}
+
+	IntrusivePtr<ProjectIndex> const index(ProjectIndex::open(index_path, project_path));
+	BOOST_REQUIRE(index.get());
+	ProjectIndexSection const* deskew_section = index->section("deskew");
+	BOOST_REQUIRE(deskew_section);
+	BOOST_REQUIRE_EQUAL(deskew_section->numEntries(), 2u);
+	BOOST_CHECK_EQUAL(deskew_section->entryId(0), 4);
+	BOOST_CHECK_EQUAL(deskew_section->entryId(1), 7);
+
+	// Settings loaded through the index are written out unchanged.
+	ProjectReader const indexed_reader(project_path, index_path);
+	BOOST_REQUIRE(indexed_reader.success());
+	std::vector<ProjectWriter::FilterPtr> const indexed_filters(createFilters());
+	indexed_reader.readFilterSettings(indexed_filters);
+	BOOST_REQUIRE(writeProject(indexed_reader, reindexed_path, indexed_filters, true));
+	BOOST_CHECK(readFile(reindexed_path) == readFile(project_path));
+	BOOST_CHECK_EQUAL(checkIndexMatchesProject(reindexed_path), 2);
+
+	// An edit that keeps the size, done within the same second,
+	// still makes the index stale.
+	{
+		QByteArray const original(readFile(project_path));
+		QByteArray edited(original);
+		int const pos = edited.indexOf("<project");
+		BOOST_REQUIRE(pos >= 0);
+		edited[pos + 1] = 'P';
+		BOOST_REQUIRE(writeFile(project_path, edited));
+		BOOST_CHECK(!ProjectIndex::open(index_path, project_path).get());
+
+		BOOST_REQUIRE(writeFile(project_path, original));
+		BOOST_CHECK(ProjectIndex::open(index_path, project_path).get());
+	}
+
+	// A project file modified behind the index's back makes it stale.
+	{
+		QFile file(project_path);
+		BOOST_REQUIRE(file.open(QIODevice::Append));
+		file.write("\n");
+	}
+	BOOST_CHECK(!ProjectIndex::open(index_path, project_path).get());
+
+	// Saving without an index doesn't leave a stale one behind.
+	BOOST_REQUIRE(writeProject(reader, project_path, filters, false));
+	BOOST_CHECK(!QFile::exists(index_path));
+
+	QFile::remove(legacy_path);
+	QFile::remove(project_path);
+	QFile::remove(reindexed_path);
+	QFile::remove(ProjectIndex::indexPathFor(reindexed_path));
+}
+
+BOOST_AUTO_TEST_CASE(test_broken_project)
+{
+	QString const path(tempFilePath("broken.ScanTailor"));
+	QByteArray const legacy(legacyProject(QDir::temp().absolutePath()));
+	BOOST_REQUIRE(writeFile(path, legacy.left(legacy.size() / 2)));
+
+	BOOST_CHECK(!ProjectReader(path).success());
+	BOOST_CHECK(!ProjectReader(tempFilePath("missing.ScanTailor")).success());
+
+	QFile::remove(path);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace Tests
@@ -0,0 +1,57 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "TestUtils.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QString>
+
+namespace Tests
+{
+
+namespace utils
+{
+
+QString tempPath(QString const& name)
+{
+	return QDir::temp().filePath(
+		QString("scantailor-test-%1-%2").arg(QCoreApplication::applicationPid()).arg(name)
+	);
+}
+
+void removeDirectory(QString const& path)
+{
+	QFileInfoList const entries(
+		QDir(path).entryInfoList(QDir::Dirs|QDir::Files|QDir::Hidden|QDir::NoDotAndDotDot)
+	);
+	for (int i = 0; i < entries.size(); ++i) {
+		QFileInfo const& entry = entries[i];
+		if (entry.isDir()) {
+			removeDirectory(entry.filePath());
+		} else {
+			QFile::remove(entry.filePath());
+		}
+	}
+	QDir().rmdir(path);
+}
+
+} // namespace utils
+
+} // namespace Tests
@@ -0,0 +1,45 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TESTS_TEST_UTILS_H_
+#define TESTS_TEST_UTILS_H_
+
+class QString;
+
+namespace Tests
+{
+
+namespace utils
+{
+
+/**
+ * A path in the system's temporary directory, unique to this process.
+ * Nothing is created there.
+ */
+QString tempPath(QString const& name);
+
+/**
+ * Removes a directory along with everything in it.
+ */
+void removeDirectory(QString const& path);
+
+} // namespace utils
+
+} // namespace Tests
+
+#endif